@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <fmt/format.h>
+#include <glm/ext.hpp>
+
+#include "scene/SceneProcessing.hpp"
+
+
+// Every benchmark reports elements and bytes per second plus the time per element. Synthetic
+// inputs are sized by the argument, bundled assets are taken as is.
+
+static constexpr std::uint32_t RANDOM_SEED = 42;
+static constexpr std::uint32_t RELEMS_PER_MESH = 4;
+static constexpr std::uint32_t INSTANCES_PER_MESH = 8;
+static constexpr int NODE_CHILDREN = 4;
+
+static constexpr const char* DARK_TOWN_SCENE =
+  GRAPHICS_COURSE_RESOURCES_ROOT "/scenes/low_poly_dark_town/scene.gltf";
+static constexpr const char* AVOCADO_SCENE =
+  GRAPHICS_COURSE_RESOURCES_ROOT "/scenes/Avocado/Avocado.gltf";
+
+// Interleaved like most exported glTF files, tangents have a handedness in w
+struct SourceVertex
+{
+  glm::vec3 position;
+  glm::vec3 normal;
+  glm::vec4 tangent;
+  glm::vec2 texcoord;
+};
+
+static void set_throughput(benchmark::State& state, std::size_t elements, std::size_t bytes)
+{
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(elements));
+  state.SetBytesProcessed(state.iterations() * static_cast<std::int64_t>(bytes));
+  // Inverted rates are printed as time, e.g. "2.7ns"
+  state.counters["time/element"] = benchmark::Counter(
+    static_cast<double>(elements),
+    benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+}
+
+static glm::vec3 random_unit_vector(std::mt19937& rng)
+{
+  std::normal_distribution<float> distribution;
+  return glm::normalize(glm::vec3{distribution(rng), distribution(rng), distribution(rng)});
+}
+
+static std::vector<SourceVertex> make_source_vertices(std::size_t count)
+{
+  std::mt19937 rng{RANDOM_SEED};
+  std::uniform_real_distribution<float> distribution{-100.0f, 100.0f};
+
+  std::vector<SourceVertex> vertices(count);
+  for (auto& [position, normal, tangent, texcoord] : vertices)
+  {
+    position = {distribution(rng), distribution(rng), distribution(rng)};
+    normal = random_unit_vector(rng);
+    tangent = glm::vec4(random_unit_vector(rng), 1.0f);
+    texcoord = {distribution(rng), distribution(rng)};
+  }
+  return vertices;
+}
+
+static void BM_EncodeNormal(benchmark::State& state)
+{
+  const auto count = static_cast<std::size_t>(state.range(0));
+  std::mt19937 rng{RANDOM_SEED};
+  std::vector<glm::vec3> normals(count);
+  for (auto& normal : normals)
+    normal = random_unit_vector(rng);
+  std::vector<std::uint32_t> encoded(count);
+
+  for (auto _ : state)
+  {
+    for (std::size_t i = 0; i < count; ++i)
+      encoded[i] = encode_normal(normals[i]);
+    benchmark::DoNotOptimize(encoded);
+    benchmark::ClobberMemory();
+  }
+
+  set_throughput(state, count, count * sizeof(glm::vec3));
+}
+BENCHMARK(BM_EncodeNormal)->RangeMultiplier(16)->Range(1 << 10, 1 << 22);
+
+static void BM_RecodeVertices(benchmark::State& state)
+{
+  const auto count = static_cast<std::size_t>(state.range(0));
+  const auto source = make_source_vertices(count);
+  const auto* base = reinterpret_cast<const std::byte*>(source.data());
+  const VertexStreams streams{
+    .count = count,
+    .position = {base + offsetof(SourceVertex, position), sizeof(SourceVertex)},
+    .normal = {base + offsetof(SourceVertex, normal), sizeof(SourceVertex)},
+    .tangent = {base + offsetof(SourceVertex, tangent), sizeof(SourceVertex)},
+    .texcoord = {base + offsetof(SourceVertex, texcoord), sizeof(SourceVertex)},
+  };
+
+  std::vector<SceneVertex> vertices;
+  vertices.reserve(count);
+  for (auto _ : state)
+  {
+    vertices.clear();
+    recode_vertices(streams, vertices);
+    benchmark::DoNotOptimize(vertices);
+    benchmark::ClobberMemory();
+  }
+
+  set_throughput(state, count, count * sizeof(SourceVertex));
+}
+BENCHMARK(BM_RecodeVertices)->RangeMultiplier(16)->Range(1 << 10, 1 << 22);
+
+static void BM_WidenIndices(benchmark::State& state)
+{
+  const auto count = static_cast<std::size_t>(state.range(0));
+  std::mt19937 rng{RANDOM_SEED};
+  std::vector<std::uint16_t> source(count);
+  for (auto& index : source)
+    index = static_cast<std::uint16_t>(rng());
+
+  std::vector<std::uint32_t> indices;
+  indices.reserve(count);
+  for (auto _ : state)
+  {
+    indices.clear();
+    widen_indices(reinterpret_cast<const std::byte*>(source.data()), count, indices);
+    benchmark::DoNotOptimize(indices);
+    benchmark::ClobberMemory();
+  }
+
+  set_throughput(state, count, count * sizeof(std::uint16_t));
+}
+BENCHMARK(BM_WidenIndices)->RangeMultiplier(16)->Range(1 << 10, 1 << 22);
+
+// A tree where every node has a mesh, NODE_CHILDREN children each and a full TRS transform
+static tinygltf::Model make_node_tree(std::size_t node_count)
+{
+  tinygltf::Model model;
+  model.nodes.resize(node_count);
+  for (std::size_t i = 0; i < node_count; ++i)
+  {
+    auto& node = model.nodes[i];
+    node.mesh = 0;
+    node.translation = {1.0, 2.0, 3.0};
+    node.rotation = {0.0, 0.38268343236, 0.0, 0.92387953251};
+    node.scale = {1.5, 1.5, 1.5};
+    if (i > 0)
+      model.nodes[(i - 1) / NODE_CHILDREN].children.push_back(static_cast<int>(i));
+  }
+
+  model.scenes.emplace_back().nodes = {0};
+  model.defaultScene = 0;
+  return model;
+}
+
+static void BM_ProcessInstances(benchmark::State& state)
+{
+  const auto count = static_cast<std::size_t>(state.range(0));
+  const auto model = make_node_tree(count);
+
+  for (auto _ : state)
+  {
+    auto instances = process_instances(model);
+    benchmark::DoNotOptimize(instances);
+  }
+
+  set_throughput(state, count, count * sizeof(glm::mat4x4));
+}
+BENCHMARK(BM_ProcessInstances)->RangeMultiplier(16)->Range(1 << 8, 1 << 18);
+
+static void BM_RelemInstanceOffsets(benchmark::State& state)
+{
+  const auto instanceCount = static_cast<std::size_t>(state.range(0));
+  const auto meshCount = std::max<std::size_t>(instanceCount / INSTANCES_PER_MESH, 1);
+
+  std::vector<Mesh> meshes(meshCount);
+  for (std::size_t i = 0; i < meshCount; ++i)
+    meshes[i] = Mesh{
+      .firstRelem = static_cast<std::uint32_t>(i * RELEMS_PER_MESH),
+      .relemCount = RELEMS_PER_MESH,
+    };
+
+  std::mt19937 rng{RANDOM_SEED};
+  std::uniform_int_distribution<std::uint32_t> distribution{
+    0, static_cast<std::uint32_t>(meshCount - 1)};
+  std::vector<std::uint32_t> instanceMeshes(instanceCount);
+  for (auto& meshIdx : instanceMeshes)
+    meshIdx = distribution(rng);
+
+  std::vector<std::uint32_t> offsets(meshCount * RELEMS_PER_MESH);
+  for (auto _ : state)
+  {
+    auto total = compute_relem_instance_offsets(meshes, instanceMeshes, offsets);
+    benchmark::DoNotOptimize(total);
+    benchmark::ClobberMemory();
+  }
+
+  set_throughput(state, instanceCount, instanceCount * sizeof(std::uint32_t));
+}
+BENCHMARK(BM_RelemInstanceOffsets)->RangeMultiplier(16)->Range(1 << 10, 1 << 22);
+
+// Assets are loaded once per process, images are skipped as no kernel here reads them
+static const tinygltf::Model* load_asset(const std::string& path)
+{
+  static std::map<std::string, std::optional<tinygltf::Model>> assets;
+  if (auto it = assets.find(path); it != assets.end())
+    return it->second ? &*it->second : nullptr;
+
+  tinygltf::TinyGLTF loader;
+  loader.SetImageLoader(
+    [](
+      tinygltf::Image*,
+      int,
+      std::string*,
+      std::string*,
+      int,
+      int,
+      const unsigned char*,
+      int,
+      void*) { return true; },
+    nullptr);
+
+  tinygltf::Model model;
+  std::string error;
+  std::string warning;
+  auto& asset = assets[path];
+  if (loader.LoadASCIIFromFile(&model, &error, &warning, path))
+    asset = std::move(model);
+  return asset ? &*asset : nullptr;
+}
+
+static void BM_AssetMeshes(benchmark::State& state, const char* path)
+{
+  const auto* model = load_asset(path);
+  if (model == nullptr)
+  {
+    state.SkipWithError(fmt::format("Unable to load {}", path).c_str());
+    return;
+  }
+
+  std::size_t vertexCount = 0;
+  std::size_t bytes = 0;
+  std::vector<SceneVertex> vertices;
+  std::vector<std::uint32_t> indices;
+  for (auto _ : state)
+  {
+    vertices.clear();
+    indices.clear();
+    for (const auto& mesh : model->meshes)
+      for (const auto& prim : mesh.primitives)
+        if (prim.mode == TINYGLTF_MODE_TRIANGLES)
+        {
+          recode_vertices(vertex_streams(*model, prim), vertices);
+          append_indices(*model, model->accessors[prim.indices], indices);
+        }
+    benchmark::DoNotOptimize(vertices);
+    benchmark::DoNotOptimize(indices);
+    vertexCount = vertices.size();
+  }
+
+  // The whole buffers, these assets keep nothing but geometry in them
+  for (const auto& buffer : model->buffers)
+    bytes += buffer.data.size();
+  set_throughput(state, vertexCount, bytes);
+}
+BENCHMARK_CAPTURE(BM_AssetMeshes, low_poly_dark_town, DARK_TOWN_SCENE)
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_AssetMeshes, avocado, AVOCADO_SCENE)->Unit(benchmark::kMillisecond);
+
+static void BM_AssetInstances(benchmark::State& state, const char* path)
+{
+  const auto* model = load_asset(path);
+  if (model == nullptr)
+  {
+    state.SkipWithError(fmt::format("Unable to load {}", path).c_str());
+    return;
+  }
+
+  for (auto _ : state)
+  {
+    auto instances = process_instances(*model);
+    benchmark::DoNotOptimize(instances);
+  }
+
+  set_throughput(state, model->nodes.size(), model->nodes.size() * sizeof(glm::mat4x4));
+}
+BENCHMARK_CAPTURE(BM_AssetInstances, low_poly_dark_town, DARK_TOWN_SCENE);
+
+BENCHMARK_MAIN();
@@ -13,6 +13,30 @@ define_property(TARGET PROPERTY INTERFACE_SHADER_INCLUDE_DIRECTORIES
 
 find_program(glslang_validator glslangValidator)
 
+set(SHADER_OPTIMIZATION "NONE" CACHE STRING
+  "spirv-opt pass set applied to all shaders: NONE, PERFORMANCE (-O) or SIZE (-Os)")
+set_property(CACHE SHADER_OPTIMIZATION PROPERTY STRINGS NONE PERFORMANCE SIZE)
+option(SHADER_STRIP_DEBUG_INFO "Strip names and source info from shaders in Release builds" OFF)
+
+if(NOT SHADER_OPTIMIZATION STREQUAL "NONE")
+  find_program(spirv_opt spirv-opt REQUIRED)
+  # Only needed for the instruction count report, which is skipped without it
+  find_program(spirv_dis spirv-dis)
+  if(NOT spirv_dis)
+    message(WARNING "spirv-dis was not found, shader instruction counts won't be reported")
+  endif()
+endif()
+
+if(SHADER_OPTIMIZATION STREQUAL "PERFORMANCE")
+  set(spirv_opt_flags -O)
+elseif(SHADER_OPTIMIZATION STREQUAL "SIZE")
+  set(spirv_opt_flags -Os)
+elseif(NOT SHADER_OPTIMIZATION STREQUAL "NONE")
+  message(FATAL_ERROR "Unknown SHADER_OPTIMIZATION ${SHADER_OPTIMIZATION}")
+endif()
+
+set(spirv_report_script "${CMAKE_CURRENT_LIST_DIR}/spirv_report.cmake")
+
 # Wokrs same way as target_include_directories, i.e. PUBLIC/PRIVATE/INTERFACE are supported
 function(target_shader_include_directories tgt)
   list(POP_FRONT ${ARGN})
@@ -43,24 +67,57 @@ function(target_add_shaders tgt)
 
   set(incl_dirs "$<TARGET_GENEX_EVAL:${tgt},$<TARGET_PROPERTY:${tgt},SHADER_INCLUDE_DIRECTORIES>>")
 
+  set(instruction_reports)
   foreach(glsl_path ${ARGN})
     set(input_path "${CMAKE_CURRENT_LIST_DIR}/${glsl_path}")
     set(output_path "${shader_binaries_dir}/$<PATH:GET_FILENAME,${glsl_path}>.spv")
+
+    # With optimization on, glslang's output is kept next to the binary for the report.
+    # It has to stay the first output, the depfile written by glslang names it as the target.
+    set(glslang_output_path ${output_path})
+    set(outputs ${output_path})
+    set(optimization_commands)
+    if(spirv_opt_flags)
+      set(glslang_output_path "${output_path}.unoptimized")
+      set(outputs ${glslang_output_path} ${output_path})
+      list(APPEND optimization_commands
+        COMMAND ${spirv_opt} ${spirv_opt_flags} ${glslang_output_path} -o ${output_path})
+      if(spirv_dis)
+        list(APPEND outputs "${output_path}.instructions")
+        list(APPEND optimization_commands
+          COMMAND ${CMAKE_COMMAND}
+            -DSPIRV_DIS=${spirv_dis}
+            -DBEFORE=${glslang_output_path}
+            -DAFTER=${output_path}
+            -DOUTPUT=${output_path}.instructions
+            -P ${spirv_report_script})
+        list(APPEND instruction_reports "${output_path}.instructions")
+      endif()
+    endif()
+
     add_custom_command(
-        OUTPUT ${output_path}
+        OUTPUT ${outputs}
         COMMAND ${CMAKE_COMMAND} -E make_directory ${shader_binaries_dir}
         COMMAND ${glslang_validator}
           "$<$<BOOL:${incl_dirs}>:-I$<JOIN:${incl_dirs},;-I>>"
           "$<$<CONFIG:Debug>:-g>"
+          "$<$<AND:$<BOOL:${SHADER_STRIP_DEBUG_INFO}>,$<CONFIG:Release>>:-g0>"
           -V
           ${input_path}
-          -o ${output_path}
-          --depfile "${output_path}.d"
+          -o ${glslang_output_path}
+          --depfile "${glslang_output_path}.d"
+        ${optimization_commands}
         VERBATIM
         COMMAND_EXPAND_LISTS
         DEPENDS ${input_path}
-        DEPFILE "${output_path}.d"
+        DEPFILE "${glslang_output_path}.d"
       )
+    # Lets the application recompile the shader by itself, see ShaderHotReloader
+    file(GENERATE
+      OUTPUT "${output_path}.reload"
+      CONTENT "${input_path}\n$<$<BOOL:${incl_dirs}>:$<JOIN:${incl_dirs},\n>\n>"
+      TARGET ${tgt}
+    )
     list(APPEND SPIRV_BINARY_FILES ${output_path})
   endforeach(glsl_path)
 
@@ -73,6 +130,21 @@ function(target_add_shaders tgt)
       TRANSITIVE_COMPILE_PROPERTIES "SHADER_INCLUDE_DIRECTORIES"
     )
 
+    # Sum of the per-shader reports, meant to be compared between revisions in review
+    if(instruction_reports)
+      set(summary_path "${shader_binaries_dir}/instruction_counts.txt")
+      add_custom_command(
+        OUTPUT ${summary_path}
+        COMMAND ${CMAKE_COMMAND}
+          "-DREPORTS=${instruction_reports}"
+          -DOUTPUT=${summary_path}
+          -P ${spirv_report_script}
+        VERBATIM
+        DEPENDS ${instruction_reports} ${spirv_report_script}
+      )
+      list(APPEND SPIRV_BINARY_FILES ${summary_path})
+    endif()
+
     add_custom_target(${custom_target_name} DEPENDS ${SPIRV_BINARY_FILES})
     add_dependencies(${tgt} ${custom_target_name})
     add_compile_definitions(${tgt}
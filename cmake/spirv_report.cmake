@@ -0,0 +1,54 @@
+# Instruction counts of shaders before and after spirv-opt, run by target_add_shaders in script
+# mode. For one shader:
+#   -DSPIRV_DIS=<spirv-dis> -DBEFORE=<unoptimized.spv> -DAFTER=<optimized.spv> -DOUTPUT=<file>
+# For a list of per-shader reports, also printing the totals:
+#   "-DREPORTS=<report>;<report>..." -DOUTPUT=<file>
+
+function(count_instructions spirv_path out_var)
+  execute_process(
+    COMMAND ${SPIRV_DIS} --no-header --no-color ${spirv_path}
+    OUTPUT_VARIABLE disassembly
+    RESULT_VARIABLE result
+  )
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Unable to disassemble ${spirv_path}")
+  endif()
+
+  # Every instruction takes one line, counting the lines is enough
+  string(REGEX MATCHALL "\n" lines "${disassembly}")
+  list(LENGTH lines count)
+  set(${out_var} ${count} PARENT_SCOPE)
+endfunction()
+
+if(DEFINED REPORTS)
+  set(reports ${REPORTS})
+  list(SORT reports)
+
+  set(summary "")
+  set(total_before 0)
+  set(total_after 0)
+  foreach(report ${reports})
+    file(READ ${report} line)
+    string(APPEND summary "${line}")
+    string(REGEX MATCH ": ([0-9]+) -> ([0-9]+)" _ "${line}")
+    math(EXPR total_before "${total_before} + ${CMAKE_MATCH_1}")
+    math(EXPR total_after "${total_after} + ${CMAKE_MATCH_2}")
+  endforeach()
+
+  string(APPEND summary "total: ${total_before} -> ${total_after} instructions\n")
+  file(WRITE ${OUTPUT} "${summary}")
+  message(STATUS "Shader instructions: ${total_before} -> ${total_after}, see ${OUTPUT}")
+  return()
+endif()
+
+count_instructions(${BEFORE} before)
+count_instructions(${AFTER} after)
+
+if(before GREATER 0)
+  math(EXPR change "(${after} - ${before}) * 100 / ${before}")
+else()
+  set(change 0)
+endif()
+
+cmake_path(GET AFTER FILENAME name)
+file(WRITE ${OUTPUT} "${name}: ${before} -> ${after} instructions (${change}%)\n")
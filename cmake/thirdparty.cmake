@@ -62,3 +62,29 @@ CPMAddPackage(
   GITHUB_REPOSITORY Naios/function2
   GIT_TAG 4.2.4
 )
+
+# GLSL to SPIR-V compiler, used as a library for in-process shader hot reload
+CPMAddPackage(
+  NAME glslang
+  GITHUB_REPOSITORY KhronosGroup/glslang
+  GIT_TAG 15.1.0
+  OPTIONS
+    "ENABLE_OPT OFF"
+    "ENABLE_HLSL OFF"
+    "ENABLE_GLSLANG_BINARIES OFF"
+    "GLSLANG_TESTS OFF"
+    "GLSLANG_ENABLE_INSTALL OFF"
+)
+
+# Microbenchmark framework, only for the optional benchmarks
+if (GRAPHICS_COURSE_BENCHMARKS)
+  CPMAddPackage(
+    NAME benchmark
+    GITHUB_REPOSITORY google/benchmark
+    GIT_TAG v1.9.1
+    OPTIONS
+      "BENCHMARK_ENABLE_TESTING OFF"
+      "BENCHMARK_ENABLE_INSTALL OFF"
+      "BENCHMARK_ENABLE_GTEST_TESTS OFF"
+  )
+endif ()
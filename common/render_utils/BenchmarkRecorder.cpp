@@ -0,0 +1,259 @@
+#include "BenchmarkRecorder.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <sstream>
+
+#include <etna/Assert.hpp>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+
+static constexpr double MISSING = std::numeric_limits<double>::quiet_NaN();
+
+// Nearest-rank percentile of sorted values
+static double percentile(std::span<const double> sorted, double fraction)
+{
+  const auto rank =
+    static_cast<std::size_t>(std::ceil(fraction * static_cast<double>(sorted.size())));
+  return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+}
+
+void BenchmarkRecorder::beginFrame()
+{
+  frames.emplace_back(metrics.size(), MISSING);
+}
+
+void BenchmarkRecorder::record(std::string_view metric, double value)
+{
+  ETNA_VERIFYF(!frames.empty(), "Benchmark metric {} recorded before the first frame", metric);
+
+  auto it = metricIndices.find(metric);
+  if (it == metricIndices.end())
+  {
+    it = metricIndices.emplace(std::string(metric), metrics.size()).first;
+    metrics.emplace_back(metric);
+  }
+
+  auto& frame = frames.back();
+  if (frame.size() <= it->second)
+    frame.resize(it->second + 1, MISSING);
+  double& slot = frame[it->second];
+  slot = std::isnan(slot) ? value : slot + value;
+}
+
+std::vector<BenchmarkRecorder::Summary> BenchmarkRecorder::summarize() const
+{
+  std::vector<Summary> summaries;
+  std::vector<double> values;
+  for (std::size_t i = 0; i < metrics.size(); ++i)
+  {
+    values.clear();
+    for (const auto& frame : frames)
+      if (i < frame.size() && !std::isnan(frame[i]))
+        values.push_back(frame[i]);
+    if (values.empty())
+      continue;
+
+    std::ranges::sort(values);
+    summaries.push_back(
+      Summary{
+        .metric = metrics[i],
+        .frames = values.size(),
+        .min = values.front(),
+        .mean = std::accumulate(values.begin(), values.end(), 0.0) /
+          static_cast<double>(values.size()),
+        .p50 = percentile(values, 0.50),
+        .p95 = percentile(values, 0.95),
+        .p99 = percentile(values, 0.99),
+      });
+  }
+  return summaries;
+}
+
+bool BenchmarkRecorder::writeFrames(const std::filesystem::path& path) const
+{
+  std::ofstream file(path, std::ios::trunc);
+  file << "frame";
+  for (const auto& metric : metrics)
+    file << ",\"" << metric << '"';
+  file << '\n';
+
+  for (std::size_t frameIdx = 0; frameIdx < frames.size(); ++frameIdx)
+  {
+    file << frameIdx;
+    const auto& frame = frames[frameIdx];
+    for (std::size_t i = 0; i < metrics.size(); ++i)
+    {
+      file << ',';
+      if (i < frame.size() && !std::isnan(frame[i]))
+        file << fmt::format("{}", frame[i]);
+    }
+    file << '\n';
+  }
+
+  if (!file)
+  {
+    spdlog::error("Unable to write benchmark frames to {}", path.string());
+    return false;
+  }
+  return true;
+}
+
+bool BenchmarkRecorder::writeSummaries(
+  const std::filesystem::path& path, std::span<const Summary> summaries)
+{
+  std::ofstream file(path, std::ios::trunc);
+  file << "metric,frames,min,mean,p50,p95,p99\n";
+  for (const auto& summary : summaries)
+    file << fmt::format(
+      "\"{}\",{},{},{},{},{},{}\n",
+      summary.metric,
+      summary.frames,
+      summary.min,
+      summary.mean,
+      summary.p50,
+      summary.p95,
+      summary.p99);
+
+  if (!file)
+  {
+    spdlog::error("Unable to write benchmark summary to {}", path.string());
+    return false;
+  }
+  return true;
+}
+
+std::optional<std::vector<BenchmarkRecorder::Summary>> BenchmarkRecorder::readSummaries(
+  const std::filesystem::path& path)
+{
+  std::ifstream file(path);
+  if (!file.is_open())
+  {
+    spdlog::error("Unable to open benchmark baseline {}", path.string());
+    return std::nullopt;
+  }
+
+  std::vector<Summary> summaries;
+  std::string line;
+  // Skips the header
+  std::getline(file, line);
+  for (std::size_t lineIdx = 2; std::getline(file, line); ++lineIdx)
+  {
+    if (line.empty())
+      continue;
+
+    // Metric names are quoted, the numbers after them are separated by commas
+    const auto nameEnd = line.find('"', 1);
+    if (!line.starts_with('"') || nameEnd == std::string::npos)
+    {
+      spdlog::error("Malformed benchmark summary at {}:{}", path.string(), lineIdx);
+      return std::nullopt;
+    }
+
+    Summary summary{.metric = line.substr(1, nameEnd - 1)};
+    auto numbers = line.substr(nameEnd + 1);
+    std::ranges::replace(numbers, ',', ' ');
+    std::istringstream fields{numbers};
+    fields >> summary.frames >> summary.min >> summary.mean >> summary.p50 >> summary.p95 >>
+      summary.p99;
+    if (fields.fail())
+    {
+      spdlog::error("Malformed benchmark summary at {}:{}", path.string(), lineIdx);
+      return std::nullopt;
+    }
+    summaries.push_back(std::move(summary));
+  }
+  return summaries;
+}
+
+std::vector<BenchmarkRecorder::Regression> BenchmarkRecorder::findRegressions(
+  std::span<const Summary> current, std::span<const Summary> baseline, double threshold)
+{
+  std::vector<Regression> regressions;
+  for (const auto& summary : current)
+  {
+    if (!summary.metric.ends_with(TIME_METRIC_SUFFIX))
+      continue;
+    const auto base = std::ranges::find(baseline, summary.metric, &Summary::metric);
+    if (base == baseline.end())
+      continue;
+
+    const std::array<std::pair<std::string_view, double Summary::*>, 2> statistics{{
+      {"mean", &Summary::mean},
+      {"p95", &Summary::p95},
+    }};
+    for (const auto& [statistic, member] : statistics)
+    {
+      const double baseValue = (*base).*member;
+      const double value = summary.*member;
+      if (value > baseValue * (1.0 + threshold))
+        regressions.push_back(
+          Regression{
+            .metric = summary.metric,
+            .statistic = statistic,
+            .baseline = baseValue,
+            .current = value,
+          });
+    }
+  }
+  return regressions;
+}
+
+bool BenchmarkRecorder::writeReport(
+  const std::filesystem::path& output_prefix,
+  const std::filesystem::path& baseline_path,
+  double threshold) const
+{
+  const auto summaries = summarize();
+
+  spdlog::info("Benchmark over {} frames:", frames.size());
+  spdlog::info(
+    "{:<40} {:>10} {:>10} {:>10} {:>10} {:>10}", "metric", "min", "mean", "p50", "p95", "p99");
+  for (const auto& summary : summaries)
+    spdlog::info(
+      "{:<40} {:>10.3f} {:>10.3f} {:>10.3f} {:>10.3f} {:>10.3f}",
+      summary.metric,
+      summary.min,
+      summary.mean,
+      summary.p50,
+      summary.p95,
+      summary.p99);
+
+  auto framesPath = output_prefix;
+  framesPath += "_frames.csv";
+  auto summaryPath = output_prefix;
+  summaryPath += "_summary.csv";
+  const bool written = writeFrames(framesPath) && writeSummaries(summaryPath, summaries);
+  if (written)
+    spdlog::info(
+      "Benchmark results written to {} and {}", framesPath.string(), summaryPath.string());
+
+  if (baseline_path.empty())
+    return written;
+
+  const auto baseline = readSummaries(baseline_path);
+  if (!baseline)
+    return false;
+
+  const auto regressions = findRegressions(summaries, *baseline, threshold);
+  for (const auto& regression : regressions)
+    spdlog::error(
+      "{} {} regressed from {:.3f} to {:.3f} (+{:.1f}%)",
+      regression.metric,
+      regression.statistic,
+      regression.baseline,
+      regression.current,
+      (regression.current / regression.baseline - 1.0) * 100.0);
+  if (regressions.empty())
+    spdlog::info(
+      "No times regressed by more than {:.1f}% against {}",
+      threshold * 100.0,
+      baseline_path.string());
+
+  return written && regressions.empty();
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+/**
+ * Per-frame values of named metrics over a benchmark run: frame times, GPU scope times,
+ * counters. A metric can be missing from some frames, e.g. a shadow cascade that was not
+ * rendered, such frames are left out of its statistics.
+ *
+ * Summaries are written as CSV and can be read back as the baseline of a later run.
+ * Only times, metrics named "... ms", are checked for regressions. Counters are kept in the
+ * summaries to explain them, more or fewer of something is not better or worse by itself.
+ */
+class BenchmarkRecorder
+{
+public:
+  static constexpr std::string_view TIME_METRIC_SUFFIX = " ms";
+
+  struct Summary
+  {
+    std::string metric;
+    std::size_t frames = 0;
+    double min = 0;
+    double mean = 0;
+    double p50 = 0;
+    double p95 = 0;
+    double p99 = 0;
+  };
+
+  struct Regression
+  {
+    std::string metric;
+    std::string_view statistic;
+    double baseline;
+    double current;
+  };
+
+  void beginFrame();
+  // Values recorded for the same metric within a frame are summed up
+  void record(std::string_view metric, double value);
+
+  std::size_t getFrameCount() const { return frames.size(); }
+
+  // Metrics in the order they were first recorded
+  std::vector<Summary> summarize() const;
+
+  // One row per frame, one column per metric, missing values are left empty
+  bool writeFrames(const std::filesystem::path& path) const;
+
+  static bool writeSummaries(
+    const std::filesystem::path& path, std::span<const Summary> summaries);
+  static std::optional<std::vector<Summary>> readSummaries(const std::filesystem::path& path);
+
+  // Means and 95th percentiles of times that grew by more than the threshold, a fraction of
+  // the baseline value. Metrics missing from either side are skipped.
+  static std::vector<Regression> findRegressions(
+    std::span<const Summary> current, std::span<const Summary> baseline, double threshold);
+
+  // Logs the summaries, writes <prefix>_frames.csv and <prefix>_summary.csv and compares to
+  // the baseline summary unless its path is empty. False if anything failed or regressed.
+  bool writeReport(
+    const std::filesystem::path& output_prefix,
+    const std::filesystem::path& baseline_path,
+    double threshold) const;
+
+private:
+  std::vector<std::string> metrics;
+  std::map<std::string, std::size_t, std::less<>> metricIndices;
+  // NaN marks metrics that were not recorded in a frame
+  std::vector<std::vector<double>> frames;
+};
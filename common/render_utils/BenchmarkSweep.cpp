@@ -0,0 +1,64 @@
+#include "BenchmarkSweep.hpp"
+
+#include <algorithm>
+
+#include <etna/Assert.hpp>
+#include <spdlog/spdlog.h>
+
+
+double BenchmarkSweep::StepResult::mean(std::string_view metric) const
+{
+  const auto it = std::ranges::find(summaries, metric, &BenchmarkRecorder::Summary::metric);
+  return it != summaries.end() ? it->mean : 0;
+}
+
+void BenchmarkSweep::start(Steps new_steps)
+{
+  ETNA_VERIFYF(!running, "Benchmark {} is already running", steps.name);
+  ETNA_VERIFYF(new_steps.count > 0, "Benchmark {} has no steps", new_steps.name);
+
+  steps = std::move(new_steps);
+  running = true;
+  step = 0;
+  frame = 0;
+  recorder = {};
+  results.clear();
+
+  spdlog::info(
+    "{}: {} steps, {} warmup and {} measured frames each",
+    steps.name,
+    steps.count,
+    steps.warmupFrames,
+    steps.measuredFrames);
+  steps.apply(step);
+}
+
+void BenchmarkSweep::update()
+{
+  if (!running || (steps.isReady && !steps.isReady()))
+    return;
+
+  if (frame++ < steps.warmupFrames)
+    return;
+
+  recorder.beginFrame();
+  steps.measure(recorder);
+  if (recorder.getFrameCount() < steps.measuredFrames)
+    return;
+
+  const StepResult result{recorder.summarize()};
+  auto& line = results.emplace_back(steps.describe(step, result));
+  spdlog::info("{}: {}", steps.name, line);
+
+  frame = 0;
+  recorder = {};
+
+  if (++step == steps.count)
+  {
+    running = false;
+    steps.restore();
+    return;
+  }
+
+  steps.apply(step);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <function2/function2.hpp>
+
+#include "BenchmarkRecorder.hpp"
+
+
+/**
+ * Measures the same metrics at every step of a sweep over some settings, e.g. thread or
+ * light counts. A step is applied, rendered for a few warmup frames, so that GPU results of
+ * the previous step that are still in flight don't count, and then measured. Once the last
+ * step is done the settings are restored.
+ *
+ * update() has to be called once per frame, after the frame was recorded.
+ */
+class BenchmarkSweep
+{
+public:
+  struct StepResult
+  {
+    std::vector<BenchmarkRecorder::Summary> summaries;
+
+    // Zero for metrics that were not recorded during the step
+    double mean(std::string_view metric) const;
+  };
+
+  struct Steps
+  {
+    // Prefix of the logged results
+    std::string name;
+    std::size_t count = 0;
+    std::uint32_t warmupFrames = 16;
+    std::uint32_t measuredFrames = 64;
+    // Switches to the settings of a step, before its warmup
+    fu2::unique_function<void(std::size_t step)> apply;
+    // Frames are not counted until this returns true, e.g. while pipelines are compiling
+    fu2::unique_function<bool()> isReady;
+    // Records the metrics of a measured frame
+    fu2::unique_function<void(BenchmarkRecorder& recorder)> measure;
+    // A line summarizing a finished step, it is logged and kept for display
+    fu2::unique_function<std::string(std::size_t step, const StepResult& result)> describe;
+    // Puts back the settings from before the sweep
+    fu2::unique_function<void()> restore;
+  };
+
+  // Results of a previous sweep are dropped, the first step is applied right away
+  void start(Steps steps);
+  void update();
+
+  bool isRunning() const { return running; }
+
+  // One line per finished step, kept until the next start
+  std::span<const std::string> getResults() const { return results; }
+
+private:
+  Steps steps;
+  bool running = false;
+  std::size_t step = 0;
+  std::uint32_t frame = 0;
+  BenchmarkRecorder recorder;
+  std::vector<std::string> results;
+};
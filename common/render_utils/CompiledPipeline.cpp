@@ -0,0 +1,189 @@
+#include "CompiledPipeline.hpp"
+
+#include <array>
+#include <fstream>
+
+#include <etna/GlobalContext.hpp>
+#include <etna/Assert.hpp>
+#include <glm/glm.hpp>
+#include <tracy/Tracy.hpp>
+
+
+static std::vector<std::uint32_t> read_spirv(const std::filesystem::path& path)
+{
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  ETNA_VERIFYF(file.is_open(), "Unable to open shader {}", path.string());
+
+  std::vector<std::uint32_t> code(static_cast<std::size_t>(file.tellg()) / sizeof(std::uint32_t));
+  file.seekg(0);
+  file.read(
+    reinterpret_cast<char*>(code.data()),
+    static_cast<std::streamsize>(code.size() * sizeof(std::uint32_t)));
+  return code;
+}
+
+static vk::ShaderStageFlagBits shader_stage(const std::filesystem::path& path)
+{
+  const auto extension = path.stem().extension();
+  if (extension == ".vert")
+    return vk::ShaderStageFlagBits::eVertex;
+  if (extension == ".frag")
+    return vk::ShaderStageFlagBits::eFragment;
+  ETNA_VERIFYF(extension == ".comp", "Unknown shader stage of {}", path.string());
+  return vk::ShaderStageFlagBits::eCompute;
+}
+
+static vk::UniqueShaderModule create_shader_module(const std::filesystem::path& path)
+{
+  const auto code = read_spirv(path);
+  return etna::unwrap_vk_result(etna::get_context().getDevice().createShaderModuleUnique(
+    vk::ShaderModuleCreateInfo{
+      .codeSize = code.size() * sizeof(std::uint32_t),
+      .pCode = code.data(),
+    }));
+}
+
+static vk::UniquePipelineLayout create_layout(
+  vk::DescriptorSetLayout set_layout,
+  std::span<const vk::DescriptorSetLayout> extra_set_layouts,
+  std::span<const vk::PushConstantRange> push_constants)
+{
+  std::vector<vk::DescriptorSetLayout> setLayouts{set_layout};
+  setLayouts.insert(setLayouts.end(), extra_set_layouts.begin(), extra_set_layouts.end());
+
+  return etna::unwrap_vk_result(etna::get_context().getDevice().createPipelineLayoutUnique(
+    vk::PipelineLayoutCreateInfo{
+      .setLayoutCount = static_cast<std::uint32_t>(setLayouts.size()),
+      .pSetLayouts = setLayouts.data(),
+      .pushConstantRangeCount = static_cast<std::uint32_t>(push_constants.size()),
+      .pPushConstantRanges = push_constants.data(),
+    }));
+}
+
+CompiledPipeline CompiledPipeline::createGraphics(
+  vk::DescriptorSetLayout set_layout,
+  std::span<const std::filesystem::path> shaders,
+  const GraphicsCreateInfo& info,
+  vk::PipelineCache cache)
+{
+  ZoneScoped;
+
+  auto device = etna::get_context().getDevice();
+
+  const vk::PushConstantRange pushConstants{
+    .stageFlags = vk::ShaderStageFlagBits::eVertex,
+    .offset = 0,
+    .size = sizeof(glm::mat4x4),
+  };
+  CompiledPipeline result;
+  result.layout = create_layout(set_layout, info.extraSetLayouts, {&pushConstants, 1});
+
+  std::vector<vk::UniqueShaderModule> modules;
+  std::vector<vk::PipelineShaderStageCreateInfo> stages;
+  for (const auto& shader : shaders)
+  {
+    modules.push_back(create_shader_module(shader));
+    stages.push_back(
+      vk::PipelineShaderStageCreateInfo{
+        .stage = shader_stage(shader),
+        .module = modules.back().get(),
+        .pName = "main",
+      });
+  }
+
+  const vk::VertexInputBindingDescription vertexBinding{
+    .binding = 0,
+    .stride = static_cast<std::uint32_t>(info.vertexFormat.stride),
+    .inputRate = vk::VertexInputRate::eVertex,
+  };
+  std::vector<vk::VertexInputAttributeDescription> vertexAttributes;
+  for (std::uint32_t location = 0; location < info.vertexFormat.attributes.size(); ++location)
+    vertexAttributes.push_back(
+      vk::VertexInputAttributeDescription{
+        .location = location,
+        .binding = 0,
+        .format = info.vertexFormat.attributes[location].format,
+        .offset = static_cast<std::uint32_t>(info.vertexFormat.attributes[location].offset),
+      });
+
+  const vk::PipelineVertexInputStateCreateInfo vertexInput{
+    .vertexBindingDescriptionCount = 1,
+    .pVertexBindingDescriptions = &vertexBinding,
+    .vertexAttributeDescriptionCount = static_cast<std::uint32_t>(vertexAttributes.size()),
+    .pVertexAttributeDescriptions = vertexAttributes.data(),
+  };
+  const vk::PipelineInputAssemblyStateCreateInfo inputAssembly{
+    .topology = vk::PrimitiveTopology::eTriangleList,
+  };
+  const vk::PipelineViewportStateCreateInfo viewport{
+    .viewportCount = 1,
+    .scissorCount = 1,
+  };
+  const vk::PipelineMultisampleStateCreateInfo multisample{
+    .rasterizationSamples = vk::SampleCountFlagBits::e1,
+  };
+  const std::vector<vk::PipelineColorBlendAttachmentState> blendAttachments(
+    info.colorAttachmentFormats.size(),
+    vk::PipelineColorBlendAttachmentState{
+      .blendEnable = vk::False,
+      .colorWriteMask = vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+        vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA,
+    });
+  const vk::PipelineColorBlendStateCreateInfo blending{
+    .attachmentCount = static_cast<std::uint32_t>(blendAttachments.size()),
+    .pAttachments = blendAttachments.data(),
+  };
+  const std::array dynamicStates{vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+  const vk::PipelineDynamicStateCreateInfo dynamicState{
+    .dynamicStateCount = static_cast<std::uint32_t>(dynamicStates.size()),
+    .pDynamicStates = dynamicStates.data(),
+  };
+  const vk::PipelineRenderingCreateInfo rendering{
+    .colorAttachmentCount = static_cast<std::uint32_t>(info.colorAttachmentFormats.size()),
+    .pColorAttachmentFormats = info.colorAttachmentFormats.data(),
+    .depthAttachmentFormat = info.depthAttachmentFormat,
+  };
+
+  result.pipeline = etna::unwrap_vk_result(device.createGraphicsPipelineUnique(
+    cache,
+    vk::GraphicsPipelineCreateInfo{
+      .pNext = &rendering,
+      .stageCount = static_cast<std::uint32_t>(stages.size()),
+      .pStages = stages.data(),
+      .pVertexInputState = &vertexInput,
+      .pInputAssemblyState = &inputAssembly,
+      .pViewportState = &viewport,
+      .pRasterizationState = &info.rasterization,
+      .pMultisampleState = &multisample,
+      .pDepthStencilState = &info.depth,
+      .pColorBlendState = &blending,
+      .pDynamicState = &dynamicState,
+      .layout = result.layout.get(),
+    }));
+  return result;
+}
+
+CompiledPipeline CompiledPipeline::createCompute(
+  vk::DescriptorSetLayout set_layout, const std::filesystem::path& shader, vk::PipelineCache cache)
+{
+  ZoneScoped;
+
+  auto device = etna::get_context().getDevice();
+
+  CompiledPipeline result;
+  result.layout = create_layout(set_layout, {}, {});
+
+  const auto module = create_shader_module(shader);
+  result.pipeline = etna::unwrap_vk_result(device.createComputePipelineUnique(
+    cache,
+    vk::ComputePipelineCreateInfo{
+      .stage =
+        vk::PipelineShaderStageCreateInfo{
+          .stage = vk::ShaderStageFlagBits::eCompute,
+          .module = module.get(),
+          .pName = "main",
+        },
+      .layout = result.layout.get(),
+    }));
+  return result;
+}
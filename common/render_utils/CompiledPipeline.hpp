@@ -0,0 +1,64 @@
+#pragma once
+
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include <etna/Vulkan.hpp>
+#include <etna/VertexInput.hpp>
+
+
+/**
+ * A pipeline created directly through Vulkan instead of etna's PipelineManager. Creating one
+ * touches no etna state, so the driver can compile it on any thread while the render thread
+ * keeps recording. The caller resolves the descriptor set layout of the program beforehand.
+ *
+ * Set 0 is the program's own, graphics programs may read further sets with layouts created
+ * outside of etna, e.g. SceneManager's bindless set. Graphics programs may push a projView
+ * matrix to the vertex stage, like all scene drawing code does. Color attachments are written
+ * without blending, viewport and scissor are dynamic.
+ */
+class CompiledPipeline
+{
+public:
+  struct GraphicsCreateInfo
+  {
+    etna::VertexByteStreamFormatDescription vertexFormat;
+    vk::PipelineRasterizationStateCreateInfo rasterization{
+      .polygonMode = vk::PolygonMode::eFill,
+      .cullMode = vk::CullModeFlagBits::eNone,
+      .frontFace = vk::FrontFace::eCounterClockwise,
+      .lineWidth = 1.f,
+    };
+    vk::PipelineDepthStencilStateCreateInfo depth{
+      .depthTestEnable = vk::True,
+      .depthWriteEnable = vk::True,
+      .depthCompareOp = vk::CompareOp::eLessOrEqual,
+      .maxDepthBounds = 1.f,
+    };
+    std::vector<vk::Format> colorAttachmentFormats;
+    vk::Format depthAttachmentFormat = vk::Format::eUndefined;
+    // Sets 1 and onwards
+    std::vector<vk::DescriptorSetLayout> extraSetLayouts;
+  };
+
+  CompiledPipeline() = default;
+
+  // Stages are taken from the extensions of the binaries, e.g. simple.vert.spv
+  static CompiledPipeline createGraphics(
+    vk::DescriptorSetLayout set_layout,
+    std::span<const std::filesystem::path> shaders,
+    const GraphicsCreateInfo& info,
+    vk::PipelineCache cache);
+  static CompiledPipeline createCompute(
+    vk::DescriptorSetLayout set_layout,
+    const std::filesystem::path& shader,
+    vk::PipelineCache cache);
+
+  vk::Pipeline getVkPipeline() const { return pipeline.get(); }
+  vk::PipelineLayout getVkPipelineLayout() const { return layout.get(); }
+
+private:
+  vk::UniquePipelineLayout layout;
+  vk::UniquePipeline pipeline;
+};
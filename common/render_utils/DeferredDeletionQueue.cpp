@@ -0,0 +1,18 @@
+#include "DeferredDeletionQueue.hpp"
+
+#include <etna/GlobalContext.hpp>
+
+
+DeferredDeletionQueue::DeferredDeletionQueue()
+  : framesInFlight{etna::get_context().getMainWorkCount().multiBufferingCount()}
+{
+}
+
+void DeferredDeletionQueue::beginFrame()
+{
+  ++frame;
+
+  // Whatever was retired while recording frame N may be used by frames up to N - 1
+  std::erase_if(
+    entries, [this](const Entry& entry) { return frame - entry.frame > framesInFlight; });
+}
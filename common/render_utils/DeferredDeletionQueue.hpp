@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+/**
+ * Keeps replaced GPU objects alive until none of the frames in flight can still be using them,
+ * so that they can be swapped out without waiting for the device to go idle.
+ */
+class DeferredDeletionQueue
+{
+public:
+  DeferredDeletionQueue();
+
+  template <class Resource>
+  void push(Resource resource)
+  {
+    entries.push_back(Entry{
+      .frame = frame,
+      .resource = std::make_shared<Resource>(std::move(resource)),
+    });
+  }
+
+  // Must be called once per frame after the command manager waited for the frame's slot,
+  // destroys everything the GPU is done with
+  void beginFrame();
+
+  DeferredDeletionQueue(const DeferredDeletionQueue&) = delete;
+  DeferredDeletionQueue& operator=(const DeferredDeletionQueue&) = delete;
+
+private:
+  struct Entry
+  {
+    std::uint64_t frame = 0;
+    std::shared_ptr<void> resource;
+  };
+
+  std::uint64_t frame = 0;
+  std::uint64_t framesInFlight = 0;
+  std::vector<Entry> entries;
+};
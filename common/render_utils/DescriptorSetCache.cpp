@@ -0,0 +1,213 @@
+#include "DescriptorSetCache.hpp"
+
+#include <array>
+#include <variant>
+
+#include <etna/GlobalContext.hpp>
+#include <etna/Etna.hpp>
+#include <tracy/Tracy.hpp>
+
+
+static constexpr std::uint32_t MAX_CACHED_SETS = 1024;
+static constexpr std::uint32_t MAX_DESCRIPTORS_PER_TYPE = 4096;
+
+template <class Handle>
+static std::uint64_t handle_bits(Handle handle)
+{
+  return reinterpret_cast<std::uint64_t>(static_cast<typename Handle::CType>(handle));
+}
+
+static vk::PipelineStageFlags2 shader_stages_to_pipeline_stages(vk::ShaderStageFlags stages)
+{
+  vk::PipelineStageFlags2 result{};
+  if (stages & vk::ShaderStageFlagBits::eVertex)
+    result |= vk::PipelineStageFlagBits2::eVertexShader;
+  if (stages & vk::ShaderStageFlagBits::eFragment)
+    result |= vk::PipelineStageFlagBits2::eFragmentShader;
+  if (stages & vk::ShaderStageFlagBits::eCompute)
+    result |= vk::PipelineStageFlagBits2::eComputeShader;
+  return result ? result : vk::PipelineStageFlagBits2::eAllCommands;
+}
+
+DescriptorSetCache::DescriptorSetCache()
+  : framesInFlight{etna::get_context().getMainWorkCount().multiBufferingCount()}
+{
+  const std::array poolSizes{
+    vk::DescriptorPoolSize{vk::DescriptorType::eUniformBuffer, MAX_DESCRIPTORS_PER_TYPE},
+    vk::DescriptorPoolSize{vk::DescriptorType::eStorageBuffer, MAX_DESCRIPTORS_PER_TYPE},
+    vk::DescriptorPoolSize{vk::DescriptorType::eCombinedImageSampler, MAX_DESCRIPTORS_PER_TYPE},
+    vk::DescriptorPoolSize{vk::DescriptorType::eSampledImage, MAX_DESCRIPTORS_PER_TYPE},
+    vk::DescriptorPoolSize{vk::DescriptorType::eStorageImage, MAX_DESCRIPTORS_PER_TYPE},
+    vk::DescriptorPoolSize{vk::DescriptorType::eSampler, MAX_DESCRIPTORS_PER_TYPE},
+  };
+
+  pool = etna::unwrap_vk_result(etna::get_context().getDevice().createDescriptorPoolUnique(
+    vk::DescriptorPoolCreateInfo{
+      .flags = vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
+      .maxSets = MAX_CACHED_SETS,
+      .poolSizeCount = static_cast<std::uint32_t>(poolSizes.size()),
+      .pPoolSizes = poolSizes.data(),
+    }));
+}
+
+std::size_t DescriptorSetCache::HashKey::operator()(const Key& key) const
+{
+  std::size_t hash = key.size();
+  for (auto word : key)
+    hash ^= std::hash<std::uint64_t>()(word) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+  return hash;
+}
+
+DescriptorSetCache::Key DescriptorSetCache::makeKey(
+  etna::DescriptorLayoutId layout_id,
+  std::span<const etna::Binding> bindings,
+  std::span<const RawImageBinding> raw_images)
+{
+  Key key;
+  key.reserve(1 + (bindings.size() + raw_images.size()) * 4);
+  key.push_back(static_cast<std::uint64_t>(layout_id));
+
+  for (const auto& binding : bindings)
+  {
+    key.push_back((static_cast<std::uint64_t>(binding.binding) << 32) | binding.arrayElem);
+
+    if (const auto* buffer = std::get_if<etna::BufferBinding>(&binding.resources))
+    {
+      key.push_back(handle_bits(buffer->descriptor_info.buffer));
+      key.push_back(buffer->descriptor_info.offset);
+      key.push_back(buffer->descriptor_info.range);
+    }
+    else
+    {
+      const auto& image = std::get<etna::ImageBinding>(binding.resources);
+      key.push_back(handle_bits(image.descriptor_info.sampler));
+      key.push_back(handle_bits(image.descriptor_info.imageView));
+      key.push_back(static_cast<std::uint64_t>(image.descriptor_info.imageLayout));
+    }
+  }
+
+  for (const auto& raw : raw_images)
+  {
+    key.push_back(static_cast<std::uint64_t>(raw.binding) << 32);
+    key.push_back(handle_bits(raw.info.sampler));
+    key.push_back(handle_bits(raw.info.imageView));
+    key.push_back(static_cast<std::uint64_t>(raw.info.imageLayout));
+  }
+
+  return key;
+}
+
+void DescriptorSetCache::beginFrame()
+{
+  ZoneScoped;
+
+  ++frame;
+
+  auto device = etna::get_context().getDevice();
+  // The last frame that used the set is guaranteed to be finished on the GPU
+  const auto tryFree = [&](const Entry& entry) {
+    if (frame - entry.lastUsedFrame <= framesInFlight)
+      return false;
+    ETNA_CHECK_VK_RESULT(device.freeDescriptorSets(pool.get(), {entry.set}));
+    return true;
+  };
+  std::erase_if(sets, [&](const auto& item) { return tryFree(item.second); });
+  std::erase_if(invalidatedSets, tryFree);
+}
+
+vk::DescriptorSet DescriptorSetCache::get(
+  etna::DescriptorLayoutId layout_id,
+  std::span<const etna::Binding> bindings,
+  std::span<const RawImageBinding> raw_images)
+{
+  auto key = makeKey(layout_id, bindings, raw_images);
+  if (auto it = sets.find(key); it != sets.end())
+  {
+    it->second.lastUsedFrame = frame;
+    return it->second.set;
+  }
+
+  ZoneScopedN("writeDescriptorSet");
+
+  auto& ctx = etna::get_context();
+  auto& layouts = ctx.getDescriptorSetLayouts();
+
+  const auto vkLayout = layouts.getVkLayout(layout_id);
+  auto allocated = etna::unwrap_vk_result(ctx.getDevice().allocateDescriptorSets(
+    vk::DescriptorSetAllocateInfo{
+      .descriptorPool = pool.get(),
+      .descriptorSetCount = 1,
+      .pSetLayouts = &vkLayout,
+    }));
+  const auto set = allocated.front();
+
+  const auto& layoutInfo = layouts.getLayoutInfo(layout_id);
+
+  std::vector<vk::WriteDescriptorSet> writes;
+  writes.reserve(bindings.size() + raw_images.size());
+  for (const auto& binding : bindings)
+  {
+    vk::WriteDescriptorSet write{
+      .dstSet = set,
+      .dstBinding = binding.binding,
+      .dstArrayElement = binding.arrayElem,
+      .descriptorCount = 1,
+      .descriptorType = layoutInfo.getBinding(binding.binding).descriptorType,
+    };
+
+    if (const auto* buffer = std::get_if<etna::BufferBinding>(&binding.resources))
+      write.pBufferInfo = &buffer->descriptor_info;
+    else
+      write.pImageInfo = &std::get<etna::ImageBinding>(binding.resources).descriptor_info;
+
+    writes.push_back(write);
+  }
+  for (const auto& raw : raw_images)
+    writes.push_back(vk::WriteDescriptorSet{
+      .dstSet = set,
+      .dstBinding = raw.binding,
+      .dstArrayElement = 0,
+      .descriptorCount = 1,
+      .descriptorType = layoutInfo.getBinding(raw.binding).descriptorType,
+      .pImageInfo = &raw.info,
+    });
+  ctx.getDevice().updateDescriptorSets(writes, {});
+
+  sets.emplace(std::move(key), Entry{.set = set, .lastUsedFrame = frame});
+  return set;
+}
+
+void DescriptorSetCache::requestStates(
+  vk::CommandBuffer cmd_buf,
+  etna::DescriptorLayoutId layout_id,
+  std::span<const etna::Binding> bindings) const
+{
+  const auto& layoutInfo = etna::get_context().getDescriptorSetLayouts().getLayoutInfo(layout_id);
+
+  for (const auto& binding : bindings)
+  {
+    const auto* image = std::get_if<etna::ImageBinding>(&binding.resources);
+    if (image == nullptr)
+      continue;
+
+    const auto& layoutBinding = layoutInfo.getBinding(binding.binding);
+    const auto access = layoutBinding.descriptorType == vk::DescriptorType::eStorageImage
+      ? vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite
+      : vk::AccessFlagBits2::eShaderSampledRead;
+
+    etna::set_state(
+      cmd_buf,
+      image->image.get(),
+      shader_stages_to_pipeline_stages(layoutBinding.stageFlags),
+      access,
+      image->descriptor_info.imageLayout,
+      image->image.getAspectMaskByFormat());
+  }
+}
+
+void DescriptorSetCache::invalidate()
+{
+  for (const auto& [key, entry] : sets)
+    invalidatedSets.push_back(entry);
+  sets.clear();
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include <etna/Vulkan.hpp>
+#include <etna/DescriptorSet.hpp>
+#include <etna/DescriptorSetLayout.hpp>
+
+
+/**
+ * Keeps descriptor sets alive across frames instead of allocating and writing them
+ * every frame with etna::create_descriptor_set. Sets are keyed by their layout and
+ * the exact resources bound (handles, offsets, ranges, image layouts), so a new set
+ * is written only when something it references changes. Sets that were not used
+ * for longer than the number of frames in flight are freed.
+ *
+ * Unlike etna::create_descriptor_set this does not request any barriers when a set
+ * is fetched, images have to be transitioned with requestStates() before use.
+ * Handles of destroyed resources may be reused by the driver, so invalidate() has to
+ * be called whenever bound resources are recreated. Replaced resources have to outlive
+ * the frames in flight, like the sets that reference them.
+ */
+class DescriptorSetCache
+{
+public:
+  // An image that is not an etna::Image, e.g. a transient image of a RenderGraph.
+  // Its state is up to whoever owns it, requestStates() ignores it.
+  struct RawImageBinding
+  {
+    std::uint32_t binding;
+    vk::DescriptorImageInfo info;
+  };
+
+  DescriptorSetCache();
+
+  // Must be called once per frame, frees sets that are not used anymore
+  void beginFrame();
+
+  vk::DescriptorSet get(
+    etna::DescriptorLayoutId layout_id,
+    std::span<const etna::Binding> bindings,
+    std::span<const RawImageBinding> raw_images = {});
+
+  // Requests the layouts images are bound with, flushed by the next etna::flush_barriers
+  void requestStates(
+    vk::CommandBuffer cmd_buf,
+    etna::DescriptorLayoutId layout_id,
+    std::span<const etna::Binding> bindings) const;
+
+  // Sets are not handed out anymore, they are freed once frames in flight are done with them
+  void invalidate();
+
+  std::size_t size() const { return sets.size(); }
+
+  DescriptorSetCache(const DescriptorSetCache&) = delete;
+  DescriptorSetCache& operator=(const DescriptorSetCache&) = delete;
+
+private:
+  using Key = std::vector<std::uint64_t>;
+
+  struct HashKey
+  {
+    std::size_t operator()(const Key& key) const;
+  };
+
+  struct Entry
+  {
+    vk::DescriptorSet set;
+    std::uint64_t lastUsedFrame = 0;
+  };
+
+  static Key makeKey(
+    etna::DescriptorLayoutId layout_id,
+    std::span<const etna::Binding> bindings,
+    std::span<const RawImageBinding> raw_images);
+
+private:
+  vk::UniqueDescriptorPool pool;
+  std::unordered_map<Key, Entry, HashKey> sets;
+  std::vector<Entry> invalidatedSets;
+  std::uint64_t frame = 0;
+  std::uint64_t framesInFlight = 0;
+};
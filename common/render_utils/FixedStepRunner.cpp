@@ -0,0 +1,86 @@
+#include "FixedStepRunner.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <utility>
+
+#include <spdlog/spdlog.h>
+#include <tracy/Tracy.hpp>
+
+
+// Covers the GPU results that lag behind by the frames in flight
+static constexpr std::uint32_t BENCHMARK_WARMUP_FRAMES = 16;
+
+FixedStepRunner::FixedStepRunner(RunOptions run_options, Hooks frame_hooks)
+  : options{std::move(run_options)}
+  , hooks{std::move(frame_hooks)}
+{
+}
+
+void FixedStepRunner::runHeadless()
+{
+  const auto start = std::chrono::steady_clock::now();
+  for (std::uint32_t frame = 0; frame < options.frameCount; ++frame)
+    drawFrame();
+  const std::chrono::duration<double, std::milli> elapsed =
+    std::chrono::steady_clock::now() - start;
+
+  // The CPU runs at most a couple of frames ahead, so this is close to the GPU's frame time
+  spdlog::info(
+    "Rendered {} headless frames at {}x{} in {:.1f} ms, {:.3f} ms per frame",
+    options.frameCount,
+    options.resolution.x,
+    options.resolution.y,
+    elapsed.count(),
+    elapsed.count() / std::max(options.frameCount, 1u));
+}
+
+bool FixedStepRunner::runBenchmark(
+  double camera_period, fu2::function_view<void(float time)> move_camera)
+{
+  // Pipelines that are still being compiled would be measured in their fallback state
+  move_camera(0);
+  for (std::uint32_t frame = 0;
+       frame < BENCHMARK_WARMUP_FRAMES || (hooks.isReady && !hooks.isReady());
+       ++frame)
+    if (!drawFrame())
+      return false;
+
+  BenchmarkRecorder recorder;
+  for (std::uint32_t frame = 0; frame < options.frameCount; ++frame)
+  {
+    const double cameraTime =
+      camera_period > 0 ? std::fmod(frame * FIXED_FRAME_TIME, camera_period) : 0.0;
+    move_camera(static_cast<float>(cameraTime));
+
+    const auto start = std::chrono::steady_clock::now();
+    if (!drawFrame())
+    {
+      spdlog::warn("Benchmark aborted after {} frames", frame);
+      return false;
+    }
+    const std::chrono::duration<double, std::milli> frameTime =
+      std::chrono::steady_clock::now() - start;
+
+    // GPU values are from the frame that was read back last, a couple of frames earlier
+    recorder.beginFrame();
+    recorder.record("Frame ms", frameTime.count());
+    hooks.reportMetrics(recorder);
+  }
+
+  return recorder.writeReport(
+    options.benchmarkOutput, options.baseline, options.regressionThreshold);
+}
+
+bool FixedStepRunner::drawFrame()
+{
+  if (!hooks.poll())
+    return false;
+
+  hooks.draw();
+  time += FIXED_FRAME_TIME;
+
+  FrameMark;
+  return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+
+#include <function2/function2.hpp>
+
+#include "BenchmarkRecorder.hpp"
+#include "RunOptions.hpp"
+
+
+/**
+ * Frame loop of headless runs and benchmarks, shared by the samples. Frames are
+ * FIXED_FRAME_TIME apart no matter how long they take, so every run renders the same images.
+ * The app passes in how to reach its window and renderer.
+ */
+class FixedStepRunner
+{
+public:
+  static constexpr double FIXED_FRAME_TIME = 1.0 / 60.0;
+
+  struct Hooks
+  {
+    // Pumps window events, false once the window was closed. Headless apps return true.
+    fu2::unique_function<bool()> poll;
+    // Updates the renderer with getTime() and draws a frame
+    fu2::unique_function<void()> draw;
+    // Measurement waits for this, e.g. while pipelines are still compiling. Optional.
+    fu2::unique_function<bool()> isReady;
+    // Adds the renderer's metrics of a measured frame
+    fu2::unique_function<void(BenchmarkRecorder& recorder)> reportMetrics;
+  };
+
+  FixedStepRunner(RunOptions options, Hooks hooks);
+
+  // Renders frameCount frames and logs how long they took
+  void runHeadless();
+
+  // Measures frameCount frames after a warmup and writes the report. The camera is moved
+  // by the same fixed step as the scene and loops after camera_period seconds.
+  // False if the window was closed, or the report could not be written or regressed.
+  bool runBenchmark(double camera_period, fu2::function_view<void(float time)> move_camera);
+
+  // False once the window is closed
+  bool drawFrame();
+
+  // Scene time of the frame being drawn
+  double getTime() const { return time; }
+
+private:
+  RunOptions options;
+  Hooks hooks;
+  double time = 0;
+};
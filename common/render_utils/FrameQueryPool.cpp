@@ -0,0 +1,84 @@
+#include "FrameQueryPool.hpp"
+
+#include <utility>
+
+#include <etna/GlobalContext.hpp>
+
+
+FrameQueryPool::FrameQueryPool(CreateInfo create_info)
+  : info{std::move(create_info)}
+  , frames{
+      etna::get_context().getMainWorkCount(),
+      [this](std::size_t) {
+        return FrameQueries{
+          .pool = etna::unwrap_vk_result(etna::get_context().getDevice().createQueryPoolUnique(
+            vk::QueryPoolCreateInfo{
+              .queryType = info.queryType,
+              .queryCount = info.maxScopes * info.queriesPerScope,
+              .pipelineStatistics = info.pipelineStatistics,
+            })),
+          .scopeNames = {},
+        };
+      }}
+{
+}
+
+bool FrameQueryPool::beginFrame(vk::CommandBuffer cmd_buf)
+{
+  auto& queries = frames.get();
+  const bool read = readBack(queries);
+
+  cmd_buf.resetQueryPool(queries.pool.get(), 0, info.maxScopes * info.queriesPerScope);
+  queries.scopeNames.clear();
+  return read;
+}
+
+std::uint32_t FrameQueryPool::addScope(std::string name)
+{
+  auto& queries = frames.get();
+  ETNA_VERIFYF(
+    queries.scopeNames.size() < info.maxScopes,
+    "{} ran out of its {} scopes",
+    info.name,
+    info.maxScopes);
+
+  const auto scope = static_cast<std::uint32_t>(queries.scopeNames.size());
+  queries.scopeNames.push_back(std::move(name));
+  return scope;
+}
+
+std::optional<std::span<const std::uint64_t>> FrameQueryPool::getReadValues(
+  std::size_t scope, std::uint32_t query) const
+{
+  const std::size_t stride = info.valuesPerQuery + 1;
+  const auto* values = &readData[(scope * info.queriesPerScope + query) * stride];
+  if (values[info.valuesPerQuery] == 0)
+    return std::nullopt;
+  return std::span{values, info.valuesPerQuery};
+}
+
+bool FrameQueryPool::readBack(FrameQueries& queries)
+{
+  if (queries.scopeNames.empty())
+    return false;
+
+  const auto queryCount =
+    static_cast<std::uint32_t>(queries.scopeNames.size() * info.queriesPerScope);
+  const std::size_t stride = info.valuesPerQuery + 1;
+  std::vector<std::uint64_t> data(queryCount * stride);
+
+  const auto result = etna::get_context().getDevice().getQueryPoolResults(
+    queries.pool.get(),
+    0,
+    queryCount,
+    data.size() * sizeof(std::uint64_t),
+    data.data(),
+    stride * sizeof(std::uint64_t),
+    vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWithAvailability);
+  if (result != vk::Result::eSuccess && result != vk::Result::eNotReady)
+    return false;
+
+  readData = std::move(data);
+  readNames = std::move(queries.scopeNames);
+  return true;
+}
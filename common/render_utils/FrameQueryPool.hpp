@@ -0,0 +1,70 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <etna/Vulkan.hpp>
+#include <etna/GpuSharedResource.hpp>
+
+
+/**
+ * Named scopes backed by one query pool per frame in flight. A pool is read back and reset
+ * once the command manager has waited for its frame again, so reading never stalls and
+ * results lag behind by the number of frames in flight. GpuTimer and PipelineStatistics only
+ * decide which queries a scope records and how to interpret their values.
+ */
+class FrameQueryPool
+{
+public:
+  struct CreateInfo
+  {
+    vk::QueryType queryType = vk::QueryType::eTimestamp;
+    vk::QueryPipelineStatisticFlags pipelineStatistics = {};
+    std::uint32_t maxScopes = 0;
+    // E.g. a begin and an end timestamp
+    std::uint32_t queriesPerScope = 1;
+    // E.g. one per requested pipeline statistic
+    std::uint32_t valuesPerQuery = 1;
+    // Used in the error raised when a frame runs out of scopes
+    std::string name;
+  };
+
+  explicit FrameQueryPool(CreateInfo info);
+
+  // Must be called once per frame after the command manager waited for the frame's slot,
+  // before any scopes are recorded. Returns whether the previous use of the slot was read
+  // back, i.e. whether the read scopes below changed.
+  bool beginFrame(vk::CommandBuffer cmd_buf);
+
+  std::uint32_t addScope(std::string name);
+  // The pool of the current frame, a scope owns queries [scope * queriesPerScope, ...)
+  vk::QueryPool getPool() { return frames.get().pool.get(); }
+
+  // Scopes of the latest frame that was read back, in recording order
+  std::size_t getReadScopeCount() const { return readNames.size(); }
+  const std::string& getReadScopeName(std::size_t scope) const { return readNames[scope]; }
+  // Empty if the query was not available
+  std::optional<std::span<const std::uint64_t>> getReadValues(
+    std::size_t scope, std::uint32_t query) const;
+
+  FrameQueryPool(const FrameQueryPool&) = delete;
+  FrameQueryPool& operator=(const FrameQueryPool&) = delete;
+
+private:
+  struct FrameQueries
+  {
+    vk::UniqueQueryPool pool;
+    std::vector<std::string> scopeNames;
+  };
+
+  bool readBack(FrameQueries& queries);
+
+private:
+  CreateInfo info;
+  etna::GpuSharedResource<FrameQueries> frames;
+  std::vector<std::string> readNames;
+  // Every query is followed by its availability word
+  std::vector<std::uint64_t> readData;
+};
@@ -0,0 +1,58 @@
+#include "FrameRingBuffer.hpp"
+
+#include <etna/GlobalContext.hpp>
+
+
+static vk::DeviceSize align_up(vk::DeviceSize value, vk::DeviceSize alignment)
+{
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+vk::DeviceSize FrameRingBuffer::getOffsetAlignment()
+{
+  const auto limits = etna::get_context().getPhysicalDevice().getProperties().limits;
+  return std::max(limits.minUniformBufferOffsetAlignment, limits.minStorageBufferOffsetAlignment);
+}
+
+FrameRingBuffer::FrameRingBuffer(CreateInfo info)
+  : alignment{getOffsetAlignment()}
+  , frameCapacity{align_up(info.frameCapacity, alignment)}
+  , buffer{etna::get_context().createBuffer(
+      etna::Buffer::CreateInfo{
+        .size = frameCapacity * etna::get_context().getMainWorkCount().multiBufferingCount(),
+        .bufferUsage = info.bufferUsage,
+        .memoryUsage = VMA_MEMORY_USAGE_CPU_TO_GPU,
+        .name = info.name,
+      })}
+  , regionOffsets{
+      etna::get_context().getMainWorkCount(),
+      [capacity = frameCapacity](std::size_t i) {
+        return static_cast<vk::DeviceSize>(i) * capacity;
+      }}
+{
+  buffer.map();
+}
+
+void FrameRingBuffer::beginFrame()
+{
+  head = 0;
+}
+
+FrameRingBuffer::Allocation FrameRingBuffer::allocate(vk::DeviceSize size)
+{
+  ETNA_VERIFYF(
+    head + size <= frameCapacity,
+    "Frame ring buffer overflow: {} + {} bytes out of {}",
+    head,
+    size,
+    frameCapacity);
+
+  const vk::DeviceSize offset = regionOffsets.get() + head;
+  head = align_up(head + size, alignment);
+
+  return Allocation{
+    .offset = offset,
+    .data = std::span<std::byte>(
+      reinterpret_cast<std::byte*>(buffer.data()) + offset, static_cast<std::size_t>(size)),
+  };
+}
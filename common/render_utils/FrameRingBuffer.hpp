@@ -0,0 +1,70 @@
+#pragma once
+
+#include <span>
+#include <string>
+
+#include <etna/Buffer.hpp>
+#include <etna/DescriptorSet.hpp>
+#include <etna/GpuSharedResource.hpp>
+
+
+/**
+ * Linear allocator over a single persistently mapped buffer split into one region per
+ * frame in flight. Whatever is allocated during a frame stays untouched until the GPU
+ * is done with that frame, so frame constants and per-draw data can be written every
+ * frame without waiting. Allocations are aligned for use as uniform and storage buffer
+ * ranges, the returned offset is what gets bound as a descriptor offset.
+ */
+class FrameRingBuffer
+{
+public:
+  struct CreateInfo
+  {
+    vk::DeviceSize frameCapacity = 0;
+    vk::BufferUsageFlags bufferUsage =
+      vk::BufferUsageFlagBits::eUniformBuffer | vk::BufferUsageFlagBits::eStorageBuffer;
+    std::string name;
+  };
+
+  struct Allocation
+  {
+    vk::DeviceSize offset = 0;
+    std::span<std::byte> data;
+
+    template <class T>
+    std::span<T> as() const
+    {
+      return {reinterpret_cast<T*>(data.data()), data.size() / sizeof(T)};
+    }
+  };
+
+  explicit FrameRingBuffer(CreateInfo info);
+
+  // Every allocation starts at a multiple of it, so each may waste up to alignment - 1 bytes
+  static vk::DeviceSize getOffsetAlignment();
+
+  // Must be called once per frame after the command manager waited for the frame's slot
+  void beginFrame();
+
+  Allocation allocate(vk::DeviceSize size);
+
+  auto genBinding(const Allocation& allocation) const
+  {
+    return buffer.genBinding(allocation.offset, allocation.data.size());
+  }
+
+  vk::DeviceSize getFrameCapacity() const { return frameCapacity; }
+  vk::DeviceSize getFrameUsage() const { return head; }
+  vk::Buffer getBuffer() const { return buffer.get(); }
+
+  FrameRingBuffer(const FrameRingBuffer&) = delete;
+  FrameRingBuffer& operator=(const FrameRingBuffer&) = delete;
+
+private:
+  vk::DeviceSize alignment;
+  vk::DeviceSize frameCapacity;
+  etna::Buffer buffer;
+  // Start of the current frame's region
+  etna::GpuSharedResource<vk::DeviceSize> regionOffsets;
+  vk::DeviceSize head = 0;
+};
@@ -0,0 +1,108 @@
+#include "FrameTimeHistory.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+static constexpr float MISSING = std::numeric_limits<float>::quiet_NaN();
+
+// Nearest-rank percentile of sorted values
+static float percentile(std::span<const float> sorted, float fraction)
+{
+  const auto rank =
+    static_cast<std::size_t>(std::ceil(fraction * static_cast<float>(sorted.size())));
+  return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+}
+
+void FrameTimeHistory::push(float cpu_frame_ms, const GpuTimer& gpu_timer)
+{
+  cpuFrameMs[head] = cpu_frame_ms;
+  gpuFrameMs[head] = static_cast<float>(gpu_timer.getFrameMilliseconds());
+
+  for (auto& [name, values] : passMs)
+    values[head] = MISSING;
+  for (const auto& result : gpu_timer.getResults())
+  {
+    auto it = passMs.find(result.name);
+    if (it == passMs.end())
+    {
+      it = passMs.emplace(result.name, std::array<float, CAPACITY>{}).first;
+      it->second.fill(MISSING);
+    }
+    float& value = it->second[head];
+    value = (std::isnan(value) ? 0.0f : value) + static_cast<float>(result.milliseconds);
+  }
+
+  std::erase_if(passMs, [](const auto& pass) {
+    return std::ranges::all_of(pass.second, [](float value) { return std::isnan(value); });
+  });
+
+  head = (head + 1) % CAPACITY;
+  frameCount = std::min(frameCount + 1, CAPACITY);
+}
+
+std::span<const float> FrameTimeHistory::getValues(Series series) const
+{
+  return series == Series::Cpu ? cpuFrameMs : gpuFrameMs;
+}
+
+std::span<const float> FrameTimeHistory::filled(Series series) const
+{
+  // Until the ring wraps around, the frames are at its start
+  return getValues(series).first(frameCount);
+}
+
+FrameTimeHistory::Percentiles FrameTimeHistory::getPercentiles(Series series) const
+{
+  if (frameCount == 0)
+    return {};
+
+  const auto values = filled(series);
+  std::vector<float> sorted(values.begin(), values.end());
+  std::ranges::sort(sorted);
+  return Percentiles{
+    .p50 = percentile(sorted, 0.50f),
+    .p90 = percentile(sorted, 0.90f),
+    .p95 = percentile(sorted, 0.95f),
+    .p99 = percentile(sorted, 0.99f),
+    .max = sorted.back(),
+  };
+}
+
+std::array<float, FrameTimeHistory::HISTOGRAM_BINS> FrameTimeHistory::getHistogram(
+  Series series, float max_ms) const
+{
+  std::array<float, HISTOGRAM_BINS> bins{};
+  if (max_ms <= 0)
+    return bins;
+
+  for (const float value : filled(series))
+  {
+    const auto bin = static_cast<std::size_t>(std::max(value, 0.0f) / max_ms * HISTOGRAM_BINS);
+    bins[std::min(bin, HISTOGRAM_BINS - 1)] += 1.0f;
+  }
+  return bins;
+}
+
+std::vector<FrameTimeHistory::PassAverage> FrameTimeHistory::getPassAverages() const
+{
+  std::vector<PassAverage> averages;
+  for (const auto& [name, values] : passMs)
+  {
+    float sum = 0;
+    std::size_t count = 0;
+    for (const float value : values)
+      if (!std::isnan(value))
+      {
+        sum += value;
+        ++count;
+      }
+    averages.push_back(
+      PassAverage{
+        .name = name,
+        .milliseconds = sum / static_cast<float>(count),
+      });
+  }
+  return averages;
+}
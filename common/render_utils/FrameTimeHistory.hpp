@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "GpuTimer.hpp"
+
+
+/**
+ * Frame times and GpuTimer scope times of the last CAPACITY frames, for overlays that work
+ * without a profiler attached. Only results the timer has already read back are used, so
+ * nothing ever waits for the GPU. GPU values of an entry therefore belong to a frame a few
+ * frames older than its CPU time.
+ */
+class FrameTimeHistory
+{
+public:
+  static constexpr std::size_t CAPACITY = 240;
+  static constexpr std::size_t HISTOGRAM_BINS = 32;
+
+  enum class Series
+  {
+    Cpu,
+    Gpu,
+  };
+
+  struct Percentiles
+  {
+    float p50 = 0;
+    float p90 = 0;
+    float p95 = 0;
+    float p99 = 0;
+    float max = 0;
+  };
+
+  struct PassAverage
+  {
+    std::string_view name;
+    float milliseconds;
+  };
+
+  void push(float cpu_frame_ms, const GpuTimer& gpu_timer);
+
+  std::size_t getFrameCount() const { return frameCount; }
+
+  // A ring, the oldest value is at getOffset() once it is full. Matches the values and
+  // values_offset of ImGui::PlotLines.
+  std::span<const float> getValues(Series series) const;
+  std::size_t getOffset() const { return head; }
+
+  Percentiles getPercentiles(Series series) const;
+  // Frame counts in HISTOGRAM_BINS equal ranges from 0 to max_ms, longer frames go to the last
+  std::array<float, HISTOGRAM_BINS> getHistogram(Series series, float max_ms) const;
+
+  // Means over the frames that had the scope, multiple scopes of a frame with the same name
+  // are added up
+  std::vector<PassAverage> getPassAverages() const;
+
+private:
+  std::span<const float> filled(Series series) const;
+
+private:
+  std::array<float, CAPACITY> cpuFrameMs{};
+  std::array<float, CAPACITY> gpuFrameMs{};
+  // NaN for frames without the scope, scopes are dropped once no frame in the ring has them
+  std::map<std::string, std::array<float, CAPACITY>, std::less<>> passMs;
+  std::size_t head = 0;
+  std::size_t frameCount = 0;
+};
@@ -0,0 +1,157 @@
+#include "GpuMemoryReport.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <etna/Assert.hpp>
+#include <etna/GlobalContext.hpp>
+#include <spdlog/spdlog.h>
+
+
+static constexpr std::array<const char*, GpuMemoryReport::CATEGORY_COUNT> CATEGORY_NAMES{
+  "Textures",
+  "Geometry",
+  "Instance data",
+  "Staging",
+  "Render targets",
+  "Other",
+};
+
+static double to_mib(vk::DeviceSize bytes)
+{
+  return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+static bool supports_memory_budget(vk::PhysicalDevice physical_device)
+{
+  const auto extensions =
+    etna::unwrap_vk_result(physical_device.enumerateDeviceExtensionProperties());
+  return std::ranges::any_of(extensions, [](const vk::ExtensionProperties& extension) {
+    return std::strcmp(extension.extensionName.data(), VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0;
+  });
+}
+
+GpuMemoryReport::GpuMemoryReport()
+  : budgetSupported{supports_memory_budget(etna::get_context().getPhysicalDevice())}
+{
+}
+
+void GpuMemoryReport::clear()
+{
+  groups.clear();
+  totals = {};
+}
+
+void GpuMemoryReport::addBuffer(
+  Category category, std::string_view group, vk::Buffer buffer, std::uint32_t copies)
+{
+  if (!buffer)
+    return;
+  const auto requirements = etna::get_context().getDevice().getBufferMemoryRequirements(buffer);
+  addBytes(category, group, requirements.size * copies, copies);
+}
+
+void GpuMemoryReport::addImage(
+  Category category, std::string_view group, vk::Image image, std::uint32_t copies)
+{
+  if (!image)
+    return;
+  const auto requirements = etna::get_context().getDevice().getImageMemoryRequirements(image);
+  addBytes(category, group, requirements.size * copies, copies);
+}
+
+void GpuMemoryReport::addBytes(
+  Category category, std::string_view group, vk::DeviceSize bytes, std::uint32_t allocations)
+{
+  auto& usage = groups[{category, std::string(group)}];
+  usage.bytes += bytes;
+  usage.allocations += allocations;
+
+  auto& total = totals[static_cast<std::size_t>(category)];
+  total.bytes += bytes;
+  total.allocations += allocations;
+}
+
+void GpuMemoryReport::queryHeaps()
+{
+  const auto physicalDevice = etna::get_context().getPhysicalDevice();
+
+  vk::PhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties;
+  vk::PhysicalDeviceMemoryProperties2 properties;
+  if (budgetSupported)
+    properties.pNext = &budgetProperties;
+  physicalDevice.getMemoryProperties2(&properties);
+
+  const auto& memoryProperties = properties.memoryProperties;
+  heaps.clear();
+  heaps.reserve(memoryProperties.memoryHeapCount);
+  for (std::uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i)
+  {
+    const auto& heap = memoryProperties.memoryHeaps[i];
+    heaps.push_back(Heap{
+      .size = heap.size,
+      .budget = budgetSupported ? budgetProperties.heapBudget[i] : 0,
+      .usage = budgetSupported ? budgetProperties.heapUsage[i] : 0,
+      .deviceLocal = static_cast<bool>(heap.flags & vk::MemoryHeapFlagBits::eDeviceLocal),
+    });
+  }
+}
+
+GpuMemoryReport::Usage GpuMemoryReport::getTotal() const
+{
+  Usage result;
+  for (const auto& total : totals)
+  {
+    result.bytes += total.bytes;
+    result.allocations += total.allocations;
+  }
+  return result;
+}
+
+const char* GpuMemoryReport::getName(Category category)
+{
+  return CATEGORY_NAMES[static_cast<std::size_t>(category)];
+}
+
+void GpuMemoryReport::log() const
+{
+  const auto total = getTotal();
+  spdlog::info(
+    "GPU memory: {:.1f} MiB in {} allocations", to_mib(total.bytes), total.allocations);
+
+  // Groups are ordered by category, so each category header comes right before its groups
+  std::size_t lastCategory = CATEGORY_COUNT;
+  for (const auto& [key, usage] : groups)
+  {
+    const auto& [category, name] = key;
+    const auto categoryIdx = static_cast<std::size_t>(category);
+    if (categoryIdx != lastCategory)
+    {
+      spdlog::info(
+        "  {}: {:.1f} MiB in {} allocations",
+        CATEGORY_NAMES[categoryIdx],
+        to_mib(totals[categoryIdx].bytes),
+        totals[categoryIdx].allocations);
+      lastCategory = categoryIdx;
+    }
+    spdlog::info("    {}: {:.1f} MiB in {}", name, to_mib(usage.bytes), usage.allocations);
+  }
+
+  for (std::size_t i = 0; i < heaps.size(); ++i)
+  {
+    const auto& heap = heaps[i];
+    const char* kind = heap.deviceLocal ? "device local" : "host";
+    if (budgetSupported)
+      spdlog::info(
+        "  Heap {} ({}): {:.1f} MiB used of a {:.1f} MiB budget, {:.1f} MiB total",
+        i,
+        kind,
+        to_mib(heap.usage),
+        to_mib(heap.budget),
+        to_mib(heap.size));
+    else
+      spdlog::info("  Heap {} ({}): {:.1f} MiB total", i, kind, to_mib(heap.size));
+  }
+  if (!budgetSupported)
+    spdlog::info("  VK_EXT_memory_budget is not supported, heap usage is unknown");
+}
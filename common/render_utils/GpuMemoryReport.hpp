@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <etna/Vulkan.hpp>
+
+
+/**
+ * Adds up the memory of resources by category and group, e.g. textures by format, next to
+ * the budget and usage of every memory heap. Sizes are the memory requirements of the
+ * handles, not what the allocator actually reserved for them, so padding and unused parts of
+ * VMA blocks show up as the difference to the heap usage.
+ *
+ * Usage and budget come from VK_EXT_memory_budget. It is a query of the physical device, so
+ * it does not have to be enabled. Without it only heap sizes are known.
+ */
+class GpuMemoryReport
+{
+public:
+  enum class Category : std::size_t
+  {
+    Textures,
+    Geometry,
+    InstanceData,
+    Staging,
+    RenderTargets,
+    Other,
+  };
+  static constexpr std::size_t CATEGORY_COUNT = 6;
+
+  struct Usage
+  {
+    vk::DeviceSize bytes = 0;
+    std::uint32_t allocations = 0;
+  };
+
+  struct Heap
+  {
+    vk::DeviceSize size = 0;
+    // Both are 0 when the budget extension is missing
+    vk::DeviceSize budget = 0;
+    vk::DeviceSize usage = 0;
+    bool deviceLocal = false;
+  };
+
+  using Groups = std::map<std::pair<Category, std::string>, Usage>;
+
+  // Checks for the budget extension once, the heaps are only read by queryHeaps
+  GpuMemoryReport();
+
+  // Forgets the resources, heaps stay until the next queryHeaps
+  void clear();
+
+  // Null handles are skipped, so optional resources can be added unconditionally.
+  // Resources kept once per frame in flight pass one of them and the number of copies.
+  void addBuffer(
+    Category category, std::string_view group, vk::Buffer buffer, std::uint32_t copies = 1);
+  void addImage(
+    Category category, std::string_view group, vk::Image image, std::uint32_t copies = 1);
+  // For memory without a handle at hand, e.g. internal staging or aliased transient memory
+  void addBytes(
+    Category category, std::string_view group, vk::DeviceSize bytes, std::uint32_t allocations);
+
+  void queryHeaps();
+
+  const Groups& getGroups() const { return groups; }
+  Usage getTotal(Category category) const { return totals[static_cast<std::size_t>(category)]; }
+  Usage getTotal() const;
+  const std::vector<Heap>& getHeaps() const { return heaps; }
+  bool hasBudget() const { return budgetSupported; }
+
+  static const char* getName(Category category);
+
+  // One line per category, group and heap
+  void log() const;
+
+private:
+  Groups groups;
+  std::array<Usage, CATEGORY_COUNT> totals{};
+  std::vector<Heap> heaps;
+  bool budgetSupported = false;
+};
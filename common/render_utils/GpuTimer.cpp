@@ -0,0 +1,68 @@
+#include "GpuTimer.hpp"
+
+#include <algorithm>
+#include <limits>
+
+#include <etna/GlobalContext.hpp>
+#include <tracy/Tracy.hpp>
+
+
+GpuTimer::GpuTimer(std::uint32_t max_scopes_per_frame)
+  : timestampPeriodNs{
+      etna::get_context().getPhysicalDevice().getProperties().limits.timestampPeriod}
+  , queries{FrameQueryPool::CreateInfo{
+      .queryType = vk::QueryType::eTimestamp,
+      .maxScopes = max_scopes_per_frame,
+      .queriesPerScope = 2,
+      .name = "GPU timer",
+    }}
+{
+}
+
+void GpuTimer::beginFrame(vk::CommandBuffer cmd_buf)
+{
+  ZoneScoped;
+
+  if (queries.beginFrame(cmd_buf))
+    collectResults();
+}
+
+std::uint32_t GpuTimer::beginScope(vk::CommandBuffer cmd_buf, std::string name)
+{
+  const auto scope = queries.addScope(std::move(name));
+  cmd_buf.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, queries.getPool(), scope * 2);
+  return scope;
+}
+
+void GpuTimer::endScope(vk::CommandBuffer cmd_buf, std::uint32_t scope)
+{
+  cmd_buf.writeTimestamp2(
+    vk::PipelineStageFlagBits2::eAllCommands, queries.getPool(), scope * 2 + 1);
+}
+
+void GpuTimer::collectResults()
+{
+  results.clear();
+  std::uint64_t frameBegin = std::numeric_limits<std::uint64_t>::max();
+  std::uint64_t frameEnd = 0;
+  for (std::size_t scope = 0; scope < queries.getReadScopeCount(); ++scope)
+  {
+    const auto begin = queries.getReadValues(scope, 0);
+    const auto end = queries.getReadValues(scope, 1);
+    if (!begin || !end)
+      continue;
+
+    frameBegin = std::min(frameBegin, (*begin)[0]);
+    frameEnd = std::max(frameEnd, (*end)[0]);
+
+    results.push_back(
+      Result{
+        .name = queries.getReadScopeName(scope),
+        .milliseconds = static_cast<double>((*end)[0] - (*begin)[0]) * timestampPeriodNs * 1e-6,
+      });
+  }
+
+  frameMilliseconds = results.empty()
+    ? 0.0
+    : static_cast<double>(frameEnd - frameBegin) * timestampPeriodNs * 1e-6;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+
+#include <etna/Vulkan.hpp>
+
+#include "FrameQueryPool.hpp"
+
+
+/**
+ * Measures GPU time of named scopes with a begin and an end timestamp query each. Queries
+ * live in a FrameQueryPool, so the reported results lag behind by the number of frames in
+ * flight and reading them never stalls.
+ */
+class GpuTimer
+{
+public:
+  struct Result
+  {
+    std::string name;
+    double milliseconds = 0;
+  };
+
+  explicit GpuTimer(std::uint32_t max_scopes_per_frame);
+
+  // Must be called once per frame after the command manager waited for the frame's slot,
+  // before any scopes are recorded
+  void beginFrame(vk::CommandBuffer cmd_buf);
+
+  std::uint32_t beginScope(vk::CommandBuffer cmd_buf, std::string name);
+  void endScope(vk::CommandBuffer cmd_buf, std::uint32_t scope);
+
+  // Scopes of the latest frame whose queries were read back, in recording order
+  std::span<const Result> getResults() const { return results; }
+  // From the start of the first scope to the end of the last one of that frame
+  double getFrameMilliseconds() const { return frameMilliseconds; }
+
+  GpuTimer(const GpuTimer&) = delete;
+  GpuTimer& operator=(const GpuTimer&) = delete;
+
+private:
+  void collectResults();
+
+private:
+  double timestampPeriodNs;
+  FrameQueryPool queries;
+  std::vector<Result> results;
+  double frameMilliseconds = 0;
+};
@@ -0,0 +1,81 @@
+#include "OffscreenFrames.hpp"
+
+#include <etna/GlobalContext.hpp>
+#include <etna/Assert.hpp>
+#include <fmt/format.h>
+
+
+static void submit_semaphores(vk::Semaphore wait, vk::Semaphore signal)
+{
+  const vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eAllCommands;
+  ETNA_CHECK_VK_RESULT(etna::get_context().getQueue().submit(
+    vk::SubmitInfo{
+      .waitSemaphoreCount = wait ? 1u : 0u,
+      .pWaitSemaphores = &wait,
+      .pWaitDstStageMask = &waitStage,
+      .signalSemaphoreCount = 1,
+      .pSignalSemaphores = &signal,
+    }));
+}
+
+OffscreenFrames::OffscreenFrames(CreateInfo info)
+  : resolution{info.resolution}
+  , format{info.format}
+  , slots{
+      etna::get_context().getMainWorkCount(),
+      [&info](std::size_t i) {
+        auto& ctx = etna::get_context();
+        return Slot{
+          .image = ctx.createImage(
+            etna::Image::CreateInfo{
+              .extent = vk::Extent3D{info.resolution.x, info.resolution.y, 1},
+              .name = fmt::format("offscreen_frame{}", i),
+              .format = info.format,
+              // Like swapchain images they are rendered and blitted to, e.g. by deferred
+              // shading or scaled benchmark frames. Transfer source allows reading them back.
+              .imageUsage = vk::ImageUsageFlagBits::eColorAttachment |
+                vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst,
+            }),
+          .available = etna::unwrap_vk_result(ctx.getDevice().createSemaphoreUnique({})),
+          .renderingDone = etna::unwrap_vk_result(ctx.getDevice().createSemaphoreUnique({})),
+          .availableSignaled = false,
+        };
+      }}
+{
+}
+
+std::optional<OffscreenFrames::Frame> OffscreenFrames::acquireNext()
+{
+  auto& slot = slots.get();
+  if (!slot.availableSignaled)
+    submit_semaphores({}, slot.available.get());
+  slot.availableSignaled = false;
+
+  return Frame{
+    .image = slot.image.get(),
+    .view = slot.image.getView({}),
+    .available = slot.available.get(),
+    .readyForPresent = slot.renderingDone.get(),
+  };
+}
+
+bool OffscreenFrames::present(vk::Semaphore wait, vk::ImageView /*view*/)
+{
+  // Waiting here keeps the binary semaphore reusable, and makes it available again for the
+  // next frame that uses the slot
+  auto& slot = slots.get();
+  submit_semaphores(wait, slot.available.get());
+  slot.availableSignaled = true;
+  return true;
+}
+
+void OffscreenFrames::reportMemory(GpuMemoryReport& report) const
+{
+  const auto framesInFlight =
+    static_cast<std::uint32_t>(etna::get_context().getMainWorkCount().multiBufferingCount());
+  report.addImage(
+    GpuMemoryReport::Category::RenderTargets,
+    "offscreen frames",
+    slots.get().image.get(),
+    framesInFlight);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <optional>
+
+#include <etna/GpuSharedResource.hpp>
+#include <etna/Image.hpp>
+#include <etna/Vulkan.hpp>
+#include <glm/glm.hpp>
+
+#include "render_utils/GpuMemoryReport.hpp"
+
+
+/**
+ * Frame delivery without a window, a stand-in for etna::Window when rendering headless.
+ * Frames are rendered into a ring of offscreen images, one per frame in flight, and
+ * "presenting" one only waits for its rendering to finish on the queue. No surface or
+ * swapchain extension is needed, and nothing throttles the frame rate like vsync would.
+ *
+ * Semaphores are signaled and waited on by empty queue submits, so the rest of the frame
+ * is submitted the same way as with a swapchain. Images are left in whatever layout the
+ * frame's commands put them.
+ */
+class OffscreenFrames
+{
+public:
+  struct CreateInfo
+  {
+    glm::uvec2 resolution;
+    vk::Format format = vk::Format::eB8G8R8A8Srgb;
+  };
+
+  // Mirrors etna::Window::SwapchainImage
+  struct Frame
+  {
+    vk::Image image;
+    vk::ImageView view;
+    vk::Semaphore available;
+    vk::Semaphore readyForPresent;
+  };
+
+  explicit OffscreenFrames(CreateInfo info);
+
+  // Never fails, the optional only keeps the interface of etna::Window
+  std::optional<Frame> acquireNext();
+  bool present(vk::Semaphore wait, vk::ImageView view);
+
+  vk::Format getCurrentFormat() const { return format; }
+  glm::uvec2 getResolution() const { return resolution; }
+
+  void reportMemory(GpuMemoryReport& report) const;
+
+  OffscreenFrames(const OffscreenFrames&) = delete;
+  OffscreenFrames& operator=(const OffscreenFrames&) = delete;
+
+private:
+  struct Slot
+  {
+    etna::Image image;
+    vk::UniqueSemaphore available;
+    vk::UniqueSemaphore renderingDone;
+    // The previous present of the slot signals it, only the first frame needs a submit of its own
+    bool availableSignaled = false;
+  };
+
+private:
+  glm::uvec2 resolution;
+  vk::Format format;
+  etna::GpuSharedResource<Slot> slots;
+};
@@ -0,0 +1,160 @@
+#include "ParallelCommandRecorder.hpp"
+
+#include <etna/GlobalContext.hpp>
+#include <tracy/Tracy.hpp>
+
+
+ParallelCommandRecorder::ParallelCommandRecorder(std::uint32_t thread_count)
+{
+  setThreadCount(thread_count);
+}
+
+ParallelCommandRecorder::~ParallelCommandRecorder()
+{
+  // Workers have to be joined while the mutex and condition variables are still alive
+  for (auto& worker : workers)
+    worker->thread.request_stop();
+  workers.clear();
+}
+
+void ParallelCommandRecorder::setThreadCount(std::uint32_t thread_count)
+{
+  auto& ctx = etna::get_context();
+
+  while (workers.size() < thread_count)
+  {
+    const auto threadIdx = static_cast<std::uint32_t>(workers.size());
+
+    // GpuSharedResource is not movable, so the worker is constructed in place
+    std::unique_ptr<Worker> worker(new Worker{
+      .pools = etna::GpuSharedResource<FramePool>(
+        ctx.getMainWorkCount(),
+        [&ctx](std::size_t) {
+          return FramePool{
+            .pool = etna::unwrap_vk_result(ctx.getDevice().createCommandPoolUnique(
+              vk::CommandPoolCreateInfo{
+                .flags = vk::CommandPoolCreateFlagBits::eTransient,
+                .queueFamilyIndex = ctx.getQueueFamilyIdx(),
+              })),
+          };
+        }),
+      .thread = {},
+    });
+    // Recording never runs concurrently with this, so generation can be read without a lock
+    worker->thread = std::jthread([this, threadIdx, spawnGeneration = generation](
+                                    std::stop_token stop_token) {
+      workerLoop(stop_token, threadIdx, spawnGeneration);
+    });
+
+    workers.push_back(std::move(worker));
+  }
+
+  activeThreadCount = std::max<std::uint32_t>(thread_count, 1);
+}
+
+void ParallelCommandRecorder::beginFrame()
+{
+  ZoneScoped;
+
+  // The command manager has already waited for the frame that used these pools last time
+  auto device = etna::get_context().getDevice();
+  for (auto& worker : workers)
+  {
+    auto& framePool = worker->pools.get();
+    ETNA_CHECK_VK_RESULT(device.resetCommandPool(framePool.pool.get()));
+    framePool.usedBuffers = 0;
+  }
+}
+
+std::vector<vk::CommandBuffer> ParallelCommandRecorder::record(std::vector<Task> tasks)
+{
+  ZoneScoped;
+
+  if (tasks.empty())
+    return {};
+
+  std::unique_lock lock{mutex};
+
+  currentTasks = std::move(tasks);
+  recordedBuffers.assign(currentTasks.size(), vk::CommandBuffer{});
+  nextTask = 0;
+  busyWorkers = static_cast<std::uint32_t>(workers.size());
+  ++generation;
+
+  wakeWorkers.notify_all();
+  tasksDone.wait(lock, [this]() { return busyWorkers == 0; });
+
+  currentTasks.clear();
+  return std::move(recordedBuffers);
+}
+
+void ParallelCommandRecorder::workerLoop(
+  std::stop_token stop_token, std::uint32_t thread_idx, std::uint64_t seen_generation)
+{
+  tracy::SetThreadName("command_recorder");
+
+  std::uint64_t seenGeneration = seen_generation;
+  while (true)
+  {
+    {
+      std::unique_lock lock{mutex};
+      if (!wakeWorkers.wait(lock, stop_token, [&]() { return generation != seenGeneration; }))
+        return;
+      seenGeneration = generation;
+    }
+
+    if (thread_idx < activeThreadCount)
+      recordTasks(thread_idx);
+
+    {
+      std::lock_guard lock{mutex};
+      if (--busyWorkers == 0)
+        tasksDone.notify_one();
+    }
+  }
+}
+
+void ParallelCommandRecorder::recordTasks(std::uint32_t thread_idx)
+{
+  ZoneScoped;
+
+  auto device = etna::get_context().getDevice();
+  auto& framePool = workers[thread_idx]->pools.get();
+
+  for (std::size_t taskIdx = nextTask++; taskIdx < currentTasks.size(); taskIdx = nextTask++)
+  {
+    auto& task = currentTasks[taskIdx];
+
+    if (framePool.usedBuffers == framePool.buffers.size())
+    {
+      auto allocated = etna::unwrap_vk_result(device.allocateCommandBuffers(
+        vk::CommandBufferAllocateInfo{
+          .commandPool = framePool.pool.get(),
+          .level = vk::CommandBufferLevel::eSecondary,
+          .commandBufferCount = 1,
+        }));
+      framePool.buffers.push_back(allocated.front());
+    }
+    auto cmdBuf = framePool.buffers[framePool.usedBuffers++];
+
+    vk::CommandBufferInheritanceRenderingInfo renderingInfo{
+      .viewMask = task.viewMask,
+      .colorAttachmentCount = static_cast<std::uint32_t>(task.colorAttachmentFormats.size()),
+      .pColorAttachmentFormats = task.colorAttachmentFormats.data(),
+      .depthAttachmentFormat = task.depthAttachmentFormat,
+      .rasterizationSamples = vk::SampleCountFlagBits::e1,
+    };
+    vk::CommandBufferInheritanceInfo inheritanceInfo{.pNext = &renderingInfo};
+
+    ETNA_CHECK_VK_RESULT(cmdBuf.begin(
+      vk::CommandBufferBeginInfo{
+        .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit |
+          vk::CommandBufferUsageFlagBits::eRenderPassContinue,
+        .pInheritanceInfo = &inheritanceInfo,
+      }));
+    task.record(cmdBuf);
+    ETNA_CHECK_VK_RESULT(cmdBuf.end());
+
+    recordedBuffers[taskIdx] = cmdBuf;
+  }
+}
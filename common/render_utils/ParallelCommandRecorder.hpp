@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <etna/Vulkan.hpp>
+#include <etna/GpuSharedResource.hpp>
+#include <function2/function2.hpp>
+
+
+/**
+ * Records chunks of draw calls into secondary command buffers on a pool of worker threads.
+ * Every worker owns a command pool per frame in flight, so recording never takes a lock.
+ * Secondary buffers do not inherit any state, so every task has to bind its pipeline,
+ * descriptor sets, vertex buffers and set the viewport on its own.
+ * Descriptor sets have to be created on the main thread beforehand, etna's descriptor
+ * pools are not thread-safe.
+ */
+class ParallelCommandRecorder
+{
+public:
+  struct Task
+  {
+    // Attachment formats of the dynamic rendering pass the buffer will be executed in
+    std::vector<vk::Format> colorAttachmentFormats;
+    vk::Format depthAttachmentFormat = vk::Format::eUndefined;
+    // Has to match the view mask of the pass when multiview rendering is used
+    std::uint32_t viewMask = 0;
+
+    // Called on a worker thread with an already begun secondary command buffer
+    fu2::unique_function<void(vk::CommandBuffer)> record;
+  };
+
+  explicit ParallelCommandRecorder(std::uint32_t thread_count);
+  ~ParallelCommandRecorder();
+
+  // Spawns missing workers, extra workers stay idle
+  void setThreadCount(std::uint32_t thread_count);
+  std::uint32_t getThreadCount() const { return activeThreadCount; }
+
+  // Must be called once per frame before any record() calls
+  void beginFrame();
+
+  // Blocks until all tasks are recorded, returned buffers are in the order of the tasks
+  std::vector<vk::CommandBuffer> record(std::vector<Task> tasks);
+
+  ParallelCommandRecorder(const ParallelCommandRecorder&) = delete;
+  ParallelCommandRecorder& operator=(const ParallelCommandRecorder&) = delete;
+
+private:
+  struct FramePool
+  {
+    vk::UniqueCommandPool pool;
+    // Buffers are reused after the pool is reset instead of being allocated every frame
+    std::vector<vk::CommandBuffer> buffers;
+    std::size_t usedBuffers = 0;
+  };
+
+  struct Worker
+  {
+    etna::GpuSharedResource<FramePool> pools;
+    std::jthread thread;
+  };
+
+  void workerLoop(
+    std::stop_token stop_token, std::uint32_t thread_idx, std::uint64_t seen_generation);
+  void recordTasks(std::uint32_t thread_idx);
+
+private:
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::uint32_t activeThreadCount = 0;
+
+  std::mutex mutex;
+  std::condition_variable_any wakeWorkers;
+  std::condition_variable tasksDone;
+  std::uint64_t generation = 0;
+  std::uint32_t busyWorkers = 0;
+
+  std::vector<Task> currentTasks;
+  std::vector<vk::CommandBuffer> recordedBuffers;
+  std::atomic<std::size_t> nextTask = 0;
+};
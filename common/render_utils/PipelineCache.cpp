@@ -0,0 +1,301 @@
+#include "PipelineCache.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <etna/GlobalContext.hpp>
+#include <etna/Assert.hpp>
+#include <spdlog/spdlog.h>
+#include <tracy/Tracy.hpp>
+
+
+static constexpr std::uint32_t CACHE_FILE_MAGIC = 0x48435050; // "PPCH"
+static constexpr std::uint32_t CACHE_FILE_VERSION = 1;
+
+// Everything the driver's cache blob may depend on
+struct DeviceKey
+{
+  std::uint32_t vendorId = 0;
+  std::uint32_t deviceId = 0;
+  std::uint32_t driverVersion = 0;
+  std::uint32_t reserved = 0;
+  std::array<std::uint8_t, VK_UUID_SIZE> deviceUuid{};
+  std::array<std::uint8_t, VK_UUID_SIZE> pipelineCacheUuid{};
+
+  bool operator==(const DeviceKey&) const = default;
+};
+
+struct CacheFileHeader
+{
+  std::uint32_t magic = CACHE_FILE_MAGIC;
+  std::uint32_t version = CACHE_FILE_VERSION;
+  DeviceKey key;
+  std::uint64_t dataSize = 0;
+  std::uint64_t dataHash = 0;
+};
+
+// vulkan.hpp's functions are wrapped for the whole life of a PipelineCache, so that they are
+// never swapped while other threads may be calling them. They only redirect pipelines created
+// without a cache on a thread with an open EtnaScope.
+struct DispatchHook
+{
+  PFN_vkCreateGraphicsPipelines createGraphicsPipelines = nullptr;
+  PFN_vkCreateComputePipelines createComputePipelines = nullptr;
+};
+
+static DispatchHook dispatch_hook;
+static thread_local PipelineCache* scoped_cache = nullptr;
+
+template <class Create, class Info>
+static VkResult create_pipelines_with_cache(
+  Create create,
+  VkDevice device,
+  VkPipelineCache cache,
+  std::uint32_t count,
+  const Info* infos,
+  const VkAllocationCallbacks* allocator,
+  VkPipeline* pipelines)
+{
+  if (cache != VK_NULL_HANDLE || scoped_cache == nullptr)
+    return create(device, cache, count, infos, allocator, pipelines);
+
+  const auto start = std::chrono::steady_clock::now();
+  const VkResult result =
+    create(device, scoped_cache->get(), count, infos, allocator, pipelines);
+  scoped_cache->recordCreation(count, std::chrono::steady_clock::now() - start);
+  return result;
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL create_graphics_pipelines(
+  VkDevice device,
+  VkPipelineCache cache,
+  std::uint32_t count,
+  const VkGraphicsPipelineCreateInfo* infos,
+  const VkAllocationCallbacks* allocator,
+  VkPipeline* pipelines)
+{
+  return create_pipelines_with_cache(
+    dispatch_hook.createGraphicsPipelines, device, cache, count, infos, allocator, pipelines);
+}
+
+static VKAPI_ATTR VkResult VKAPI_CALL create_compute_pipelines(
+  VkDevice device,
+  VkPipelineCache cache,
+  std::uint32_t count,
+  const VkComputePipelineCreateInfo* infos,
+  const VkAllocationCallbacks* allocator,
+  VkPipeline* pipelines)
+{
+  return create_pipelines_with_cache(
+    dispatch_hook.createComputePipelines, device, cache, count, infos, allocator, pipelines);
+}
+
+static DeviceKey current_device_key()
+{
+  const auto properties =
+    etna::get_context()
+      .getPhysicalDevice()
+      .getProperties2<vk::PhysicalDeviceProperties2, vk::PhysicalDeviceIDProperties>();
+  const auto& deviceProperties = properties.get<vk::PhysicalDeviceProperties2>().properties;
+  const auto& idProperties = properties.get<vk::PhysicalDeviceIDProperties>();
+
+  DeviceKey key{
+    .vendorId = deviceProperties.vendorID,
+    .deviceId = deviceProperties.deviceID,
+    .driverVersion = deviceProperties.driverVersion,
+  };
+  std::ranges::copy(idProperties.deviceUUID, key.deviceUuid.begin());
+  std::ranges::copy(deviceProperties.pipelineCacheUUID, key.pipelineCacheUuid.begin());
+  return key;
+}
+
+// FNV-1a, only meant to catch damaged files
+static std::uint64_t hash_bytes(std::span<const std::uint8_t> bytes)
+{
+  std::uint64_t hash = 0xcbf29ce484222325;
+  for (const auto byte : bytes)
+    hash = (hash ^ byte) * 0x100000001b3;
+  return hash;
+}
+
+static std::vector<std::uint8_t> read_cache_file(
+  const std::filesystem::path& path, const DeviceKey& key)
+{
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  if (!file.is_open())
+    return {};
+
+  const auto reject = [&path](std::string_view reason) {
+    spdlog::warn("Ignoring pipeline cache {}: {}", path.string(), reason);
+    return std::vector<std::uint8_t>{};
+  };
+
+  const auto fileSize = static_cast<std::size_t>(file.tellg());
+  CacheFileHeader header;
+  if (fileSize < sizeof(header))
+    return reject("file is too small");
+
+  file.seekg(0);
+  file.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!file || header.magic != CACHE_FILE_MAGIC || header.version != CACHE_FILE_VERSION)
+    return reject("unknown file format");
+  if (header.key != key)
+    return reject("written by a different device or driver");
+  if (header.dataSize != fileSize - sizeof(header))
+    return reject("file is truncated");
+
+  std::vector<std::uint8_t> data(header.dataSize);
+  file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+  if (!file || hash_bytes(data) != header.dataHash)
+    return reject("contents are damaged");
+
+  // Drivers are required to check this themselves, but a blob from a buggy driver version
+  // is better caught here than in the driver
+  VkPipelineCacheHeaderVersionOne vkHeader;
+  if (data.size() < sizeof(vkHeader))
+    return reject("driver data is too small");
+  std::memcpy(&vkHeader, data.data(), sizeof(vkHeader));
+  if (
+    vkHeader.headerSize < sizeof(vkHeader) || vkHeader.headerSize > data.size() ||
+    vkHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+    vkHeader.vendorID != key.vendorId || vkHeader.deviceID != key.deviceId ||
+    !std::ranges::equal(vkHeader.pipelineCacheUUID, key.pipelineCacheUuid))
+    return reject("driver header doesn't match the device");
+
+  return data;
+}
+
+PipelineCache::PipelineCache(std::filesystem::path directory)
+{
+  ZoneScoped;
+
+  ETNA_VERIFYF(
+    dispatch_hook.createGraphicsPipelines == nullptr,
+    "Only one PipelineCache may exist at a time");
+
+  const auto key = current_device_key();
+
+  std::string uuid;
+  for (const auto byte : key.deviceUuid)
+    uuid += fmt::format("{:02x}", byte);
+  path = std::move(directory) / fmt::format("{}_{:08x}.bin", uuid, key.driverVersion);
+
+  const auto data = read_cache_file(path, key);
+  loadedBytes = data.size();
+
+  cache = etna::unwrap_vk_result(etna::get_context().getDevice().createPipelineCacheUnique(
+    vk::PipelineCacheCreateInfo{
+      .initialDataSize = data.size(),
+      .pInitialData = data.data(),
+    }));
+
+  if (isWarm())
+    spdlog::info("Loaded {} bytes of pipeline cache from {}", loadedBytes, path.string());
+  else
+    spdlog::info("No usable pipeline cache at {}, starting cold", path.string());
+
+  // etna's PipelineManager takes no pipeline cache, so its calls through the vulkan.hpp
+  // dispatcher are redirected inside scopes instead. The destructor puts the functions back.
+  dispatch_hook.createGraphicsPipelines = std::exchange(
+    VULKAN_HPP_DEFAULT_DISPATCHER.vkCreateGraphicsPipelines, &create_graphics_pipelines);
+  dispatch_hook.createComputePipelines = std::exchange(
+    VULKAN_HPP_DEFAULT_DISPATCHER.vkCreateComputePipelines, &create_compute_pipelines);
+}
+
+PipelineCache::~PipelineCache()
+{
+  // Hooks installed after this one would be lost, and would call into a dead cache
+  ETNA_VERIFYF(
+    VULKAN_HPP_DEFAULT_DISPATCHER.vkCreateGraphicsPipelines == &create_graphics_pipelines &&
+      VULKAN_HPP_DEFAULT_DISPATCHER.vkCreateComputePipelines == &create_compute_pipelines,
+    "Pipeline creation was redirected again while a PipelineCache was alive");
+  VULKAN_HPP_DEFAULT_DISPATCHER.vkCreateGraphicsPipelines =
+    std::exchange(dispatch_hook.createGraphicsPipelines, nullptr);
+  VULKAN_HPP_DEFAULT_DISPATCHER.vkCreateComputePipelines =
+    std::exchange(dispatch_hook.createComputePipelines, nullptr);
+
+  save();
+}
+
+void PipelineCache::save()
+{
+  ZoneScoped;
+
+  const auto data =
+    etna::unwrap_vk_result(etna::get_context().getDevice().getPipelineCacheData(cache.get()));
+
+  const CacheFileHeader header{
+    .key = current_device_key(),
+    .dataSize = data.size(),
+    .dataHash = hash_bytes(data),
+  };
+
+  std::error_code error;
+  std::filesystem::create_directories(path.parent_path(), error);
+
+  // A crash while writing must not leave a torn cache behind, so the old file is replaced
+  // only once the new one is complete
+  auto tmpPath = path;
+  tmpPath += ".tmp";
+  {
+    std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(
+      reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    if (!file)
+    {
+      spdlog::warn("Unable to write pipeline cache to {}", tmpPath.string());
+      return;
+    }
+  }
+
+  std::filesystem::rename(tmpPath, path, error);
+  if (error)
+  {
+    spdlog::warn("Unable to save pipeline cache to {}: {}", path.string(), error.message());
+    return;
+  }
+
+  spdlog::info("Saved {} bytes of pipeline cache to {}", data.size(), path.string());
+}
+
+PipelineCache::EtnaScope::EtnaScope(PipelineCache& cache)
+{
+  ETNA_VERIFYF(scoped_cache == nullptr, "Pipeline cache scopes can't be nested");
+  scoped_cache = &cache;
+}
+
+PipelineCache::EtnaScope::~EtnaScope()
+{
+  scoped_cache = nullptr;
+}
+
+void PipelineCache::recordCreation(std::uint32_t pipelines, std::chrono::nanoseconds time)
+{
+  createdPipelines += pipelines;
+  creationNanoseconds += time.count();
+}
+
+PipelineCache::CreationStats PipelineCache::getCreationStats() const
+{
+  return CreationStats{
+    .pipelines = createdPipelines.load(),
+    .time = std::chrono::nanoseconds{creationNanoseconds.load()},
+  };
+}
+
+void PipelineCache::logCreationStats() const
+{
+  const auto stats = getCreationStats();
+  spdlog::info(
+    "Created {} pipelines in {:.2f}ms with a {} pipeline cache",
+    stats.pipelines,
+    std::chrono::duration<double, std::milli>(stats.time).count(),
+    isWarm() ? "warm" : "cold");
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <utility>
+
+#include <etna/Vulkan.hpp>
+
+
+/**
+ * A Vulkan pipeline cache that is kept on disk between launches. Every device and driver
+ * version gets its own file, a file whose header doesn't match the current device, or whose
+ * contents are damaged, is ignored and the cache starts out empty.
+ *
+ * Pipelines created by hand get the cache through create(), which also measures the time
+ * spent creating them. etna's PipelineManager takes no cache, so it is handed one only inside
+ * an EtnaScope: while the scope is alive, pipelines created without a cache on the thread that
+ * opened it use this one. Only one instance may exist at a time, it has to be created after
+ * etna and before any other thread creates pipelines.
+ */
+class PipelineCache
+{
+public:
+  struct CreationStats
+  {
+    std::uint32_t pipelines = 0;
+    std::chrono::nanoseconds time{0};
+  };
+
+  class EtnaScope
+  {
+  public:
+    explicit EtnaScope(PipelineCache& cache);
+    ~EtnaScope();
+
+    EtnaScope(const EtnaScope&) = delete;
+    EtnaScope& operator=(const EtnaScope&) = delete;
+  };
+
+  explicit PipelineCache(std::filesystem::path directory);
+  // Saves the cache
+  ~PipelineCache();
+
+  vk::PipelineCache get() const { return cache.get(); }
+
+  // Calls create with the cache and counts the pipeline it returns, may be called on any thread
+  template <class Create>
+  auto create(Create&& create)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    auto result = std::forward<Create>(create)(get());
+    recordCreation(1, std::chrono::steady_clock::now() - start);
+    return result;
+  }
+  void recordCreation(std::uint32_t pipelines, std::chrono::nanoseconds time);
+
+  // Pipelines created by etna on this thread use the cache until the scope ends
+  [[nodiscard]] EtnaScope scopeEtnaPipelines() { return EtnaScope{*this}; }
+
+  void save();
+
+  // Whether a valid cache was loaded from disk
+  bool isWarm() const { return loadedBytes > 0; }
+
+  // Pipelines created through create() and inside scopes since the cache was created
+  CreationStats getCreationStats() const;
+  void logCreationStats() const;
+
+  PipelineCache(const PipelineCache&) = delete;
+  PipelineCache& operator=(const PipelineCache&) = delete;
+
+private:
+  std::filesystem::path path;
+  vk::UniquePipelineCache cache;
+  std::size_t loadedBytes = 0;
+  std::atomic<std::uint32_t> createdPipelines = 0;
+  std::atomic<std::int64_t> creationNanoseconds = 0;
+};
@@ -0,0 +1,131 @@
+#include "PipelineCompiler.hpp"
+
+#include <algorithm>
+
+#include <etna/Etna.hpp>
+#include <etna/GlobalContext.hpp>
+#include <spdlog/spdlog.h>
+#include <tracy/Tracy.hpp>
+
+
+// The handle stays valid after the lock is released, etna keeps layouts until shutdown
+static vk::DescriptorSetLayout program_set_layout(const std::string& program)
+{
+  return etna::get_context().getDescriptorSetLayouts().getVkLayout(
+    etna::get_shader_program(program.c_str()).getDescriptorLayoutId(0));
+}
+
+PipelineCompiler::PipelineCompiler(std::uint32_t thread_count, PipelineCache& pipeline_cache)
+  : pipelineCache{&pipeline_cache}
+{
+  for (std::uint32_t i = 0; i < std::max<std::uint32_t>(thread_count, 1); ++i)
+    threads.emplace_back([this](std::stop_token stop_token) { workerLoop(stop_token); });
+}
+
+PipelineCompiler::~PipelineCompiler()
+{
+  waitIdle();
+  // Workers have to be joined while the mutex and condition variables are still alive
+  for (auto& thread : threads)
+    thread.request_stop();
+  threads.clear();
+}
+
+AsyncPipeline<CompiledPipeline> PipelineCompiler::submitGraphics(
+  std::string program,
+  std::vector<std::filesystem::path> shaders,
+  CompiledPipeline::GraphicsCreateInfo info)
+{
+  auto name = program;
+  return submit(
+    std::move(name),
+    [this, program = std::move(program), shaders = std::move(shaders), info = std::move(info)]() {
+      vk::DescriptorSetLayout setLayout;
+      {
+        const auto lock = lockEtna();
+        setLayout = program_set_layout(program);
+      }
+      return pipelineCache->create([&](vk::PipelineCache cache) {
+        return CompiledPipeline::createGraphics(setLayout, shaders, info, cache);
+      });
+    });
+}
+
+AsyncPipeline<CompiledPipeline> PipelineCompiler::submitCompute(
+  std::string program, std::filesystem::path shader)
+{
+  auto name = program;
+  return submit(
+    std::move(name), [this, program = std::move(program), shader = std::move(shader)]() {
+      vk::DescriptorSetLayout setLayout;
+      {
+        const auto lock = lockEtna();
+        setLayout = program_set_layout(program);
+      }
+      return pipelineCache->create([&](vk::PipelineCache cache) {
+        return CompiledPipeline::createCompute(setLayout, shader, cache);
+      });
+    });
+}
+
+void PipelineCompiler::enqueue(Job job)
+{
+  {
+    std::lock_guard lock{mutex};
+    if (pendingJobs == 0)
+    {
+      batchJobs = 0;
+      batchStart = std::chrono::steady_clock::now();
+    }
+    ++pendingJobs;
+    ++batchJobs;
+    jobs.push_back(std::move(job));
+  }
+  jobsAvailable.notify_one();
+}
+
+void PipelineCompiler::waitIdle()
+{
+  ZoneScoped;
+
+  std::unique_lock lock{mutex};
+  jobsDone.wait(lock, [this]() { return pendingJobs == 0; });
+}
+
+std::uint32_t PipelineCompiler::getPendingJobs() const
+{
+  std::lock_guard lock{mutex};
+  return pendingJobs;
+}
+
+void PipelineCompiler::workerLoop(std::stop_token stop_token)
+{
+  tracy::SetThreadName("pipeline_compiler");
+
+  while (true)
+  {
+    Job job;
+    {
+      std::unique_lock lock{mutex};
+      if (!jobsAvailable.wait(lock, stop_token, [this]() { return !jobs.empty(); }))
+        return;
+      job = std::move(jobs.front());
+      jobs.pop_front();
+    }
+
+    {
+      ZoneScopedN("compilePipeline");
+      ZoneText(job.name.data(), job.name.size());
+      job.run();
+    }
+
+    std::lock_guard lock{mutex};
+    if (--pendingJobs == 0)
+    {
+      const std::chrono::duration<double, std::milli> time =
+        std::chrono::steady_clock::now() - batchStart;
+      spdlog::info("Compiled {} pipelines in the background in {:.2f}ms", batchJobs, time.count());
+      jobsDone.notify_all();
+    }
+  }
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <function2/function2.hpp>
+
+#include "render_utils/CompiledPipeline.hpp"
+#include "render_utils/PipelineCache.hpp"
+
+
+/**
+ * A pipeline that is being created by a PipelineCompiler. Nothing waits for it until get()
+ * is called, code that has a fallback checks isReady() instead.
+ */
+template <class Pipeline>
+class AsyncPipeline
+{
+public:
+  AsyncPipeline() = default;
+  explicit AsyncPipeline(std::future<Pipeline> pipeline_future)
+    : future{std::move(pipeline_future)}
+  {
+  }
+
+  bool isReady()
+  {
+    if (
+      !pipeline && future.valid() &&
+      future.wait_for(std::chrono::seconds{0}) == std::future_status::ready)
+      pipeline.emplace(future.get());
+    return pipeline.has_value();
+  }
+
+  // Blocks until the pipeline is created
+  Pipeline& get()
+  {
+    if (!pipeline)
+      pipeline.emplace(future.get());
+    return *pipeline;
+  }
+
+private:
+  std::future<Pipeline> future;
+  std::optional<Pipeline> pipeline;
+};
+
+/**
+ * Creates pipelines on worker threads, so that the driver compiles them while the scene is
+ * loading and frames are rendered.
+ *
+ * etna is not thread-safe. submitGraphics and submitCompute only hold lockEtna() while they
+ * look up the descriptor set layout of the program, the driver compiles without the lock, so
+ * jobs run concurrently with each other and with command recording. The render thread has to
+ * hold the lock while it creates etna programs, as long as jobs may be running. Waiting for
+ * a pipeline while holding the lock deadlocks.
+ */
+class PipelineCompiler
+{
+public:
+  // Pipelines of submitGraphics and submitCompute are created with the cache
+  PipelineCompiler(std::uint32_t thread_count, PipelineCache& pipeline_cache);
+  // Waits for all submitted jobs
+  ~PipelineCompiler();
+
+  template <class Create, class Pipeline = std::invoke_result_t<Create&>>
+  AsyncPipeline<Pipeline> submit(std::string name, Create create)
+  {
+    std::packaged_task<Pipeline()> task{std::move(create)};
+    auto future = task.get_future();
+    enqueue(Job{
+      .name = std::move(name),
+      .run = [task = std::move(task)]() mutable { task(); },
+    });
+    return AsyncPipeline<Pipeline>{std::move(future)};
+  }
+
+  // Binaries are the ones of the etna program, or of a variant with the same descriptor layout
+  AsyncPipeline<CompiledPipeline> submitGraphics(
+    std::string program,
+    std::vector<std::filesystem::path> shaders,
+    CompiledPipeline::GraphicsCreateInfo info);
+  AsyncPipeline<CompiledPipeline> submitCompute(std::string program, std::filesystem::path shader);
+
+  [[nodiscard]] std::unique_lock<std::mutex> lockEtna() { return std::unique_lock{etnaMutex}; }
+
+  void waitIdle();
+  std::uint32_t getPendingJobs() const;
+
+  PipelineCompiler(const PipelineCompiler&) = delete;
+  PipelineCompiler& operator=(const PipelineCompiler&) = delete;
+
+private:
+  struct Job
+  {
+    std::string name;
+    fu2::unique_function<void()> run;
+  };
+
+  void enqueue(Job job);
+  void workerLoop(std::stop_token stop_token);
+
+private:
+  PipelineCache* pipelineCache;
+  std::mutex etnaMutex;
+
+  mutable std::mutex mutex;
+  std::condition_variable_any jobsAvailable;
+  std::condition_variable jobsDone;
+  std::deque<Job> jobs;
+  std::uint32_t pendingJobs = 0;
+
+  // Reported once every batch of jobs is done
+  std::uint32_t batchJobs = 0;
+  std::chrono::steady_clock::time_point batchStart;
+
+  std::vector<std::jthread> threads;
+};
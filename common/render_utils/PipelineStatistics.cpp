@@ -0,0 +1,57 @@
+#include "PipelineStatistics.hpp"
+
+#include <bit>
+
+#include <etna/GlobalContext.hpp>
+#include <tracy/Tracy.hpp>
+
+
+PipelineStatistics::PipelineStatistics(
+  std::uint32_t max_scopes_per_frame, vk::QueryPipelineStatisticFlags statistics)
+  : queries{FrameQueryPool::CreateInfo{
+      .queryType = vk::QueryType::ePipelineStatistics,
+      .pipelineStatistics = statistics,
+      .maxScopes = max_scopes_per_frame,
+      .valuesPerQuery = static_cast<std::uint32_t>(
+        std::popcount(static_cast<vk::QueryPipelineStatisticFlags::MaskType>(statistics))),
+      .name = "Pipeline statistics",
+    }}
+{
+}
+
+void PipelineStatistics::beginFrame(vk::CommandBuffer cmd_buf)
+{
+  ZoneScoped;
+
+  if (queries.beginFrame(cmd_buf))
+    collectResults();
+}
+
+std::uint32_t PipelineStatistics::beginScope(vk::CommandBuffer cmd_buf, std::string name)
+{
+  const auto scope = queries.addScope(std::move(name));
+  cmd_buf.beginQuery(queries.getPool(), scope, {});
+  return scope;
+}
+
+void PipelineStatistics::endScope(vk::CommandBuffer cmd_buf, std::uint32_t scope)
+{
+  cmd_buf.endQuery(queries.getPool(), scope);
+}
+
+void PipelineStatistics::collectResults()
+{
+  results.clear();
+  for (std::size_t scope = 0; scope < queries.getReadScopeCount(); ++scope)
+  {
+    const auto values = queries.getReadValues(scope, 0);
+    if (!values)
+      continue;
+
+    results.push_back(
+      Result{
+        .name = queries.getReadScopeName(scope),
+        .values = {values->begin(), values->end()},
+      });
+  }
+}
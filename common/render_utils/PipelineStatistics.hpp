@@ -0,0 +1,50 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+
+#include <etna/Vulkan.hpp>
+
+#include "FrameQueryPool.hpp"
+
+
+/**
+ * Collects pipeline statistics (fragment shader invocations, clipped primitives, ...)
+ * of named scopes. Like GpuTimer it keeps its queries in a FrameQueryPool, so results lag
+ * a few frames behind and reading them never stalls. Scopes can not be nested and must not be
+ * opened inside a render pass that executes secondary command buffers.
+ */
+class PipelineStatistics
+{
+public:
+  struct Result
+  {
+    std::string name;
+    // One value per requested statistic, in the order of the flag bits
+    std::vector<std::uint64_t> values;
+  };
+
+  PipelineStatistics(
+    std::uint32_t max_scopes_per_frame, vk::QueryPipelineStatisticFlags statistics);
+
+  // Must be called once per frame after the command manager waited for the frame's slot,
+  // before any scopes are recorded
+  void beginFrame(vk::CommandBuffer cmd_buf);
+
+  std::uint32_t beginScope(vk::CommandBuffer cmd_buf, std::string name);
+  void endScope(vk::CommandBuffer cmd_buf, std::uint32_t scope);
+
+  // Scopes of the latest frame whose queries were read back, in recording order
+  std::span<const Result> getResults() const { return results; }
+
+  PipelineStatistics(const PipelineStatistics&) = delete;
+  PipelineStatistics& operator=(const PipelineStatistics&) = delete;
+
+private:
+  void collectResults();
+
+private:
+  FrameQueryPool queries;
+  std::vector<Result> results;
+};
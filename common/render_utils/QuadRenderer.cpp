@@ -35,13 +35,45 @@ void QuadRenderer::render(
   vk::ImageView target_image_view,
   const etna::Image& tex_to_draw,
   const etna::Sampler& sampler)
+{
+  renderBinding(
+    cmd_buf,
+    target_image,
+    target_image_view,
+    tex_to_draw.genBinding(sampler.get(), vk::ImageLayout::eShaderReadOnlyOptimal));
+}
+
+void QuadRenderer::render(
+  vk::CommandBuffer cmd_buf,
+  vk::Image target_image,
+  vk::ImageView target_image_view,
+  const etna::Image& tex_to_draw,
+  vk::ImageView tex_view,
+  const etna::Sampler& sampler)
+{
+  renderBinding(
+    cmd_buf,
+    target_image,
+    target_image_view,
+    etna::ImageBinding{
+      tex_to_draw,
+      vk::DescriptorImageInfo{
+        .sampler = sampler.get(),
+        .imageView = tex_view,
+        .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+      },
+    });
+}
+
+void QuadRenderer::renderBinding(
+  vk::CommandBuffer cmd_buf,
+  vk::Image target_image,
+  vk::ImageView target_image_view,
+  etna::ImageBinding tex_binding)
 {
   auto programInfo = etna::get_shader_program(programId);
   auto set = etna::create_descriptor_set(
-    programInfo.getDescriptorLayoutId(0),
-    cmd_buf,
-    {etna::Binding{
-      0, tex_to_draw.genBinding(sampler.get(), vk::ImageLayout::eShaderReadOnlyOptimal)}});
+    programInfo.getDescriptorLayoutId(0), cmd_buf, {etna::Binding{0, std::move(tex_binding)}});
 
   etna::RenderTargetState renderTargets(
     cmd_buf,
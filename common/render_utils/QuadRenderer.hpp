@@ -4,6 +4,7 @@
 #include <etna/GraphicsPipeline.hpp>
 #include <etna/Image.hpp>
 #include <etna/Sampler.hpp>
+#include <etna/DescriptorSet.hpp>
 
 
 /**
@@ -28,7 +29,22 @@ public:
     const etna::Image& tex_to_draw,
     const etna::Sampler& sampler);
 
+  // Draws a specific view of the texture, e.g. a single layer of an array
+  void render(
+    vk::CommandBuffer cmd_buff,
+    vk::Image target_image,
+    vk::ImageView target_image_view,
+    const etna::Image& tex_to_draw,
+    vk::ImageView tex_view,
+    const etna::Sampler& sampler);
+
 private:
+  void renderBinding(
+    vk::CommandBuffer cmd_buff,
+    vk::Image target_image,
+    vk::ImageView target_image_view,
+    etna::ImageBinding tex_binding);
+
   etna::GraphicsPipeline pipeline;
   etna::ShaderProgramId programId;
   vk::Rect2D rect{};
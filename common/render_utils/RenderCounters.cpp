@@ -0,0 +1,51 @@
+#include "RenderCounters.hpp"
+
+#include <algorithm>
+#include <map>
+
+#include <fmt/format.h>
+#include <tracy/Tracy.hpp>
+
+
+static constexpr std::array<const char*, RenderCounters::COUNTER_COUNT> COUNTER_NAMES{
+  "Draws",
+  "Triangles",
+  "Instances visited",
+  "Instances culled",
+  "Relems visited",
+  "Relems culled",
+  "Pipeline binds",
+  "Push constants",
+};
+
+void RenderCounters::beginFrame()
+{
+  for (std::size_t i = 0; i < COUNTER_COUNT; ++i)
+  {
+    lastFrame[i] = current[i].exchange(0, std::memory_order_relaxed);
+    TracyPlot(COUNTER_NAMES[i], static_cast<std::int64_t>(lastFrame[i]));
+  }
+}
+
+const char* RenderCounters::getName(Counter counter)
+{
+  return COUNTER_NAMES[static_cast<std::size_t>(counter)];
+}
+
+void RenderCounters::plotPipelineStatistics(
+  std::span<const PipelineStatistics::Result> results,
+  std::span<const char* const> statistic_names)
+{
+  std::map<std::string, std::uint64_t, std::less<>> sums;
+  for (const auto& result : results)
+    for (std::size_t i = 0; i < std::min(result.values.size(), statistic_names.size()); ++i)
+      sums[fmt::format("{} {}", result.name, statistic_names[i])] += result.values[i];
+
+  for (const auto& [name, value] : sums)
+  {
+    auto it = plotNames.find(name);
+    if (it == plotNames.end())
+      it = plotNames.insert(name).first;
+    TracyPlot(it->c_str(), static_cast<std::int64_t>(value));
+  }
+}
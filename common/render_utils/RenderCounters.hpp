@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <set>
+#include <span>
+#include <string>
+
+#include "PipelineStatistics.hpp"
+
+
+/**
+ * CPU-side counts of the work recorded for a frame: draws, triangles, visited and culled
+ * instances and render elements, pipeline binds and push constant updates. Adding is
+ * thread-safe, so command recording workers share one instance. Callers should accumulate
+ * in locals and add once per batch rather than once per draw.
+ *
+ * beginFrame moves the counts of the previous frame aside and emits them as Tracy plots.
+ */
+class RenderCounters
+{
+public:
+  enum class Counter : std::size_t
+  {
+    Draws,
+    // Of non-indirect draws only, indirect ones are counted on the GPU
+    Triangles,
+    // Instances and render elements that draws were recorded for
+    InstancesVisited,
+    // Ones rejected by CPU culling, once per culling test
+    InstancesCulled,
+    RelemsVisited,
+    RelemsCulled,
+    PipelineBinds,
+    PushConstants,
+  };
+  static constexpr std::size_t COUNTER_COUNT = 8;
+
+  RenderCounters() = default;
+
+  void beginFrame();
+
+  void add(Counter counter, std::uint64_t value = 1)
+  {
+    current[static_cast<std::size_t>(counter)].fetch_add(value, std::memory_order_relaxed);
+  }
+
+  std::uint64_t getLastFrame(Counter counter) const
+  {
+    return lastFrame[static_cast<std::size_t>(counter)];
+  }
+  static const char* getName(Counter counter);
+
+  // Plots every statistic of every scope as "<scope> <statistic>", scopes with the same name
+  // are added up. Statistic names follow the order of the flag bits of the results.
+  void plotPipelineStatistics(
+    std::span<const PipelineStatistics::Result> results,
+    std::span<const char* const> statistic_names);
+
+  RenderCounters(const RenderCounters&) = delete;
+  RenderCounters& operator=(const RenderCounters&) = delete;
+
+private:
+  std::array<std::atomic<std::uint64_t>, COUNTER_COUNT> current{};
+  std::array<std::uint64_t, COUNTER_COUNT> lastFrame{};
+  // Tracy keeps the plot name pointers, set nodes never move
+  std::set<std::string, std::less<>> plotNames;
+};
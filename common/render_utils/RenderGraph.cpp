@@ -0,0 +1,637 @@
+#include "RenderGraph.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+#include <etna/Assert.hpp>
+#include <etna/Etna.hpp>
+#include <etna/GlobalContext.hpp>
+#include <spdlog/spdlog.h>
+#include <tracy/Tracy.hpp>
+
+
+static bool is_write_access(RenderGraph::Access access)
+{
+  switch (access)
+  {
+  case RenderGraph::Access::ColorAttachment:
+  case RenderGraph::Access::DepthAttachment:
+  case RenderGraph::Access::StorageWrite:
+  case RenderGraph::Access::TransferDst:
+    return true;
+  default:
+    return false;
+  }
+}
+
+static vk::ImageLayout access_layout(RenderGraph::Access access)
+{
+  switch (access)
+  {
+  case RenderGraph::Access::ColorAttachment:
+    return vk::ImageLayout::eColorAttachmentOptimal;
+  case RenderGraph::Access::DepthAttachment:
+    // The same layout etna's render targets use, so they don't transition it again
+    return vk::ImageLayout::eDepthStencilAttachmentOptimal;
+  case RenderGraph::Access::Sampled:
+    return vk::ImageLayout::eShaderReadOnlyOptimal;
+  case RenderGraph::Access::StorageRead:
+  case RenderGraph::Access::StorageWrite:
+    return vk::ImageLayout::eGeneral;
+  case RenderGraph::Access::TransferSrc:
+    return vk::ImageLayout::eTransferSrcOptimal;
+  case RenderGraph::Access::TransferDst:
+    return vk::ImageLayout::eTransferDstOptimal;
+  }
+  return vk::ImageLayout::eUndefined;
+}
+
+static vk::AccessFlags2 access_flags(RenderGraph::Access access, bool write)
+{
+  switch (access)
+  {
+  case RenderGraph::Access::ColorAttachment:
+    if (write)
+      return vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite;
+    return vk::AccessFlagBits2::eColorAttachmentRead;
+  case RenderGraph::Access::DepthAttachment:
+    if (write)
+      return vk::AccessFlagBits2::eDepthStencilAttachmentRead |
+        vk::AccessFlagBits2::eDepthStencilAttachmentWrite;
+    return vk::AccessFlagBits2::eDepthStencilAttachmentRead;
+  case RenderGraph::Access::Sampled:
+    return vk::AccessFlagBits2::eShaderSampledRead;
+  case RenderGraph::Access::StorageRead:
+    return vk::AccessFlagBits2::eShaderStorageRead;
+  case RenderGraph::Access::StorageWrite:
+    return vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite;
+  case RenderGraph::Access::TransferSrc:
+    return vk::AccessFlagBits2::eTransferRead;
+  case RenderGraph::Access::TransferDst:
+    return vk::AccessFlagBits2::eTransferWrite;
+  }
+  return vk::AccessFlagBits2::eNone;
+}
+
+static vk::ImageAspectFlags format_aspect(vk::Format format)
+{
+  switch (format)
+  {
+  case vk::Format::eD16Unorm:
+  case vk::Format::eX8D24UnormPack32:
+  case vk::Format::eD32Sfloat:
+    return vk::ImageAspectFlagBits::eDepth;
+  case vk::Format::eD16UnormS8Uint:
+  case vk::Format::eD24UnormS8Uint:
+  case vk::Format::eD32SfloatS8Uint:
+    return vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+  case vk::Format::eS8Uint:
+    return vk::ImageAspectFlagBits::eStencil;
+  default:
+    return vk::ImageAspectFlagBits::eColor;
+  }
+}
+
+static vk::ImageCreateInfo transient_image_create_info(const RenderGraph::TransientImageInfo& info)
+{
+  return vk::ImageCreateInfo{
+    .imageType = vk::ImageType::e2D,
+    .format = info.format,
+    .extent = vk::Extent3D{info.extent.width, info.extent.height, 1},
+    .mipLevels = info.mipLevels,
+    .arrayLayers = 1,
+    .samples = vk::SampleCountFlagBits::e1,
+    .tiling = vk::ImageTiling::eOptimal,
+    .usage = info.usage,
+    .sharingMode = vk::SharingMode::eExclusive,
+    .initialLayout = vk::ImageLayout::eUndefined,
+  };
+}
+
+static std::uint32_t find_device_local_memory_type(std::uint32_t type_bits)
+{
+  const auto properties = etna::get_context().getPhysicalDevice().getMemoryProperties();
+
+  std::uint32_t typeIdx = 0;
+  while (typeIdx < properties.memoryTypeCount &&
+         ((type_bits & (1u << typeIdx)) == 0 ||
+          !(properties.memoryTypes[typeIdx].propertyFlags &
+            vk::MemoryPropertyFlagBits::eDeviceLocal)))
+    ++typeIdx;
+
+  ETNA_VERIFYF(
+    typeIdx < properties.memoryTypeCount,
+    "No device local memory type fits the transient images");
+  return typeIdx;
+}
+
+static double to_mib(vk::DeviceSize bytes)
+{
+  return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+RenderGraph::PassBuilder::PassBuilder(RenderGraph& graph, std::size_t pass_idx)
+  : graph{graph}
+  , passIdx{pass_idx}
+{
+}
+
+void RenderGraph::PassBuilder::read(ImageId image, Access access, vk::PipelineStageFlags2 stages)
+{
+  ETNA_VERIFYF(
+    access == Access::DepthAttachment || !is_write_access(access),
+    "Image {} can not be read as a write-only access",
+    graph.getImage(image).name);
+  addAccess(image, access, stages, false);
+}
+
+void RenderGraph::PassBuilder::write(ImageId image, Access access, vk::PipelineStageFlags2 stages)
+{
+  ETNA_VERIFYF(
+    is_write_access(access),
+    "Image {} can not be written as a read-only access",
+    graph.getImage(image).name);
+  addAccess(image, access, stages, true);
+}
+
+void RenderGraph::PassBuilder::markSideEffect()
+{
+  graph.passes[passIdx].sideEffect = true;
+}
+
+void RenderGraph::PassBuilder::addAccess(
+  ImageId image, Access access, vk::PipelineStageFlags2 stages, bool write)
+{
+  auto& pass = graph.passes[passIdx];
+  const ImageState state{
+    .layout = access_layout(access),
+    .stages = stages,
+    .access = access_flags(access, write),
+  };
+
+  // An image used in several ways by one pass gets a single state covering all of them
+  auto it = std::ranges::find(pass.accesses, image, &ImageAccess::image);
+  if (it != pass.accesses.end())
+  {
+    ETNA_VERIFYF(
+      it->state.layout == state.layout,
+      "Pass {} uses image {} in two different layouts",
+      pass.name,
+      graph.getImage(image).name);
+    it->state.stages |= state.stages;
+    it->state.access |= state.access;
+    it->write = it->write || write;
+    return;
+  }
+
+  pass.accesses.push_back(ImageAccess{.image = image, .state = state, .write = write});
+  if (write && !graph.getImage(image).transient)
+    pass.sideEffect = true;
+}
+
+RenderGraph::Resources::Resources(const RenderGraph& graph)
+  : graph{graph}
+{
+}
+
+vk::Image RenderGraph::Resources::getImage(ImageId image) const
+{
+  const auto& info = graph.getImage(image);
+  return info.transient ? graph.plan->images[info.planIdx].get() : info.image;
+}
+
+vk::ImageView RenderGraph::Resources::getView(ImageId image) const
+{
+  const auto& info = graph.getImage(image);
+  return info.transient ? graph.plan->views[info.planIdx].get() : info.view;
+}
+
+vk::ImageView RenderGraph::Resources::getMipView(ImageId image, std::uint32_t mip) const
+{
+  const auto& info = graph.getImage(image);
+  ETNA_VERIFYF(
+    info.transient && mip < info.transient->mipLevels,
+    "Image {} has no view of mip {}",
+    info.name,
+    mip);
+  if (info.transient->mipLevels == 1)
+    return graph.plan->views[info.planIdx].get();
+  return graph.plan->mipViews[info.planIdx][mip].get();
+}
+
+vk::Extent2D RenderGraph::Resources::getExtent(ImageId image) const
+{
+  return graph.getImage(image).extent;
+}
+
+RenderGraph::RenderGraph()
+  : framesInFlight{etna::get_context().getMainWorkCount().multiBufferingCount()}
+{
+}
+
+RenderGraph::~RenderGraph() = default;
+
+RenderGraph::ImageId RenderGraph::importImage(
+  std::string name,
+  vk::Image image,
+  vk::ImageView view,
+  vk::Extent2D extent,
+  vk::ImageAspectFlags aspect)
+{
+  images.push_back(Image{
+    .name = std::move(name),
+    .transient = std::nullopt,
+    .aspect = aspect,
+    .extent = extent,
+    .image = image,
+    .view = view,
+  });
+  return static_cast<ImageId>(images.size() - 1);
+}
+
+RenderGraph::ImageId RenderGraph::createImage(std::string name, const TransientImageInfo& info)
+{
+  images.push_back(Image{
+    .name = std::move(name),
+    .transient = info,
+    .aspect = format_aspect(info.format),
+    .extent = info.extent,
+  });
+  return static_cast<ImageId>(images.size() - 1);
+}
+
+void RenderGraph::addPass(std::string name, SetupFunction setup, RecordFunction record)
+{
+  passes.push_back(Pass{.name = std::move(name), .record = std::move(record)});
+
+  PassBuilder builder{*this, passes.size() - 1};
+  setup(builder);
+}
+
+void RenderGraph::cullPasses()
+{
+  // Walking backwards, a pass is kept if a kept pass after it touches anything it writes.
+  // Writes are not assumed to overwrite everything, so earlier writers are kept as well.
+  std::vector<bool> needed(images.size(), false);
+  for (auto pass = passes.rbegin(); pass != passes.rend(); ++pass)
+  {
+    pass->alive = pass->sideEffect || std::ranges::any_of(pass->accesses, [&](const auto& access) {
+                    return access.write && needed[static_cast<std::uint32_t>(access.image)];
+                  });
+    if (!pass->alive)
+    {
+      ++stats.culledPasses;
+      continue;
+    }
+
+    for (const auto& access : pass->accesses)
+      needed[static_cast<std::uint32_t>(access.image)] = true;
+  }
+}
+
+void RenderGraph::computeLifetimes()
+{
+  for (std::size_t passIdx = 0; passIdx < passes.size(); ++passIdx)
+  {
+    if (!passes[passIdx].alive)
+      continue;
+
+    for (const auto& access : passes[passIdx].accesses)
+    {
+      auto& image = getImage(access.image);
+      if (!image.used)
+        image.firstPass = passIdx;
+      image.lastPass = passIdx;
+      image.used = true;
+    }
+  }
+}
+
+void RenderGraph::prepareTransients()
+{
+  auto device = etna::get_context().getDevice();
+
+  // Transients of culled passes count as requested, they would have been allocated before
+  std::vector<std::uint64_t> key;
+  for (auto& image : images)
+  {
+    if (!image.transient)
+      continue;
+
+    const auto createInfo = transient_image_create_info(*image.transient);
+    image.memorySize = device
+                         .getImageMemoryRequirements(
+                           vk::DeviceImageMemoryRequirements{.pCreateInfo = &createInfo})
+                         .memoryRequirements.size;
+    stats.transientBytesRequested += image.memorySize;
+
+    if (!image.used)
+      continue;
+
+    key.insert(
+      key.end(),
+      {static_cast<std::uint64_t>(image.transient->format),
+       (static_cast<std::uint64_t>(image.transient->extent.width) << 32) |
+         image.transient->extent.height,
+       (static_cast<std::uint64_t>(image.transient->mipLevels) << 32) |
+         static_cast<VkImageUsageFlags>(image.transient->usage),
+       (static_cast<std::uint64_t>(image.firstPass) << 32) | image.lastPass});
+  }
+
+  if (!plan || plan->key != key)
+  {
+    if (plan)
+      retiredPlans.emplace_back(frame, std::move(plan));
+    plan = createPlan(std::move(key));
+  }
+
+  std::size_t planIdx = 0;
+  for (auto& image : images)
+    if (image.transient && image.used)
+      image.planIdx = planIdx++;
+
+  stats.transientImages = static_cast<std::uint32_t>(planIdx);
+  stats.transientBytesAllocated = plan->size;
+}
+
+std::unique_ptr<RenderGraph::TransientPlan> RenderGraph::createPlan(std::vector<std::uint64_t> key)
+{
+  ZoneScoped;
+
+  auto device = etna::get_context().getDevice();
+  auto result = std::make_unique<TransientPlan>();
+  result->key = std::move(key);
+
+  std::vector<const Image*> transients;
+  for (const auto& image : images)
+    if (image.transient && image.used)
+      transients.push_back(&image);
+
+  if (transients.empty())
+    return result;
+
+  std::vector<vk::MemoryRequirements> requirements;
+  std::uint32_t memoryTypeBits = ~0u;
+  for (const auto* image : transients)
+  {
+    result->images.push_back(etna::unwrap_vk_result(
+      device.createImageUnique(transient_image_create_info(*image->transient))));
+    requirements.push_back(device.getImageMemoryRequirements(result->images.back().get()));
+    memoryTypeBits &= requirements.back().memoryTypeBits;
+  }
+
+  // Images take over slots whose previous user is done before they are first needed,
+  // preferring the smallest slot that fits over growing one
+  struct Slot
+  {
+    vk::DeviceSize size = 0;
+    vk::DeviceSize alignment = 1;
+    std::size_t lastPass = 0;
+    vk::DeviceSize offset = 0;
+  };
+  std::vector<Slot> slots;
+
+  std::vector<std::size_t> order(transients.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::ranges::stable_sort(order, {}, [&](std::size_t idx) { return transients[idx]->firstPass; });
+
+  result->imageSlots.resize(transients.size());
+  for (const auto idx : order)
+  {
+    const auto& image = *transients[idx];
+    const auto& req = requirements[idx];
+
+    const auto better = [&](const Slot& a, const Slot& b) {
+      const bool aFits = a.size >= req.size;
+      const bool bFits = b.size >= req.size;
+      if (aFits != bFits)
+        return aFits;
+      return aFits ? a.size < b.size : a.size > b.size;
+    };
+
+    std::size_t best = slots.size();
+    for (std::size_t slotIdx = 0; slotIdx < slots.size(); ++slotIdx)
+      if (
+        slots[slotIdx].lastPass < image.firstPass &&
+        (best == slots.size() || better(slots[slotIdx], slots[best])))
+        best = slotIdx;
+    if (best == slots.size())
+      slots.emplace_back();
+
+    auto& slot = slots[best];
+    slot.size = std::max(slot.size, req.size);
+    slot.alignment = std::max(slot.alignment, req.alignment);
+    slot.lastPass = image.lastPass;
+    result->imageSlots[idx] = best;
+  }
+
+  for (auto& slot : slots)
+  {
+    slot.offset = (result->size + slot.alignment - 1) / slot.alignment * slot.alignment;
+    result->size = slot.offset + slot.size;
+  }
+
+  result->memory = etna::unwrap_vk_result(device.allocateMemoryUnique(
+    vk::MemoryAllocateInfo{
+      .allocationSize = result->size,
+      .memoryTypeIndex = find_device_local_memory_type(memoryTypeBits),
+    }));
+
+  for (std::size_t idx = 0; idx < transients.size(); ++idx)
+  {
+    const auto& image = *transients[idx];
+    const auto vkImage = result->images[idx].get();
+    ETNA_CHECK_VK_RESULT(device.bindImageMemory(
+      vkImage, result->memory.get(), slots[result->imageSlots[idx]].offset));
+
+    const auto createView = [&](std::uint32_t base_mip, std::uint32_t level_count) {
+      return etna::unwrap_vk_result(device.createImageViewUnique(
+        vk::ImageViewCreateInfo{
+          .image = vkImage,
+          .viewType = vk::ImageViewType::e2D,
+          .format = image.transient->format,
+          .subresourceRange =
+            {
+              .aspectMask = image.aspect,
+              .baseMipLevel = base_mip,
+              .levelCount = level_count,
+              .baseArrayLayer = 0,
+              .layerCount = 1,
+            },
+        }));
+    };
+
+    const auto mipLevels = image.transient->mipLevels;
+    result->views.push_back(createView(0, mipLevels));
+    auto& mipViews = result->mipViews.emplace_back();
+    if (mipLevels > 1)
+      for (std::uint32_t mip = 0; mip < mipLevels; ++mip)
+        mipViews.push_back(createView(mip, 1));
+  }
+
+  result->slotStates.resize(slots.size());
+
+  const auto unaliasedSize = std::accumulate(
+    requirements.begin(), requirements.end(), vk::DeviceSize{0}, [](auto sum, const auto& req) {
+      return sum + req.size;
+    });
+  spdlog::info(
+    "Render graph: {} transient images in {} slots, {:.2f} MiB instead of {:.2f} MiB",
+    transients.size(),
+    slots.size(),
+    to_mib(result->size),
+    to_mib(unaliasedSize));
+
+  return result;
+}
+
+void RenderGraph::placeBarriers()
+{
+  struct Tracked
+  {
+    ImageState state;
+    bool seen = false;
+    // Set while the last access was a read, later reads in the same layout join its barrier
+    bool readOpen = false;
+    std::size_t barrierPass = 0;
+    std::size_t barrierIdx = 0;
+  };
+  std::vector<Tracked> tracked(images.size());
+
+  for (std::size_t passIdx = 0; passIdx < passes.size(); ++passIdx)
+  {
+    auto& pass = passes[passIdx];
+    if (!pass.alive)
+      continue;
+
+    for (const auto& access : pass.accesses)
+    {
+      auto& image = getImage(access.image);
+      auto& track = tracked[static_cast<std::uint32_t>(access.image)];
+      auto* slotState =
+        image.transient ? &plan->slotStates[plan->imageSlots[image.planIdx]] : nullptr;
+
+      if (track.readOpen && !access.write && track.state.layout == access.state.layout)
+      {
+        auto& barrierPass = passes[track.barrierPass];
+        if (image.transient)
+        {
+          auto& barrier = barrierPass.transientBarriers[track.barrierIdx];
+          barrier.dstStageMask |= access.state.stages;
+          barrier.dstAccessMask |= access.state.access;
+        }
+        else
+        {
+          auto& transition = barrierPass.importedTransitions[track.barrierIdx];
+          transition.state.stages |= access.state.stages;
+          transition.state.access |= access.state.access;
+        }
+        track.state.stages |= access.state.stages;
+        track.state.access |= access.state.access;
+        if (slotState != nullptr)
+          *slotState = track.state;
+        ++stats.mergedReads;
+        continue;
+      }
+
+      if (image.transient)
+      {
+        // The first use waits for whatever used the slot last, this frame or the previous one
+        const auto& src = track.seen ? track.state : *slotState;
+        pass.transientBarriers.push_back(vk::ImageMemoryBarrier2{
+          .srcStageMask = src.stages,
+          .srcAccessMask = src.access,
+          .dstStageMask = access.state.stages,
+          .dstAccessMask = access.state.access,
+          .oldLayout = track.seen ? track.state.layout : vk::ImageLayout::eUndefined,
+          .newLayout = access.state.layout,
+          .srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+          .dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+          .image = plan->images[image.planIdx].get(),
+          .subresourceRange =
+            {
+              .aspectMask = image.aspect,
+              .baseMipLevel = 0,
+              .levelCount = image.transient->mipLevels,
+              .baseArrayLayer = 0,
+              .layerCount = 1,
+            },
+        });
+        track.barrierIdx = pass.transientBarriers.size() - 1;
+      }
+      else
+      {
+        pass.importedTransitions.push_back(
+          ImportedTransition{.image = access.image, .state = access.state});
+        track.barrierIdx = pass.importedTransitions.size() - 1;
+      }
+
+      track.state = access.state;
+      track.seen = true;
+      track.readOpen = !access.write;
+      track.barrierPass = passIdx;
+      if (slotState != nullptr)
+        *slotState = track.state;
+      ++stats.imageBarriers;
+    }
+  }
+}
+
+void RenderGraph::execute(vk::CommandBuffer cmd_buf)
+{
+  ZoneScoped;
+
+  ++frame;
+  std::erase_if(retiredPlans, [this](const auto& retired) {
+    return frame - retired.first > framesInFlight + 1;
+  });
+
+  stats = Stats{.passes = static_cast<std::uint32_t>(passes.size())};
+
+  cullPasses();
+  computeLifetimes();
+  prepareTransients();
+  placeBarriers();
+
+  const Resources resources{*this};
+  for (auto& pass : passes)
+  {
+    if (!pass.alive)
+      continue;
+
+    ZoneScopedN("recordPass");
+    ZoneName(pass.name.c_str(), pass.name.size());
+
+    for (const auto& transition : pass.importedTransitions)
+    {
+      const auto& image = getImage(transition.image);
+      etna::set_state(
+        cmd_buf,
+        image.image,
+        transition.state.stages,
+        transition.state.access,
+        transition.state.layout,
+        image.aspect);
+    }
+    if (!pass.importedTransitions.empty())
+    {
+      etna::flush_barriers(cmd_buf);
+      ++stats.barrierBatches;
+    }
+
+    if (!pass.transientBarriers.empty())
+    {
+      cmd_buf.pipelineBarrier2(
+        vk::DependencyInfo{
+          .imageMemoryBarrierCount = static_cast<std::uint32_t>(pass.transientBarriers.size()),
+          .pImageMemoryBarriers = pass.transientBarriers.data(),
+        });
+      ++stats.barrierBatches;
+    }
+
+    pass.record(cmd_buf, resources);
+  }
+
+  passes.clear();
+  images.clear();
+}
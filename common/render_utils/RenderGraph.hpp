@@ -0,0 +1,218 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <etna/Vulkan.hpp>
+#include <function2/function2.hpp>
+
+
+/**
+ * A graph of passes that is rebuilt every frame. Passes declare the images they read and
+ * write and are recorded in the order they were added. Before recording, the graph
+ *  - culls passes that have no side effects and whose results are never read,
+ *  - places all barriers a pass needs right before it as one batch, consecutive reads of
+ *    an image in the same layout share a single transition,
+ *  - backs transient images with memory shared by images whose lifetimes don't overlap.
+ *
+ * Imported images stay tracked by etna, the graph requests their states with etna::set_state.
+ * Transient images are created by the graph and are unknown to etna, so their barriers are
+ * recorded directly and passes must not hand them to etna (RenderTargetState, set_state).
+ * Their contents are undefined at the start of every frame.
+ */
+class RenderGraph
+{
+public:
+  enum class ImageId : std::uint32_t
+  {
+  };
+
+  enum class Access
+  {
+    ColorAttachment,
+    // Read only when the pass uses it for depth testing without writes
+    DepthAttachment,
+    Sampled,
+    StorageRead,
+    StorageWrite,
+    TransferSrc,
+    TransferDst,
+  };
+
+  struct TransientImageInfo
+  {
+    vk::Extent2D extent;
+    vk::Format format = vk::Format::eUndefined;
+    vk::ImageUsageFlags usage;
+    // Barriers always cover the whole chain, passes pick levels with Resources::getMipView
+    std::uint32_t mipLevels = 1;
+  };
+
+  class PassBuilder
+  {
+  public:
+    void read(ImageId image, Access access, vk::PipelineStageFlags2 stages);
+    void write(ImageId image, Access access, vk::PipelineStageFlags2 stages);
+    // Writes to imported images are side effects already
+    void markSideEffect();
+
+  private:
+    friend class RenderGraph;
+
+    PassBuilder(RenderGraph& graph, std::size_t pass_idx);
+    void addAccess(ImageId image, Access access, vk::PipelineStageFlags2 stages, bool write);
+
+    RenderGraph& graph;
+    std::size_t passIdx;
+  };
+
+  // Handles of the graph's images, only valid while passes are being recorded
+  class Resources
+  {
+  public:
+    vk::Image getImage(ImageId image) const;
+    vk::ImageView getView(ImageId image) const;
+    // A view of a single level, transient images only
+    vk::ImageView getMipView(ImageId image, std::uint32_t mip) const;
+    vk::Extent2D getExtent(ImageId image) const;
+
+  private:
+    friend class RenderGraph;
+
+    explicit Resources(const RenderGraph& graph);
+
+    const RenderGraph& graph;
+  };
+
+  using SetupFunction = fu2::function_view<void(PassBuilder&)>;
+  using RecordFunction = fu2::unique_function<void(vk::CommandBuffer, const Resources&)>;
+
+  // Counters of the last executed frame
+  struct Stats
+  {
+    std::uint32_t passes = 0;
+    std::uint32_t culledPasses = 0;
+    std::uint32_t imageBarriers = 0;
+    // Calls to vkCmdPipelineBarrier2, the ones etna::flush_barriers does for imported images
+    // included, so this is an upper bound
+    std::uint32_t barrierBatches = 0;
+    // Reads that reused the transition of a previous read instead of getting their own
+    std::uint32_t mergedReads = 0;
+    std::uint32_t transientImages = 0;
+    // What the transient images would take up without aliasing and pass culling
+    vk::DeviceSize transientBytesRequested = 0;
+    vk::DeviceSize transientBytesAllocated = 0;
+  };
+
+  RenderGraph();
+  ~RenderGraph();
+
+  ImageId importImage(
+    std::string name,
+    vk::Image image,
+    vk::ImageView view,
+    vk::Extent2D extent,
+    vk::ImageAspectFlags aspect);
+  ImageId createImage(std::string name, const TransientImageInfo& info);
+
+  // The setup function is called right away, the record function during execute()
+  void addPass(std::string name, SetupFunction setup, RecordFunction record);
+
+  // Records all passes that survived culling, the graph is empty afterwards
+  void execute(vk::CommandBuffer cmd_buf);
+
+  const Stats& getStats() const { return stats; }
+
+  RenderGraph(const RenderGraph&) = delete;
+  RenderGraph& operator=(const RenderGraph&) = delete;
+
+private:
+  struct ImageState
+  {
+    vk::ImageLayout layout = vk::ImageLayout::eUndefined;
+    vk::PipelineStageFlags2 stages = vk::PipelineStageFlagBits2::eNone;
+    vk::AccessFlags2 access = vk::AccessFlagBits2::eNone;
+  };
+
+  struct ImageAccess
+  {
+    ImageId image;
+    ImageState state;
+    bool write = false;
+  };
+
+  struct Image
+  {
+    std::string name;
+    std::optional<TransientImageInfo> transient;
+    vk::ImageAspectFlags aspect;
+    vk::Extent2D extent;
+    // Only set for imported images, transients are looked up in the plan
+    vk::Image image;
+    vk::ImageView view;
+    vk::DeviceSize memorySize = 0;
+    std::size_t firstPass = 0;
+    std::size_t lastPass = 0;
+    bool used = false;
+    std::size_t planIdx = 0;
+  };
+
+  struct ImportedTransition
+  {
+    ImageId image;
+    ImageState state;
+  };
+
+  struct Pass
+  {
+    std::string name;
+    std::vector<ImageAccess> accesses;
+    bool sideEffect = false;
+    RecordFunction record;
+    bool alive = false;
+
+    std::vector<ImportedTransition> importedTransitions;
+    std::vector<vk::ImageMemoryBarrier2> transientBarriers;
+  };
+
+  // Images and memory backing the transients, kept while the graph keeps the same shape
+  struct TransientPlan
+  {
+    std::vector<std::uint64_t> key;
+    vk::UniqueDeviceMemory memory;
+    vk::DeviceSize size = 0;
+    std::vector<vk::UniqueImage> images;
+    std::vector<vk::UniqueImageView> views;
+    // One view per level, left empty for images without a mip chain
+    std::vector<std::vector<vk::UniqueImageView>> mipViews;
+    // Every image is placed in a slot, images sharing a slot alias each other
+    std::vector<std::size_t> imageSlots;
+    // What the last image in the slot was used for, the next user has to wait for it
+    std::vector<ImageState> slotStates;
+  };
+
+  void cullPasses();
+  void computeLifetimes();
+  void prepareTransients();
+  std::unique_ptr<TransientPlan> createPlan(std::vector<std::uint64_t> key);
+  void placeBarriers();
+
+  Image& getImage(ImageId id) { return images[static_cast<std::uint32_t>(id)]; }
+  const Image& getImage(ImageId id) const { return images[static_cast<std::uint32_t>(id)]; }
+
+private:
+  std::vector<Image> images;
+  std::vector<Pass> passes;
+
+  std::unique_ptr<TransientPlan> plan;
+  // Destroyed a frame later than strictly needed, so that descriptor set caches keyed by
+  // handles have dropped their sets before the handles can be reused
+  std::vector<std::pair<std::uint64_t, std::unique_ptr<TransientPlan>>> retiredPlans;
+  std::uint64_t frame = 0;
+  std::uint64_t framesInFlight = 0;
+
+  Stats stats;
+};
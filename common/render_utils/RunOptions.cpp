@@ -0,0 +1,107 @@
+#include "RunOptions.hpp"
+
+#include <charconv>
+
+#include <spdlog/spdlog.h>
+
+
+template <class T>
+static std::optional<T> parse_number(std::string_view text)
+{
+  T value{};
+  const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+  if (error != std::errc{} || end != text.data() + text.size())
+    return std::nullopt;
+  return value;
+}
+
+// E.g. 1920x1080
+static std::optional<glm::uvec2> parse_resolution(std::string_view text)
+{
+  const auto separator = text.find('x');
+  if (separator == std::string_view::npos)
+    return std::nullopt;
+
+  const auto width = parse_number<std::uint32_t>(text.substr(0, separator));
+  const auto height = parse_number<std::uint32_t>(text.substr(separator + 1));
+  if (!width || !height || *width == 0 || *height == 0)
+    return std::nullopt;
+  return glm::uvec2{*width, *height};
+}
+
+static std::optional<RunOptions> parse_arguments(std::span<char*> args)
+{
+  RunOptions options;
+  for (std::size_t i = 0; i < args.size(); ++i)
+  {
+    const std::string_view arg = args[i];
+    const std::string_view value = i + 1 < args.size() ? args[i + 1] : "";
+
+    if (arg == "--headless")
+      options.headless = true;
+    else if (arg == "--benchmark")
+      options.benchmark = true;
+    else if (arg == "--frames")
+    {
+      const auto frames = parse_number<std::uint32_t>(value);
+      if (!frames)
+      {
+        spdlog::error("--frames expects a frame count, got '{}'", value);
+        return std::nullopt;
+      }
+      options.frameCount = *frames;
+      ++i;
+    }
+    else if (arg == "--resolution")
+    {
+      const auto resolution = parse_resolution(value);
+      if (!resolution)
+      {
+        spdlog::error("--resolution expects WIDTHxHEIGHT, got '{}'", value);
+        return std::nullopt;
+      }
+      options.resolution = *resolution;
+      ++i;
+    }
+    else if (arg == "--camera-path" && !value.empty())
+    {
+      options.cameraPath = value;
+      ++i;
+    }
+    else if (arg == "--benchmark-output" && !value.empty())
+    {
+      options.benchmarkOutput = value;
+      ++i;
+    }
+    else if (arg == "--baseline" && !value.empty())
+    {
+      options.baseline = value;
+      ++i;
+    }
+    else if (arg == "--threshold")
+    {
+      const auto threshold = parse_number<double>(value);
+      if (!threshold || *threshold < 0)
+      {
+        spdlog::error("--threshold expects a non-negative fraction, got '{}'", value);
+        return std::nullopt;
+      }
+      options.regressionThreshold = *threshold;
+      ++i;
+    }
+    else
+    {
+      spdlog::error("Unknown argument '{}'", arg);
+      return std::nullopt;
+    }
+  }
+  return options;
+}
+
+std::optional<RunOptions> parse_run_options(std::span<char*> args, std::string_view usage)
+{
+  auto options = parse_arguments(args);
+  if (!options)
+    spdlog::info("{}", usage);
+  return options;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include <glm/glm.hpp>
+
+
+// Command line of the samples that can run headless and benchmark themselves
+struct RunOptions
+{
+  glm::uvec2 resolution = {1280, 720};
+  // Renders into offscreen images without opening a window, there is no input
+  bool headless = false;
+  // Length of a headless run or of a benchmark, other windowed runs last until the window is
+  // closed
+  std::uint32_t frameCount = 1000;
+
+  // Plays the camera path in a loop for frameCount frames with a fixed timestep, ignoring
+  // input, and records frame times and counters. Works both with and without a window.
+  bool benchmark = false;
+  // Benchmarks orbit the scene if empty. C records the main camera to this file and P plays
+  // it back, camera_path.txt is used if empty.
+  std::filesystem::path cameraPath;
+  std::filesystem::path benchmarkOutput = "benchmark";
+  // Summary of an earlier run, times may not grow by more than the threshold fraction
+  std::filesystem::path baseline;
+  double regressionThreshold = 0.05;
+};
+
+// Arguments without the program name. On a malformed or unknown argument the error and the
+// usage text are logged and nothing is returned.
+std::optional<RunOptions> parse_run_options(std::span<char*> args, std::string_view usage);
@@ -0,0 +1,387 @@
+#include "ShaderHotReloader.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include <etna/Assert.hpp>
+#include <fmt/format.h>
+#include <glslang/Public/ResourceLimits.h>
+#include <glslang/Public/ShaderLang.h>
+#include <SPIRV/GlslangToSpv.h>
+#include <spdlog/spdlog.h>
+#include <tracy/Tracy.hpp>
+
+
+static constexpr auto POLL_INTERVAL = std::chrono::milliseconds{250};
+
+static std::optional<std::string> read_text_file(const std::filesystem::path& path)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open())
+    return std::nullopt;
+
+  std::stringstream text;
+  text << file.rdbuf();
+  return std::move(text).str();
+}
+
+// Make-style "target: dependency dependency \", spaces in paths are escaped with a backslash
+static std::vector<std::filesystem::path> parse_depfile(const std::string& text)
+{
+  std::vector<std::filesystem::path> result;
+
+  // The target may start with a drive letter, so a lone ':' doesn't end it
+  const auto targetEnd = text.find(": ");
+  if (targetEnd == std::string::npos)
+    return result;
+
+  std::string current;
+  const auto flush = [&]() {
+    if (!current.empty())
+      result.emplace_back(current);
+    current.clear();
+  };
+  for (std::size_t i = targetEnd + 2; i < text.size(); ++i)
+  {
+    const char c = text[i];
+    const char next = i + 1 < text.size() ? text[i + 1] : '\0';
+    if (c == '\\' && next == ' ')
+    {
+      current += ' ';
+      ++i;
+    }
+    else if (c == '\\' && (next == '\n' || next == '\r'))
+      flush();
+    else if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
+      flush();
+    else
+      current += c;
+  }
+  flush();
+
+  return result;
+}
+
+static std::optional<EShLanguage> stage_from_extension(const std::filesystem::path& path)
+{
+  const auto extension = path.extension().string();
+  if (extension == ".vert")
+    return EShLangVertex;
+  if (extension == ".tesc")
+    return EShLangTessControl;
+  if (extension == ".tese")
+    return EShLangTessEvaluation;
+  if (extension == ".geom")
+    return EShLangGeometry;
+  if (extension == ".frag")
+    return EShLangFragment;
+  if (extension == ".comp")
+    return EShLangCompute;
+  if (extension == ".task")
+    return EShLangTask;
+  if (extension == ".mesh")
+    return EShLangMesh;
+  return std::nullopt;
+}
+
+// Resolves includes the way glslangValidator does and records every file that was included
+class FileIncluder : public glslang::TShader::Includer
+{
+public:
+  FileIncluder(
+    const std::vector<std::filesystem::path>& include_dirs,
+    std::vector<std::filesystem::path>& included_files)
+    : includeDirs{include_dirs}
+    , includedFiles{included_files}
+  {
+  }
+
+  IncludeResult* includeLocal(
+    const char* header_name, const char* includer_name, std::size_t inclusion_depth) override
+  {
+    const auto includerDir = std::filesystem::path(includer_name).parent_path();
+    if (auto* result = tryInclude(includerDir / header_name))
+      return result;
+    return includeSystem(header_name, includer_name, inclusion_depth);
+  }
+
+  IncludeResult* includeSystem(const char* header_name, const char*, std::size_t) override
+  {
+    for (const auto& dir : includeDirs)
+      if (auto* result = tryInclude(dir / header_name))
+        return result;
+    return nullptr;
+  }
+
+  void releaseInclude(IncludeResult* result) override
+  {
+    if (result == nullptr)
+      return;
+    delete static_cast<std::string*>(result->userData);
+    delete result;
+  }
+
+private:
+  IncludeResult* tryInclude(const std::filesystem::path& path)
+  {
+    auto text = read_text_file(path);
+    if (!text)
+      return nullptr;
+
+    const auto normalized = path.lexically_normal();
+    includedFiles.push_back(normalized);
+
+    auto* data = new std::string(std::move(*text));
+    return new IncludeResult(normalized.generic_string(), data->data(), data->size(), data);
+  }
+
+private:
+  const std::vector<std::filesystem::path>& includeDirs;
+  std::vector<std::filesystem::path>& includedFiles;
+};
+
+// Targets the same environment as glslangValidator -V, Vulkan 1.0 and SPIR-V 1.0
+static std::optional<std::vector<std::uint32_t>> compile_glsl(
+  const std::filesystem::path& source_path,
+  const std::vector<std::filesystem::path>& include_dirs,
+  std::vector<std::filesystem::path>& dependencies)
+{
+  ZoneScoped;
+
+  const std::string sourceName = source_path.generic_string();
+  const auto stage = stage_from_extension(source_path);
+  if (!stage)
+  {
+    spdlog::error("Unable to tell the shader stage of {}", sourceName);
+    return std::nullopt;
+  }
+  const auto source = read_text_file(source_path);
+  if (!source)
+  {
+    spdlog::error("Unable to read shader {}", sourceName);
+    return std::nullopt;
+  }
+
+  const char* sourceText = source->c_str();
+  const char* sourceNameText = sourceName.c_str();
+  glslang::TShader shader(*stage);
+  shader.setStringsWithLengthsAndNames(&sourceText, nullptr, &sourceNameText, 1);
+  shader.setEnvInput(glslang::EShSourceGlsl, *stage, glslang::EShClientVulkan, 100);
+  shader.setEnvClient(glslang::EShClientVulkan, glslang::EShTargetVulkan_1_0);
+  shader.setEnvTarget(glslang::EShTargetSpv, glslang::EShTargetSpv_1_0);
+
+  dependencies = {source_path};
+  FileIncluder includer{include_dirs, dependencies};
+  const auto messages = static_cast<EShMessages>(EShMsgSpvRules | EShMsgVulkanRules);
+  if (!shader.parse(GetDefaultResources(), 100, false, messages, includer))
+  {
+    spdlog::error("Failed to compile {}:\n{}", sourceName, shader.getInfoLog());
+    return std::nullopt;
+  }
+
+  glslang::TProgram program;
+  program.addShader(&shader);
+  if (!program.link(messages))
+  {
+    spdlog::error("Failed to link {}:\n{}", sourceName, program.getInfoLog());
+    return std::nullopt;
+  }
+
+  glslang::SpvOptions options;
+#ifndef NDEBUG
+  // Matches the -g the build passes in debug configurations
+  options.generateDebugInfo = true;
+#endif
+  std::vector<std::uint32_t> spirv;
+  glslang::GlslangToSpv(*program.getIntermediate(*stage), spirv, &options);
+  return spirv;
+}
+
+static bool write_spirv(const std::filesystem::path& path, std::span<const std::uint32_t> spirv)
+{
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(
+    reinterpret_cast<const char*>(spirv.data()), static_cast<std::streamsize>(spirv.size_bytes()));
+  if (!file)
+  {
+    spdlog::error("Unable to write {}", path.string());
+    return false;
+  }
+  return true;
+}
+
+static std::filesystem::file_time_type newest_write_time(
+  std::span<const std::filesystem::path> files)
+{
+  auto newest = std::filesystem::file_time_type::min();
+  for (const auto& file : files)
+  {
+    // Files that are being replaced by an editor may be missing for a moment
+    std::error_code error;
+    const auto time = std::filesystem::last_write_time(file, error);
+    if (!error)
+      newest = std::max(newest, time);
+  }
+  return newest;
+}
+
+ShaderHotReloader::ShaderHotReloader(
+  std::vector<std::filesystem::path> spirv_paths, std::filesystem::path output_directory)
+  : outputDirectory{std::move(output_directory)}
+{
+  std::error_code error;
+  std::filesystem::create_directories(outputDirectory, error);
+  ETNA_VERIFYF(!error, "Unable to create {}: {}", outputDirectory.string(), error.message());
+
+  glslang::InitializeProcess();
+
+  for (auto& spirvPath : spirv_paths)
+  {
+    auto manifestPath = spirvPath;
+    manifestPath += ".reload";
+    const auto manifest = read_text_file(manifestPath);
+    if (!manifest)
+    {
+      spdlog::warn(
+        "{} can't be hot reloaded, re-run cmake to generate its manifest", spirvPath.string());
+      continue;
+    }
+
+    Shader shader{.spirvPath = std::move(spirvPath)};
+
+    std::istringstream lines{*manifest};
+    std::string line;
+    std::getline(lines, line);
+    shader.sourcePath = line;
+    while (std::getline(lines, line))
+      if (!line.empty())
+        shader.includeDirs.emplace_back(line);
+
+    auto depfilePath = shader.spirvPath;
+    depfilePath += ".d";
+    if (const auto depfile = read_text_file(depfilePath))
+      shader.dependencies = parse_depfile(*depfile);
+    if (shader.dependencies.empty())
+      shader.dependencies = {shader.sourcePath};
+
+    shader.compiledTime = std::filesystem::last_write_time(shader.spirvPath, error);
+
+    shaders.push_back(std::move(shader));
+  }
+
+  spdlog::info("Watching {} shaders for changes", shaders.size());
+
+  thread = std::jthread([this](std::stop_token stop_token) { pollLoop(stop_token); });
+}
+
+ShaderHotReloader::~ShaderHotReloader()
+{
+  // The thread may be compiling, glslang has to outlive it
+  thread.request_stop();
+  thread.join();
+
+  glslang::FinalizeProcess();
+
+  // Leftovers are harmless, the next run overwrites files with the same names
+  std::error_code error;
+  for (const auto& path : writtenFiles)
+    std::filesystem::remove(path, error);
+}
+
+void ShaderHotReloader::rescan()
+{
+  {
+    std::lock_guard lock{mutex};
+    rescanRequested = true;
+  }
+  wakeUp.notify_one();
+}
+
+std::vector<std::filesystem::path> ShaderHotReloader::takeRecompiled()
+{
+  std::vector<Recompiled> taken;
+  {
+    std::lock_guard lock{mutex};
+    taken = std::exchange(recompiled, {});
+  }
+
+  std::vector<std::filesystem::path> result;
+  for (auto& shader : taken)
+  {
+    reloadedPaths.insert_or_assign(shader.spirvPath, std::move(shader.reloadedPath));
+    result.push_back(std::move(shader.spirvPath));
+  }
+  return result;
+}
+
+const std::filesystem::path& ShaderHotReloader::resolve(
+  const std::filesystem::path& spirv_path) const
+{
+  const auto it = reloadedPaths.find(spirv_path);
+  return it != reloadedPaths.end() ? it->second : spirv_path;
+}
+
+void ShaderHotReloader::pollLoop(std::stop_token stop_token)
+{
+  tracy::SetThreadName("shader_hot_reload");
+
+  while (true)
+  {
+    {
+      std::unique_lock lock{mutex};
+      wakeUp.wait_for(lock, stop_token, POLL_INTERVAL, [this]() { return rescanRequested; });
+      if (stop_token.stop_requested())
+        return;
+      rescanRequested = false;
+    }
+
+    checkShaders();
+  }
+}
+
+void ShaderHotReloader::checkShaders()
+{
+  ZoneScoped;
+
+  std::vector<Recompiled> changed;
+  for (auto& shader : shaders)
+  {
+    const auto newest = newest_write_time(shader.dependencies);
+    if (newest <= shader.compiledTime)
+      continue;
+
+    // A broken shader is only retried once one of its files changes again
+    shader.compiledTime = newest;
+
+    std::vector<std::filesystem::path> dependencies;
+    const auto spirv = compile_glsl(shader.sourcePath, shader.includeDirs, dependencies);
+    if (!spirv)
+      continue;
+
+    // Binaries that were handed out may still be read, so every version gets its own file,
+    // simple.vert.spv becomes simple.<version>.vert.spv
+    const auto stem = shader.spirvPath.stem();
+    auto reloadedPath = outputDirectory /
+      fmt::format("{}.{}{}.spv", stem.stem().string(), ++version, stem.extension().string());
+    if (!write_spirv(reloadedPath, *spirv))
+      continue;
+    writtenFiles.push_back(reloadedPath);
+
+    shader.dependencies = std::move(dependencies);
+    spdlog::info("Recompiled {}", shader.sourcePath.string());
+    changed.push_back(
+      Recompiled{.spirvPath = shader.spirvPath, .reloadedPath = std::move(reloadedPath)});
+  }
+
+  if (changed.empty())
+    return;
+
+  std::lock_guard lock{mutex};
+  recompiled.insert(recompiled.end(), changed.begin(), changed.end());
+}
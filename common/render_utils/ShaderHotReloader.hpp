@@ -0,0 +1,80 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/**
+ * Recompiles GLSL shaders in-process whenever their sources or any of the files they include
+ * change, without a build tree or a cmake invocation. target_add_shaders puts a manifest with
+ * the source path and include directories next to every SPIR-V binary, the initial list of
+ * included files is taken from glslang's depfile.
+ *
+ * Files are polled on a background thread, which also compiles the changed shaders with
+ * glslang. The build tree's binaries are spirv-opt output and are never touched, every
+ * recompiled one is written to the output directory under a new name, resolve() maps a build
+ * tree path to the latest of them. A shader that fails to compile keeps its old binary.
+ */
+class ShaderHotReloader
+{
+public:
+  ShaderHotReloader(
+    std::vector<std::filesystem::path> spirv_paths, std::filesystem::path output_directory);
+  ~ShaderHotReloader();
+
+  // Checks the files right away instead of waiting for the next poll
+  void rescan();
+
+  // Build tree paths of the binaries that were recompiled since the last call, resolve() only
+  // returns the new binaries once they were taken
+  std::vector<std::filesystem::path> takeRecompiled();
+
+  // The latest recompiled binary of a build tree one, or the path itself
+  const std::filesystem::path& resolve(const std::filesystem::path& spirv_path) const;
+
+  ShaderHotReloader(const ShaderHotReloader&) = delete;
+  ShaderHotReloader& operator=(const ShaderHotReloader&) = delete;
+
+private:
+  struct Shader
+  {
+    std::filesystem::path spirvPath;
+    std::filesystem::path sourcePath;
+    std::vector<std::filesystem::path> includeDirs;
+    // The source and everything it includes
+    std::vector<std::filesystem::path> dependencies;
+    std::filesystem::file_time_type compiledTime;
+  };
+
+  struct Recompiled
+  {
+    std::filesystem::path spirvPath;
+    std::filesystem::path reloadedPath;
+  };
+
+  void pollLoop(std::stop_token stop_token);
+  void checkShaders();
+
+private:
+  std::filesystem::path outputDirectory;
+
+  // Only touched by the polling thread once it is started
+  std::vector<Shader> shaders;
+  std::uint32_t version = 0;
+  std::vector<std::filesystem::path> writtenFiles;
+
+  std::mutex mutex;
+  std::condition_variable_any wakeUp;
+  bool rescanRequested = false;
+  std::vector<Recompiled> recompiled;
+
+  // Only touched by the thread that takes the recompiled binaries
+  std::map<std::filesystem::path, std::filesystem::path> reloadedPaths;
+
+  std::jthread thread;
+};
@@ -0,0 +1,145 @@
+#include "ShaderVariants.hpp"
+
+#include <fstream>
+
+#include <etna/Etna.hpp>
+#include <etna/Assert.hpp>
+#include <fmt/ranges.h>
+#include <tracy/Tracy.hpp>
+
+
+static constexpr std::uint32_t SPIRV_MAGIC = 0x07230203;
+static constexpr std::size_t SPIRV_HEADER_WORDS = 5;
+
+static constexpr std::uint32_t SPIRV_OP_DECORATE = 71;
+static constexpr std::uint32_t SPIRV_OP_SPEC_CONSTANT_TRUE = 48;
+static constexpr std::uint32_t SPIRV_OP_SPEC_CONSTANT_FALSE = 49;
+static constexpr std::uint32_t SPIRV_OP_SPEC_CONSTANT = 50;
+static constexpr std::uint32_t SPIRV_DECORATION_SPEC_ID = 1;
+
+static std::vector<std::uint32_t> read_spirv(const std::filesystem::path& path)
+{
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  ETNA_VERIFYF(file.is_open(), "Unable to open shader {}", path.string());
+
+  std::vector<std::uint32_t> code(static_cast<std::size_t>(file.tellg()) / sizeof(std::uint32_t));
+  file.seekg(0);
+  file.read(
+    reinterpret_cast<char*>(code.data()),
+    static_cast<std::streamsize>(code.size() * sizeof(std::uint32_t)));
+  return code;
+}
+
+// A pipeline without VkSpecializationInfo uses the defaults, so these become the values
+static void bake_specialization(
+  std::span<std::uint32_t> spirv, std::span<const std::uint32_t> values, std::string_view name)
+{
+  ETNA_VERIFYF(
+    spirv.size() >= SPIRV_HEADER_WORDS && spirv[0] == SPIRV_MAGIC, "{} is not SPIR-V", name);
+
+  // Annotations come before all constants in a module, so one pass sees every SpecId first
+  std::map<std::uint32_t, std::uint32_t> specIds;
+  for (std::size_t i = SPIRV_HEADER_WORDS; i < spirv.size();)
+  {
+    const std::uint32_t opcode = spirv[i] & 0xFFFF;
+    const std::uint32_t wordCount = spirv[i] >> 16;
+    ETNA_VERIFYF(wordCount > 0 && i + wordCount <= spirv.size(), "{} is damaged", name);
+    const auto instruction = spirv.subspan(i, wordCount);
+    i += wordCount;
+
+    if (opcode == SPIRV_OP_DECORATE && wordCount == 4 && instruction[2] == SPIRV_DECORATION_SPEC_ID)
+    {
+      specIds[instruction[1]] = instruction[3];
+      continue;
+    }
+
+    const bool isSpecConstant = opcode == SPIRV_OP_SPEC_CONSTANT_TRUE ||
+      opcode == SPIRV_OP_SPEC_CONSTANT_FALSE || opcode == SPIRV_OP_SPEC_CONSTANT;
+    if (!isSpecConstant || wordCount < 3)
+      continue;
+
+    const auto specId = specIds.find(instruction[2]);
+    if (specId == specIds.end() || specId->second >= values.size())
+      continue;
+    const std::uint32_t value = values[specId->second];
+
+    if (opcode == SPIRV_OP_SPEC_CONSTANT)
+    {
+      ETNA_VERIFYF(wordCount == 4, "Constant {} of {} is not 32 bits wide", specId->second, name);
+      instruction[3] = value;
+    }
+    else
+    {
+      const std::uint32_t newOpcode =
+        value != 0 ? SPIRV_OP_SPEC_CONSTANT_TRUE : SPIRV_OP_SPEC_CONSTANT_FALSE;
+      instruction[0] = (wordCount << 16) | newOpcode;
+    }
+  }
+}
+
+ShaderVariants::ShaderVariants(std::filesystem::path output_directory)
+  : outputDirectory{std::move(output_directory)}
+{
+  std::error_code error;
+  std::filesystem::create_directories(outputDirectory, error);
+  ETNA_VERIFYF(!error, "Unable to create {}: {}", outputDirectory.string(), error.message());
+}
+
+ShaderVariants::~ShaderVariants()
+{
+  // Leftovers are harmless, the next run overwrites files with the same names
+  std::error_code error;
+  for (const auto& path : writtenFiles)
+    std::filesystem::remove(path, error);
+}
+
+const ShaderVariants::Variant& ShaderVariants::getProgram(
+  std::string_view base_program,
+  std::span<const std::filesystem::path> shaders,
+  std::span<const std::uint32_t> values)
+{
+  Key key{std::string(base_program), {values.begin(), values.end()}};
+  if (const auto it = programs.find(key); it != programs.end())
+    return it->second;
+
+  ZoneScoped;
+
+  ETNA_VERIFYF(
+    !shaders.empty() && shaders.size() <= 2, "{} has an unsupported stage count", base_program);
+
+  ++version;
+  std::vector<std::filesystem::path> paths;
+  for (const auto& shader : shaders)
+  {
+    auto code = read_spirv(shader);
+    bake_specialization(code, values, shader.string());
+
+    // simple.vert.spv becomes simple.<version>.vert.spv, the stage stays next to .spv
+    const auto stem = shader.stem();
+    auto& path = paths.emplace_back(
+      outputDirectory /
+      fmt::format("{}.{}{}.spv", stem.stem().string(), version, stem.extension().string()));
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(
+      reinterpret_cast<const char*>(code.data()),
+      static_cast<std::streamsize>(code.size() * sizeof(std::uint32_t)));
+    ETNA_VERIFYF(file.good(), "Unable to write {}", path.string());
+    writtenFiles.push_back(path);
+  }
+
+  auto name = fmt::format("{}<{}>#{}", base_program, fmt::join(values, ","), version);
+  if (paths.size() == 1)
+    etna::create_program(name.c_str(), {paths[0]});
+  else
+    etna::create_program(name.c_str(), {paths[0], paths[1]});
+
+  return programs.emplace(std::move(key), Variant{std::move(name), std::move(paths)})
+    .first->second;
+}
+
+void ShaderVariants::invalidate(std::string_view base_program)
+{
+  std::erase_if(programs, [base_program](const auto& entry) {
+    return entry.first.baseProgram == base_program;
+  });
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <compare>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+/**
+ * etna programs with their specialization constants baked in, one per permutation of values
+ * that was asked for. etna gives no way to pass VkSpecializationInfo to a pipeline, so the
+ * default values of the constants are patched in copies of the SPIR-V binaries instead.
+ * Drivers compile such a module the same way as a specialized one and fold away every branch
+ * that depends on the constants.
+ *
+ * Values are indexed by constant_id and must be 32 bits wide, booleans are 0 or 1.
+ * Constants a shader doesn't declare are ignored. A variant has the same descriptor layouts
+ * as the program it was made from.
+ */
+class ShaderVariants
+{
+public:
+  // Only the binaries written by this instance are deleted, on destruction
+  explicit ShaderVariants(std::filesystem::path output_directory);
+  ~ShaderVariants();
+
+  struct Variant
+  {
+    std::string program;
+    // Patched binaries the program was created from
+    std::vector<std::filesystem::path> shaders;
+  };
+
+  // The program is created on first use
+  const Variant& getProgram(
+    std::string_view base_program,
+    std::span<const std::filesystem::path> shaders,
+    std::span<const std::uint32_t> values);
+
+  // Variants of the program are made again from its current binaries on next use
+  void invalidate(std::string_view base_program);
+
+  std::size_t size() const { return programs.size(); }
+
+  ShaderVariants(const ShaderVariants&) = delete;
+  ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+private:
+  struct Key
+  {
+    std::string baseProgram;
+    std::vector<std::uint32_t> values;
+
+    auto operator<=>(const Key&) const = default;
+  };
+
+private:
+  std::filesystem::path outputDirectory;
+  std::map<Key, Variant> programs;
+  // Invalidated variants included, etna may still read their binaries
+  std::vector<std::filesystem::path> writtenFiles;
+  // etna keeps programs until shutdown, names and files are never reused
+  std::uint32_t version = 0;
+};
@@ -215,6 +215,125 @@ void blit_image(
   cmd_buf.blitImage2(&blitInfo);
 }
 
+void buffer_barrier(
+  vk::CommandBuffer cmd_buf,
+  vk::Buffer buffer,
+  vk::PipelineStageFlags2 src_stage,
+  vk::AccessFlags2 src_access,
+  vk::PipelineStageFlags2 dst_stage,
+  vk::AccessFlags2 dst_access)
+{
+  vk::BufferMemoryBarrier2 barrier{
+    .srcStageMask = src_stage,
+    .srcAccessMask = src_access,
+    .dstStageMask = dst_stage,
+    .dstAccessMask = dst_access,
+    .srcQueueFamilyIndex = vk::QueueFamilyIgnored,
+    .dstQueueFamilyIndex = vk::QueueFamilyIgnored,
+    .buffer = buffer,
+    .offset = 0,
+    .size = vk::WholeSize,
+  };
+
+  cmd_buf.pipelineBarrier2(
+    vk::DependencyInfo{
+      .bufferMemoryBarrierCount = 1,
+      .pBufferMemoryBarriers = &barrier,
+    });
+}
+
+void memory_barrier(
+  vk::CommandBuffer cmd_buf,
+  vk::PipelineStageFlags2 src_stage,
+  vk::AccessFlags2 src_access,
+  vk::PipelineStageFlags2 dst_stage,
+  vk::AccessFlags2 dst_access)
+{
+  vk::MemoryBarrier2 barrier{
+    .srcStageMask = src_stage,
+    .srcAccessMask = src_access,
+    .dstStageMask = dst_stage,
+    .dstAccessMask = dst_access,
+  };
+
+  cmd_buf.pipelineBarrier2(
+    vk::DependencyInfo{
+      .memoryBarrierCount = 1,
+      .pMemoryBarriers = &barrier,
+    });
+}
+
+void execute_secondary_pass(
+  vk::CommandBuffer cmd_buf,
+  vk::Rect2D rect,
+  std::optional<SecondaryPassAttachment> color_attachment,
+  std::optional<SecondaryPassAttachment> depth_attachment,
+  std::span<const vk::CommandBuffer> secondary_cmd_bufs,
+  std::uint32_t view_mask)
+{
+  std::optional<vk::RenderingAttachmentInfo> colorInfo;
+  std::optional<vk::RenderingAttachmentInfo> depthInfo;
+
+  if (color_attachment)
+  {
+    etna::set_state(
+      cmd_buf,
+      color_attachment->image,
+      vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+      vk::AccessFlagBits2::eColorAttachmentRead | vk::AccessFlagBits2::eColorAttachmentWrite,
+      vk::ImageLayout::eColorAttachmentOptimal,
+      vk::ImageAspectFlagBits::eColor);
+
+    colorInfo = vk::RenderingAttachmentInfo{
+      .imageView = color_attachment->view,
+      .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+      .loadOp = color_attachment->loadOp,
+      .storeOp = vk::AttachmentStoreOp::eStore,
+      .clearValue = color_attachment->clearValue,
+    };
+  }
+
+  if (depth_attachment)
+  {
+    etna::set_state(
+      cmd_buf,
+      depth_attachment->image,
+      vk::PipelineStageFlagBits2::eEarlyFragmentTests |
+        vk::PipelineStageFlagBits2::eLateFragmentTests,
+      vk::AccessFlagBits2::eDepthStencilAttachmentRead |
+        vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+      vk::ImageLayout::eDepthAttachmentOptimal,
+      vk::ImageAspectFlagBits::eDepth);
+
+    depthInfo = vk::RenderingAttachmentInfo{
+      .imageView = depth_attachment->view,
+      .imageLayout = vk::ImageLayout::eDepthAttachmentOptimal,
+      .loadOp = depth_attachment->loadOp,
+      .storeOp = vk::AttachmentStoreOp::eStore,
+      .clearValue = depth_attachment->clearValue,
+    };
+  }
+
+  etna::flush_barriers(cmd_buf);
+
+  cmd_buf.beginRendering(
+    vk::RenderingInfo{
+      .flags = vk::RenderingFlagBits::eContentsSecondaryCommandBuffers,
+      .renderArea = rect,
+      .layerCount = 1,
+      .viewMask = view_mask,
+      .colorAttachmentCount = colorInfo ? 1u : 0u,
+      .pColorAttachments = colorInfo ? &*colorInfo : nullptr,
+      .pDepthAttachment = depthInfo ? &*depthInfo : nullptr,
+    });
+
+  if (!secondary_cmd_bufs.empty())
+    cmd_buf.executeCommands(
+      static_cast<std::uint32_t>(secondary_cmd_bufs.size()), secondary_cmd_bufs.data());
+
+  cmd_buf.endRendering();
+}
+
 etna::Image load_texture(
   etna::BlockingTransferHelper& transfer_helper,
   etna::OneShotCmdMgr& one_shot_commands,
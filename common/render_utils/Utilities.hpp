@@ -5,6 +5,8 @@
 #include <etna/Buffer.hpp>
 #include <etna/Image.hpp>
 #include <etna/Etna.hpp>
+#include <optional>
+#include <span>
 
 
 namespace render_utility
@@ -29,6 +31,42 @@ void blit_image(
   vk::Image target_image,
   vk::Offset3D offset_size);
 
+// etna only tracks image states, so buffers written and read on the GPU
+// have to be synchronized by hand
+void buffer_barrier(
+  vk::CommandBuffer cmd_buf,
+  vk::Buffer buffer,
+  vk::PipelineStageFlags2 src_stage,
+  vk::AccessFlags2 src_access,
+  vk::PipelineStageFlags2 dst_stage,
+  vk::AccessFlags2 dst_access);
+
+void memory_barrier(
+  vk::CommandBuffer cmd_buf,
+  vk::PipelineStageFlags2 src_stage,
+  vk::AccessFlags2 src_access,
+  vk::PipelineStageFlags2 dst_stage,
+  vk::AccessFlags2 dst_access);
+
+struct SecondaryPassAttachment
+{
+  vk::Image image;
+  vk::ImageView view;
+  vk::AttachmentLoadOp loadOp = vk::AttachmentLoadOp::eClear;
+  vk::ClearValue clearValue = {};
+};
+
+// Same as etna::RenderTargetState, but the contents of the pass are recorded
+// into secondary command buffers, which etna has no rendering flag for.
+// A non-zero view mask renders to several layers of the attachments at once.
+void execute_secondary_pass(
+  vk::CommandBuffer cmd_buf,
+  vk::Rect2D rect,
+  std::optional<SecondaryPassAttachment> color_attachment,
+  std::optional<SecondaryPassAttachment> depth_attachment,
+  std::span<const vk::CommandBuffer> secondary_cmd_bufs,
+  std::uint32_t view_mask = 0);
+
 etna::Image load_texture(
   etna::BlockingTransferHelper& transfer_helper,
   etna::OneShotCmdMgr& one_shot_commands,
@@ -0,0 +1,25 @@
+#ifndef OCTAHEDRAL_GLSL_INCLUDED
+#define OCTAHEDRAL_GLSL_INCLUDED
+
+// Octahedral mapping of unit vectors to [-1, 1]^2, fits a normal into two snorm channels.
+// See "A Survey of Efficient Representations for Independent Unit Vectors", Cigolle et al.
+
+vec2 oct_wrap(vec2 v)
+{
+  return (1.0f - abs(v.yx)) * vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+}
+
+vec2 oct_encode(vec3 n)
+{
+  n /= abs(n.x) + abs(n.y) + abs(n.z);
+  return n.z >= 0.0f ? n.xy : oct_wrap(n.xy);
+}
+
+vec3 oct_decode(vec2 e)
+{
+  vec3 n = vec3(e, 1.0f - abs(e.x) - abs(e.y));
+  n.xy = n.z >= 0.0f ? n.xy : oct_wrap(n.xy);
+  return normalize(n);
+}
+
+#endif // OCTAHEDRAL_GLSL_INCLUDED
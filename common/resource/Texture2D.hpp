@@ -13,4 +13,6 @@ struct Texture2D
   };
 
   etna::Image texture;
+  // Kept for memory reports, etna images don't expose it
+  vk::Format format = vk::Format::eUndefined;
 };
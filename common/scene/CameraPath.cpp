@@ -0,0 +1,167 @@
+#include "CameraPath.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <etna/Assert.hpp>
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+
+static constexpr std::size_t ORBIT_KEYFRAMES = 16;
+
+static CameraPath::Keyframe make_keyframe(float time, const Camera& camera)
+{
+  return CameraPath::Keyframe{
+    .time = time,
+    .position = camera.position,
+    .rotation = camera.rotation,
+    .fov = camera.fov,
+  };
+}
+
+static glm::vec3 catmull_rom(glm::vec3 p0, glm::vec3 p1, glm::vec3 p2, glm::vec3 p3, float t)
+{
+  const float t2 = t * t;
+  const float t3 = t2 * t;
+  return 0.5f *
+    (2.0f * p1 + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+     (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+}
+
+CameraPath::CameraPath(std::vector<Keyframe> path_keyframes)
+  : keyframes{std::move(path_keyframes)}
+{
+  ETNA_VERIFYF(!keyframes.empty(), "A camera path needs at least one keyframe");
+  ETNA_VERIFYF(
+    std::ranges::is_sorted(keyframes, {}, &Keyframe::time),
+    "Camera path keyframes must be sorted by time");
+}
+
+std::optional<CameraPath> CameraPath::load(const std::filesystem::path& path)
+{
+  std::ifstream file(path);
+  if (!file.is_open())
+  {
+    spdlog::error("Unable to open camera path {}", path.string());
+    return std::nullopt;
+  }
+
+  std::vector<Keyframe> keyframes;
+  std::string line;
+  for (std::size_t lineIdx = 1; std::getline(file, line); ++lineIdx)
+  {
+    if (line.empty() || line.front() == '#')
+      continue;
+
+    Keyframe keyframe;
+    auto& [time, pos, rot, fov] = keyframe;
+    std::istringstream fields{line};
+    fields >> time >> pos.x >> pos.y >> pos.z >> rot.w >> rot.x >> rot.y >> rot.z >> fov;
+    if (fields.fail() || (!keyframes.empty() && time < keyframes.back().time))
+    {
+      spdlog::error("Malformed keyframe at {}:{}", path.string(), lineIdx);
+      return std::nullopt;
+    }
+    rot = glm::normalize(rot);
+    keyframes.push_back(keyframe);
+  }
+
+  if (keyframes.empty())
+  {
+    spdlog::error("Camera path {} has no keyframes", path.string());
+    return std::nullopt;
+  }
+  return CameraPath{std::move(keyframes)};
+}
+
+bool CameraPath::save(const std::filesystem::path& path) const
+{
+  std::ofstream file(path, std::ios::trunc);
+  file << "# time px py pz qw qx qy qz fov\n";
+  for (const auto& [time, pos, rot, fov] : keyframes)
+    file << fmt::format(
+      "{} {} {} {} {} {} {} {} {}\n", time, pos.x, pos.y, pos.z, rot.w, rot.x, rot.y, rot.z, fov);
+
+  if (!file)
+  {
+    spdlog::error("Unable to write camera path {}", path.string());
+    return false;
+  }
+  return true;
+}
+
+CameraPath CameraPath::orbit(glm::vec3 center, float radius, float height, float duration)
+{
+  std::vector<Keyframe> keyframes;
+  for (std::size_t i = 0; i <= ORBIT_KEYFRAMES; ++i)
+  {
+    const float progress = static_cast<float>(i) / ORBIT_KEYFRAMES;
+    const float angle = progress * glm::two_pi<float>();
+
+    Camera camera;
+    camera.lookAt(
+      center + glm::vec3{radius * glm::sin(angle), height, radius * glm::cos(angle)},
+      center,
+      {0, 1, 0});
+    keyframes.push_back(make_keyframe(progress * duration, camera));
+  }
+  return CameraPath{std::move(keyframes)};
+}
+
+void CameraPath::apply(float time, Camera& camera) const
+{
+  const float absoluteTime = keyframes.front().time + std::clamp(time, 0.0f, getDuration());
+
+  // The first keyframe that is later than the time ends the segment
+  const auto next = std::ranges::upper_bound(keyframes, absoluteTime, {}, &Keyframe::time);
+  if (next == keyframes.begin() || next == keyframes.end())
+  {
+    const auto& keyframe = next == keyframes.end() ? keyframes.back() : keyframes.front();
+    camera.position = keyframe.position;
+    camera.rotation = keyframe.rotation;
+    camera.fov = keyframe.fov;
+    return;
+  }
+
+  const auto i = static_cast<std::size_t>(next - keyframes.begin()) - 1;
+  const auto& k1 = keyframes[i];
+  const auto& k2 = keyframes[i + 1];
+  // End segments reuse their outer keyframe as the missing neighbour
+  const auto& k0 = keyframes[i > 0 ? i - 1 : i];
+  const auto& k3 = keyframes[std::min(i + 2, keyframes.size() - 1)];
+
+  const float span = k2.time - k1.time;
+  const float t = span > 0 ? (absoluteTime - k1.time) / span : 0.0f;
+
+  camera.position = catmull_rom(k0.position, k1.position, k2.position, k3.position, t);
+  // glm::slerp takes the shorter arc
+  camera.rotation = glm::slerp(k1.rotation, k2.rotation, t);
+  camera.fov = glm::mix(k1.fov, k2.fov, t);
+}
+
+CameraPathRecorder::CameraPathRecorder(float sample_interval)
+  : interval{sample_interval}
+{
+}
+
+void CameraPathRecorder::update(float dt, const Camera& camera)
+{
+  if (!keyframes.empty())
+    elapsed += dt;
+
+  lastCamera = make_keyframe(elapsed, camera);
+  // A long frame may cover several intervals, they all get its camera
+  for (; nextSampleTime <= elapsed; nextSampleTime += interval)
+    keyframes.push_back(make_keyframe(nextSampleTime, camera));
+}
+
+CameraPath CameraPathRecorder::finish() const
+{
+  auto path = keyframes;
+  if (path.empty() || path.back().time < lastCamera.time)
+    path.push_back(lastCamera);
+  return CameraPath{std::move(path)};
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/ext.hpp>
+
+#include "scene/Camera.hpp"
+
+
+/**
+ * Camera keyframes at increasing times. Positions are interpolated with a Catmull-Rom spline
+ * through the keyframes, rotations are slerped and the field of view is lerped, so a path
+ * recorded at a low rate still plays back smoothly.
+ *
+ * Stored as text, one "time px py pz qw qx qy qz fov" keyframe per line. Lines starting
+ * with '#' are comments.
+ */
+class CameraPath
+{
+public:
+  struct Keyframe
+  {
+    float time = 0;
+    glm::vec3 position{};
+    glm::quat rotation{};
+    float fov = 60;
+  };
+
+  explicit CameraPath(std::vector<Keyframe> path_keyframes);
+
+  // Fails on malformed lines and on paths with no keyframes
+  static std::optional<CameraPath> load(const std::filesystem::path& path);
+  bool save(const std::filesystem::path& path) const;
+
+  // Circles around the center while looking at it, starting on the +Z side
+  static CameraPath orbit(glm::vec3 center, float radius, float height, float duration);
+
+  float getDuration() const { return keyframes.back().time - keyframes.front().time; }
+  std::size_t getKeyframeCount() const { return keyframes.size(); }
+
+  // Time is relative to the first keyframe and clamped to the path
+  void apply(float time, Camera& camera) const;
+
+private:
+  std::vector<Keyframe> keyframes;
+};
+
+/**
+ * Takes keyframes of a camera at a fixed interval of app time rather than every frame, so
+ * recordings made at different frame rates are alike and playback smooths them out anyway.
+ * Each keyframe holds the camera of the first frame at or after its time.
+ */
+class CameraPathRecorder
+{
+public:
+  explicit CameraPathRecorder(float sample_interval);
+
+  // The first call takes the first keyframe
+  void update(float dt, const Camera& camera);
+
+  // Ends the path with the camera of the last update
+  CameraPath finish() const;
+
+private:
+  float interval;
+  float elapsed = 0;
+  float nextSampleTime = 0;
+  std::vector<CameraPath::Keyframe> keyframes;
+  CameraPath::Keyframe lastCamera;
+};
@@ -0,0 +1,158 @@
+#include "LightClusters.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <fmt/format.h>
+#include <etna/GlobalContext.hpp>
+#include <etna/Etna.hpp>
+#include <etna/PipelineManager.hpp>
+#include <etna/DescriptorSet.hpp>
+#include <etna/Profiling.hpp>
+
+#include "render_utils/Utilities.hpp"
+
+
+namespace
+{
+
+struct CullingParams
+{
+  glm::mat4x4 view;
+  glm::vec2 projScale;
+  glm::vec2 resolution;
+  float zNear;
+  float zFar;
+  std::uint32_t lightCount;
+};
+
+} // namespace
+
+LightClusters::LightClusters(std::uint32_t max_lights)
+  : maxLights{max_lights}
+  , lightBuffers{
+      etna::get_context().getMainWorkCount(),
+      [max_lights](std::size_t i) {
+        auto buffer = etna::get_context().createBuffer(
+          etna::Buffer::CreateInfo{
+            .size = std::max<std::size_t>(max_lights, 1) * sizeof(PointLight),
+            .bufferUsage = vk::BufferUsageFlagBits::eStorageBuffer,
+            .memoryUsage = VMA_MEMORY_USAGE_CPU_TO_GPU,
+            .name = fmt::format("point_lights{}", i),
+          });
+        buffer.map();
+        return buffer;
+      }}
+{
+  if (etna::get_program_id("scene_light_clusters") == etna::ShaderProgramId::Invalid)
+    etna::create_program("scene_light_clusters", {SCENE_SHADERS_ROOT "light_clusters.comp.spv"});
+
+  cullingPipeline = etna::get_context().getPipelineManager().createComputePipeline(
+    "scene_light_clusters", {});
+
+  auto& ctx = etna::get_context();
+  clusters = ctx.createBuffer(
+    etna::Buffer::CreateInfo{
+      .size = sizeof(LightClusterGrid) + LIGHT_CLUSTER_COUNT * sizeof(glm::uvec2),
+      .bufferUsage = vk::BufferUsageFlagBits::eStorageBuffer,
+      .memoryUsage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+      .name = "light_clusters",
+    });
+  // The counter is followed by the indices
+  lightIndices = ctx.createBuffer(
+    etna::Buffer::CreateInfo{
+      .size = (1 + LIGHT_INDEX_CAPACITY) * sizeof(std::uint32_t),
+      .bufferUsage =
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+      .memoryUsage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+      .name = "cluster_light_indices",
+    });
+}
+
+void LightClusters::cull(
+  vk::CommandBuffer cmd_buf,
+  std::span<const PointLight> lights,
+  const glm::mat4x4& view,
+  const glm::mat4x4& proj,
+  float z_near,
+  float z_far,
+  glm::uvec2 resolution)
+{
+  ETNA_PROFILE_GPU(cmd_buf, lightClusters);
+
+  // The command manager has already waited for the frame that used this buffer last time
+  auto& lightBuffer = lightBuffers.get();
+  const auto lightCount =
+    static_cast<std::uint32_t>(std::min<std::size_t>(lights.size(), maxLights));
+  std::memcpy(lightBuffer.data(), lights.data(), lightCount * sizeof(PointLight));
+
+  // Shading of the previous frame might still be reading the clusters
+  render_utility::memory_barrier(
+    cmd_buf,
+    vk::PipelineStageFlagBits2::eFragmentShader | vk::PipelineStageFlagBits2::eComputeShader,
+    vk::AccessFlagBits2::eShaderStorageRead,
+    vk::PipelineStageFlagBits2::eTransfer | vk::PipelineStageFlagBits2::eComputeShader,
+    vk::AccessFlagBits2::eTransferWrite | vk::AccessFlagBits2::eShaderStorageWrite);
+
+  cmd_buf.fillBuffer(lightIndices.get(), 0, sizeof(std::uint32_t), 0);
+  render_utility::buffer_barrier(
+    cmd_buf,
+    lightIndices.get(),
+    vk::PipelineStageFlagBits2::eTransfer,
+    vk::AccessFlagBits2::eTransferWrite,
+    vk::PipelineStageFlagBits2::eComputeShader,
+    vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+
+  auto programInfo = etna::get_shader_program("scene_light_clusters");
+  auto set = etna::create_descriptor_set(
+    programInfo.getDescriptorLayoutId(0),
+    cmd_buf,
+    {
+      etna::Binding{0, lightBuffer.genBinding()},
+      etna::Binding{1, clusters.genBinding()},
+      etna::Binding{2, lightIndices.genBinding()},
+    });
+
+  cmd_buf.bindPipeline(vk::PipelineBindPoint::eCompute, cullingPipeline.getVkPipeline());
+  cmd_buf.bindDescriptorSets(
+    vk::PipelineBindPoint::eCompute,
+    cullingPipeline.getVkPipelineLayout(),
+    0,
+    {set.getVkSet()},
+    {});
+
+  const CullingParams params{
+    .view = view,
+    .projScale = {proj[0][0], proj[1][1]},
+    .resolution = resolution,
+    .zNear = z_near,
+    .zFar = z_far,
+    .lightCount = lightCount,
+  };
+  cmd_buf.pushConstants<CullingParams>(
+    cullingPipeline.getVkPipelineLayout(), vk::ShaderStageFlagBits::eCompute, 0, {params});
+
+  etna::flush_barriers(cmd_buf);
+
+  cmd_buf.dispatch(
+    (LIGHT_CLUSTER_COUNT + LIGHT_CLUSTERS_GROUP_SIZE - 1) / LIGHT_CLUSTERS_GROUP_SIZE, 1, 1);
+
+  render_utility::memory_barrier(
+    cmd_buf,
+    vk::PipelineStageFlagBits2::eComputeShader,
+    vk::AccessFlagBits2::eShaderStorageWrite,
+    vk::PipelineStageFlagBits2::eFragmentShader | vk::PipelineStageFlagBits2::eComputeShader,
+    vk::AccessFlagBits2::eShaderStorageRead);
+}
+
+void LightClusters::reportMemory(GpuMemoryReport& report) const
+{
+  using Category = GpuMemoryReport::Category;
+
+  const auto framesInFlight =
+    static_cast<std::uint32_t>(etna::get_context().getMainWorkCount().multiBufferingCount());
+
+  report.addBuffer(Category::Other, "point lights", lightBuffers.get().get(), framesInFlight);
+  report.addBuffer(Category::Other, "light clusters", clusters.get());
+  report.addBuffer(Category::Other, "cluster light indices", lightIndices.get());
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <span>
+
+#include <etna/Vulkan.hpp>
+#include <etna/Buffer.hpp>
+#include <etna/ComputePipeline.hpp>
+#include <etna/GpuSharedResource.hpp>
+#include <glm/glm.hpp>
+
+#include "shaders/light_clusters.h"
+#include "render_utils/GpuMemoryReport.hpp"
+
+
+/**
+ * Clustered light culling. Point lights are uploaded every frame and binned by a compute
+ * pass into a grid of LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y screen tiles times LIGHT_CLUSTERS_Z
+ * exponential depth slices. Every cluster gets a compact range of indices into a single
+ * shared list, so shading only loops over the lights that can reach the fragment.
+ * Shaders read the results through clustered_lights.glsl.
+ */
+class LightClusters
+{
+public:
+  explicit LightClusters(std::uint32_t max_lights);
+
+  // Uploads the lights into this frame's buffer and bins them,
+  // must be recorded outside of a render pass
+  void cull(
+    vk::CommandBuffer cmd_buf,
+    std::span<const PointLight> lights,
+    const glm::mat4x4& view,
+    const glm::mat4x4& proj,
+    float z_near,
+    float z_far,
+    glm::uvec2 resolution);
+
+  std::uint32_t getMaxLights() const { return maxLights; }
+
+  // Bound as CLUSTERED_LIGHTS_BINDING, +1 and +2 respectively
+  etna::Buffer& getLightsBuffer() { return lightBuffers.get(); }
+  etna::Buffer& getClustersBuffer() { return clusters; }
+  etna::Buffer& getLightIndicesBuffer() { return lightIndices; }
+
+  void reportMemory(GpuMemoryReport& report) const;
+
+  LightClusters(const LightClusters&) = delete;
+  LightClusters& operator=(const LightClusters&) = delete;
+
+private:
+  std::uint32_t maxLights;
+
+  etna::ComputePipeline cullingPipeline;
+
+  // Written by the CPU, one per frame in flight
+  etna::GpuSharedResource<etna::Buffer> lightBuffers;
+  etna::Buffer clusters;
+  etna::Buffer lightIndices;
+};
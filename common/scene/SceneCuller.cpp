@@ -0,0 +1,343 @@
+#include "SceneCuller.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <fmt/format.h>
+#include <etna/GlobalContext.hpp>
+#include <etna/Etna.hpp>
+#include <etna/PipelineManager.hpp>
+#include <etna/DescriptorSet.hpp>
+#include <etna/Profiling.hpp>
+
+#include "render_utils/Utilities.hpp"
+
+
+static constexpr std::uint32_t CULLING_GROUP_SIZE = 64;
+static constexpr std::uint32_t HIZ_GROUP_SIZE = 8;
+
+SceneCuller::SceneCuller(SceneManager& scene_manager, DescriptorSetCache& descriptor_sets)
+  : sceneMgr{scene_manager}
+  , descriptorSets{descriptor_sets}
+  , hiZPlaceholder{etna::get_context().createImage(
+      etna::Image::CreateInfo{
+        .extent = vk::Extent3D{1, 1, 1},
+        .name = "hiz_placeholder",
+        .format = vk::Format::eR32Sfloat,
+        .imageUsage = vk::ImageUsageFlagBits::eSampled,
+      })}
+  , hiZSampler{etna::Sampler::CreateInfo{
+      .filter = vk::Filter::eNearest,
+      .addressMode = vk::SamplerAddressMode::eClampToEdge,
+      .name = "hiz_sampler"}}
+  , statsBuffers{etna::get_context().getMainWorkCount(), [](std::size_t i) {
+    auto buffer = etna::get_context().createBuffer(
+      etna::Buffer::CreateInfo{
+        .size = sizeof(Stats),
+        .bufferUsage =
+          vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+        .memoryUsage = VMA_MEMORY_USAGE_GPU_TO_CPU,
+        .name = fmt::format("culling_stats{}", i),
+      });
+    buffer.map();
+    std::memset(buffer.data(), 0, sizeof(Stats));
+    return buffer;
+  }}
+{
+  if (etna::get_program_id("scene_culling_reset") == etna::ShaderProgramId::Invalid)
+    etna::create_program("scene_culling_reset", {SCENE_SHADERS_ROOT "culling_reset.comp.spv"});
+  if (etna::get_program_id("scene_culling") == etna::ShaderProgramId::Invalid)
+    etna::create_program("scene_culling", {SCENE_SHADERS_ROOT "culling.comp.spv"});
+  if (etna::get_program_id("scene_hiz_reduce") == etna::ShaderProgramId::Invalid)
+    etna::create_program("scene_hiz_reduce", {SCENE_SHADERS_ROOT "hiz_reduce.comp.spv"});
+
+  auto& pipelineManager = etna::get_context().getPipelineManager();
+  resetPipeline = pipelineManager.createComputePipeline("scene_culling_reset", {});
+  cullingPipeline = pipelineManager.createComputePipeline("scene_culling", {});
+  hiZReducePipeline = pipelineManager.createComputePipeline("scene_hiz_reduce", {});
+}
+
+void SceneCuller::allocateResources(glm::uvec2 depth_resolution)
+{
+  // Level 0 of the pyramid is already a 2x2 reduction of the depth buffer
+  hiZResolution = glm::max(depth_resolution / 2u, glm::uvec2{1, 1});
+  const auto largestSide = std::max(hiZResolution.x, hiZResolution.y);
+  hiZMipLevels = static_cast<std::uint32_t>(std::floor(std::log2(largestSide))) + 1;
+}
+
+RenderGraph::TransientImageInfo SceneCuller::getHiZInfo() const
+{
+  return RenderGraph::TransientImageInfo{
+    .extent = vk::Extent2D{hiZResolution.x, hiZResolution.y},
+    .format = vk::Format::eR32Sfloat,
+    .usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled,
+    .mipLevels = hiZMipLevels,
+  };
+}
+
+void SceneCuller::prepareFrame(vk::CommandBuffer cmd_buf)
+{
+  // The frame that used this buffer last has already been waited for by the command manager
+  auto& statsBuffer = statsBuffers.get();
+  std::memcpy(&stats, statsBuffer.data(), sizeof(Stats));
+
+  cmd_buf.fillBuffer(statsBuffer.get(), 0, sizeof(Stats), 0);
+  render_utility::buffer_barrier(
+    cmd_buf,
+    statsBuffer.get(),
+    vk::PipelineStageFlagBits2::eTransfer,
+    vk::AccessFlagBits2::eTransferWrite,
+    vk::PipelineStageFlagBits2::eComputeShader,
+    vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+}
+
+void SceneCuller::ensureVisibilityBuffer(vk::CommandBuffer cmd_buf)
+{
+  const std::size_t instanceCount = sceneMgr.getInstanceMeshes().size();
+  if (instanceVisibility.get() && visibilityInstanceCount == instanceCount)
+    return;
+
+  instanceVisibility = etna::get_context().createBuffer(
+    etna::Buffer::CreateInfo{
+      .size = std::max<std::size_t>(instanceCount, 1) * sizeof(std::uint32_t),
+      .bufferUsage =
+        vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+      .memoryUsage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+      .name = "instance_visibility",
+    });
+  visibilityInstanceCount = instanceCount;
+
+  // Nothing was visible "last frame", so the first late phase draws everything
+  cmd_buf.fillBuffer(instanceVisibility.get(), 0, vk::WholeSize, 0);
+  render_utility::buffer_barrier(
+    cmd_buf,
+    instanceVisibility.get(),
+    vk::PipelineStageFlagBits2::eTransfer,
+    vk::AccessFlagBits2::eTransferWrite,
+    vk::PipelineStageFlagBits2::eComputeShader,
+    vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+}
+
+void SceneCuller::cull(
+  vk::CommandBuffer cmd_buf,
+  const glm::mat4x4& proj_view,
+  Phase phase,
+  bool gather_stats,
+  vk::ImageView hi_z)
+{
+  ETNA_PROFILE_GPU(cmd_buf, sceneCulling);
+
+  const auto relemCount = static_cast<std::uint32_t>(sceneMgr.getRenderElements().size());
+  const auto instanceCount = static_cast<std::uint32_t>(sceneMgr.getInstanceMeshes().size());
+  if (relemCount == 0 || instanceCount == 0)
+    return;
+
+  ensureVisibilityBuffer(cmd_buf);
+
+  auto& drawCommands = sceneMgr.getDrawCommandsBuffer();
+  auto& drawInstanceIndices = sceneMgr.getDrawInstanceIndicesBuffer();
+
+  // Previous draws might still be reading the commands and indices
+  render_utility::buffer_barrier(
+    cmd_buf,
+    drawCommands.get(),
+    vk::PipelineStageFlagBits2::eDrawIndirect,
+    vk::AccessFlagBits2::eIndirectCommandRead,
+    vk::PipelineStageFlagBits2::eComputeShader,
+    vk::AccessFlagBits2::eShaderStorageWrite);
+  render_utility::buffer_barrier(
+    cmd_buf,
+    drawInstanceIndices.get(),
+    vk::PipelineStageFlagBits2::eVertexShader,
+    vk::AccessFlagBits2::eShaderStorageRead,
+    vk::PipelineStageFlagBits2::eComputeShader,
+    vk::AccessFlagBits2::eShaderStorageWrite);
+
+  {
+    const auto layoutId = etna::get_shader_program("scene_culling_reset").getDescriptorLayoutId(0);
+    const std::array bindings{etna::Binding{0, drawCommands.genBinding()}};
+    const auto set = descriptorSets.get(layoutId, bindings);
+
+    cmd_buf.bindPipeline(vk::PipelineBindPoint::eCompute, resetPipeline.getVkPipeline());
+    cmd_buf.bindDescriptorSets(
+      vk::PipelineBindPoint::eCompute, resetPipeline.getVkPipelineLayout(), 0, {set}, {});
+    cmd_buf.pushConstants<std::uint32_t>(
+      resetPipeline.getVkPipelineLayout(), vk::ShaderStageFlagBits::eCompute, 0, {relemCount});
+
+    etna::flush_barriers(cmd_buf);
+
+    cmd_buf.dispatch((relemCount + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE, 1, 1);
+  }
+
+  render_utility::buffer_barrier(
+    cmd_buf,
+    drawCommands.get(),
+    vk::PipelineStageFlagBits2::eComputeShader,
+    vk::AccessFlagBits2::eShaderStorageWrite,
+    vk::PipelineStageFlagBits2::eComputeShader,
+    vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+  // Visibility is written by the late phase of the previous cull
+  render_utility::buffer_barrier(
+    cmd_buf,
+    instanceVisibility.get(),
+    vk::PipelineStageFlagBits2::eComputeShader,
+    vk::AccessFlagBits2::eShaderStorageWrite,
+    vk::PipelineStageFlagBits2::eComputeShader,
+    vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+
+  {
+    struct CullingParams
+    {
+      glm::mat4x4 projView;
+      std::uint32_t instanceCount;
+      std::uint32_t phase;
+      std::uint32_t gatherStats;
+      std::uint32_t _padding0 = 0;
+      glm::vec2 hiZResolution;
+    } params{
+      .projView = proj_view,
+      .instanceCount = instanceCount,
+      .phase = static_cast<std::uint32_t>(phase),
+      .gatherStats = gather_stats ? 1u : 0u,
+      .hiZResolution = glm::vec2(hiZResolution),
+    };
+
+    ETNA_VERIFYF(phase != Phase::Late || hi_z, "The late culling phase needs a Hi-Z pyramid");
+
+    const auto layoutId = etna::get_shader_program("scene_culling").getDescriptorLayoutId(0);
+    const auto readLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+    std::vector<etna::Binding> bindings{
+      etna::Binding{0, sceneMgr.getMeshesBuffer().genBinding()},
+      etna::Binding{1, sceneMgr.getBoundsBuffer().genBinding()},
+      etna::Binding{2, sceneMgr.getInstanceMatricesBuffer().genBinding()},
+      etna::Binding{3, sceneMgr.getInstanceMeshesBuffer().genBinding()},
+      etna::Binding{4, drawCommands.genBinding()},
+      etna::Binding{5, drawInstanceIndices.genBinding()},
+      etna::Binding{6, instanceVisibility.genBinding()},
+      etna::Binding{7, statsBuffers.get().genBinding()},
+    };
+    std::vector<DescriptorSetCache::RawImageBinding> rawImages;
+    if (hi_z)
+      rawImages.push_back({.binding = 8, .info = {hiZSampler.get(), hi_z, readLayout}});
+    else
+      bindings.push_back(etna::Binding{8, hiZPlaceholder.genBinding(hiZSampler.get(), readLayout)});
+
+    descriptorSets.requestStates(cmd_buf, layoutId, bindings);
+    const auto set = descriptorSets.get(layoutId, bindings, rawImages);
+
+    cmd_buf.bindPipeline(vk::PipelineBindPoint::eCompute, cullingPipeline.getVkPipeline());
+    cmd_buf.bindDescriptorSets(
+      vk::PipelineBindPoint::eCompute, cullingPipeline.getVkPipelineLayout(), 0, {set}, {});
+    cmd_buf.pushConstants<CullingParams>(
+      cullingPipeline.getVkPipelineLayout(), vk::ShaderStageFlagBits::eCompute, 0, {params});
+
+    etna::flush_barriers(cmd_buf);
+
+    cmd_buf.dispatch((instanceCount + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE, 1, 1);
+  }
+
+  render_utility::buffer_barrier(
+    cmd_buf,
+    drawCommands.get(),
+    vk::PipelineStageFlagBits2::eComputeShader,
+    vk::AccessFlagBits2::eShaderStorageWrite,
+    vk::PipelineStageFlagBits2::eDrawIndirect,
+    vk::AccessFlagBits2::eIndirectCommandRead);
+  render_utility::buffer_barrier(
+    cmd_buf,
+    drawInstanceIndices.get(),
+    vk::PipelineStageFlagBits2::eComputeShader,
+    vk::AccessFlagBits2::eShaderStorageWrite,
+    vk::PipelineStageFlagBits2::eVertexShader,
+    vk::AccessFlagBits2::eShaderStorageRead);
+}
+
+void SceneCuller::buildHiZ(
+  vk::CommandBuffer cmd_buf, const etna::Image& depth, std::span<const vk::ImageView> hi_z_mips)
+{
+  ETNA_PROFILE_GPU(cmd_buf, buildHiZ);
+
+  ETNA_VERIFYF(
+    hi_z_mips.size() == hiZMipLevels,
+    "Hi-Z pyramid has {} levels instead of {}",
+    hi_z_mips.size(),
+    hiZMipLevels);
+
+  const auto layoutId = etna::get_shader_program("scene_hiz_reduce").getDescriptorLayoutId(0);
+
+  cmd_buf.bindPipeline(vk::PipelineBindPoint::eCompute, hiZReducePipeline.getVkPipeline());
+
+  const auto depthExtent = depth.getExtent();
+  glm::uvec2 srcSize{depthExtent.width, depthExtent.height};
+  glm::uvec2 dstSize = hiZResolution;
+
+  for (std::uint32_t mip = 0; mip < hiZMipLevels; ++mip)
+  {
+    const auto src = mip == 0
+      ? vk::DescriptorImageInfo{
+          hiZSampler.get(), depth.getView({}), vk::ImageLayout::eShaderReadOnlyOptimal}
+      : vk::DescriptorImageInfo{hiZSampler.get(), hi_z_mips[mip - 1], vk::ImageLayout::eGeneral};
+    const std::array rawImages{
+      DescriptorSetCache::RawImageBinding{.binding = 0, .info = src},
+      DescriptorSetCache::RawImageBinding{
+        .binding = 1,
+        .info = {{}, hi_z_mips[mip], vk::ImageLayout::eGeneral},
+      },
+    };
+    const auto set = descriptorSets.get(layoutId, {}, rawImages);
+
+    cmd_buf.bindDescriptorSets(
+      vk::PipelineBindPoint::eCompute, hiZReducePipeline.getVkPipelineLayout(), 0, {set}, {});
+
+    const glm::ivec4 sizes{srcSize, dstSize};
+    cmd_buf.pushConstants<glm::ivec4>(
+      hiZReducePipeline.getVkPipelineLayout(), vk::ShaderStageFlagBits::eCompute, 0, {sizes});
+
+    cmd_buf.dispatch(
+      (dstSize.x + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE,
+      (dstSize.y + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE,
+      1);
+
+    // Next level reads what was just written
+    render_utility::memory_barrier(
+      cmd_buf,
+      vk::PipelineStageFlagBits2::eComputeShader,
+      vk::AccessFlagBits2::eShaderStorageWrite,
+      vk::PipelineStageFlagBits2::eComputeShader,
+      vk::AccessFlagBits2::eShaderSampledRead | vk::AccessFlagBits2::eShaderStorageWrite);
+
+    srcSize = dstSize;
+    dstSize = glm::max(dstSize / 2u, glm::uvec2{1, 1});
+  }
+}
+
+void SceneCuller::reportMemory(GpuMemoryReport& report) const
+{
+  using Category = GpuMemoryReport::Category;
+
+  const auto framesInFlight =
+    static_cast<std::uint32_t>(etna::get_context().getMainWorkCount().multiBufferingCount());
+
+  report.addBuffer(Category::InstanceData, "instance visibility", instanceVisibility.get());
+  report.addBuffer(Category::Other, "culling stats", statsBuffers.get().get(), framesInFlight);
+  report.addImage(Category::Other, "hi-z placeholder", hiZPlaceholder.get());
+}
+
+void SceneCuller::drawIndirect(vk::CommandBuffer cmd_buf, vk::Buffer vertex_buffer)
+{
+  if (!vertex_buffer)
+    return;
+
+  const auto relemCount = static_cast<std::uint32_t>(sceneMgr.getRenderElements().size());
+
+  cmd_buf.bindVertexBuffers(0, {vertex_buffer}, {0});
+  cmd_buf.bindIndexBuffer(sceneMgr.getIndexBuffer(), 0, vk::IndexType::eUint32);
+
+  cmd_buf.drawIndexedIndirect(
+    sceneMgr.getDrawCommandsBuffer().get(),
+    0,
+    relemCount,
+    sizeof(vk::DrawIndexedIndirectCommand));
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <span>
+
+#include <etna/Vulkan.hpp>
+#include <etna/ComputePipeline.hpp>
+#include <etna/GpuSharedResource.hpp>
+#include <etna/Buffer.hpp>
+#include <etna/Image.hpp>
+#include <etna/Sampler.hpp>
+#include <glm/glm.hpp>
+
+#include "scene/SceneManager.hpp"
+#include "render_utils/DescriptorSetCache.hpp"
+#include "render_utils/GpuMemoryReport.hpp"
+#include "render_utils/RenderGraph.hpp"
+
+
+/**
+ * GPU-driven frustum and occlusion culling over the unified scene buffers of a SceneManager.
+ * Every cull() call resets the draw commands, tests each instance in a compute shader and
+ * appends the visible ones to unifiedDrawInstanceIndicesbuf, after which the whole scene is
+ * drawn with a single vkCmdDrawIndexedIndirect.
+ * Vertex shaders are expected to fetch the model matrix as
+ * instanceMatrices[drawInstanceIndices[gl_InstanceIndex]].
+ *
+ * Occlusion culling is done in two phases. The early phase draws what was visible
+ * last frame, then a hierarchical-Z pyramid is built from the resulting depth and
+ * the late phase tests all instances against it, drawing only the newly visible ones.
+ * The pyramid is only needed between those two points, so the culler does not own it:
+ * it is a transient image of the frame's render graph, which also places its barriers.
+ */
+class SceneCuller
+{
+public:
+  enum class Phase : std::uint32_t
+  {
+    FrustumOnly = 0,
+    Early = 1,
+    Late = 2,
+  };
+
+  // Per-instance results of the last main view cull, read back with a few frames of delay
+  struct Stats
+  {
+    std::uint32_t visibleInstances = 0;
+    std::uint32_t frustumCulledInstances = 0;
+    std::uint32_t occludedInstances = 0;
+  };
+
+  // Sets binding the pyramid reference raw views, so they come from the renderer's cache
+  SceneCuller(SceneManager& scene_manager, DescriptorSetCache& descriptor_sets);
+
+  void allocateResources(glm::uvec2 depth_resolution);
+
+  // The pyramid for the depth resolution passed to allocateResources
+  RenderGraph::TransientImageInfo getHiZInfo() const;
+
+  // Must be called once per frame before any culling
+  void prepareFrame(vk::CommandBuffer cmd_buf);
+
+  // Must be recorded outside of a render pass. The late phase samples hi_z, which has to be
+  // in ShaderReadOnlyOptimal.
+  void cull(
+    vk::CommandBuffer cmd_buf,
+    const glm::mat4x4& proj_view,
+    Phase phase = Phase::FrustumOnly,
+    bool gather_stats = false,
+    vk::ImageView hi_z = {});
+
+  // Builds the Hi-Z pyramid used by the late phase, must be recorded outside of a render pass.
+  // Depth has to be in ShaderReadOnlyOptimal and the pyramid in General, only the barriers
+  // between its levels are recorded here.
+  void buildHiZ(
+    vk::CommandBuffer cmd_buf, const etna::Image& depth, std::span<const vk::ImageView> hi_z_mips);
+
+  // Binds scene geometry and draws everything that survived the last cull() call.
+  // Depth-only passes can pass SceneManager::getPositionBuffer() as the vertex buffer.
+  void drawIndirect(vk::CommandBuffer cmd_buf, vk::Buffer vertex_buffer);
+
+  const Stats& getStats() const { return stats; }
+
+  // The Hi-Z pyramid belongs to the render graph and is not reported here
+  void reportMemory(GpuMemoryReport& report) const;
+
+  SceneCuller(const SceneCuller&) = delete;
+  SceneCuller& operator=(const SceneCuller&) = delete;
+
+private:
+  void ensureVisibilityBuffer(vk::CommandBuffer cmd_buf);
+
+private:
+  SceneManager& sceneMgr;
+  DescriptorSetCache& descriptorSets;
+
+  etna::ComputePipeline resetPipeline;
+  etna::ComputePipeline cullingPipeline;
+  etna::ComputePipeline hiZReducePipeline;
+
+  // Bound instead of the pyramid by the phases that never sample it
+  etna::Image hiZPlaceholder;
+  etna::Sampler hiZSampler;
+  glm::uvec2 hiZResolution{};
+  std::uint32_t hiZMipLevels = 0;
+
+  // Whether an instance was visible during the last late phase, one uint per instance
+  etna::Buffer instanceVisibility;
+  std::size_t visibilityInstanceCount = 0;
+
+  etna::GpuSharedResource<etna::Buffer> statsBuffers;
+  Stats stats;
+};
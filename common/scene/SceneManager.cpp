@@ -2,7 +2,10 @@
 #include "etna/DescriptorSet.hpp"
 #include "render_utils/Timer.hpp"
 
-#include <stack>
+#include <array>
+#include <bit>
+#include <utility>
+#include <variant>
 
 #include <stb_image.h>
 #include <spdlog/spdlog.h>
@@ -22,24 +25,12 @@
 #include "render_utils/Utilities.hpp"
 
 
-static std::uint32_t encode_normal(glm::vec3 normal)
-{
-  const std::int32_t x = static_cast<std::int32_t>(normal.x * 32767.0f);
-  const std::int32_t y = static_cast<std::int32_t>(normal.y * 32767.0f);
-
-  const std::uint32_t sign = normal.z >= 0 ? 0 : 1;
-  const std::uint32_t sx = static_cast<std::uint32_t>(x & 0xfffe) | sign;
-  const std::uint32_t sy = static_cast<std::uint32_t>(y & 0xffff) << 16;
-
-  return sx | sy;
-}
-
 SceneManager::SceneManager()
   : baseColorPlaceholder(Texture2D::Id::Invalid)
   , metallicRoughnessPlaceholder(Texture2D::Id::Invalid)
   , normalPlaceholder(Texture2D::Id::Invalid)
   , oneShotCommands{etna::get_context().createOneShotCmdMgr()}
-  , transferHelper{etna::BlockingTransferHelper::CreateInfo{.stagingSize = 4096 * 4096 * 4}}
+  , transferHelper{etna::BlockingTransferHelper::CreateInfo{.stagingSize = TRANSFER_STAGING_SIZE}}
   , defaultSampler(
       etna::Sampler::CreateInfo{.filter = vk::Filter::eLinear, .name = "default_sampler"})
 {
@@ -178,7 +169,8 @@ void SceneManager::processTextures(
     render_utility::generate_mipmaps_vk_style(*oneShotCommands, texture, mipLevels, layerCount);
 
     auto id = texture2dManager.loadResource(
-      ("texture_" + currentTextureImage.uri).c_str(), {.texture = std::move(texture)});
+      ("texture_" + currentTextureImage.uri).c_str(),
+      {.texture = std::move(texture), .format = format});
     spdlog::info(
       "New texture loaded from file {}, texture id = {}",
       currentTextureImage.uri,
@@ -389,7 +381,8 @@ Texture2D::Id SceneManager::generatePlaceholderTexture(
   oneShotCommands->submitAndWait(commandBuffer);
 
   Texture2D::Id placeholder =
-    texture2dManager.loadResource(("texture_" + name).c_str(), {.texture = std::move(texture)});
+    texture2dManager.loadResource(
+      ("texture_" + name).c_str(), {.texture = std::move(texture), .format = format});
   spdlog::info(
     "Placeholder texture {} created , texture id = {}", name, static_cast<uint32_t>(placeholder));
   return placeholder;
@@ -438,87 +431,6 @@ void SceneManager::generatePlaceholderMaterial()
     static_cast<uint32_t>(normalPlaceholder));
 }
 
-SceneManager::ProcessedInstances SceneManager::processInstances(const tinygltf::Model& model) const
-{
-  std::vector nodeTransforms(model.nodes.size(), glm::identity<glm::mat4x4>());
-
-  for (std::size_t nodeIdx = 0; nodeIdx < model.nodes.size(); ++nodeIdx)
-  {
-    const auto& node = model.nodes[nodeIdx];
-    auto& transform = nodeTransforms[nodeIdx];
-
-    if (!node.matrix.empty())
-    {
-      for (int i = 0; i < 4; ++i)
-        for (int j = 0; j < 4; ++j)
-          transform[i][j] = static_cast<float>(node.matrix[4 * i + j]);
-    }
-    else
-    {
-      if (!node.scale.empty())
-        transform = scale(
-          transform,
-          glm::vec3(
-            static_cast<float>(node.scale[0]),
-            static_cast<float>(node.scale[1]),
-            static_cast<float>(node.scale[2])));
-
-      if (!node.rotation.empty())
-        transform *= mat4_cast(
-          glm::quat(
-            static_cast<float>(node.rotation[3]),
-            static_cast<float>(node.rotation[0]),
-            static_cast<float>(node.rotation[1]),
-            static_cast<float>(node.rotation[2])));
-
-      if (!node.translation.empty())
-        transform = translate(
-          transform,
-          glm::vec3(
-            static_cast<float>(node.translation[0]),
-            static_cast<float>(node.translation[1]),
-            static_cast<float>(node.translation[2])));
-    }
-  }
-
-  std::stack<std::size_t> vertices;
-  for (auto vert : model.scenes[model.defaultScene].nodes)
-    vertices.push(vert);
-
-  while (!vertices.empty())
-  {
-    auto vert = vertices.top();
-    vertices.pop();
-
-    for (auto child : model.nodes[vert].children)
-    {
-      nodeTransforms[child] = nodeTransforms[vert] * nodeTransforms[child];
-      vertices.push(child);
-    }
-  }
-
-  ProcessedInstances result;
-
-  // Don't overallocate matrices, they are pretty chonky.
-  {
-    std::size_t totalNodesWithMeshes = 0;
-    for (std::size_t i = 0; i < model.nodes.size(); ++i)
-      if (model.nodes[i].mesh >= 0)
-        ++totalNodesWithMeshes;
-    result.matrices.reserve(totalNodesWithMeshes);
-    result.meshes.reserve(totalNodesWithMeshes);
-  }
-
-  for (std::size_t i = 0; i < model.nodes.size(); ++i)
-    if (model.nodes[i].mesh >= 0)
-    {
-      result.matrices.push_back(nodeTransforms[i]);
-      result.meshes.push_back(model.nodes[i].mesh);
-    }
-
-  return result;
-}
-
 SceneManager::ProcessedMeshes SceneManager::processMeshes(const tinygltf::Model& model) const
 {
   // NOTE: glTF assets can have pretty wonky data layouts which are not appropriate
@@ -579,163 +491,36 @@ SceneManager::ProcessedMeshes SceneManager::processMeshes(const tinygltf::Model&
         continue;
       }
 
-      const auto normalIt = prim.attributes.find("NORMAL");
-      const auto tangentIt = prim.attributes.find("TANGENT");
-      const auto texcoordIt = prim.attributes.find("TEXCOORD_0");
-
-      const bool hasNormals = normalIt != prim.attributes.end();
-      const bool hasTangents = tangentIt != prim.attributes.end();
-      const bool hasTexcoord = texcoordIt != prim.attributes.end();
-      std::array accessorIndices{
-        prim.indices,
-        prim.attributes.at("POSITION"),
-        hasNormals ? normalIt->second : -1,
-        hasTangents ? tangentIt->second : -1,
-        hasTexcoord ? texcoordIt->second : -1,
-      };
-
-      std::array accessors{
-        &model.accessors[prim.indices],
-        &model.accessors[accessorIndices[1]],
-        hasNormals ? &model.accessors[accessorIndices[2]] : nullptr,
-        hasTangents ? &model.accessors[accessorIndices[3]] : nullptr,
-        hasTexcoord ? &model.accessors[accessorIndices[4]] : nullptr,
-      };
-
-      std::array bufViews{
-        &model.bufferViews[accessors[0]->bufferView],
-        &model.bufferViews[accessors[1]->bufferView],
-        hasNormals ? &model.bufferViews[accessors[2]->bufferView] : nullptr,
-        hasTangents ? &model.bufferViews[accessors[3]->bufferView] : nullptr,
-        hasTexcoord ? &model.bufferViews[accessors[4]->bufferView] : nullptr,
-      };
+      const auto& indexAccessor = model.accessors[prim.indices];
+      const auto& positionAccessor = model.accessors[prim.attributes.at("POSITION")];
 
       result.relems.push_back(
         RenderElement{
           .vertexOffset = static_cast<std::uint32_t>(result.vertices.size()),
           .indexOffset = static_cast<std::uint32_t>(result.indices.size()),
-          .indexCount = static_cast<std::uint32_t>(accessors[0]->count),
+          .indexCount = static_cast<std::uint32_t>(indexAccessor.count),
           .material = static_cast<Material::Id>(prim.material)});
 
 
-      const auto& positionAccessor = accessors[1];
       glm::vec4 minPos = {
-        positionAccessor->minValues[0],
-        positionAccessor->minValues[1],
-        positionAccessor->minValues[2],
+        positionAccessor.minValues[0],
+        positionAccessor.minValues[1],
+        positionAccessor.minValues[2],
         0};
       glm::vec4 maxPos = {
-        positionAccessor->maxValues[0],
-        positionAccessor->maxValues[1],
-        positionAccessor->maxValues[2],
+        positionAccessor.maxValues[0],
+        positionAccessor.maxValues[1],
+        positionAccessor.maxValues[2],
         0};
 
       result.bounds.push_back(Bounds{minPos, maxPos});
 
-      const std::size_t vertexCount = accessors[1]->count;
-
-      std::array ptrs{
-        reinterpret_cast<const std::byte*>(model.buffers[bufViews[0]->buffer].data.data()) +
-          bufViews[0]->byteOffset + accessors[0]->byteOffset,
-        reinterpret_cast<const std::byte*>(model.buffers[bufViews[1]->buffer].data.data()) +
-          bufViews[1]->byteOffset + accessors[1]->byteOffset,
-        hasNormals
-          ? reinterpret_cast<const std::byte*>(model.buffers[bufViews[2]->buffer].data.data()) +
-            bufViews[2]->byteOffset + accessors[2]->byteOffset
-          : nullptr,
-        hasTangents
-          ? reinterpret_cast<const std::byte*>(model.buffers[bufViews[3]->buffer].data.data()) +
-            bufViews[3]->byteOffset + accessors[3]->byteOffset
-          : nullptr,
-        hasTexcoord
-          ? reinterpret_cast<const std::byte*>(model.buffers[bufViews[4]->buffer].data.data()) +
-            bufViews[4]->byteOffset + accessors[4]->byteOffset
-          : nullptr,
-      };
-
-      std::array strides{
-        bufViews[0]->byteStride != 0
-          ? bufViews[0]->byteStride
-          : tinygltf::GetComponentSizeInBytes(accessors[0]->componentType) *
-            tinygltf::GetNumComponentsInType(accessors[0]->type),
-        bufViews[1]->byteStride != 0
-          ? bufViews[1]->byteStride
-          : tinygltf::GetComponentSizeInBytes(accessors[1]->componentType) *
-            tinygltf::GetNumComponentsInType(accessors[1]->type),
-        hasNormals ? (bufViews[2]->byteStride != 0
-                        ? bufViews[2]->byteStride
-                        : tinygltf::GetComponentSizeInBytes(accessors[2]->componentType) *
-                          tinygltf::GetNumComponentsInType(accessors[2]->type))
-                   : 0,
-        hasTangents ? (bufViews[3]->byteStride != 0
-                         ? bufViews[3]->byteStride
-                         : tinygltf::GetComponentSizeInBytes(accessors[3]->componentType) *
-                           tinygltf::GetNumComponentsInType(accessors[3]->type))
-                    : 0,
-        hasTexcoord ? (bufViews[4]->byteStride != 0
-                         ? bufViews[4]->byteStride
-                         : tinygltf::GetComponentSizeInBytes(accessors[4]->componentType) *
-                           tinygltf::GetNumComponentsInType(accessors[4]->type))
-                    : 0,
-      };
-
-      for (std::size_t i = 0; i < vertexCount; ++i)
-      {
-        auto& vtx = result.vertices.emplace_back();
-        glm::vec3 pos;
-        // Fall back to 0 in case we don't have something.
-        // NOTE: if tangents are not available, one could use http://mikktspace.com/
-        // NOTE: if normals are not available, reconstructing them is possible but will look ugly
-        glm::vec3 normal{0};
-        glm::vec3 tangent{0};
-        glm::vec2 texcoord{0};
-        std::memcpy(&pos, ptrs[1], sizeof(pos));
-
-        // NOTE: it's faster to do a template here with specializations for all combinations than to
-        // do ifs at runtime. Also, SIMD should be used. Try implementing this!
-        if (hasNormals)
-          std::memcpy(&normal, ptrs[2], sizeof(normal));
-        if (hasTangents)
-          std::memcpy(&tangent, ptrs[3], sizeof(tangent));
-        if (hasTexcoord)
-          std::memcpy(&texcoord, ptrs[4], sizeof(texcoord));
-
-
-        vtx.positionAndNormal = glm::vec4(pos, std::bit_cast<float>(encode_normal(normal)));
-        vtx.texCoordAndTangentAndPadding =
-          glm::vec4(texcoord, std::bit_cast<float>(encode_normal(tangent)), 0);
-
-        ptrs[1] += strides[1];
-        if (hasNormals)
-          ptrs[2] += strides[2];
-        if (hasTangents)
-          ptrs[3] += strides[3];
-        if (hasTexcoord)
-          ptrs[4] += strides[4];
-      }
-
-      // Indices are guaranteed to have no stride
-      ETNA_VERIFY(bufViews[0]->byteStride == 0);
-      const std::size_t indexCount = accessors[0]->count;
-      if (accessors[0]->componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT)
-      {
-        for (std::size_t i = 0; i < indexCount; ++i)
-        {
-          std::uint16_t index;
-          std::memcpy(&index, ptrs[0], sizeof(index));
-          result.indices.push_back(index);
-          ptrs[0] += 2;
-        }
-      }
-      else if (accessors[0]->componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT)
-      {
-        const std::size_t lastTotalIndices = result.indices.size();
-        result.indices.resize(lastTotalIndices + indexCount);
-        std::memcpy(
-          result.indices.data() + lastTotalIndices,
-          ptrs[0],
-          sizeof(result.indices[0]) * indexCount);
-      }
+      recode_vertices(vertex_streams(model, prim), result.vertices);
+      // Shading reads the material from the vertex, so one draw may cover several materials
+      const auto material = std::bit_cast<float>(static_cast<std::uint32_t>(prim.material));
+      for (auto& vertex : std::span(result.vertices).subspan(result.relems.back().vertexOffset))
+        vertex.texCoordAndTangentAndPadding.w = material;
+      append_indices(model, indexAccessor, result.indices);
     }
   }
 
@@ -846,6 +631,23 @@ void SceneManager::uploadData(
   transferHelper.uploadBuffer<Vertex>(*oneShotCommands, unifiedVbuf, 0, vertices);
   transferHelper.uploadBuffer<std::uint32_t>(*oneShotCommands, unifiedIbuf, 0, indices);
 
+  // Depth-only passes fetch 12 bytes per vertex instead of the full 32 byte vertex
+  std::vector<glm::vec3> positions;
+  positions.reserve(vertices.size());
+  for (const auto& vertex : vertices)
+    positions.emplace_back(vertex.positionAndNormal);
+
+  unifiedPositionVbuf = ctx.createBuffer(
+    etna::Buffer::CreateInfo{
+      .size = positions.size() * sizeof(glm::vec3),
+      .bufferUsage = vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eVertexBuffer,
+      .memoryUsage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+      .name = "unifiedPositionVbuf",
+    });
+
+  transferHelper.uploadBuffer<glm::vec3>(
+    *oneShotCommands, unifiedPositionVbuf, 0, std::span<const glm::vec3>(positions));
+
   unifiedMaterialsbuf = ctx.createBuffer(
     etna::Buffer::CreateInfo{
       .size = materialManager.size() * sizeof(MaterialGLSLCompat),
@@ -934,15 +736,6 @@ void SceneManager::uploadData(
   transferHelper.uploadBuffer<std::uint32_t>(
     *oneShotCommands, unifiedInstanceMeshesbuf, 0, std::span(instanceMeshes));
 
-  // filled on GPU when culling
-  unifiedDrawInstanceIndicesbuf = ctx.createBuffer(
-    etna::Buffer::CreateInfo{
-      .size = instanceMeshes.size() * sizeof(std::uint32_t),
-      .bufferUsage =
-        vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer,
-      .memoryUsage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
-      .name = "unifiedDrawInstanceIndicesbuf"});
-
   unifiedRelemInstanceOffsetsbuf = ctx.createBuffer(
     etna::Buffer::CreateInfo{
       .size = renderElements.size() * sizeof(std::uint32_t),
@@ -951,32 +744,22 @@ void SceneManager::uploadData(
       .memoryUsage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
       .name = "unifiedRelemInstanceOffsetsbuf"});
 
-  std::vector<std::uint32_t> relemInstanceOffsets(renderElements.size(), 0);
-  // calculate total amounts first
-  for (const auto& meshIdx : instanceMeshes)
-  {
-    const auto& currentMesh = meshes[meshIdx];
-    for (std::uint32_t relemIdx = currentMesh.firstRelem;
-         relemIdx < currentMesh.firstRelem + currentMesh.relemCount;
-         relemIdx++)
-    {
-      relemInstanceOffsets[relemIdx]++;
-    }
-  }
-
-  // then convert amounts to respective offsets
-  std::uint32_t offset = 0;
-  std::uint32_t previousAmount = 0;
-  for (auto& amount : relemInstanceOffsets)
-  {
-    previousAmount = amount;
-    amount = offset;
-    offset += previousAmount;
-  }
+  std::vector<std::uint32_t> relemInstanceOffsets(renderElements.size());
+  const std::uint32_t offset =
+    compute_relem_instance_offsets(meshes, instanceMeshes, relemInstanceOffsets);
 
   transferHelper.uploadBuffer<std::uint32_t>(
     *oneShotCommands, unifiedRelemInstanceOffsetsbuf, 0, std::span(relemInstanceOffsets));
 
+  // filled on GPU when culling, every instance of a mesh occupies one slot per relem
+  unifiedDrawInstanceIndicesbuf = ctx.createBuffer(
+    etna::Buffer::CreateInfo{
+      .size = std::max<std::size_t>(offset, 1) * sizeof(std::uint32_t),
+      .bufferUsage =
+        vk::BufferUsageFlagBits::eTransferDst | vk::BufferUsageFlagBits::eStorageBuffer,
+      .memoryUsage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+      .name = "unifiedDrawInstanceIndicesbuf"});
+
   unifiedDrawCommandsbuf = ctx.createBuffer(
     etna::Buffer::CreateInfo{
       .size = renderElements.size() * sizeof(vk::DrawIndexedIndirectCommand),
@@ -1019,7 +802,7 @@ void SceneManager::selectScene(std::filesystem::path path)
   // when re-loading a scene.
 
   // NOTE: you might want to store these on the GPU for GPU-driven rendering.
-  auto [instMats, instMeshes] = processInstances(model);
+  auto [instMats, instMeshes] = process_instances(model);
   instanceMatrices = std::move(instMats);
   instanceMeshes = std::move(instMeshes);
 
@@ -1030,6 +813,7 @@ void SceneManager::selectScene(std::filesystem::path path)
   renderElementsBounds = std::move(bounds);
 
   uploadData(verts, inds);
+  updateBindlessResources();
 }
 
 void SceneManager::selectBakedScene(std::filesystem::path path)
@@ -1049,7 +833,7 @@ void SceneManager::selectBakedScene(std::filesystem::path path)
   processMaterials(model);
   generatePlaceholderMaterial();
 
-  auto [instMats, instMeshes] = processInstances(model);
+  auto [instMats, instMeshes] = process_instances(model);
   instanceMatrices = std::move(instMats);
   instanceMeshes = std::move(instMeshes);
 
@@ -1060,19 +844,21 @@ void SceneManager::selectBakedScene(std::filesystem::path path)
   renderElementsBounds = std::move(bounds);
 
   uploadData(verts, inds);
+  updateBindlessResources();
 }
 
-std::vector<etna::Binding> SceneManager::getBindlessBindings() const
+void SceneManager::updateBindlessResources()
 {
-  std::vector<etna::Binding> bindings;
-  bindings.reserve(texture2dManager.size() + 1);
+  bindlessBindings.clear();
+  bindlessBindings.reserve(texture2dManager.size() + 1);
 
-  bindings.emplace_back(etna::Binding{0, unifiedMaterialsbuf.genBinding()});
+  bindlessBindings.emplace_back(etna::Binding{0, unifiedMaterialsbuf.genBinding()});
 
   for (uint32_t i = 0; i < texture2dManager.size(); i++)
   {
-    auto& currentTexture = texture2dManager.getResource(static_cast<Texture2D::Id>(i));
-    bindings.emplace_back(
+    const auto& currentTexture =
+      std::as_const(texture2dManager).getResource(static_cast<Texture2D::Id>(i));
+    bindlessBindings.emplace_back(
       etna::Binding{
         1,
         currentTexture.texture.genBinding(
@@ -1080,7 +866,124 @@ std::vector<etna::Binding> SceneManager::getBindlessBindings() const
         i});
   }
 
-  return bindings;
+  if (texture2dManager.size() > MAX_BINDLESS_TEXTURES)
+    spdlog::warn(
+      "Scene has {} textures, only the first {} fit into the bindless set",
+      texture2dManager.size(),
+      MAX_BINDLESS_TEXTURES);
+
+  if (!bindlessSet)
+    return;
+
+  // The set already exists, so only the slots of the new scene are patched
+  const auto& materials = std::get<etna::BufferBinding>(bindlessBindings.front().resources);
+  etna::get_context().getDevice().updateDescriptorSets(
+    {vk::WriteDescriptorSet{
+      .dstSet = bindlessSet,
+      .dstBinding = BINDLESS_MATERIALS_BINDING,
+      .descriptorCount = 1,
+      .descriptorType = vk::DescriptorType::eStorageBuffer,
+      .pBufferInfo = &materials.descriptor_info,
+    }},
+    {});
+
+  for (uint32_t i = 0; i < texture2dManager.size(); i++)
+    updateBindlessTexture(static_cast<Texture2D::Id>(i));
+}
+
+vk::DescriptorSetLayout SceneManager::getBindlessLayout()
+{
+  if (bindlessLayout)
+    return bindlessLayout.get();
+
+  const std::array layoutBindings{
+    vk::DescriptorSetLayoutBinding{
+      .binding = BINDLESS_MATERIALS_BINDING,
+      .descriptorType = vk::DescriptorType::eStorageBuffer,
+      .descriptorCount = 1,
+      .stageFlags = vk::ShaderStageFlagBits::eAll,
+    },
+    vk::DescriptorSetLayoutBinding{
+      .binding = BINDLESS_TEXTURES_BINDING,
+      .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+      .descriptorCount = MAX_BINDLESS_TEXTURES,
+      .stageFlags = vk::ShaderStageFlagBits::eAll,
+    },
+  };
+  // Scene loads rewrite both bindings of a set that previous frames have bound
+  const vk::DescriptorBindingFlags bindingFlags = vk::DescriptorBindingFlagBits::eUpdateAfterBind |
+    vk::DescriptorBindingFlagBits::ePartiallyBound;
+  const std::array perBindingFlags{bindingFlags, bindingFlags};
+  vk::DescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{
+    .bindingCount = static_cast<std::uint32_t>(perBindingFlags.size()),
+    .pBindingFlags = perBindingFlags.data(),
+  };
+
+  bindlessLayout =
+    etna::unwrap_vk_result(etna::get_context().getDevice().createDescriptorSetLayoutUnique(
+      vk::DescriptorSetLayoutCreateInfo{
+        .pNext = &bindingFlagsInfo,
+        .flags = vk::DescriptorSetLayoutCreateFlagBits::eUpdateAfterBindPool,
+        .bindingCount = static_cast<std::uint32_t>(layoutBindings.size()),
+        .pBindings = layoutBindings.data(),
+      }));
+
+  return bindlessLayout.get();
+}
+
+vk::DescriptorSet SceneManager::getBindlessSet()
+{
+  if (bindlessSet)
+    return bindlessSet;
+
+  auto device = etna::get_context().getDevice();
+  const auto layout = getBindlessLayout();
+
+  const std::array poolSizes{
+    vk::DescriptorPoolSize{vk::DescriptorType::eStorageBuffer, 1},
+    vk::DescriptorPoolSize{vk::DescriptorType::eCombinedImageSampler, MAX_BINDLESS_TEXTURES},
+  };
+  bindlessPool = etna::unwrap_vk_result(device.createDescriptorPoolUnique(
+    vk::DescriptorPoolCreateInfo{
+      .flags = vk::DescriptorPoolCreateFlagBits::eUpdateAfterBind,
+      .maxSets = 1,
+      .poolSizeCount = static_cast<std::uint32_t>(poolSizes.size()),
+      .pPoolSizes = poolSizes.data(),
+    }));
+
+  bindlessSet = etna::unwrap_vk_result(device.allocateDescriptorSets(
+                                         vk::DescriptorSetAllocateInfo{
+                                           .descriptorPool = bindlessPool.get(),
+                                           .descriptorSetCount = 1,
+                                           .pSetLayouts = &layout,
+                                         }))
+                  .front();
+
+  // Everything loaded so far gets written once, later changes patch single slots
+  if (!bindlessBindings.empty())
+    updateBindlessResources();
+
+  return bindlessSet;
+}
+
+void SceneManager::updateBindlessTexture(Texture2D::Id id)
+{
+  if (!bindlessSet || static_cast<std::uint32_t>(id) >= MAX_BINDLESS_TEXTURES)
+    return;
+
+  const auto binding = std::as_const(texture2dManager).getResource(id).texture.genBinding(
+    defaultSampler.get(), vk::ImageLayout::eShaderReadOnlyOptimal);
+
+  etna::get_context().getDevice().updateDescriptorSets(
+    {vk::WriteDescriptorSet{
+      .dstSet = bindlessSet,
+      .dstBinding = BINDLESS_TEXTURES_BINDING,
+      .dstArrayElement = static_cast<std::uint32_t>(id),
+      .descriptorCount = 1,
+      .descriptorType = vk::DescriptorType::eCombinedImageSampler,
+      .pImageInfo = &binding.descriptor_info,
+    }},
+    {});
 }
 
 etna::VertexByteStreamFormatDescription SceneManager::getVertexFormatDescription()
@@ -1098,3 +1001,43 @@ etna::VertexByteStreamFormatDescription SceneManager::getVertexFormatDescription
       },
     }};
 }
+
+etna::VertexByteStreamFormatDescription SceneManager::getPositionFormatDescription()
+{
+  return etna::VertexByteStreamFormatDescription{
+    .stride = sizeof(glm::vec3),
+    .attributes = {
+      etna::VertexByteStreamFormatDescription::Attribute{
+        .format = vk::Format::eR32G32B32Sfloat,
+        .offset = 0,
+      },
+    }};
+}
+
+void SceneManager::reportMemory(GpuMemoryReport& report) const
+{
+  using Category = GpuMemoryReport::Category;
+
+  for (const auto& texture : texture2dManager)
+    report.addImage(Category::Textures, vk::to_string(texture.format), texture.texture.get());
+
+  report.addBuffer(Category::Geometry, "vertices", unifiedVbuf.get());
+  report.addBuffer(Category::Geometry, "indices", unifiedIbuf.get());
+  report.addBuffer(Category::Geometry, "positions", unifiedPositionVbuf.get());
+  report.addBuffer(Category::Geometry, "relems", unifiedRelemsbuf.get());
+  report.addBuffer(Category::Geometry, "bounds", unifiedBoundsbuf.get());
+  report.addBuffer(Category::Geometry, "meshes", unifiedMeshesbuf.get());
+
+  report.addBuffer(Category::InstanceData, "matrices", unifiedInstanceMatricesbuf.get());
+  report.addBuffer(Category::InstanceData, "meshes", unifiedInstanceMeshesbuf.get());
+  report.addBuffer(
+    Category::InstanceData, "relem instance offsets", unifiedRelemInstanceOffsetsbuf.get());
+  report.addBuffer(
+    Category::InstanceData, "draw instance indices", unifiedDrawInstanceIndicesbuf.get());
+  report.addBuffer(Category::InstanceData, "draw commands", unifiedDrawCommandsbuf.get());
+
+  // The helper owns its buffer, so the size it was created with is all there is to go by
+  report.addBytes(Category::Staging, "transfer helper", TRANSFER_STAGING_SIZE, 1);
+
+  report.addBuffer(Category::Other, "materials", unifiedMaterialsbuf.get());
+}
@@ -15,6 +15,9 @@
 #include "etna/DescriptorSet.hpp"
 #include "resource/Material.hpp"
 #include "resource/Texture2D.hpp"
+#include "scene/SceneProcessing.hpp"
+#include "shaders/bindless.h"
+#include "render_utils/GpuMemoryReport.hpp"
 
 
 // Bounds for each render element
@@ -48,15 +51,6 @@ struct HashRenderElement
   }
 };
 
-// A mesh is a collection of relems. A scene may have the same mesh
-// located in several different places, so a scene consists of **instances**,
-// not meshes.
-struct Mesh
-{
-  std::uint32_t firstRelem;
-  std::uint32_t relemCount;
-};
-
 class SceneManager
 {
 public:
@@ -83,6 +77,8 @@ public:
 
   vk::Buffer getVertexBuffer() { return unifiedVbuf.get(); }
   vk::Buffer getIndexBuffer() { return unifiedIbuf.get(); }
+  // Tightly packed positions in the same order as the vertex buffer, for depth-only passes
+  vk::Buffer getPositionBuffer() { return unifiedPositionVbuf.get(); }
 
   etna::Buffer& getMaterialBuffer() { return unifiedMaterialsbuf; }
 
@@ -95,9 +91,24 @@ public:
   etna::Buffer& getDrawInstanceIndicesBuffer() { return unifiedDrawInstanceIndicesbuf; }
   etna::Buffer& getDrawCommandsBuffer() { return unifiedDrawCommandsbuf; }
 
-  std::vector<etna::Binding> getBindlessBindings() const;
+  // Rebuilt only when a scene is loaded
+  const std::vector<etna::Binding>& getBindlessBindings() const { return bindlessBindings; }
+
+  // Persistent set read through shaders/bindless.glsl, bound as BINDLESS_SET. Both bindings are
+  // update-after-bind and partially bound, so the device must enable descriptorIndexing,
+  // descriptorBindingPartiallyBound, descriptorBindingStorageBufferUpdateAfterBind,
+  // descriptorBindingSampledImageUpdateAfterBind and shaderSampledImageArrayNonUniformIndexing
+  // before calling these. Created on first use, scene loads rewrite it in place.
+  vk::DescriptorSetLayout getBindlessLayout();
+  vk::DescriptorSet getBindlessSet();
+  // Patches a single slot, e.g. after a texture got streamed in, even while the set is bound
+  void updateBindlessTexture(Texture2D::Id id);
 
   etna::VertexByteStreamFormatDescription getVertexFormatDescription();
+  etna::VertexByteStreamFormatDescription getPositionFormatDescription();
+
+  // Textures grouped by format, the unified buffers and the staging buffer of the transfers
+  void reportMemory(GpuMemoryReport& report) const;
 
   // for now one placeholder for all materials
   Texture2D::Id baseColorPlaceholder;
@@ -117,6 +128,7 @@ private:
   static_assert(sizeof(RenderElementGLSLCompat) % (sizeof(float) * 4) == 0);
 
 
+  // Read as SceneMaterial by shaders/bindless.glsl
   struct MaterialGLSLCompat
   {
     glm::vec4 baseColorFactor;
@@ -131,20 +143,7 @@ private:
   };
   static_assert(sizeof(MaterialGLSLCompat) % (sizeof(float) * 4) == 0);
 
-  struct ProcessedInstances
-  {
-    std::vector<glm::mat4x4> matrices;
-    std::vector<std::uint32_t> meshes;
-  };
-
-  struct Vertex
-  {
-    // First 3 floats are position, 4th float is a packed normal
-    glm::vec4 positionAndNormal;
-    // First 2 floats are tex coords, 3rd is a packed tangent, 4th is padding
-    glm::vec4 texCoordAndTangentAndPadding;
-  };
-  static_assert(sizeof(Vertex) == sizeof(float) * 8);
+  using Vertex = SceneVertex;
 
   struct ProcessedMeshes
   {
@@ -179,12 +178,15 @@ private:
 
   void generatePlaceholderMaterial();
 
-  ProcessedInstances processInstances(const tinygltf::Model& model) const;
   ProcessedMeshes processMeshes(const tinygltf::Model& model) const;
   BakedMeshes processBakedMeshes(const tinygltf::Model& model) const;
   void uploadData(std::span<const Vertex> vertices, std::span<const std::uint32_t> indices);
+  void updateBindlessResources();
 
 private:
+  // Big enough for a 4096x4096 RGBA8 texture in a single upload
+  static constexpr vk::DeviceSize TRANSFER_STAGING_SIZE = 4096 * 4096 * 4;
+
   tinygltf::TinyGLTF loader;
   std::unique_ptr<etna::OneShotCmdMgr> oneShotCommands;
   etna::BlockingTransferHelper transferHelper;
@@ -202,6 +204,7 @@ private:
 
   etna::Buffer unifiedVbuf;
   etna::Buffer unifiedIbuf;
+  etna::Buffer unifiedPositionVbuf;
 
   etna::Buffer unifiedMaterialsbuf;
 
@@ -215,4 +218,9 @@ private:
   etna::Buffer unifiedDrawInstanceIndicesbuf;
 
   etna::Buffer unifiedDrawCommandsbuf;
+
+  std::vector<etna::Binding> bindlessBindings;
+  vk::UniqueDescriptorSetLayout bindlessLayout;
+  vk::UniqueDescriptorPool bindlessPool;
+  vk::DescriptorSet bindlessSet;
 };
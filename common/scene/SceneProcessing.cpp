@@ -0,0 +1,243 @@
+#include "SceneProcessing.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stack>
+
+#include <etna/Assert.hpp>
+#include <glm/ext.hpp>
+
+
+std::uint32_t encode_normal(glm::vec3 normal)
+{
+  const std::int32_t x = static_cast<std::int32_t>(normal.x * 32767.0f);
+  const std::int32_t y = static_cast<std::int32_t>(normal.y * 32767.0f);
+
+  const std::uint32_t sign = normal.z >= 0 ? 0 : 1;
+  const std::uint32_t sx = static_cast<std::uint32_t>(x & 0xfffe) | sign;
+  const std::uint32_t sy = static_cast<std::uint32_t>(y & 0xffff) << 16;
+
+  return sx | sy;
+}
+
+SceneInstances process_instances(const tinygltf::Model& model)
+{
+  std::vector nodeTransforms(model.nodes.size(), glm::identity<glm::mat4x4>());
+
+  for (std::size_t nodeIdx = 0; nodeIdx < model.nodes.size(); ++nodeIdx)
+  {
+    const auto& node = model.nodes[nodeIdx];
+    auto& transform = nodeTransforms[nodeIdx];
+
+    if (!node.matrix.empty())
+    {
+      for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j)
+          transform[i][j] = static_cast<float>(node.matrix[4 * i + j]);
+    }
+    else
+    {
+      if (!node.scale.empty())
+        transform = scale(
+          transform,
+          glm::vec3(
+            static_cast<float>(node.scale[0]),
+            static_cast<float>(node.scale[1]),
+            static_cast<float>(node.scale[2])));
+
+      if (!node.rotation.empty())
+        transform *= mat4_cast(
+          glm::quat(
+            static_cast<float>(node.rotation[3]),
+            static_cast<float>(node.rotation[0]),
+            static_cast<float>(node.rotation[1]),
+            static_cast<float>(node.rotation[2])));
+
+      if (!node.translation.empty())
+        transform = translate(
+          transform,
+          glm::vec3(
+            static_cast<float>(node.translation[0]),
+            static_cast<float>(node.translation[1]),
+            static_cast<float>(node.translation[2])));
+    }
+  }
+
+  std::stack<std::size_t> vertices;
+  for (auto vert : model.scenes[model.defaultScene].nodes)
+    vertices.push(vert);
+
+  while (!vertices.empty())
+  {
+    auto vert = vertices.top();
+    vertices.pop();
+
+    for (auto child : model.nodes[vert].children)
+    {
+      nodeTransforms[child] = nodeTransforms[vert] * nodeTransforms[child];
+      vertices.push(child);
+    }
+  }
+
+  SceneInstances result;
+
+  // Don't overallocate matrices, they are pretty chonky.
+  {
+    std::size_t totalNodesWithMeshes = 0;
+    for (std::size_t i = 0; i < model.nodes.size(); ++i)
+      if (model.nodes[i].mesh >= 0)
+        ++totalNodesWithMeshes;
+    result.matrices.reserve(totalNodesWithMeshes);
+    result.meshes.reserve(totalNodesWithMeshes);
+  }
+
+  for (std::size_t i = 0; i < model.nodes.size(); ++i)
+    if (model.nodes[i].mesh >= 0)
+    {
+      result.matrices.push_back(nodeTransforms[i]);
+      result.meshes.push_back(model.nodes[i].mesh);
+    }
+
+  return result;
+}
+
+static const std::byte* accessor_data(
+  const tinygltf::Model& model, const tinygltf::Accessor& accessor)
+{
+  const auto& bufView = model.bufferViews[accessor.bufferView];
+  return reinterpret_cast<const std::byte*>(model.buffers[bufView.buffer].data.data()) +
+    bufView.byteOffset + accessor.byteOffset;
+}
+
+static VertexStreams::Stream attribute_stream(
+  const tinygltf::Model& model, const tinygltf::Primitive& prim, const char* attribute)
+{
+  const auto it = prim.attributes.find(attribute);
+  if (it == prim.attributes.end())
+    return {};
+
+  const auto& accessor = model.accessors[it->second];
+  const auto& bufView = model.bufferViews[accessor.bufferView];
+  return VertexStreams::Stream{
+    .data = accessor_data(model, accessor),
+    .stride = bufView.byteStride != 0
+      ? bufView.byteStride
+      : static_cast<std::size_t>(
+          tinygltf::GetComponentSizeInBytes(accessor.componentType) *
+          tinygltf::GetNumComponentsInType(accessor.type)),
+  };
+}
+
+VertexStreams vertex_streams(const tinygltf::Model& model, const tinygltf::Primitive& prim)
+{
+  return VertexStreams{
+    .count = model.accessors[prim.attributes.at("POSITION")].count,
+    .position = attribute_stream(model, prim, "POSITION"),
+    .normal = attribute_stream(model, prim, "NORMAL"),
+    .tangent = attribute_stream(model, prim, "TANGENT"),
+    .texcoord = attribute_stream(model, prim, "TEXCOORD_0"),
+  };
+}
+
+void recode_vertices(const VertexStreams& streams, std::vector<SceneVertex>& vertices)
+{
+  auto [count, positionStream, normalStream, tangentStream, texcoordStream] = streams;
+  const bool hasNormals = normalStream.data != nullptr;
+  const bool hasTangents = tangentStream.data != nullptr;
+  const bool hasTexcoord = texcoordStream.data != nullptr;
+
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    auto& vtx = vertices.emplace_back();
+    glm::vec3 pos;
+    // Fall back to 0 in case we don't have something.
+    // NOTE: if tangents are not available, one could use http://mikktspace.com/
+    // NOTE: if normals are not available, reconstructing them is possible but will look ugly
+    glm::vec3 normal{0};
+    glm::vec3 tangent{0};
+    glm::vec2 texcoord{0};
+    std::memcpy(&pos, positionStream.data, sizeof(pos));
+
+    // NOTE: it's faster to do a template here with specializations for all combinations than to
+    // do ifs at runtime. Also, SIMD should be used. Try implementing this!
+    if (hasNormals)
+      std::memcpy(&normal, normalStream.data, sizeof(normal));
+    if (hasTangents)
+      std::memcpy(&tangent, tangentStream.data, sizeof(tangent));
+    if (hasTexcoord)
+      std::memcpy(&texcoord, texcoordStream.data, sizeof(texcoord));
+
+
+    vtx.positionAndNormal = glm::vec4(pos, std::bit_cast<float>(encode_normal(normal)));
+    vtx.texCoordAndTangentAndPadding =
+      glm::vec4(texcoord, std::bit_cast<float>(encode_normal(tangent)), 0);
+
+    positionStream.data += positionStream.stride;
+    if (hasNormals)
+      normalStream.data += normalStream.stride;
+    if (hasTangents)
+      tangentStream.data += tangentStream.stride;
+    if (hasTexcoord)
+      texcoordStream.data += texcoordStream.stride;
+  }
+}
+
+void widen_indices(const std::byte* data, std::size_t count, std::vector<std::uint32_t>& indices)
+{
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    std::uint16_t index;
+    std::memcpy(&index, data, sizeof(index));
+    indices.push_back(index);
+    data += sizeof(index);
+  }
+}
+
+void append_indices(
+  const tinygltf::Model& model,
+  const tinygltf::Accessor& accessor,
+  std::vector<std::uint32_t>& indices)
+{
+  // Indices are guaranteed to have no stride
+  ETNA_VERIFY(model.bufferViews[accessor.bufferView].byteStride == 0);
+  const auto* data = accessor_data(model, accessor);
+  if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT)
+    widen_indices(data, accessor.count, indices);
+  else if (accessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT)
+  {
+    const std::size_t lastTotalIndices = indices.size();
+    indices.resize(lastTotalIndices + accessor.count);
+    std::memcpy(indices.data() + lastTotalIndices, data, sizeof(indices[0]) * accessor.count);
+  }
+}
+
+std::uint32_t compute_relem_instance_offsets(
+  std::span<const Mesh> meshes,
+  std::span<const std::uint32_t> instance_meshes,
+  std::span<std::uint32_t> relem_offsets)
+{
+  std::ranges::fill(relem_offsets, 0);
+  // calculate total amounts first
+  for (const auto& meshIdx : instance_meshes)
+  {
+    const auto& currentMesh = meshes[meshIdx];
+    for (std::uint32_t relemIdx = currentMesh.firstRelem;
+         relemIdx < currentMesh.firstRelem + currentMesh.relemCount;
+         relemIdx++)
+    {
+      relem_offsets[relemIdx]++;
+    }
+  }
+
+  // then convert amounts to respective offsets
+  std::uint32_t offset = 0;
+  std::uint32_t previousAmount = 0;
+  for (auto& amount : relem_offsets)
+  {
+    previousAmount = amount;
+    amount = offset;
+    offset += previousAmount;
+  }
+  return offset;
+}
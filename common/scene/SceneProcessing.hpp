@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <tiny_gltf.h>
+
+
+// CPU kernels that turn glTF data into the layout SceneManager uploads. They only touch
+// memory, so they can be measured and tested without a GPU.
+
+// A mesh is a collection of relems. A scene may have the same mesh
+// located in several different places, so a scene consists of **instances**,
+// not meshes.
+struct Mesh
+{
+  std::uint32_t firstRelem;
+  std::uint32_t relemCount;
+};
+
+struct SceneVertex
+{
+  // First 3 floats are position, 4th float is a packed normal
+  glm::vec4 positionAndNormal;
+  // First 2 floats are tex coords, 3rd is a packed tangent, 4th holds the bits of the
+  // primitive's material id, written by SceneManager
+  glm::vec4 texCoordAndTangentAndPadding;
+};
+static_assert(sizeof(SceneVertex) == sizeof(float) * 8);
+
+struct SceneInstances
+{
+  std::vector<glm::mat4x4> matrices;
+  std::vector<std::uint32_t> meshes;
+};
+
+// Float attributes of a primitive, missing ones have no data and are read as zeros
+struct VertexStreams
+{
+  struct Stream
+  {
+    const std::byte* data = nullptr;
+    std::size_t stride = 0;
+  };
+
+  std::size_t count = 0;
+  Stream position;
+  Stream normal;
+  Stream tangent;
+  Stream texcoord;
+};
+
+// x and y as 16 bit snorms, the sign of z replaces the lowest bit of x
+std::uint32_t encode_normal(glm::vec3 normal);
+
+// Flattens the node hierarchy of the default scene into one instance per node with a mesh
+SceneInstances process_instances(const tinygltf::Model& model);
+
+VertexStreams vertex_streams(const tinygltf::Model& model, const tinygltf::Primitive& prim);
+// Appends streams.count vertices with packed normals and tangents
+void recode_vertices(const VertexStreams& streams, std::vector<SceneVertex>& vertices);
+
+// Appends 16 bit indices as 32 bit ones
+void widen_indices(const std::byte* data, std::size_t count, std::vector<std::uint32_t>& indices);
+// Appends the 16 or 32 bit indices of an accessor
+void append_indices(
+  const tinygltf::Model& model,
+  const tinygltf::Accessor& accessor,
+  std::vector<std::uint32_t>& indices);
+
+// The first slot of every relem in a buffer with one slot per instance of its mesh, i.e. an
+// exclusive prefix sum of relem instance counts. Returns the total slot count.
+std::uint32_t compute_relem_instance_offsets(
+  std::span<const Mesh> meshes,
+  std::span<const std::uint32_t> instance_meshes,
+  std::span<std::uint32_t> relem_offsets);
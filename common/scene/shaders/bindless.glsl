@@ -0,0 +1,42 @@
+#ifndef BINDLESS_GLSL_INCLUDED
+#define BINDLESS_GLSL_INCLUDED
+
+// Read side of SceneManager's bindless set. The including shader has to enable
+// GL_EXT_nonuniform_qualifier, a single draw may cover relems with different materials.
+
+#include "bindless.h"
+
+// Matches SceneManager::MaterialGLSLCompat
+struct SceneMaterial
+{
+  vec4 baseColorFactor;
+  float roughnessFactor;
+  float metallicFactor;
+  uint baseColorTexture;
+  uint metallicRoughnessTexture;
+  uint normalTexture;
+};
+
+layout(std430, binding = BINDLESS_MATERIALS_BINDING, set = BINDLESS_SET) readonly buffer
+  SceneMaterials_t
+{
+  SceneMaterial sceneMaterials[];
+};
+
+// Indexed by Texture2D::Id, slots without a texture are never sampled
+layout(binding = BINDLESS_TEXTURES_BINDING, set = BINDLESS_SET) uniform sampler2D
+  sceneTextures[MAX_BINDLESS_TEXTURES];
+
+// Material ids come from the vertices, see SceneVertex. Relems without a material are white.
+vec4 material_base_color(uint material, vec2 tex_coord)
+{
+  if (material >= sceneMaterials.length())
+    return vec4(1.0f);
+
+  const SceneMaterial m = sceneMaterials[material];
+  if (m.baseColorTexture >= MAX_BINDLESS_TEXTURES)
+    return m.baseColorFactor;
+  return m.baseColorFactor * texture(sceneTextures[nonuniformEXT(m.baseColorTexture)], tex_coord);
+}
+
+#endif // BINDLESS_GLSL_INCLUDED
@@ -0,0 +1,12 @@
+#ifndef BINDLESS_H_INCLUDED
+#define BINDLESS_H_INCLUDED
+
+// Layout of SceneManager's bindless set, bound after the pass' own set 0
+#define BINDLESS_SET 1
+#define BINDLESS_MATERIALS_BINDING 0
+#define BINDLESS_TEXTURES_BINDING 1
+
+// Textures past this are left out of the set, materials using them sample nothing
+#define MAX_BINDLESS_TEXTURES 4096
+
+#endif // BINDLESS_H_INCLUDED
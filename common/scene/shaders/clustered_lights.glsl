@@ -0,0 +1,41 @@
+#ifndef CLUSTERED_LIGHTS_GLSL_INCLUDED
+#define CLUSTERED_LIGHTS_GLSL_INCLUDED
+
+// Read side of LightClusters. The including shader picks the first of the three
+// bindings by defining CLUSTERED_LIGHTS_BINDING.
+
+#include "light_clusters.h"
+
+#ifndef CLUSTERED_LIGHTS_BINDING
+#error "CLUSTERED_LIGHTS_BINDING has to be defined before including clustered_lights.glsl"
+#endif
+
+layout(std430, binding = CLUSTERED_LIGHTS_BINDING) readonly buffer ClusteredLights_t
+{
+  PointLight clusteredLights[];
+};
+
+layout(std430, binding = CLUSTERED_LIGHTS_BINDING + 1) readonly buffer LightClusters_t
+{
+  LightClusterGrid lightGrid;
+  uvec2 lightClusterRanges[];
+};
+
+layout(std430, binding = CLUSTERED_LIGHTS_BINDING + 2) readonly buffer ClusterLightIndices_t
+{
+  uint clusterLightIndexCount;
+  uint clusterLightIndices[];
+};
+
+// Offset into clusterLightIndices and the number of lights affecting the fragment
+uvec2 light_cluster_range(vec2 frag_coord, vec3 w_pos)
+{
+  const float depth = max(dot(lightGrid.viewDepthRow, vec4(w_pos, 1.0f)), 1e-4f);
+  const uvec2 tile = min(
+    uvec2(frag_coord * lightGrid.pixelToTile), uvec2(LIGHT_CLUSTERS_X - 1, LIGHT_CLUSTERS_Y - 1));
+  const int slice = clamp(
+    int(floor(log(depth) * lightGrid.sliceScale + lightGrid.sliceBias)), 0, LIGHT_CLUSTERS_Z - 1);
+  return lightClusterRanges[tile.x + LIGHT_CLUSTERS_X * (tile.y + LIGHT_CLUSTERS_Y * slice)];
+}
+
+#endif // CLUSTERED_LIGHTS_GLSL_INCLUDED
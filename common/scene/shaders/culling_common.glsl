@@ -0,0 +1,57 @@
+#ifndef CULLING_COMMON_GLSL_INCLUDED
+#define CULLING_COMMON_GLSL_INCLUDED
+
+// GLSL mirrors of the unified scene buffers created by SceneManager
+
+struct Mesh
+{
+  uint firstRelem;
+  uint relemCount;
+};
+
+struct Bounds
+{
+  vec4 minPos;
+  vec4 maxPos;
+};
+
+// Same layout as VkDrawIndexedIndirectCommand
+struct DrawCommand
+{
+  uint indexCount;
+  uint instanceCount;
+  uint firstIndex;
+  int vertexOffset;
+  uint firstInstance;
+};
+
+// Conservative test: a box is rejected only when all of its corners
+// lie outside of the same clip plane
+bool is_box_visible(mat4 mvp, vec3 min_pos, vec3 max_pos)
+{
+  uint outside[6] = uint[6](0u, 0u, 0u, 0u, 0u, 0u);
+
+  for (uint i = 0u; i < 8u; ++i)
+  {
+    const vec3 corner = vec3(
+      (i & 1u) == 0u ? min_pos.x : max_pos.x,
+      (i & 2u) == 0u ? min_pos.y : max_pos.y,
+      (i & 4u) == 0u ? min_pos.z : max_pos.z);
+    const vec4 clip = mvp * vec4(corner, 1.0);
+
+    outside[0] += clip.x < -clip.w ? 1u : 0u;
+    outside[1] += clip.x > clip.w ? 1u : 0u;
+    outside[2] += clip.y < -clip.w ? 1u : 0u;
+    outside[3] += clip.y > clip.w ? 1u : 0u;
+    outside[4] += clip.z < 0.0 ? 1u : 0u;
+    outside[5] += clip.z > clip.w ? 1u : 0u;
+  }
+
+  for (uint plane = 0u; plane < 6u; ++plane)
+    if (outside[plane] == 8u)
+      return false;
+
+  return true;
+}
+
+#endif // CULLING_COMMON_GLSL_INCLUDED
@@ -0,0 +1,38 @@
+#ifndef LIGHT_CLUSTERS_H_INCLUDED
+#define LIGHT_CLUSTERS_H_INCLUDED
+
+#include "cpp_glsl_compat.h"
+
+
+// Screen tiles times exponential depth slices between the camera's near and far planes
+#define LIGHT_CLUSTERS_X 16
+#define LIGHT_CLUSTERS_Y 9
+#define LIGHT_CLUSTERS_Z 24
+#define LIGHT_CLUSTER_COUNT (LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z)
+
+// Lights beyond this are dropped from a cluster
+#define MAX_LIGHTS_PER_CLUSTER 128
+// Size of the compacted index list shared by all clusters
+#define LIGHT_INDEX_CAPACITY (LIGHT_CLUSTER_COUNT * 64)
+
+#define LIGHT_CLUSTERS_GROUP_SIZE 128
+
+struct PointLight
+{
+  shader_vec3 position;
+  shader_float radius;
+  shader_vec3 color;
+  shader_float intensity;
+};
+
+// Written by the culling pass, maps a fragment to its cluster
+struct LightClusterGrid
+{
+  // Dot with a world position gives its view space depth
+  shader_vec4 viewDepthRow;
+  shader_vec2 pixelToTile;
+  shader_float sliceScale;
+  shader_float sliceBias;
+};
+
+#endif // LIGHT_CLUSTERS_H_INCLUDED
@@ -1,45 +1,83 @@
 #include "App.hpp"
 
+#include <spdlog/spdlog.h>
 #include <tracy/Tracy.hpp>
 
 #include "gui/ImGuiRenderer.hpp"
 
 
-App::App()
+// Same distance and height as the initial camera
+static constexpr float BENCHMARK_ORBIT_RADIUS = 10.0f;
+static constexpr float BENCHMARK_ORBIT_HEIGHT = 10.0f;
+static constexpr float BENCHMARK_ORBIT_DURATION = 20.0f;
+
+static constexpr float CAMERA_RECORDING_INTERVAL = 0.1f;
+static constexpr const char* DEFAULT_CAMERA_PATH = "camera_path.txt";
+
+App::App(RunOptions app_options)
+  : options{app_options}
+  , fixedStep{
+      app_options,
+      FixedStepRunner::Hooks{
+        .poll =
+          [this]() {
+            if (!windowing)
+              return true;
+            windowing->poll();
+            return !mainWindow->isBeingClosed();
+          },
+        .draw = [this]() { drawFrame(); },
+        .isReady = [this]() { return renderer->arePipelinesReady(); },
+        .reportMetrics =
+          [this](BenchmarkRecorder& recorder) { renderer->reportFrameMetrics(recorder); },
+      }}
 {
-  glm::uvec2 initialRes = {1280, 720};
-  mainWindow = windowing.createWindow(
-    OsWindow::CreateInfo{
-      .resolution = initialRes,
-      .resizeable = true,
-      .refreshCb =
-        [this]() {
-          // NOTE: this is only called when the window is being resized.
-          drawFrame();
-          FrameMark;
-        },
-      .resizeCb =
-        [this](glm::uvec2 res) {
-          if (res.x == 0 || res.y == 0)
-            return;
-
-          renderer->recreateSwapchain(res);
-        },
-    });
+  if (!options.headless)
+  {
+    windowing = std::make_unique<OsWindowingManager>();
+    mainWindow = windowing->createWindow(
+      OsWindow::CreateInfo{
+        .resolution = options.resolution,
+        .resizeable = true,
+        .refreshCb =
+          [this]() {
+            // NOTE: this is only called when the window is being resized.
+            drawFrame();
+            FrameMark;
+          },
+        .resizeCb =
+          [this](glm::uvec2 res) {
+            if (res.x == 0 || res.y == 0)
+              return;
+
+            renderer->recreateSwapchain(res);
+          },
+      });
+  }
 
-  renderer.reset(new Renderer(initialRes));
+  renderer.reset(new Renderer(options.resolution, options.headless));
 
-  auto instExts = windowing.getRequiredVulkanInstanceExtensions();
-  renderer->initVulkan(instExts);
+  if (options.headless)
+  {
+    // Nothing is presented to a window system, so the instance needs no extensions for it
+    renderer->initVulkan({});
+    renderer->initFrameDelivery({}, [res = options.resolution]() { return res; });
+  }
+  else
+  {
+    auto instExts = windowing->getRequiredVulkanInstanceExtensions();
+    renderer->initVulkan(instExts);
 
-  auto surface = mainWindow->createVkSurface(etna::get_context().getInstance());
+    auto surface = mainWindow->createVkSurface(etna::get_context().getInstance());
 
-  renderer->initFrameDelivery(
-    std::move(surface), [window = mainWindow.get()]() { return window->getResolution(); });
+    renderer->initFrameDelivery(
+      std::move(surface), [window = mainWindow.get()]() { return window->getResolution(); });
 
-  // TODO: this is bad design, this initialization is dependent on the current ImGui context, but we
-  // pass it implicitly here instead of explicitly. Beware if trying to do something tricky.
-  ImGuiRenderer::enableImGuiForWindow(mainWindow->native());
+    // TODO: this is bad design, this initialization is dependent on the current ImGui context,
+    // but we pass it implicitly here instead of explicitly. Beware if trying to do something
+    // tricky.
+    ImGuiRenderer::enableImGuiForWindow(mainWindow->native());
+  }
 
   shadowCam.lookAt({-8, 10, 8}, {0, 0, 0}, {0, 1, 0});
   mainCam.lookAt({0, 10, 10}, {0, 0, 0}, {0, 1, 0});
@@ -47,16 +85,25 @@ App::App()
   renderer->loadScene(GRAPHICS_COURSE_RESOURCES_ROOT "/scenes/low_poly_dark_town/scene.gltf");
 }
 
-void App::run()
+bool App::run()
 {
-  double lastTime = windowing.getTime();
+  if (options.benchmark)
+    return runBenchmark();
+
+  if (options.headless)
+  {
+    fixedStep.runHeadless();
+    return true;
+  }
+
+  double lastTime = windowing->getTime();
   while (!mainWindow->isBeingClosed())
   {
-    const double currTime = windowing.getTime();
+    const double currTime = windowing->getTime();
     const float diffTime = static_cast<float>(currTime - lastTime);
     lastTime = currTime;
 
-    windowing.poll();
+    windowing->poll();
 
     processInput(diffTime);
 
@@ -64,6 +111,26 @@ void App::run()
 
     FrameMark;
   }
+
+  return true;
+}
+
+bool App::runBenchmark()
+{
+  const auto path = options.cameraPath.empty()
+    ? std::optional{CameraPath::orbit(
+        {0, 0, 0}, BENCHMARK_ORBIT_RADIUS, BENCHMARK_ORBIT_HEIGHT, BENCHMARK_ORBIT_DURATION)}
+    : CameraPath::load(options.cameraPath);
+  if (!path)
+    return false;
+
+  return fixedStep.runBenchmark(
+    path->getDuration(), [&](float time) { path->apply(time, mainCam); });
+}
+
+double App::getTime() const
+{
+  return windowing && !options.benchmark ? windowing->getTime() : fixedStep.getTime();
 }
 
 void App::processInput(float dt)
@@ -90,9 +157,72 @@ void App::processInput(float dt)
   if (mainWindow->captureMouse)
     rotateCam(camToControl, mainWindow->mouse, dt);
 
+  if (mainWindow->keyboard[KeyboardKey::kC] == ButtonState::Falling)
+    toggleCameraRecording();
+  if (mainWindow->keyboard[KeyboardKey::kP] == ButtonState::Falling)
+    toggleCameraPlayback();
+  updateCameraPath(dt);
+
   renderer->debugInput(mainWindow->keyboard);
 }
 
+void App::toggleCameraRecording()
+{
+  if (cameraPlayback)
+    return;
+
+  if (!cameraRecorder)
+  {
+    cameraRecorder.emplace(CAMERA_RECORDING_INTERVAL);
+    spdlog::info("Recording the camera path, press C again to stop");
+    return;
+  }
+
+  const auto path = cameraRecorder->finish();
+  cameraRecorder.reset();
+
+  const auto file = options.cameraPath.empty() ? DEFAULT_CAMERA_PATH : options.cameraPath;
+  if (path.save(file))
+    spdlog::info(
+      "Saved {} camera keyframes over {:.1f} s to {}",
+      path.getKeyframeCount(),
+      path.getDuration(),
+      file.string());
+}
+
+void App::toggleCameraPlayback()
+{
+  if (cameraRecorder)
+    return;
+
+  if (cameraPlayback)
+  {
+    cameraPlayback.reset();
+    return;
+  }
+
+  cameraPlayback =
+    CameraPath::load(options.cameraPath.empty() ? DEFAULT_CAMERA_PATH : options.cameraPath);
+  cameraPlaybackTime = 0;
+}
+
+void App::updateCameraPath(float dt)
+{
+  if (cameraRecorder)
+    cameraRecorder->update(dt, mainCam);
+
+  if (!cameraPlayback)
+    return;
+
+  cameraPlayback->apply(cameraPlaybackTime, mainCam);
+  cameraPlaybackTime += dt;
+  if (cameraPlaybackTime > cameraPlayback->getDuration())
+  {
+    spdlog::info("Camera path playback finished");
+    cameraPlayback.reset();
+  }
+}
+
 void App::drawFrame()
 {
   ZoneScoped;
@@ -101,7 +231,7 @@ void App::drawFrame()
     FramePacket{
       .mainCam = mainCam,
       .shadowCam = shadowCam,
-      .currentTime = static_cast<float>(windowing.getTime()),
+      .currentTime = static_cast<float>(getTime()),
     });
   renderer->drawFrame();
 }
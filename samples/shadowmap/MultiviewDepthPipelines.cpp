@@ -0,0 +1,146 @@
+#include "MultiviewDepthPipelines.hpp"
+
+#include <array>
+#include <fstream>
+
+#include <etna/GlobalContext.hpp>
+#include <etna/Etna.hpp>
+#include <glm/glm.hpp>
+#include <tracy/Tracy.hpp>
+
+
+static std::vector<std::uint32_t> read_spirv(const std::string& path)
+{
+  std::ifstream file(path, std::ios::binary | std::ios::ate);
+  ETNA_VERIFYF(file.is_open(), "Unable to open shader {}", path);
+
+  std::vector<std::uint32_t> code(static_cast<std::size_t>(file.tellg()) / sizeof(std::uint32_t));
+  file.seekg(0);
+  file.read(
+    reinterpret_cast<char*>(code.data()),
+    static_cast<std::streamsize>(code.size() * sizeof(std::uint32_t)));
+  return code;
+}
+
+MultiviewDepthPipelines::MultiviewDepthPipelines(CreateInfo create_info)
+  : info{std::move(create_info)}
+{
+  auto& ctx = etna::get_context();
+
+  const auto setLayout = ctx.getDescriptorSetLayouts().getVkLayout(
+    etna::get_shader_program(info.programName.c_str()).getDescriptorLayoutId(0));
+  // Scene drawing code always pushes a projView matrix, multiview shaders may ignore it
+  const vk::PushConstantRange pushConstants{
+    .stageFlags = vk::ShaderStageFlagBits::eVertex,
+    .offset = 0,
+    .size = sizeof(glm::mat4x4),
+  };
+
+  layout = etna::unwrap_vk_result(ctx.getDevice().createPipelineLayoutUnique(
+    vk::PipelineLayoutCreateInfo{
+      .setLayoutCount = 1,
+      .pSetLayouts = &setLayout,
+      .pushConstantRangeCount = 1,
+      .pPushConstantRanges = &pushConstants,
+    }));
+}
+
+vk::Pipeline MultiviewDepthPipelines::get(std::uint32_t view_mask)
+{
+  auto& pipeline = pipelines[view_mask];
+  if (!pipeline)
+    pipeline = createPipeline(view_mask);
+  return pipeline.get();
+}
+
+vk::UniquePipeline MultiviewDepthPipelines::createPipeline(std::uint32_t view_mask)
+{
+  ZoneScoped;
+
+  auto device = etna::get_context().getDevice();
+
+  if (!shaderModule)
+  {
+    const auto code = read_spirv(info.vertexShaderPath);
+    shaderModule = etna::unwrap_vk_result(device.createShaderModuleUnique(
+      vk::ShaderModuleCreateInfo{
+        .codeSize = code.size() * sizeof(std::uint32_t),
+        .pCode = code.data(),
+      }));
+  }
+
+  const vk::PipelineShaderStageCreateInfo stage{
+    .stage = vk::ShaderStageFlagBits::eVertex,
+    .module = shaderModule.get(),
+    .pName = "main",
+  };
+
+  const vk::VertexInputBindingDescription vertexBinding{
+    .binding = 0,
+    .stride = static_cast<std::uint32_t>(info.vertexFormat.stride),
+    .inputRate = vk::VertexInputRate::eVertex,
+  };
+  std::vector<vk::VertexInputAttributeDescription> vertexAttributes;
+  for (std::uint32_t location = 0; location < info.vertexFormat.attributes.size(); ++location)
+    vertexAttributes.push_back(
+      vk::VertexInputAttributeDescription{
+        .location = location,
+        .binding = 0,
+        .format = info.vertexFormat.attributes[location].format,
+        .offset = static_cast<std::uint32_t>(info.vertexFormat.attributes[location].offset),
+      });
+
+  const vk::PipelineVertexInputStateCreateInfo vertexInput{
+    .vertexBindingDescriptionCount = 1,
+    .pVertexBindingDescriptions = &vertexBinding,
+    .vertexAttributeDescriptionCount = static_cast<std::uint32_t>(vertexAttributes.size()),
+    .pVertexAttributeDescriptions = vertexAttributes.data(),
+  };
+  const vk::PipelineInputAssemblyStateCreateInfo inputAssembly{
+    .topology = vk::PrimitiveTopology::eTriangleList,
+  };
+  const vk::PipelineViewportStateCreateInfo viewport{
+    .viewportCount = 1,
+    .scissorCount = 1,
+  };
+  const vk::PipelineRasterizationStateCreateInfo rasterization{
+    .polygonMode = vk::PolygonMode::eFill,
+    .cullMode = vk::CullModeFlagBits::eBack,
+    .frontFace = vk::FrontFace::eCounterClockwise,
+    .lineWidth = 1.f,
+  };
+  const vk::PipelineMultisampleStateCreateInfo multisample{
+    .rasterizationSamples = vk::SampleCountFlagBits::e1,
+  };
+  const vk::PipelineDepthStencilStateCreateInfo depthStencil{
+    .depthTestEnable = vk::True,
+    .depthWriteEnable = vk::True,
+    .depthCompareOp = vk::CompareOp::eLessOrEqual,
+  };
+  const std::array dynamicStates{vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+  const vk::PipelineDynamicStateCreateInfo dynamicState{
+    .dynamicStateCount = static_cast<std::uint32_t>(dynamicStates.size()),
+    .pDynamicStates = dynamicStates.data(),
+  };
+  const vk::PipelineRenderingCreateInfo rendering{
+    .viewMask = view_mask,
+    .depthAttachmentFormat = info.depthAttachmentFormat,
+  };
+
+  const vk::GraphicsPipelineCreateInfo pipelineInfo{
+    .pNext = &rendering,
+    .stageCount = 1,
+    .pStages = &stage,
+    .pVertexInputState = &vertexInput,
+    .pInputAssemblyState = &inputAssembly,
+    .pViewportState = &viewport,
+    .pRasterizationState = &rasterization,
+    .pMultisampleState = &multisample,
+    .pDepthStencilState = &depthStencil,
+    .pDynamicState = &dynamicState,
+    .layout = layout.get(),
+  };
+  return info.pipelineCache->create([&](vk::PipelineCache cache) {
+    return etna::unwrap_vk_result(device.createGraphicsPipelineUnique(cache, pipelineInfo));
+  });
+}
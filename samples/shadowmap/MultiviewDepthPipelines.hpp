@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+#include <etna/Vulkan.hpp>
+#include <etna/VertexInput.hpp>
+
+#include "render_utils/PipelineCache.hpp"
+
+
+/**
+ * Depth-only pipelines of a single vertex shader that render to several layers at once
+ * with VK_KHR_multiview. etna's graphics pipelines have no view mask, so these are created
+ * directly. The view mask of a pipeline has to match the one of the pass it is used in,
+ * so a pipeline is created lazily for every combination of views that gets rendered.
+ * The descriptor set layout comes from the etna program of the same shader.
+ */
+class MultiviewDepthPipelines
+{
+public:
+  struct CreateInfo
+  {
+    std::string programName;
+    std::string vertexShaderPath;
+    etna::VertexByteStreamFormatDescription vertexFormat;
+    vk::Format depthAttachmentFormat = vk::Format::eUndefined;
+    PipelineCache* pipelineCache = nullptr;
+  };
+
+  explicit MultiviewDepthPipelines(CreateInfo info);
+
+  vk::PipelineLayout getLayout() const { return layout.get(); }
+  vk::Pipeline get(std::uint32_t view_mask);
+
+  MultiviewDepthPipelines(const MultiviewDepthPipelines&) = delete;
+  MultiviewDepthPipelines& operator=(const MultiviewDepthPipelines&) = delete;
+
+private:
+  vk::UniquePipeline createPipeline(std::uint32_t view_mask);
+
+private:
+  CreateInfo info;
+  vk::UniquePipelineLayout layout;
+  vk::UniqueShaderModule shaderModule;
+  std::unordered_map<std::uint32_t, vk::UniquePipeline> pipelines;
+};
@@ -8,10 +8,12 @@
 #include <imgui.h>
 
 #include <gui/ImGuiRenderer.hpp>
+#include <render_utils/PipelineCache.hpp>
 
 
-Renderer::Renderer(glm::uvec2 res)
-  : resolution{res}
+Renderer::Renderer(glm::uvec2 res, bool headless_rendering)
+  : headless{headless_rendering}
+  , resolution{res}
 {
 }
 
@@ -24,7 +26,24 @@ void Renderer::initVulkan(std::span<const char*> instance_extensions)
 
   std::vector<const char*> deviceExtensions;
 
-  deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+  if (!headless)
+    deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+  // The scene's bindless set, see SceneManager::getBindlessSet
+  vk::PhysicalDeviceVulkan12Features vulkan12Features{
+    .descriptorIndexing = vk::True,
+    .shaderSampledImageArrayNonUniformIndexing = vk::True,
+    .descriptorBindingSampledImageUpdateAfterBind = vk::True,
+    .descriptorBindingStorageBufferUpdateAfterBind = vk::True,
+    .descriptorBindingPartiallyBound = vk::True,
+  };
+
+  // Single-pass shadow cascades, gl_DrawID is used for per-view culling of indirect draws
+  vk::PhysicalDeviceVulkan11Features vulkan11Features{
+    .pNext = &vulkan12Features,
+    .multiview = vk::True,
+    .shaderDrawParameters = vk::True,
+  };
 
   etna::initialize(
     etna::InitParams{
@@ -32,7 +51,15 @@ void Renderer::initVulkan(std::span<const char*> instance_extensions)
       .applicationVersion = VK_MAKE_VERSION(0, 1, 0),
       .instanceExtensions = instanceExtensions,
       .deviceExtensions = deviceExtensions,
-      .features = vk::PhysicalDeviceFeatures2{.features = {}},
+      // Indirect draws over all relems of the scene at once, each with its own firstInstance
+      .features = vk::PhysicalDeviceFeatures2{
+        .pNext = &vulkan11Features,
+        .features =
+          {
+            .multiDrawIndirect = vk::True,
+            .drawIndirectFirstInstance = vk::True,
+            .pipelineStatisticsQuery = vk::True,
+          }},
       // Replace with an index if etna detects your preferred GPU incorrectly
       .physicalDeviceIndexOverride = {},
       // How much frames we buffer on the GPU without waiting for their completion on the CPU
@@ -44,28 +71,47 @@ void Renderer::initFrameDelivery(vk::UniqueSurfaceKHR a_surface, ResolutionProvi
 {
   auto& ctx = etna::get_context();
 
+  ETNA_VERIFY(headless == !a_surface);
+
   resolutionProvider = std::move(res_provider);
   commandManager = ctx.createPerFrameCmdMgr();
 
-  window = ctx.createWindow(
-    etna::Window::CreateInfo{
-      .surface = std::move(a_surface),
-    });
+  if (headless)
+    offscreenFrames =
+      std::make_unique<OffscreenFrames>(OffscreenFrames::CreateInfo{.resolution = resolution});
+  else
+  {
+    window = ctx.createWindow(
+      etna::Window::CreateInfo{
+        .surface = std::move(a_surface),
+      });
+
+    auto [w, h] = window->recreateSwapchain(
+      etna::Window::DesiredProperties{
+        .resolution = {resolution.x, resolution.y},
+        .vsync = true,
+      });
+    resolution = {w, h};
+  }
+  const vk::Format targetFormat =
+    window ? window->getCurrentFormat() : offscreenFrames->getCurrentFormat();
 
-  auto [w, h] = window->recreateSwapchain(
-    etna::Window::DesiredProperties{
-      .resolution = {resolution.x, resolution.y},
-      .vsync = true,
-    });
-  resolution = {w, h};
+  // Has to be loaded before any pipelines are created to have an effect on them
+  pipelineCache = std::make_unique<PipelineCache>(SHADOWMAP_PIPELINE_CACHE_DIR);
 
-  worldRenderer = std::make_unique<WorldRenderer>();
+  {
+    // Culling, light clustering and the debug quad create their pipelines through etna
+    const auto etnaPipelines = pipelineCache->scopeEtnaPipelines();
 
-  worldRenderer->allocateResources(resolution);
-  worldRenderer->loadShaders();
-  worldRenderer->setupPipelines(window->getCurrentFormat());
+    worldRenderer = std::make_unique<WorldRenderer>(*pipelineCache, offscreenFrames.get());
+
+    worldRenderer->allocateResources(resolution);
+    worldRenderer->loadShaders();
+    worldRenderer->setupPipelines(targetFormat);
+  }
 
-  guiRenderer = std::make_unique<ImGuiRenderer>(window->getCurrentFormat());
+  if (!headless)
+    guiRenderer = std::make_unique<ImGuiRenderer>(targetFormat, pipelineCache->get());
 }
 
 void Renderer::recreateSwapchain(glm::uvec2 res)
@@ -85,6 +131,7 @@ void Renderer::recreateSwapchain(glm::uvec2 res)
   worldRenderer->allocateResources(resolution);
 
   // Format of the swapchain CAN change on android
+  const auto etnaPipelines = pipelineCache->scopeEtnaPipelines();
   worldRenderer->setupPipelines(window->getCurrentFormat());
 }
 
@@ -96,21 +143,6 @@ void Renderer::loadScene(std::filesystem::path path)
 void Renderer::debugInput(const Keyboard& kb)
 {
   worldRenderer->debugInput(kb);
-
-  if (kb[KeyboardKey::kB] == ButtonState::Falling)
-  {
-    const int retval = std::system(
-      "cd " GRAPHICS_COURSE_ROOT "/build"
-      " && cmake --build . --target shadowmap_shaders");
-    if (retval != 0)
-      spdlog::warn("Shader recompilation returned a non-zero return code!");
-    else
-    {
-      ETNA_CHECK_VK_RESULT(etna::get_context().getDevice().waitIdle());
-      etna::reload_shaders();
-      spdlog::info("Successfully reloaded shaders!");
-    }
-  }
 }
 
 void Renderer::update(const FramePacket& packet)
@@ -122,6 +154,15 @@ void Renderer::drawFrame()
 {
   ZoneScoped;
 
+  // Pipelines are compiled while the scene loads and the first frames are drawn
+  if (!pipelineCacheReported && worldRenderer->arePipelinesReady())
+  {
+    pipelineCache->logCreationStats();
+    pipelineCache->save();
+    pipelineCacheReported = true;
+  }
+
+  if (guiRenderer)
   {
     ZoneScopedN("drawGui");
     guiRenderer->nextFrame();
@@ -136,7 +177,7 @@ void Renderer::drawFrame()
   // it doesn't actually begin anything, just resets descriptor pools
   etna::begin_frame();
 
-  auto nextSwapchainImage = window->acquireNext();
+  auto nextSwapchainImage = acquireTargetImage();
 
   // NOTE: here, we skip frames when the window is in the process of being
   // re-sized. This is not mandatory, it is possible to submit frames to a
@@ -152,19 +193,24 @@ void Renderer::drawFrame()
 
       worldRenderer->renderWorld(currentCmdBuf, image, view);
 
+      if (guiRenderer)
       {
         ImDrawData* pDrawData = ImGui::GetDrawData();
+        auto& gpuTimer = worldRenderer->getGpuTimer();
+        const auto timerScope = gpuTimer.beginScope(currentCmdBuf, "GUI");
         guiRenderer->render(
           currentCmdBuf, {{0, 0}, {resolution.x, resolution.y}}, image, view, pDrawData);
+        gpuTimer.endScope(currentCmdBuf, timerScope);
       }
 
-      etna::set_state(
-        currentCmdBuf,
-        image,
-        vk::PipelineStageFlagBits2::eColorAttachmentOutput,
-        {},
-        vk::ImageLayout::ePresentSrcKHR,
-        vk::ImageAspectFlagBits::eColor);
+      if (window)
+        etna::set_state(
+          currentCmdBuf,
+          image,
+          vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+          {},
+          vk::ImageLayout::ePresentSrcKHR,
+          vk::ImageAspectFlagBits::eColor);
 
       etna::flush_barriers(currentCmdBuf);
 
@@ -175,7 +221,7 @@ void Renderer::drawFrame()
     auto renderingDone = commandManager->submit(
       std::move(currentCmdBuf), std::move(availableSem), std::move(readyForPresentSem));
 
-    const bool presented = window->present(std::move(renderingDone), view);
+    const bool presented = presentTargetImage(std::move(renderingDone), view);
 
     if (!presented)
       nextSwapchainImage = std::nullopt;
@@ -193,6 +239,41 @@ void Renderer::drawFrame()
   }
 }
 
+bool Renderer::arePipelinesReady() const
+{
+  return worldRenderer->arePipelinesReady();
+}
+
+void Renderer::reportFrameMetrics(BenchmarkRecorder& recorder) const
+{
+  worldRenderer->reportFrameMetrics(recorder);
+}
+
+std::optional<OffscreenFrames::Frame> Renderer::acquireTargetImage()
+{
+  if (offscreenFrames)
+    return offscreenFrames->acquireNext();
+
+  auto swapchainImage = window->acquireNext();
+  if (!swapchainImage)
+    return std::nullopt;
+
+  auto [image, view, availableSem, readyForPresentSem] = *swapchainImage;
+  return OffscreenFrames::Frame{
+    .image = image,
+    .view = view,
+    .available = availableSem,
+    .readyForPresent = readyForPresentSem,
+  };
+}
+
+bool Renderer::presentTargetImage(vk::Semaphore rendering_done, vk::ImageView view)
+{
+  if (offscreenFrames)
+    return offscreenFrames->present(rendering_done, view);
+  return window->present(rendering_done, view);
+}
+
 Renderer::~Renderer()
 {
   ETNA_CHECK_VK_RESULT(etna::get_context().getDevice().waitIdle());
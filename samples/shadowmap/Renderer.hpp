@@ -5,6 +5,7 @@
 #include <glm/glm.hpp>
 #include <function2/function2.hpp>
 
+#include "render_utils/OffscreenFrames.hpp"
 #include "wsi/Keyboard.hpp"
 
 #include "FramePacket.hpp"
@@ -12,6 +13,7 @@
 
 
 class ImGuiRenderer;
+class PipelineCache;
 
 using ResolutionProvider = fu2::unique_function<glm::uvec2() const>;
 
@@ -22,11 +24,13 @@ using ResolutionProvider = fu2::unique_function<glm::uvec2() const>;
 class Renderer
 {
 public:
-  explicit Renderer(glm::uvec2 resolution);
+  // Headless renderers draw into offscreen images instead of a window and have no GUI
+  explicit Renderer(glm::uvec2 resolution, bool headless = false);
   ~Renderer();
 
   // Initializing all of rendering is a tricky multi-step dance
   void initVulkan(std::span<const char*> instance_extensions);
+  // The surface is null for headless renderers
   void initFrameDelivery(vk::UniqueSurfaceKHR surface, ResolutionProvider res_provider);
   void recreateSwapchain(glm::uvec2 res);
   void loadScene(std::filesystem::path path);
@@ -35,11 +39,23 @@ public:
   void update(const FramePacket& packet);
   void drawFrame();
 
+  bool arePipelinesReady() const;
+  void reportFrameMetrics(BenchmarkRecorder& recorder) const;
 
 private:
+  // Swapchain images are converted to the offscreen frame type, they have the same fields
+  std::optional<OffscreenFrames::Frame> acquireTargetImage();
+  bool presentTargetImage(vk::Semaphore rendering_done, vk::ImageView view);
+
+private:
+  bool headless;
   ResolutionProvider resolutionProvider;
+  // Exactly one of them delivers frames
   std::unique_ptr<etna::Window> window;
+  std::unique_ptr<OffscreenFrames> offscreenFrames;
   std::unique_ptr<etna::PerFrameCmdMgr> commandManager;
+  std::unique_ptr<PipelineCache> pipelineCache;
+  bool pipelineCacheReported = false;
 
   glm::uvec2 resolution;
   std::unique_ptr<ImGuiRenderer> guiRenderer;
@@ -1,118 +1,834 @@
 #include "WorldRenderer.hpp"
 
 #include <etna/GlobalContext.hpp>
-#include <etna/PipelineManager.hpp>
 #include <etna/RenderTargetStates.hpp>
 #include <etna/Profiling.hpp>
 #include <glm/ext.hpp>
 #include <imgui.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <utility>
 
+#include "render_utils/Utilities.hpp"
 
-WorldRenderer::WorldRenderer()
+
+// Small chunks are dominated by binding overhead, large ones balance poorly
+static constexpr std::size_t MIN_INSTANCES_PER_CHUNK = 64;
+static constexpr std::size_t CHUNKS_PER_THREAD = 4;
+
+static constexpr std::uint32_t MAX_POINT_LIGHTS = 8192;
+
+static_assert(SHADOW_CASCADE_COUNT <= 32, "cascade masks are stored as 32-bit words");
+// A cached cascade is re-rendered once the light direction changes by about half a degree
+static constexpr float CASCADE_CACHE_MIN_ROTATION_COS = 0.99999f;
+// Cascade timings, plus whatever else ends up being measured
+static constexpr std::uint32_t MAX_GPU_TIMER_SCOPES = 16;
+// Main view passes of both occlusion culling phases and every shadow cascade
+static constexpr std::uint32_t MAX_PIPELINE_STATISTICS_SCOPES = 16;
+
+// Jobs only lock etna to look up a layout, drivers compile pipelines in parallel. Half of the
+// cores are left to the render thread and the driver's own threads.
+static std::uint32_t pipeline_compiler_threads()
+{
+  return std::max(1u, std::thread::hardware_concurrency() / 2);
+}
+
+// Values of a PipelineStatistics result are in the order of the flag bits
+static constexpr vk::QueryPipelineStatisticFlags PIPELINE_STATISTICS =
+  vk::QueryPipelineStatisticFlagBits::eVertexShaderInvocations |
+  vk::QueryPipelineStatisticFlagBits::eClippingPrimitives |
+  vk::QueryPipelineStatisticFlagBits::eFragmentShaderInvocations;
+static constexpr std::size_t VERTEX_INVOCATIONS_STAT = 0;
+static constexpr std::size_t CLIPPING_PRIMITIVES_STAT = 1;
+static constexpr std::size_t FRAGMENT_INVOCATIONS_STAT = 2;
+static constexpr std::array<const char*, 3> PIPELINE_STATISTIC_NAMES{
+  "vertex invocations", "clipping primitives", "fragment invocations"};
+
+// Names of the GPU timer and pipeline statistics scopes of the main view
+static constexpr std::string_view DEPTH_PREPASS_SCOPE = "Depth prepass";
+static constexpr std::string_view FORWARD_SCOPE = "Forward";
+static constexpr std::string_view GBUFFER_SCOPE = "G-buffer";
+static constexpr std::string_view DEFERRED_LIGHTING_SCOPE = "Deferred lighting";
+static constexpr std::string_view DEFERRED_RESOLVE_SCOPE = "Deferred resolve";
+static constexpr std::string_view LIGHT_CLUSTERS_SCOPE = "Light clusters";
+
+static constexpr vk::Format GBUFFER_NORMAL_FORMAT = vk::Format::eR16G16Snorm;
+static constexpr vk::Format GBUFFER_ALBEDO_FORMAT = vk::Format::eR8G8B8A8Unorm;
+static constexpr vk::Format GBUFFER_MATERIAL_FORMAT = vk::Format::eR8G8Unorm;
+static constexpr vk::Format DEFERRED_COLOR_FORMAT = vk::Format::eR16G16B16A16Sfloat;
+static constexpr std::uint32_t DEFERRED_LIGHTING_GROUP_SIZE = 8;
+
+// Attachment bytes a pass touches per fragment, ignoring framebuffer compression and caches.
+// Forward: color write, depth read and write. G-buffer: three targets and depth read and write.
+// Lighting reads the G-buffer and depth, writes the color and blits it: per pixel, not fragment.
+static constexpr double FORWARD_BYTES_PER_FRAGMENT = 4 + 4 + 4;
+static constexpr double DEPTH_PREPASS_BYTES_PER_FRAGMENT = 4 + 4;
+static constexpr double GBUFFER_BYTES_PER_FRAGMENT = 4 + 4 + 2 + 4 + 4;
+static constexpr double DEFERRED_LIGHTING_BYTES_PER_PIXEL = 4 + 4 + 2 + 4 + 8 + 8 + 4;
+
+static constexpr vk::Rect2D SHADOW_CASCADE_RECT{
+  {0, 0}, {SHADOW_CASCADE_RESOLUTION, SHADOW_CASCADE_RESOLUTION}};
+
+struct ProgramShaders
+{
+  std::string_view name;
+  // Binaries in SHADOWMAP_SHADERS_ROOT, the second one is empty for single stage programs
+  std::array<std::string_view, 2> shaders;
+};
+
+static constexpr std::array SHADER_PROGRAMS{
+  ProgramShaders{"simple_material", {"simple_shadow.frag.spv", "simple.vert.spv"}},
+  ProgramShaders{"simple_shadow", {"simple.vert.spv"}},
+  ProgramShaders{"depth_only", {"depth_only.vert.spv"}},
+  ProgramShaders{
+    "simple_material_indirect", {"simple_shadow.frag.spv", "simple_indirect.vert.spv"}},
+  ProgramShaders{"simple_shadow_indirect", {"simple_indirect.vert.spv"}},
+  ProgramShaders{"depth_only_indirect", {"depth_only_indirect.vert.spv"}},
+  ProgramShaders{"gbuffer", {"gbuffer.frag.spv", "simple.vert.spv"}},
+  ProgramShaders{"gbuffer_indirect", {"gbuffer.frag.spv", "simple_indirect.vert.spv"}},
+  ProgramShaders{"deferred_lighting", {"deferred_lighting.comp.spv"}},
+  ProgramShaders{"depth_multiview", {"depth_multiview.vert.spv"}},
+  ProgramShaders{"depth_multiview_indirect", {"depth_multiview_indirect.vert.spv"}},
+};
+
+static std::string shader_path(std::string_view shader)
+{
+  return std::string(SHADOWMAP_SHADERS_ROOT) + std::string(shader);
+}
+
+// Binaries a program is currently built from, the hot reloaded ones replace the build tree's
+static std::vector<std::filesystem::path> program_shaders(
+  const ShaderHotReloader& reloader, std::string_view name)
+{
+  const auto program = std::ranges::find(SHADER_PROGRAMS, name, &ProgramShaders::name);
+  ETNA_VERIFYF(program != SHADER_PROGRAMS.end(), "Unknown program {}", name);
+
+  std::vector<std::filesystem::path> result;
+  for (const auto shader : program->shaders)
+    if (!shader.empty())
+      result.push_back(reloader.resolve(shader_path(shader)));
+  return result;
+}
+
+static void create_program(
+  const ShaderHotReloader& reloader, const std::string& name, const ProgramShaders& program)
+{
+  const auto shaders = program_shaders(reloader, program.name);
+  if (shaders.size() == 1)
+    etna::create_program(name.c_str(), {shaders[0]});
+  else
+    etna::create_program(name.c_str(), {shaders[0], shaders[1]});
+}
+
+static vk::UniqueImageView create_depth_view(
+  vk::Image image,
+  vk::Format format,
+  vk::ImageViewType type,
+  std::uint32_t base_layer,
+  std::uint32_t layer_count)
+{
+  return etna::unwrap_vk_result(etna::get_context().getDevice().createImageViewUnique(
+    vk::ImageViewCreateInfo{
+      .image = image,
+      .viewType = type,
+      .format = format,
+      .subresourceRange =
+        {
+          .aspectMask = vk::ImageAspectFlagBits::eDepth,
+          .baseMipLevel = 0,
+          .levelCount = 1,
+          .baseArrayLayer = base_layer,
+          .layerCount = layer_count,
+        },
+    }));
+}
+
+static void set_viewport_and_scissor(vk::CommandBuffer cmd_buf, vk::Rect2D rect)
+{
+  cmd_buf.setViewport(
+    0,
+    {vk::Viewport{
+      .x = static_cast<float>(rect.offset.x),
+      .y = static_cast<float>(rect.offset.y),
+      .width = static_cast<float>(rect.extent.width),
+      .height = static_cast<float>(rect.extent.height),
+      .minDepth = 0.0f,
+      .maxDepth = 1.0f,
+    }});
+  cmd_buf.setScissor(0, {rect});
+}
+
+// The radius only depends on the slice shape, so it stays the same while the camera turns
+static std::pair<glm::vec3, float> frustum_slice_bounding_sphere(
+  const Camera& cam, float aspect, float near_dist, float far_dist)
+{
+  const float tanHalfFov = std::tan(glm::radians(cam.fov) * 0.5f);
+
+  std::array<glm::vec3, 8> corners;
+  std::size_t cornerIdx = 0;
+  for (const float dist : {near_dist, far_dist})
+  {
+    const glm::vec3 center = cam.position + cam.forward() * dist;
+    const glm::vec3 right = cam.right() * (dist * tanHalfFov * aspect);
+    const glm::vec3 up = cam.up() * (dist * tanHalfFov);
+    corners[cornerIdx++] = center - right - up;
+    corners[cornerIdx++] = center + right - up;
+    corners[cornerIdx++] = center - right + up;
+    corners[cornerIdx++] = center + right + up;
+  }
+
+  const glm::vec3 center =
+    std::accumulate(corners.begin(), corners.end(), glm::vec3{0.0f}) / float(corners.size());
+  float radius = 0;
+  for (const auto& corner : corners)
+    radius = std::max(radius, glm::distance(center, corner));
+
+  // Rounding hides float noise, which would otherwise change the texel size every frame
+  return {center, std::ceil(radius * 16.0f) / 16.0f};
+}
+
+static bool is_main_view_scope(std::string_view name)
+{
+  return name == DEPTH_PREPASS_SCOPE || name == FORWARD_SCOPE || name == GBUFFER_SCOPE ||
+    name == DEFERRED_LIGHTING_SCOPE || name == DEFERRED_RESOLVE_SCOPE;
+}
+
+static double attachment_bytes_per_fragment(std::string_view scope)
+{
+  if (scope == FORWARD_SCOPE)
+    return FORWARD_BYTES_PER_FRAGMENT;
+  if (scope == DEPTH_PREPASS_SCOPE)
+    return DEPTH_PREPASS_BYTES_PER_FRAGMENT;
+  if (scope == GBUFFER_SCOPE)
+    return GBUFFER_BYTES_PER_FRAGMENT;
+  return 0;
+}
+
+// Scales the whole source color image onto the whole destination one,
+// both have to be in the transfer layouts already
+static void record_blit(
+  vk::CommandBuffer cmd_buf, vk::Image src, glm::uvec2 src_size, vk::Image dst, glm::uvec2 dst_size)
+{
+  const auto corner = [](glm::uvec2 size) {
+    return vk::Offset3D{static_cast<std::int32_t>(size.x), static_cast<std::int32_t>(size.y), 1};
+  };
+  const vk::ImageSubresourceLayers layers{
+    .aspectMask = vk::ImageAspectFlagBits::eColor,
+    .mipLevel = 0,
+    .baseArrayLayer = 0,
+    .layerCount = 1,
+  };
+  cmd_buf.blitImage(
+    src,
+    vk::ImageLayout::eTransferSrcOptimal,
+    dst,
+    vk::ImageLayout::eTransferDstOptimal,
+    {vk::ImageBlit{
+      .srcSubresource = layers,
+      .srcOffsets = std::array{vk::Offset3D{0, 0, 0}, corner(src_size)},
+      .dstSubresource = layers,
+      .dstOffsets = std::array{vk::Offset3D{0, 0, 0}, corner(dst_size)},
+    }},
+    vk::Filter::eLinear);
+}
+
+static void blit_color_image(
+  vk::CommandBuffer cmd_buf, vk::Image src, glm::uvec2 src_size, vk::Image dst, glm::uvec2 dst_size)
+{
+  etna::set_state(
+    cmd_buf,
+    src,
+    vk::PipelineStageFlagBits2::eBlit,
+    vk::AccessFlagBits2::eTransferRead,
+    vk::ImageLayout::eTransferSrcOptimal,
+    vk::ImageAspectFlagBits::eColor);
+  etna::set_state(
+    cmd_buf,
+    dst,
+    vk::PipelineStageFlagBits2::eBlit,
+    vk::AccessFlagBits2::eTransferWrite,
+    vk::ImageLayout::eTransferDstOptimal,
+    vk::ImageAspectFlagBits::eColor);
+  etna::flush_barriers(cmd_buf);
+
+  record_blit(cmd_buf, src, src_size, dst, dst_size);
+}
+
+// Frame constants, a model matrix and a cascade mask per instance, each allocated separately
+static constexpr vk::DeviceSize FRAME_DATA_ALLOCATIONS = 3;
+
+static vk::DeviceSize frame_data_capacity(std::size_t instance_count)
+{
+  // Empty scenes still allocate a single matrix and mask
+  const auto drawCount = std::max<std::size_t>(instance_count, 1);
+  return sizeof(UniformParams) + drawCount * (sizeof(glm::mat4x4) + sizeof(std::uint32_t)) +
+    FRAME_DATA_ALLOCATIONS * (FrameRingBuffer::getOffsetAlignment() - 1);
+}
+
+WorldRenderer::WorldRenderer(
+  PipelineCache& pipeline_cache, const OffscreenFrames* offscreen_frames)
   : sceneMgr{std::make_unique<SceneManager>()}
+  , descriptorSets{std::make_unique<DescriptorSetCache>()}
+  , sceneCuller{std::make_unique<SceneCuller>(*sceneMgr, *descriptorSets)}
+  , lightClusters{std::make_unique<LightClusters>(MAX_POINT_LIGHTS)}
+  , renderGraph{std::make_unique<RenderGraph>()}
+  , frameData{std::make_unique<FrameRingBuffer>(FrameRingBuffer::CreateInfo{
+      .frameCapacity = frame_data_capacity(0),
+      .name = "frame_data",
+    })}
+  , gpuTimer{std::make_unique<GpuTimer>(MAX_GPU_TIMER_SCOPES)}
+  , pipelineStats{
+      std::make_unique<PipelineStatistics>(MAX_PIPELINE_STATISTICS_SCOPES, PIPELINE_STATISTICS)}
+  , offscreenFrames{offscreen_frames}
+  , pipelineCache{&pipeline_cache}
+  , retiredResources{std::make_unique<DeferredDeletionQueue>()}
+  , pipelineCompiler{
+      std::make_unique<PipelineCompiler>(pipeline_compiler_threads(), pipeline_cache)}
+  , commandRecorder{
+      std::make_unique<ParallelCommandRecorder>(static_cast<std::uint32_t>(recordingThreadCount))}
 {
 }
 
 void WorldRenderer::allocateResources(glm::uvec2 swapchain_resolution)
 {
-  resolution = swapchain_resolution;
+  targetResolution = swapchain_resolution;
+  allocateRenderTargets(benchmarkResolution.value_or(swapchain_resolution));
 
   auto& ctx = etna::get_context();
 
-  mainViewDepth = ctx.createImage(
-    etna::Image::CreateInfo{
-      .extent = vk::Extent3D{resolution.x, resolution.y, 1},
-      .name = "main_view_depth",
-      .format = vk::Format::eD32Sfloat,
-      .imageUsage = vk::ImageUsageFlagBits::eDepthStencilAttachment,
-    });
+  shadowMapArrayView.reset();
+  for (auto& view : shadowMapLayerViews)
+    view.reset();
 
   shadowMap = ctx.createImage(
     etna::Image::CreateInfo{
-      .extent = vk::Extent3D{2048, 2048, 1},
+      .extent = vk::Extent3D{SHADOW_CASCADE_RESOLUTION, SHADOW_CASCADE_RESOLUTION, 1},
       .name = "shadow_map",
       .format = vk::Format::eD16Unorm,
       .imageUsage =
         vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled,
+      .layers = SHADOW_CASCADE_COUNT,
     });
 
+  // etna creates 2D views only, so the array and per-layer views are made here
+  shadowMapArrayView = create_depth_view(
+    shadowMap.get(), vk::Format::eD16Unorm, vk::ImageViewType::e2DArray, 0, SHADOW_CASCADE_COUNT);
+  for (std::uint32_t layer = 0; layer < SHADOW_CASCADE_COUNT; ++layer)
+    shadowMapLayerViews[layer] = create_depth_view(
+      shadowMap.get(), vk::Format::eD16Unorm, vk::ImageViewType::e2D, layer, 1);
+
   defaultSampler = etna::Sampler(etna::Sampler::CreateInfo{.name = "default_sampler"});
-  constants = ctx.createBuffer(
-    etna::Buffer::CreateInfo{
-      .size = sizeof(UniformParams),
-      .bufferUsage = vk::BufferUsageFlagBits::eUniformBuffer,
-      .memoryUsage = VMA_MEMORY_USAGE_CPU_ONLY,
-      .name = "constants",
+
+  // Cached sets reference the images that were just recreated
+  descriptorSets->invalidate();
+  for (auto& cascade : cascades)
+    cascade.needsRender = true;
+}
+
+void WorldRenderer::allocateRenderTargets(glm::uvec2 render_resolution)
+{
+  resolution = render_resolution;
+
+  auto& ctx = etna::get_context();
+
+  // Frames in flight may still render to the old targets
+  retiredResources->push(std::move(mainViewDepth));
+  retiredResources->push(std::move(offscreenTarget));
+
+  mainViewDepth = ctx.createImage(
+    etna::Image::CreateInfo{
+      .extent = vk::Extent3D{resolution.x, resolution.y, 1},
+      .name = "main_view_depth",
+      .format = vk::Format::eD32Sfloat,
+      .imageUsage =
+        vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled,
     });
 
-  constants.map();
+  sceneCuller->allocateResources(resolution);
+
+  offscreenTarget = {};
+  if (resolution != targetResolution)
+    offscreenTarget = ctx.createImage(
+      etna::Image::CreateInfo{
+        .extent = vk::Extent3D{resolution.x, resolution.y, 1},
+        .name = "offscreen_target",
+        .format = targetFormat,
+        .imageUsage = vk::ImageUsageFlagBits::eColorAttachment |
+          vk::ImageUsageFlagBits::eTransferSrc | vk::ImageUsageFlagBits::eTransferDst,
+      });
+
+  descriptorSets->invalidate();
 }
 
 void WorldRenderer::loadScene(std::filesystem::path path)
 {
   sceneMgr->selectScene(path);
+
+  // Scenes are loaded before any frame is in flight, so the old buffer can go right away
+  frameData = std::make_unique<FrameRingBuffer>(FrameRingBuffer::CreateInfo{
+    .frameCapacity = frame_data_capacity(sceneMgr->getInstanceMatrices().size()),
+    .name = "frame_data",
+  });
+  descriptorSets->invalidate();
+
+  auto instanceMatrices = sceneMgr->getInstanceMatrices();
+  auto instanceMeshes = sceneMgr->getInstanceMeshes();
+  auto meshes = sceneMgr->getMeshes();
+  auto bounds = sceneMgr->getRenderElementsBounds();
+
+  instanceSpheres.clear();
+  instanceSpheres.reserve(instanceMeshes.size());
+  for (std::size_t instIdx = 0; instIdx < instanceMeshes.size(); ++instIdx)
+  {
+    const auto& mesh = meshes[instanceMeshes[instIdx]];
+    if (mesh.relemCount == 0)
+    {
+      instanceSpheres.emplace_back(0.0f);
+      continue;
+    }
+
+    glm::vec3 minPos{std::numeric_limits<float>::max()};
+    glm::vec3 maxPos{std::numeric_limits<float>::lowest()};
+    for (std::uint32_t relemIdx = mesh.firstRelem; relemIdx < mesh.firstRelem + mesh.relemCount;
+         ++relemIdx)
+    {
+      const auto& relemBounds = bounds[relemIdx];
+      for (std::uint32_t corner = 0; corner < 8; ++corner)
+      {
+        const glm::vec3 local{
+          corner & 1 ? relemBounds.maxPos.x : relemBounds.minPos.x,
+          corner & 2 ? relemBounds.maxPos.y : relemBounds.minPos.y,
+          corner & 4 ? relemBounds.maxPos.z : relemBounds.minPos.z};
+        const auto world = glm::vec3(instanceMatrices[instIdx] * glm::vec4(local, 1.0f));
+        minPos = glm::min(minPos, world);
+        maxPos = glm::max(maxPos, world);
+      }
+    }
+
+    instanceSpheres.emplace_back((minPos + maxPos) * 0.5f, glm::distance(minPos, maxPos) * 0.5f);
+  }
+
+  allInstances.resize(instanceMeshes.size());
+  std::iota(allInstances.begin(), allInstances.end(), 0u);
+
+  // Point lights are scattered over the scene bounds, the seed is fixed so that
+  // light benchmarks are comparable between runs
+  {
+    glm::vec3 sceneMin{std::numeric_limits<float>::max()};
+    glm::vec3 sceneMax{std::numeric_limits<float>::lowest()};
+    for (const auto& sphere : instanceSpheres)
+      if (sphere.w > 0)
+      {
+        sceneMin = glm::min(sceneMin, glm::vec3(sphere) - sphere.w);
+        sceneMax = glm::max(sceneMax, glm::vec3(sphere) + sphere.w);
+      }
+    if (sceneMin.x > sceneMax.x)
+      sceneMin = sceneMax = glm::vec3{0.0f};
+
+    const float sceneSize = std::max(glm::distance(sceneMin, sceneMax), 1.0f);
+
+    // Argument evaluation order is unspecified, so every value is drawn in its own statement
+    std::mt19937 rng{42};
+    std::uniform_real_distribution<float> unit{0.0f, 1.0f};
+    const auto randomVec3 = [&]() {
+      glm::vec3 result;
+      for (int i = 0; i < 3; ++i)
+        result[i] = unit(rng);
+      return result;
+    };
+
+    pointLightOrigins.resize(MAX_POINT_LIGHTS);
+    pointLights.resize(MAX_POINT_LIGHTS);
+    for (std::uint32_t i = 0; i < MAX_POINT_LIGHTS; ++i)
+    {
+      const glm::vec3 position = glm::mix(sceneMin, sceneMax, randomVec3());
+      const float phase = unit(rng) * glm::two_pi<float>();
+      const float radius = sceneSize * glm::mix(0.01f, 0.03f, unit(rng));
+      pointLightOrigins[i] = glm::vec4(position, phase);
+      pointLights[i] = PointLight{
+        .position = position,
+        .radius = radius,
+        .color = glm::mix(glm::vec3{0.2f}, glm::vec3{1.0f}, randomVec3()),
+        .intensity = 0.5f,
+      };
+    }
+  }
+
+  for (auto& cascade : cascades)
+    cascade.needsRender = true;
+
+  updateMemoryReport();
+  memoryReport.log();
 }
 
 void WorldRenderer::loadShaders()
 {
-  etna::create_program(
-    "simple_material",
-    {SHADOWMAP_SHADERS_ROOT "simple_shadow.frag.spv", SHADOWMAP_SHADERS_ROOT "simple.vert.spv"});
-  etna::create_program("simple_shadow", {SHADOWMAP_SHADERS_ROOT "simple.vert.spv"});
+  std::vector<std::filesystem::path> binaries;
+  for (const auto& program : SHADER_PROGRAMS)
+    for (const auto shader : program.shaders)
+      if (!shader.empty())
+        binaries.push_back(shader_path(shader));
+
+  // Several programs share shaders, every binary is watched once
+  std::ranges::sort(binaries);
+  binaries.erase(std::ranges::unique(binaries).begin(), binaries.end());
+  shaderReloader =
+    std::make_unique<ShaderHotReloader>(std::move(binaries), SHADOWMAP_RELOADED_SHADERS_DIR);
+
+  for (const auto& program : SHADER_PROGRAMS)
+  {
+    auto& name = programNames[std::string(program.name)];
+    name = program.name;
+    create_program(*shaderReloader, name, program);
+  }
+
+  shaderVariants = std::make_unique<ShaderVariants>(SHADOWMAP_SHADER_VARIANTS_DIR);
 }
 
 void WorldRenderer::setupPipelines(vk::Format swapchain_format)
 {
+  targetFormat = swapchain_format;
+
   quadRenderer = std::make_unique<QuadRenderer>(QuadRenderer::CreateInfo{
     .format = swapchain_format,
     .rect = {{0, 0}, {512, 512}},
   });
 
-  etna::VertexShaderInputDescription sceneVertexInputDesc{
-    .bindings = {etna::VertexShaderInputDescription::Binding{
-      .byteStreamDescription = sceneMgr->getVertexFormatDescription(),
-    }},
+  const auto sceneVertexFormat = sceneMgr->getVertexFormatDescription();
+  const auto positionVertexFormat = sceneMgr->getPositionFormatDescription();
+
+  const vk::PipelineRasterizationStateCreateInfo backFaceCulling{
+    .polygonMode = vk::PolygonMode::eFill,
+    .cullMode = vk::CullModeFlagBits::eBack,
+    .frontFace = vk::FrontFace::eCounterClockwise,
+    .lineWidth = 1.f,
   };
 
+  // Shading reads materials and textures from the scene's bindless set
+  const std::vector materialSetLayouts{sceneMgr->getBindlessLayout()};
 
-  auto& pipelineManager = etna::get_context().getPipelineManager();
+  // Pipelines are created in the order they are submitted, the ones every frame needs go first
+  graphicsPipelines.clear();
+  graphicsPipelines.push_back(GraphicsPipelineDesc{
+    .pipeline = &basicForwardPipeline,
+    .program = "simple_material",
+    .info =
+      CompiledPipeline::GraphicsCreateInfo{
+        .vertexFormat = sceneVertexFormat,
+        .rasterization = backFaceCulling,
+        .colorAttachmentFormats = {swapchain_format},
+        .depthAttachmentFormat = vk::Format::eD32Sfloat,
+        .extraSetLayouts = materialSetLayouts,
+      },
+  });
 
-  basicForwardPipeline = {};
-  basicForwardPipeline = pipelineManager.createGraphicsPipeline(
-    "simple_material",
-    etna::GraphicsPipeline::CreateInfo{
-      .vertexShaderInput = sceneVertexInputDesc,
-      .rasterizationConfig =
-        vk::PipelineRasterizationStateCreateInfo{
-          .polygonMode = vk::PolygonMode::eFill,
-          .cullMode = vk::CullModeFlagBits::eBack,
-          .frontFace = vk::FrontFace::eCounterClockwise,
-          .lineWidth = 1.f,
-        },
-      .fragmentShaderOutput =
-        {
-          .colorAttachmentFormats = {swapchain_format},
-          .depthAttachmentFormat = vk::Format::eD32Sfloat,
-        },
-    });
+  graphicsPipelines.push_back(GraphicsPipelineDesc{
+    .pipeline = &shadowPipeline,
+    .program = "depth_only",
+    .info =
+      CompiledPipeline::GraphicsCreateInfo{
+        .vertexFormat = positionVertexFormat,
+        .rasterization = backFaceCulling,
+        .depthAttachmentFormat = vk::Format::eD16Unorm,
+      },
+  });
 
-  shadowPipeline = {};
-  shadowPipeline = pipelineManager.createGraphicsPipeline(
-    "simple_shadow",
-    etna::GraphicsPipeline::CreateInfo{
-      .vertexShaderInput = sceneVertexInputDesc,
-      .rasterizationConfig =
-        vk::PipelineRasterizationStateCreateInfo{
-          .polygonMode = vk::PolygonMode::eFill,
-          .cullMode = vk::CullModeFlagBits::eBack,
-          .frontFace = vk::FrontFace::eCounterClockwise,
-          .lineWidth = 1.f,
-        },
-      .fragmentShaderOutput =
-        {
-          .depthAttachmentFormat = vk::Format::eD16Unorm,
-        },
+  graphicsPipelines.push_back(GraphicsPipelineDesc{
+    .pipeline = &fullVertexShadowPipeline,
+    .program = "simple_shadow",
+    .info =
+      CompiledPipeline::GraphicsCreateInfo{
+        .vertexFormat = sceneVertexFormat,
+        .rasterization = backFaceCulling,
+        .depthAttachmentFormat = vk::Format::eD16Unorm,
+      },
+  });
+
+  graphicsPipelines.push_back(GraphicsPipelineDesc{
+    .pipeline = &gpuDrivenForwardPipeline,
+    .program = "simple_material_indirect",
+    .info =
+      CompiledPipeline::GraphicsCreateInfo{
+        .vertexFormat = sceneVertexFormat,
+        .rasterization = backFaceCulling,
+        .colorAttachmentFormats = {swapchain_format},
+        .depthAttachmentFormat = vk::Format::eD32Sfloat,
+        .extraSetLayouts = materialSetLayouts,
+      },
+  });
+
+  graphicsPipelines.push_back(GraphicsPipelineDesc{
+    .pipeline = &gpuDrivenShadowPipeline,
+    .program = "depth_only_indirect",
+    .info =
+      CompiledPipeline::GraphicsCreateInfo{
+        .vertexFormat = positionVertexFormat,
+        .rasterization = backFaceCulling,
+        .depthAttachmentFormat = vk::Format::eD16Unorm,
+      },
+  });
+
+  graphicsPipelines.push_back(GraphicsPipelineDesc{
+    .pipeline = &gpuDrivenFullVertexShadowPipeline,
+    .program = "simple_shadow_indirect",
+    .info =
+      CompiledPipeline::GraphicsCreateInfo{
+        .vertexFormat = sceneVertexFormat,
+        .rasterization = backFaceCulling,
+        .depthAttachmentFormat = vk::Format::eD16Unorm,
+      },
+  });
+
+  graphicsPipelines.push_back(GraphicsPipelineDesc{
+    .pipeline = &depthPrepassPipeline,
+    .program = "depth_only",
+    .info =
+      CompiledPipeline::GraphicsCreateInfo{
+        .vertexFormat = positionVertexFormat,
+        .rasterization = backFaceCulling,
+        .depthAttachmentFormat = vk::Format::eD32Sfloat,
+      },
+  });
+
+  graphicsPipelines.push_back(GraphicsPipelineDesc{
+    .pipeline = &gpuDrivenDepthPrepassPipeline,
+    .program = "depth_only_indirect",
+    .info =
+      CompiledPipeline::GraphicsCreateInfo{
+        .vertexFormat = positionVertexFormat,
+        .rasterization = backFaceCulling,
+        .depthAttachmentFormat = vk::Format::eD32Sfloat,
+      },
+  });
+
+  // Depth is already final, only the fragments that won the prepass pass the test
+  const vk::PipelineDepthStencilStateCreateInfo equalDepthConfig{
+    .depthTestEnable = vk::True,
+    .depthWriteEnable = vk::False,
+    .depthCompareOp = vk::CompareOp::eEqual,
+    .maxDepthBounds = 1.f,
+  };
+
+  graphicsPipelines.push_back(GraphicsPipelineDesc{
+    .pipeline = &forwardAfterPrepassPipeline,
+    .program = "simple_material",
+    .info =
+      CompiledPipeline::GraphicsCreateInfo{
+        .vertexFormat = sceneVertexFormat,
+        .rasterization = backFaceCulling,
+        .depth = equalDepthConfig,
+        .colorAttachmentFormats = {swapchain_format},
+        .depthAttachmentFormat = vk::Format::eD32Sfloat,
+        .extraSetLayouts = materialSetLayouts,
+      },
+  });
+
+  graphicsPipelines.push_back(GraphicsPipelineDesc{
+    .pipeline = &gpuDrivenForwardAfterPrepassPipeline,
+    .program = "simple_material_indirect",
+    .info =
+      CompiledPipeline::GraphicsCreateInfo{
+        .vertexFormat = sceneVertexFormat,
+        .rasterization = backFaceCulling,
+        .depth = equalDepthConfig,
+        .colorAttachmentFormats = {swapchain_format},
+        .depthAttachmentFormat = vk::Format::eD32Sfloat,
+        .extraSetLayouts = materialSetLayouts,
+      },
+  });
+
+  graphicsPipelines.push_back(GraphicsPipelineDesc{
+    .pipeline = &gbufferPipeline,
+    .program = "gbuffer",
+    .info =
+      CompiledPipeline::GraphicsCreateInfo{
+        .vertexFormat = sceneVertexFormat,
+        .rasterization = backFaceCulling,
+        .colorAttachmentFormats =
+          {GBUFFER_NORMAL_FORMAT, GBUFFER_ALBEDO_FORMAT, GBUFFER_MATERIAL_FORMAT},
+        .depthAttachmentFormat = vk::Format::eD32Sfloat,
+        .extraSetLayouts = materialSetLayouts,
+      },
+  });
+
+  graphicsPipelines.push_back(GraphicsPipelineDesc{
+    .pipeline = &gpuDrivenGbufferPipeline,
+    .program = "gbuffer_indirect",
+    .info =
+      CompiledPipeline::GraphicsCreateInfo{
+        .vertexFormat = sceneVertexFormat,
+        .rasterization = backFaceCulling,
+        .colorAttachmentFormats =
+          {GBUFFER_NORMAL_FORMAT, GBUFFER_ALBEDO_FORMAT, GBUFFER_MATERIAL_FORMAT},
+        .depthAttachmentFormat = vk::Format::eD32Sfloat,
+        .extraSetLayouts = materialSetLayouts,
+      },
+  });
+
+  submitPipelines([](std::string_view) { return true; });
+}
+
+void WorldRenderer::submitPipelines(fu2::function_view<bool(std::string_view)> affected)
+{
+  // Replaced pipelines are retired below, nothing may be creating them concurrently
+  pipelineCompiler->waitIdle();
+
+  // Variants are specialized again from the new binaries once they are used
+  for (const auto& program : SHADER_PROGRAMS)
+    if (affected(program.name))
+      shaderVariants->invalidate(program.name);
+  std::erase_if(graphicsVariants, [&](auto& variant) {
+    const auto desc =
+      std::ranges::find(graphicsPipelines, variant.first.first, &GraphicsPipelineDesc::pipeline);
+    if (desc != graphicsPipelines.end() && !affected(desc->program))
+      return false;
+    retiredResources->push(std::move(variant.second));
+    return true;
+  });
+
+  auto* compiler = pipelineCompiler.get();
+  for (auto& desc : graphicsPipelines)
+  {
+    if (!affected(desc.program))
+      continue;
+
+    retiredResources->push(std::move(*desc.pipeline));
+    *desc.pipeline = compiler->submitGraphics(
+      programName(desc.program), program_shaders(*shaderReloader, desc.program), desc.info);
+  }
+
+  if (affected("deferred_lighting"))
+  {
+    retiredResources->push(std::move(deferredLightingVariants));
+    deferredLightingVariants.clear();
+    retiredResources->push(std::move(deferredLightingPipeline));
+    deferredLightingPipeline = compiler->submitCompute(
+      programName("deferred_lighting"), program_shaders(*shaderReloader, "deferred_lighting")[0]);
+  }
+
+  if (affected("depth_multiview"))
+  {
+    retiredResources->push(std::move(multiviewShadowPipelines));
+    multiviewShadowPipelines = std::make_unique<MultiviewDepthPipelines>(
+      MultiviewDepthPipelines::CreateInfo{
+        .programName = programName("depth_multiview"),
+        .vertexShaderPath = program_shaders(*shaderReloader, "depth_multiview")[0].string(),
+        .vertexFormat = sceneMgr->getPositionFormatDescription(),
+        .depthAttachmentFormat = vk::Format::eD16Unorm,
+        .pipelineCache = pipelineCache,
+      });
+  }
+  if (affected("depth_multiview_indirect"))
+  {
+    retiredResources->push(std::move(gpuDrivenMultiviewShadowPipelines));
+    gpuDrivenMultiviewShadowPipelines = std::make_unique<MultiviewDepthPipelines>(
+      MultiviewDepthPipelines::CreateInfo{
+        .programName = programName("depth_multiview_indirect"),
+        .vertexShaderPath =
+          program_shaders(*shaderReloader, "depth_multiview_indirect")[0].string(),
+        .vertexFormat = sceneMgr->getPositionFormatDescription(),
+        .depthAttachmentFormat = vk::Format::eD16Unorm,
+        .pipelineCache = pipelineCache,
+      });
+  }
+}
+
+void WorldRenderer::reloadChangedShaders()
+{
+  const auto recompiled = shaderReloader->takeRecompiled();
+  if (recompiled.empty())
+    return;
+
+  ZoneScoped;
+
+  // Jobs read the programs that are about to be replaced
+  pipelineCompiler->waitIdle();
+
+  // etna can't replace a program, so the changed ones are created again under a new name
+  std::vector<std::string_view> changedPrograms;
+  for (const auto& program : SHADER_PROGRAMS)
+  {
+    const bool changed = std::ranges::any_of(program.shaders, [&](std::string_view shader) {
+      return !shader.empty() &&
+        std::ranges::find(recompiled, std::filesystem::path(shader_path(shader))) !=
+        recompiled.end();
     });
+    if (!changed)
+      continue;
+
+    auto& name = programNames.find(program.name)->second;
+    name = fmt::format("{}#{}", program.name, ++programVersion);
+    create_program(*shaderReloader, name, program);
+    changedPrograms.push_back(program.name);
+  }
+
+  spdlog::info("Rebuilding the pipelines of {} changed programs", changedPrograms.size());
+  submitPipelines([&changedPrograms](std::string_view program) {
+    return std::ranges::find(changedPrograms, program) != changedPrograms.end();
+  });
+}
+
+WorldRenderer::ShadingConstants WorldRenderer::shadingConstants() const
+{
+  ShadingConstants constants{};
+  constants[SHADOW_FILTER_CONSTANT_ID] = uniformParams.shadowFilter;
+  constants[VISUALIZE_CASCADES_CONSTANT_ID] = uniformParams.visualizeCascades;
+  return constants;
+}
+
+CompiledPipeline& WorldRenderer::specialized(AsyncPipeline<CompiledPipeline>& generic)
+{
+  auto& fallback = generic.get();
+  if (!useSpecializedShaders)
+    return fallback;
+
+  auto [variant, inserted] = graphicsVariants.try_emplace(std::pair{&generic, shadingConstants()});
+  if (inserted)
+  {
+    const auto desc =
+      std::ranges::find(graphicsPipelines, &generic, &GraphicsPipelineDesc::pipeline);
+    const auto lock = pipelineCompiler->lockEtna();
+    const auto& program = shaderVariants->getProgram(
+      desc->program, program_shaders(*shaderReloader, desc->program), variant->first.second);
+    variant->second =
+      pipelineCompiler->submitGraphics(program.program, program.shaders, desc->info);
+  }
+
+  return variant->second.isReady() ? variant->second.get() : fallback;
+}
+
+CompiledPipeline& WorldRenderer::specializedDeferredLighting()
+{
+  auto& fallback = deferredLightingPipeline.get();
+  if (!useSpecializedShaders)
+    return fallback;
+
+  auto [variant, inserted] = deferredLightingVariants.try_emplace(shadingConstants());
+  if (inserted)
+  {
+    const auto lock = pipelineCompiler->lockEtna();
+    const auto& program = shaderVariants->getProgram(
+      "deferred_lighting", program_shaders(*shaderReloader, "deferred_lighting"), variant->first);
+    variant->second = pipelineCompiler->submitCompute(program.program, program.shaders[0]);
+  }
+
+  return variant->second.isReady() ? variant->second.get() : fallback;
+}
+
+const char* WorldRenderer::programName(std::string_view program) const
+{
+  const auto it = programNames.find(program);
+  ETNA_VERIFYF(it != programNames.end(), "Unknown program {}", program);
+  return it->second.c_str();
 }
 
 void WorldRenderer::debugInput(const Keyboard& kb)
@@ -120,8 +836,8 @@ void WorldRenderer::debugInput(const Keyboard& kb)
   if (kb[KeyboardKey::kQ] == ButtonState::Falling)
     drawDebugFSQuad = !drawDebugFSQuad;
 
-  if (kb[KeyboardKey::kP] == ButtonState::Falling)
-    lightProps.usePerspectiveM = !lightProps.usePerspectiveM;
+  if (kb[KeyboardKey::kB] == ButtonState::Falling)
+    shaderReloader->rescan();
 }
 
 void WorldRenderer::update(const FramePacket& packet)
@@ -132,129 +848,1530 @@ void WorldRenderer::update(const FramePacket& packet)
   {
     const float aspect = float(resolution.x) / float(resolution.y);
     worldViewProj = packet.mainCam.projTm(aspect) * packet.mainCam.viewTm();
+    uniformParams.invProjView = glm::inverse(worldViewProj);
+    uniformParams.cameraPos = packet.mainCam.position;
+
+    mainViewTm = packet.mainCam.viewTm();
+    mainProjTm = packet.mainCam.projTm(aspect);
+    mainZNear = packet.mainCam.zNear;
+    mainZFar = packet.mainCam.zFar;
   }
 
-  // calc light matrix
+  // Lights bob up and down by half of their radius
+  const auto lightCount = std::min<std::size_t>(pointLightCount, pointLights.size());
+  for (std::size_t i = 0; i < lightCount; ++i)
   {
-    const auto mProj = lightProps.usePerspectiveM
-      ? glm::perspectiveLH_ZO(
-          -glm::radians(packet.shadowCam.fov), 1.0f, 1.0f, lightProps.lightTargetDist * 2.0f)
-      : glm::orthoLH_ZO(
-          +lightProps.radius,
-          -lightProps.radius,
-          +lightProps.radius,
-          -lightProps.radius,
-          0.0f,
-          lightProps.lightTargetDist);
-
-    lightMatrix = mProj * packet.shadowCam.viewTm();
-
-    lightPos = packet.shadowCam.position;
+    const auto& origin = pointLightOrigins[i];
+    auto& light = pointLights[i];
+    const float offset = 0.5f * light.radius * std::sin(packet.currentTime + origin.w);
+    light.position = glm::vec3(origin) + glm::vec3{0.0f, offset, 0.0f};
   }
 
-  // Upload everything to GPU-mapped memory
+  updateShadowCascades(packet.mainCam, packet.shadowCam);
+  lightPos = packet.shadowCam.position;
+
+  // Uploaded in renderWorld, once the GPU is done with this frame's part of the ring buffer
   {
-    uniformParams.lightMatrix = lightMatrix;
+    for (std::size_t i = 0; i < cascades.size(); ++i)
+      uniformParams.cascadeMatrices[i] = cascades[i].projView;
     uniformParams.lightPos = lightPos;
     uniformParams.time = packet.currentTime;
-
-    std::memcpy(constants.data(), &uniformParams, sizeof(uniformParams));
   }
 }
 
-void WorldRenderer::renderScene(
-  vk::CommandBuffer cmd_buf, const glm::mat4x4& glob_tm, vk::PipelineLayout pipeline_layout)
+void WorldRenderer::updateShadowCascades(const Camera& main_cam, const Camera& light_cam)
 {
-  if (!sceneMgr->getVertexBuffer())
-    return;
-
-  cmd_buf.bindVertexBuffers(0, {sceneMgr->getVertexBuffer()}, {0});
-  cmd_buf.bindIndexBuffer(sceneMgr->getIndexBuffer(), 0, vk::IndexType::eUint32);
-
-  pushConst2M.projView = glob_tm;
-
-  auto instanceMeshes = sceneMgr->getInstanceMeshes();
-  auto instanceMatrices = sceneMgr->getInstanceMatrices();
+  ZoneScoped;
 
-  auto meshes = sceneMgr->getMeshes();
-  auto relems = sceneMgr->getRenderElements();
+  const float aspect = float(resolution.x) / float(resolution.y);
+  const float nearDist = main_cam.zNear;
+  const float farDist = std::min(main_cam.zFar, shadowSettings.shadowDistance);
+  const glm::mat3 toLightSpace = glm::mat3_cast(glm::conjugate(light_cam.rotation));
 
-  for (std::size_t instIdx = 0; instIdx < instanceMeshes.size(); ++instIdx)
+  float splitNear = nearDist;
+  for (std::size_t i = 0; i < cascades.size(); ++i)
   {
-    pushConst2M.model = instanceMatrices[instIdx];
+    auto& cascade = cascades[i];
 
-    cmd_buf.pushConstants<PushConstants>(
-      pipeline_layout, vk::ShaderStageFlagBits::eVertex, 0, {pushConst2M});
+    // Practical split scheme, a blend of logarithmic and uniform splits
+    const float t = static_cast<float>(i + 1) / static_cast<float>(cascades.size());
+    const float splitFar = glm::mix(
+      nearDist + (farDist - nearDist) * t,
+      nearDist * std::pow(farDist / nearDist, t),
+      shadowSettings.splitLambda);
+    const auto [center, radius] =
+      frustum_slice_bounding_sphere(main_cam, aspect, splitNear, splitFar);
+    splitNear = splitFar;
 
-    const auto meshIdx = instanceMeshes[instIdx];
+    // Moving the cascade by whole texels keeps shadow edges from shimmering
+    const float texelSize = 2.0f * radius / static_cast<float>(SHADOW_CASCADE_RESOLUTION);
+    glm::vec3 lightSpaceCenter = toLightSpace * center;
+    lightSpaceCenter.x = std::floor(lightSpaceCenter.x / texelSize) * texelSize;
+    lightSpaceCenter.y = std::floor(lightSpaceCenter.y / texelSize) * texelSize;
 
-    for (std::size_t j = 0; j < meshes[meshIdx].relemCount; ++j)
+    const bool cached = shadowSettings.cacheFarCascades &&
+      i >= static_cast<std::size_t>(shadowSettings.firstCachedCascade);
+    if (cached && !cascade.needsRender)
     {
-      const auto relemIdx = meshes[meshIdx].firstRelem + j;
-      const auto& relem = relems[relemIdx];
-      cmd_buf.drawIndexed(relem.indexCount, 1, relem.indexOffset, relem.vertexOffset, 0);
+      const bool lightTurned = std::abs(glm::dot(cascade.lightRotation, light_cam.rotation)) <
+        CASCADE_CACHE_MIN_ROTATION_COS;
+      const bool cameraMoved = glm::distance(lightSpaceCenter, cascade.center) >
+        shadowSettings.cacheThreshold * radius;
+      // The old matrix stays in use, so the cascade keeps matching what is in the atlas
+      if (!lightTurned && !cameraMoved && radius == cascade.radius)
+        continue;
     }
+
+    cascade.center = lightSpaceCenter;
+    cascade.radius = radius;
+    cascade.zNear = lightSpaceCenter.z - radius - shadowSettings.casterDistance;
+    cascade.zFar = lightSpaceCenter.z + radius;
+    cascade.lightRotation = light_cam.rotation;
+
+    // Both axes are flipped, same as for the main camera projection
+    const auto proj = glm::orthoLH_ZO(
+      lightSpaceCenter.x + radius,
+      lightSpaceCenter.x - radius,
+      lightSpaceCenter.y + radius,
+      lightSpaceCenter.y - radius,
+      cascade.zNear,
+      cascade.zFar);
+    cascade.projView = proj * glm::mat4x4(toLightSpace);
+    cascade.needsRender = true;
   }
 }
 
-void WorldRenderer::renderWorld(
-  vk::CommandBuffer cmd_buf, vk::Image target_image, vk::ImageView target_image_view)
+void WorldRenderer::cullShadowCascade(std::size_t cascade_idx)
 {
-  ETNA_PROFILE_GPU(cmd_buf, renderWorld);
+  ZoneScoped;
 
-  // draw scene to shadowmap
+  auto& cascade = cascades[cascade_idx];
+  const glm::mat3 toLightSpace = glm::mat3_cast(glm::conjugate(cascade.lightRotation));
 
+  auto instanceMeshes = sceneMgr->getInstanceMeshes();
+  auto meshes = sceneMgr->getMeshes();
+
+  cascade.visibleInstances.clear();
+  std::uint64_t culledRelems = 0;
+  for (std::uint32_t instIdx = 0; instIdx < instanceSpheres.size(); ++instIdx)
   {
-    ETNA_PROFILE_GPU(cmd_buf, renderShadowMap);
+    const auto& sphere = instanceSpheres[instIdx];
+    const glm::vec3 center = toLightSpace * glm::vec3(sphere);
 
-    etna::RenderTargetState renderTargets(
-      cmd_buf,
-      {{0, 0}, {2048, 2048}},
-      {},
-      {.image = shadowMap.get(), .view = shadowMap.getView({})});
+    const float maxOffset = cascade.radius + sphere.w;
+    if (
+      std::abs(center.x - cascade.center.x) > maxOffset ||
+      std::abs(center.y - cascade.center.y) > maxOffset || center.z + sphere.w < cascade.zNear ||
+      center.z - sphere.w > cascade.zFar)
+    {
+      culledRelems += meshes[instanceMeshes[instIdx]].relemCount;
+      continue;
+    }
 
-    cmd_buf.bindPipeline(vk::PipelineBindPoint::eGraphics, shadowPipeline.getVkPipeline());
-    renderScene(cmd_buf, lightMatrix, shadowPipeline.getVkPipelineLayout());
+    cascade.visibleInstances.push_back(instIdx);
   }
 
-  // draw final scene to screen
+  renderCounters.add(
+    RenderCounters::Counter::InstancesCulled,
+    instanceSpheres.size() - cascade.visibleInstances.size());
+  renderCounters.add(RenderCounters::Counter::RelemsCulled, culledRelems);
+}
+
+void WorldRenderer::cullShadowCascadesMultiview(std::uint32_t view_mask)
+{
+  ZoneScoped;
 
+  instanceViewMasks.assign(instanceSpheres.size(), 0);
+  for (std::size_t i = 0; i < cascades.size(); ++i)
   {
-    ETNA_PROFILE_GPU(cmd_buf, renderForward);
+    if ((view_mask & (1u << i)) == 0)
+      continue;
+    cullShadowCascade(i);
+    for (const auto instIdx : cascades[i].visibleInstances)
+      instanceViewMasks[instIdx] |= 1u << i;
+  }
 
-    auto simpleMaterialInfo = etna::get_shader_program("simple_material");
+  // Instances are drawn once for all views, the vertex shader drops the views they miss
+  multiviewInstances.clear();
+  for (std::uint32_t instIdx = 0; instIdx < instanceViewMasks.size(); ++instIdx)
+    if (instanceViewMasks[instIdx] != 0)
+      multiviewInstances.push_back(instIdx);
 
-    auto set = etna::create_descriptor_set(
-      simpleMaterialInfo.getDescriptorLayoutId(0),
-      cmd_buf,
-      {etna::Binding{0, constants.genBinding()},
-       etna::Binding{
-         1, shadowMap.genBinding(defaultSampler.get(), vk::ImageLayout::eShaderReadOnlyOptimal)}});
+  drawViewMasks = frameData->allocate(
+    std::max<std::size_t>(instanceViewMasks.size(), 1) * sizeof(std::uint32_t));
+  std::ranges::copy(instanceViewMasks, drawViewMasks.as<std::uint32_t>().begin());
+}
 
-    etna::RenderTargetState renderTargets(
-      cmd_buf,
-      {{0, 0}, {resolution.x, resolution.y}},
-      {{.image = target_image, .view = target_image_view}},
-      {.image = mainViewDepth.get(), .view = mainViewDepth.getView({})});
+glm::mat4x4 WorldRenderer::multiviewCullingMatrix(std::uint32_t view_mask) const
+{
+  // Cascades rendered in the same frame share the light rotation,
+  // so the union of their light space boxes is a box as well
+  glm::vec3 minCorner{std::numeric_limits<float>::max()};
+  glm::vec3 maxCorner{std::numeric_limits<float>::lowest()};
+  glm::quat lightRotation{};
+  for (std::size_t i = 0; i < cascades.size(); ++i)
+  {
+    if ((view_mask & (1u << i)) == 0)
+      continue;
+    const auto& cascade = cascades[i];
+    const glm::vec2 halfExtent{cascade.radius};
+    minCorner =
+      glm::min(minCorner, glm::vec3(glm::vec2(cascade.center) - halfExtent, cascade.zNear));
+    maxCorner =
+      glm::max(maxCorner, glm::vec3(glm::vec2(cascade.center) + halfExtent, cascade.zFar));
+    lightRotation = cascade.lightRotation;
+  }
 
-    cmd_buf.bindPipeline(vk::PipelineBindPoint::eGraphics, basicForwardPipeline.getVkPipeline());
-    cmd_buf.bindDescriptorSets(
-      vk::PipelineBindPoint::eGraphics,
-      basicForwardPipeline.getVkPipelineLayout(),
-      0,
-      {set.getVkSet()},
-      {});
+  const auto proj = glm::orthoLH_ZO(
+    maxCorner.x, minCorner.x, maxCorner.y, minCorner.y, minCorner.z, maxCorner.z);
+  return proj * glm::mat4x4(glm::mat3_cast(glm::conjugate(lightRotation)));
+}
 
-    renderScene(cmd_buf, worldViewProj, basicForwardPipeline.getVkPipelineLayout());
+std::uint32_t WorldRenderer::takeCascadesToRender()
+{
+  std::uint32_t viewMask = 0;
+  for (std::size_t i = 0; i < cascades.size(); ++i)
+  {
+    auto& cascade = cascades[i];
+    cascade.renderedLastFrame = std::exchange(cascade.needsRender, false);
+    if (cascade.renderedLastFrame)
+      viewMask |= 1u << i;
   }
-
-  if (drawDebugFSQuad)
-    quadRenderer->render(cmd_buf, target_image, target_image_view, shadowMap, defaultSampler);
+  return viewMask;
 }
 
-void WorldRenderer::drawGui()
+void WorldRenderer::uploadFrameData()
 {
-  ImGui::Begin("Simple render settings");
+  ZoneScoped;
+
+  frameData->beginFrame();
+
+  frameConstants = frameData->allocate(sizeof(UniformParams));
+  std::memcpy(frameConstants.data.data(), &uniformParams, sizeof(uniformParams));
+
+  // The GPU-driven path reads the static instance buffer instead
+  if (useGpuCulling)
+    return;
+
+  auto instanceMatrices = sceneMgr->getInstanceMatrices();
+  drawMatrices = frameData->allocate(
+    std::max<std::size_t>(instanceMatrices.size(), 1) * sizeof(glm::mat4x4));
+  std::ranges::copy(instanceMatrices, drawMatrices.as<glm::mat4x4>().begin());
+}
+
+etna::ImageBinding WorldRenderer::shadowMapBinding() const
+{
+  return etna::ImageBinding{
+    shadowMap,
+    vk::DescriptorImageInfo{
+      .sampler = defaultSampler.get(),
+      .imageView = shadowMapArrayView.get(),
+      .imageLayout = vk::ImageLayout::eShaderReadOnlyOptimal,
+    },
+  };
+}
+
+vk::DescriptorSet WorldRenderer::getDescriptorSet(
+  vk::CommandBuffer cmd_buf,
+  etna::DescriptorLayoutId layout_id,
+  const std::vector<etna::Binding>& bindings,
+  std::span<const DescriptorSetCache::RawImageBinding> raw_images)
+{
+  descriptorSets->requestStates(cmd_buf, layout_id, bindings);
+  return descriptorSets->get(layout_id, bindings, raw_images);
+}
+
+void WorldRenderer::bindPipeline(
+  vk::CommandBuffer cmd_buf, vk::PipelineBindPoint bind_point, vk::Pipeline pipeline)
+{
+  cmd_buf.bindPipeline(bind_point, pipeline);
+  renderCounters.add(RenderCounters::Counter::PipelineBinds);
+}
+
+void WorldRenderer::renderScene(
+  vk::CommandBuffer cmd_buf,
+  const glm::mat4x4& glob_tm,
+  vk::PipelineLayout pipeline_layout,
+  vk::Buffer vertex_buffer,
+  std::span<const std::uint32_t> instances)
+{
+  if (!vertex_buffer)
+    return;
+
+  cmd_buf.bindVertexBuffers(0, {vertex_buffer}, {0});
+  cmd_buf.bindIndexBuffer(sceneMgr->getIndexBuffer(), 0, vk::IndexType::eUint32);
+
+  // Model matrices are written into the frame data, so only projView is pushed
+  cmd_buf.pushConstants<glm::mat4x4>(
+    pipeline_layout, vk::ShaderStageFlagBits::eVertex, 0, {glob_tm});
+
+  auto instanceMeshes = sceneMgr->getInstanceMeshes();
+
+  auto meshes = sceneMgr->getMeshes();
+  auto relems = sceneMgr->getRenderElements();
+
+  std::uint64_t drawCount = 0;
+  std::uint64_t indexCount = 0;
+  for (const auto instIdx : instances)
+  {
+    const auto meshIdx = instanceMeshes[instIdx];
+
+    // firstInstance is the draw ID the vertex shader uses to fetch the model matrix
+    for (std::size_t j = 0; j < meshes[meshIdx].relemCount; ++j)
+    {
+      const auto relemIdx = meshes[meshIdx].firstRelem + j;
+      const auto& relem = relems[relemIdx];
+      cmd_buf.drawIndexed(
+        relem.indexCount,
+        1,
+        relem.indexOffset,
+        relem.vertexOffset,
+        static_cast<std::uint32_t>(instIdx));
+      ++drawCount;
+      indexCount += relem.indexCount;
+    }
+  }
+
+  renderCounters.add(RenderCounters::Counter::PushConstants);
+  renderCounters.add(RenderCounters::Counter::Draws, drawCount);
+  renderCounters.add(RenderCounters::Counter::Triangles, indexCount / 3);
+  renderCounters.add(RenderCounters::Counter::InstancesVisited, instances.size());
+  renderCounters.add(RenderCounters::Counter::RelemsVisited, drawCount);
+}
+
+void WorldRenderer::renderSceneGpuDriven(
+  vk::CommandBuffer cmd_buf,
+  const glm::mat4x4& glob_tm,
+  vk::PipelineLayout pipeline_layout,
+  vk::Buffer vertex_buffer)
+{
+  if (!vertex_buffer)
+    return;
+
+  // Model matrices are fetched from the instance buffer, so only projView is pushed
+  cmd_buf.pushConstants<glm::mat4x4>(
+    pipeline_layout, vk::ShaderStageFlagBits::eVertex, 0, {glob_tm});
+
+  sceneCuller->drawIndirect(cmd_buf, vertex_buffer);
+
+  renderCounters.add(RenderCounters::Counter::PushConstants);
+  renderCounters.add(RenderCounters::Counter::Draws);
+}
+
+void WorldRenderer::renderForward(
+  vk::CommandBuffer cmd_buf,
+  vk::Image target_image,
+  vk::ImageView target_image_view,
+  vk::AttachmentLoadOp load_op)
+{
+  ETNA_PROFILE_GPU(cmd_buf, renderForward);
+
+  auto& forwardPipeline = specialized(
+    useGpuCulling
+      ? (useDepthPrepass ? gpuDrivenForwardAfterPrepassPipeline : gpuDrivenForwardPipeline)
+      : (useDepthPrepass ? forwardAfterPrepassPipeline : basicForwardPipeline));
+
+  std::vector<etna::Binding> bindings{
+    etna::Binding{0, frameData->genBinding(frameConstants)},
+    etna::Binding{1, shadowMapBinding()}};
+  if (useGpuCulling)
+  {
+    bindings.push_back(etna::Binding{2, sceneMgr->getInstanceMatricesBuffer().genBinding()});
+    bindings.push_back(etna::Binding{3, sceneMgr->getDrawInstanceIndicesBuffer().genBinding()});
+  }
+  else
+    bindings.push_back(etna::Binding{2, frameData->genBinding(drawMatrices)});
+  addLightClusterBindings(bindings);
+
+  const auto& simpleMaterialInfo = etna::get_shader_program(
+    programName(useGpuCulling ? "simple_material_indirect" : "simple_material"));
+
+  const auto set = getDescriptorSet(cmd_buf, simpleMaterialInfo.getDescriptorLayoutId(0), bindings);
+
+  // The prepass has already filled the depth buffer
+  etna::RenderTargetState renderTargets(
+    cmd_buf,
+    {{0, 0}, {resolution.x, resolution.y}},
+    {{.image = target_image, .view = target_image_view, .loadOp = load_op}},
+    {.image = mainViewDepth.get(),
+     .view = mainViewDepth.getView({}),
+     .loadOp = useDepthPrepass ? vk::AttachmentLoadOp::eLoad : load_op});
+
+  bindPipeline(cmd_buf, vk::PipelineBindPoint::eGraphics, forwardPipeline.getVkPipeline());
+  cmd_buf.bindDescriptorSets(
+    vk::PipelineBindPoint::eGraphics,
+    forwardPipeline.getVkPipelineLayout(),
+    0,
+    {set, sceneMgr->getBindlessSet()},
+    {});
+
+  if (useGpuCulling)
+    renderSceneGpuDriven(
+      cmd_buf,
+      worldViewProj,
+      forwardPipeline.getVkPipelineLayout(),
+      sceneMgr->getVertexBuffer());
+  else
+    renderScene(
+      cmd_buf,
+      worldViewProj,
+      forwardPipeline.getVkPipelineLayout(),
+      sceneMgr->getVertexBuffer(),
+      allInstances);
+}
+
+void WorldRenderer::renderDepthPrepass(vk::CommandBuffer cmd_buf, vk::AttachmentLoadOp load_op)
+{
+  ETNA_PROFILE_GPU(cmd_buf, renderDepthPrepass);
+
+  auto& pipeline = (useGpuCulling ? gpuDrivenDepthPrepassPipeline : depthPrepassPipeline).get();
+
+  std::vector<etna::Binding> bindings;
+  if (useGpuCulling)
+    bindings = {
+      etna::Binding{2, sceneMgr->getInstanceMatricesBuffer().genBinding()},
+      etna::Binding{3, sceneMgr->getDrawInstanceIndicesBuffer().genBinding()}};
+  else
+    bindings = {etna::Binding{2, frameData->genBinding(drawMatrices)}};
+
+  const auto set = getDescriptorSet(
+    cmd_buf,
+    etna::get_shader_program(programName(useGpuCulling ? "depth_only_indirect" : "depth_only"))
+      .getDescriptorLayoutId(0),
+    bindings);
+
+  etna::RenderTargetState renderTargets(
+    cmd_buf,
+    {{0, 0}, {resolution.x, resolution.y}},
+    {},
+    {.image = mainViewDepth.get(), .view = mainViewDepth.getView({}), .loadOp = load_op});
+
+  bindPipeline(cmd_buf, vk::PipelineBindPoint::eGraphics, pipeline.getVkPipeline());
+  cmd_buf.bindDescriptorSets(
+    vk::PipelineBindPoint::eGraphics, pipeline.getVkPipelineLayout(), 0, {set}, {});
+
+  if (useGpuCulling)
+    renderSceneGpuDriven(
+      cmd_buf, worldViewProj, pipeline.getVkPipelineLayout(), sceneMgr->getPositionBuffer());
+  else
+    renderScene(
+      cmd_buf,
+      worldViewProj,
+      pipeline.getVkPipelineLayout(),
+      sceneMgr->getPositionBuffer(),
+      allInstances);
+}
+
+void WorldRenderer::renderGBuffer(vk::CommandBuffer cmd_buf, vk::AttachmentLoadOp load_op)
+{
+  ETNA_PROFILE_GPU(cmd_buf, renderGBuffer);
+
+  auto& pipeline = (useGpuCulling ? gpuDrivenGbufferPipeline : gbufferPipeline).get();
+
+  std::vector<etna::Binding> bindings{etna::Binding{0, frameData->genBinding(frameConstants)}};
+  if (useGpuCulling)
+  {
+    bindings.push_back(etna::Binding{2, sceneMgr->getInstanceMatricesBuffer().genBinding()});
+    bindings.push_back(etna::Binding{3, sceneMgr->getDrawInstanceIndicesBuffer().genBinding()});
+  }
+  else
+    bindings.push_back(etna::Binding{2, frameData->genBinding(drawMatrices)});
+
+  const auto set = getDescriptorSet(
+    cmd_buf,
+    etna::get_shader_program(programName(useGpuCulling ? "gbuffer_indirect" : "gbuffer"))
+      .getDescriptorLayoutId(0),
+    bindings);
+
+  // The render graph has put the G-buffer and depth into attachment layouts
+  std::array<vk::RenderingAttachmentInfo, GBUFFER_TARGET_COUNT> colorAttachments;
+  for (std::size_t i = 0; i < GBUFFER_TARGET_COUNT; ++i)
+    colorAttachments[i] = vk::RenderingAttachmentInfo{
+      .imageView = gbufferViews[i],
+      .imageLayout = vk::ImageLayout::eColorAttachmentOptimal,
+      .loadOp = load_op,
+      .storeOp = vk::AttachmentStoreOp::eStore,
+      .clearValue = vk::ClearColorValue{std::array{0.0f, 0.0f, 0.0f, 0.0f}},
+    };
+  const vk::RenderingAttachmentInfo depthAttachment{
+    .imageView = mainViewDepth.getView({}),
+    .imageLayout = vk::ImageLayout::eDepthStencilAttachmentOptimal,
+    .loadOp = load_op,
+    .storeOp = vk::AttachmentStoreOp::eStore,
+    .clearValue = vk::ClearDepthStencilValue{1.0f, 0},
+  };
+  const vk::Rect2D renderArea{{0, 0}, {resolution.x, resolution.y}};
+  cmd_buf.beginRendering(
+    vk::RenderingInfo{
+      .renderArea = renderArea,
+      .layerCount = 1,
+      .colorAttachmentCount = static_cast<std::uint32_t>(colorAttachments.size()),
+      .pColorAttachments = colorAttachments.data(),
+      .pDepthAttachment = &depthAttachment,
+    });
+  set_viewport_and_scissor(cmd_buf, renderArea);
+
+  bindPipeline(cmd_buf, vk::PipelineBindPoint::eGraphics, pipeline.getVkPipeline());
+  cmd_buf.bindDescriptorSets(
+    vk::PipelineBindPoint::eGraphics,
+    pipeline.getVkPipelineLayout(),
+    0,
+    {set, sceneMgr->getBindlessSet()},
+    {});
+
+  if (useGpuCulling)
+    renderSceneGpuDriven(
+      cmd_buf, worldViewProj, pipeline.getVkPipelineLayout(), sceneMgr->getVertexBuffer());
+  else
+    renderScene(
+      cmd_buf,
+      worldViewProj,
+      pipeline.getVkPipelineLayout(),
+      sceneMgr->getVertexBuffer(),
+      allInstances);
+
+  cmd_buf.endRendering();
+}
+
+void WorldRenderer::renderDeferredLighting(
+  vk::CommandBuffer cmd_buf,
+  const std::array<vk::ImageView, GBUFFER_TARGET_COUNT>& gbuffer_views,
+  vk::ImageView output_view)
+{
+  ETNA_PROFILE_GPU(cmd_buf, renderDeferredLighting);
+
+  const auto timerScope = gpuTimer->beginScope(cmd_buf, std::string(DEFERRED_LIGHTING_SCOPE));
+
+  const auto readLayout = vk::ImageLayout::eShaderReadOnlyOptimal;
+  std::vector<etna::Binding> bindings{
+    etna::Binding{0, frameData->genBinding(frameConstants)},
+    etna::Binding{1, shadowMapBinding()}};
+  addLightClusterBindings(bindings);
+
+  // Images of the render graph, their layouts are taken care of by the graph
+  std::array<DescriptorSetCache::RawImageBinding, GBUFFER_TARGET_COUNT + 2> rawImages;
+  for (std::size_t i = 0; i < GBUFFER_TARGET_COUNT; ++i)
+    rawImages[i] = {
+      .binding = static_cast<std::uint32_t>(2 + i),
+      .info = {defaultSampler.get(), gbuffer_views[i], readLayout},
+    };
+  rawImages[GBUFFER_TARGET_COUNT] = {
+    .binding = 5,
+    .info = {defaultSampler.get(), mainViewDepth.getView({}), readLayout},
+  };
+  rawImages.back() = {.binding = 6, .info = {{}, output_view, vk::ImageLayout::eGeneral}};
+
+  const auto set = getDescriptorSet(
+    cmd_buf,
+    etna::get_shader_program(programName("deferred_lighting")).getDescriptorLayoutId(0),
+    bindings,
+    rawImages);
+  etna::flush_barriers(cmd_buf);
+
+  auto& pipeline = specializedDeferredLighting();
+  bindPipeline(cmd_buf, vk::PipelineBindPoint::eCompute, pipeline.getVkPipeline());
+  cmd_buf.bindDescriptorSets(
+    vk::PipelineBindPoint::eCompute,
+    pipeline.getVkPipelineLayout(),
+    0,
+    {set},
+    {});
+  cmd_buf.dispatch(
+    (resolution.x + DEFERRED_LIGHTING_GROUP_SIZE - 1) / DEFERRED_LIGHTING_GROUP_SIZE,
+    (resolution.y + DEFERRED_LIGHTING_GROUP_SIZE - 1) / DEFERRED_LIGHTING_GROUP_SIZE,
+    1);
+
+  gpuTimer->endScope(cmd_buf, timerScope);
+}
+
+void WorldRenderer::addLightClusterBindings(std::vector<etna::Binding>& bindings)
+{
+  // Matches CLUSTERED_LIGHTS_BINDING in shading.glsl
+  bindings.push_back(etna::Binding{8, lightClusters->getLightsBuffer().genBinding()});
+  bindings.push_back(etna::Binding{9, lightClusters->getClustersBuffer().genBinding()});
+  bindings.push_back(etna::Binding{10, lightClusters->getLightIndicesBuffer().genBinding()});
+}
+
+void WorldRenderer::cullLights(vk::CommandBuffer cmd_buf)
+{
+  const auto timerScope = gpuTimer->beginScope(cmd_buf, std::string(LIGHT_CLUSTERS_SCOPE));
+
+  lightClusters->cull(
+    cmd_buf,
+    std::span(pointLights).first(std::min<std::size_t>(pointLightCount, pointLights.size())),
+    mainViewTm,
+    mainProjTm,
+    mainZNear,
+    mainZFar,
+    resolution);
+
+  gpuTimer->endScope(cmd_buf, timerScope);
+}
+
+void WorldRenderer::renderMainView(
+  vk::CommandBuffer cmd_buf,
+  vk::Image target_image,
+  vk::ImageView target_image_view,
+  vk::AttachmentLoadOp load_op)
+{
+  // Queries can not cross render pass boundaries, so the scopes wrap whole passes
+  const auto measured = [&](std::string_view name, auto&& record) {
+    const auto timerScope = gpuTimer->beginScope(cmd_buf, std::string(name));
+    const auto statsScope = pipelineStats->beginScope(cmd_buf, std::string(name));
+    record();
+    pipelineStats->endScope(cmd_buf, statsScope);
+    gpuTimer->endScope(cmd_buf, timerScope);
+  };
+
+  if (shadingPath == ShadingPath::Deferred)
+  {
+    measured(GBUFFER_SCOPE, [&]() { renderGBuffer(cmd_buf, load_op); });
+    return;
+  }
+
+  if (useDepthPrepass)
+    measured(DEPTH_PREPASS_SCOPE, [&]() { renderDepthPrepass(cmd_buf, load_op); });
+
+  measured(
+    FORWARD_SCOPE, [&]() { renderForward(cmd_buf, target_image, target_image_view, load_op); });
+}
+
+void WorldRenderer::addSceneRecordingTasks(
+  std::vector<ParallelCommandRecorder::Task>& tasks,
+  vk::Pipeline pipeline,
+  vk::PipelineLayout pipeline_layout,
+  std::vector<vk::DescriptorSet> sets,
+  vk::Buffer vertex_buffer,
+  std::span<const std::uint32_t> instances,
+  vk::Rect2D rect,
+  const glm::mat4x4& glob_tm,
+  std::optional<vk::Format> color_format,
+  vk::Format depth_format,
+  std::uint32_t view_mask)
+{
+  const std::size_t instanceCount = instances.size();
+  const std::size_t chunkCount =
+    static_cast<std::size_t>(commandRecorder->getThreadCount()) * CHUNKS_PER_THREAD;
+  const std::size_t chunkSize =
+    std::max((instanceCount + chunkCount - 1) / chunkCount, MIN_INSTANCES_PER_CHUNK);
+
+  for (std::size_t firstInstance = 0; firstInstance < instanceCount; firstInstance += chunkSize)
+  {
+    ParallelCommandRecorder::Task task{
+      .colorAttachmentFormats = {},
+      .depthAttachmentFormat = depth_format,
+      .viewMask = view_mask,
+      .record = {},
+    };
+    if (color_format)
+      task.colorAttachmentFormats.push_back(*color_format);
+
+    task.record = [this,
+                   pipeline,
+                   pipeline_layout,
+                   sets,
+                   vertex_buffer,
+                   chunk = instances.subspan(
+                     firstInstance, std::min(chunkSize, instanceCount - firstInstance)),
+                   rect,
+                   glob_tm](vk::CommandBuffer cmd_buf) {
+      // Secondary command buffers inherit no dynamic state
+      set_viewport_and_scissor(cmd_buf, rect);
+
+      bindPipeline(cmd_buf, vk::PipelineBindPoint::eGraphics, pipeline);
+      if (!sets.empty())
+        cmd_buf.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipeline_layout, 0, sets, {});
+
+      renderScene(cmd_buf, glob_tm, pipeline_layout, vertex_buffer, chunk);
+    };
+
+    tasks.push_back(std::move(task));
+  }
+}
+
+void WorldRenderer::renderWorldParallel(
+  vk::CommandBuffer cmd_buf, vk::Image target_image, vk::ImageView target_image_view)
+{
+  commandRecorder->beginFrame();
+
+  const auto viewMask = takeCascadesToRender();
+  if (useMultiviewShadows)
+    cullShadowCascadesMultiview(viewMask);
+
+  // Descriptor sets have to be fetched on this thread, the shadow map is moved back
+  // into the read layout explicitly once the shadow pass is done
+  const auto& shadowPipelineToUse =
+    (useDepthOnlyShadows ? shadowPipeline : fullVertexShadowPipeline).get();
+  std::vector<etna::Binding> shadowBindings{
+    etna::Binding{2, frameData->genBinding(drawMatrices)}};
+  const char* shadowProgram = useDepthOnlyShadows ? "depth_only" : "simple_shadow";
+  if (useMultiviewShadows)
+  {
+    shadowBindings.push_back(etna::Binding{0, frameData->genBinding(frameConstants)});
+    shadowBindings.push_back(etna::Binding{3, frameData->genBinding(drawViewMasks)});
+    shadowProgram = "depth_multiview";
+  }
+  const auto shadowSet = getDescriptorSet(
+    cmd_buf,
+    etna::get_shader_program(programName(shadowProgram)).getDescriptorLayoutId(0),
+    shadowBindings);
+
+  std::vector<etna::Binding> forwardBindings{
+    etna::Binding{0, frameData->genBinding(frameConstants)},
+    etna::Binding{1, shadowMapBinding()},
+    etna::Binding{2, frameData->genBinding(drawMatrices)}};
+  addLightClusterBindings(forwardBindings);
+  const auto forwardSet = getDescriptorSet(
+    cmd_buf,
+    etna::get_shader_program(programName("simple_material")).getDescriptorLayoutId(0),
+    forwardBindings);
+  etna::flush_barriers(cmd_buf);
+
+  const vk::Rect2D forwardRect{{0, 0}, {resolution.x, resolution.y}};
+  const auto shadowVertexBuffer = useDepthOnlyShadows || useMultiviewShadows
+    ? sceneMgr->getPositionBuffer()
+    : sceneMgr->getVertexBuffer();
+
+  // Both passes are recorded at the same time, cached cascades are skipped
+  std::vector<ParallelCommandRecorder::Task> tasks;
+  std::array<std::size_t, SHADOW_CASCADE_COUNT + 1> cascadeTaskOffsets{};
+  if (useMultiviewShadows && viewMask != 0)
+  {
+    // Cascade matrices are taken from the frame constants by the view index
+    addSceneRecordingTasks(
+      tasks,
+      multiviewShadowPipelines->get(viewMask),
+      multiviewShadowPipelines->getLayout(),
+      {shadowSet},
+      shadowVertexBuffer,
+      multiviewInstances,
+      SHADOW_CASCADE_RECT,
+      glm::mat4x4{1.0f},
+      std::nullopt,
+      vk::Format::eD16Unorm,
+      viewMask);
+  }
+  else if (!useMultiviewShadows)
+  {
+    for (std::size_t i = 0; i < cascades.size(); ++i)
+    {
+      if ((viewMask & (1u << i)) != 0)
+      {
+        cullShadowCascade(i);
+        addSceneRecordingTasks(
+          tasks,
+          shadowPipelineToUse.getVkPipeline(),
+          shadowPipelineToUse.getVkPipelineLayout(),
+          {shadowSet},
+          shadowVertexBuffer,
+          cascades[i].visibleInstances,
+          SHADOW_CASCADE_RECT,
+          cascades[i].projView,
+          std::nullopt,
+          vk::Format::eD16Unorm);
+      }
+      cascadeTaskOffsets[i + 1] = tasks.size();
+    }
+  }
+  const std::size_t shadowTaskCount = tasks.size();
+  const auto& forwardPipeline = specialized(basicForwardPipeline);
+  addSceneRecordingTasks(
+    tasks,
+    forwardPipeline.getVkPipeline(),
+    forwardPipeline.getVkPipelineLayout(),
+    {forwardSet, sceneMgr->getBindlessSet()},
+    sceneMgr->getVertexBuffer(),
+    allInstances,
+    forwardRect,
+    worldViewProj,
+    targetFormat,
+    vk::Format::eD32Sfloat);
+
+  const auto recordStart = std::chrono::steady_clock::now();
+  const auto secondaryCmdBufs = commandRecorder->record(std::move(tasks));
+  lastRecordTimeMs =
+    std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordStart)
+      .count();
+
+  const auto secondaries = std::span<const vk::CommandBuffer>(secondaryCmdBufs);
+
+  if (useMultiviewShadows && viewMask != 0)
+  {
+    ETNA_PROFILE_GPU(cmd_buf, renderShadowMap);
+
+    const auto timerScope = gpuTimer->beginScope(cmd_buf, "Cascades (multiview)");
+    render_utility::execute_secondary_pass(
+      cmd_buf,
+      SHADOW_CASCADE_RECT,
+      std::nullopt,
+      render_utility::SecondaryPassAttachment{
+        .image = shadowMap.get(),
+        .view = shadowMapArrayView.get(),
+        .clearValue = vk::ClearDepthStencilValue{1.0f, 0},
+      },
+      secondaries.subspan(0, shadowTaskCount),
+      viewMask);
+    gpuTimer->endScope(cmd_buf, timerScope);
+  }
+  else if (!useMultiviewShadows)
+  {
+    ETNA_PROFILE_GPU(cmd_buf, renderShadowMap);
+
+    for (std::size_t i = 0; i < cascades.size(); ++i)
+    {
+      if ((viewMask & (1u << i)) == 0)
+        continue;
+
+      const auto timerScope = gpuTimer->beginScope(cmd_buf, fmt::format("Cascade {}", i));
+      render_utility::execute_secondary_pass(
+        cmd_buf,
+        SHADOW_CASCADE_RECT,
+        std::nullopt,
+        render_utility::SecondaryPassAttachment{
+          .image = shadowMap.get(),
+          .view = shadowMapLayerViews[i].get(),
+          .clearValue = vk::ClearDepthStencilValue{1.0f, 0},
+        },
+        secondaries.subspan(
+          cascadeTaskOffsets[i], cascadeTaskOffsets[i + 1] - cascadeTaskOffsets[i]));
+      gpuTimer->endScope(cmd_buf, timerScope);
+    }
+  }
+
+  etna::set_state(
+    cmd_buf,
+    shadowMap.get(),
+    vk::PipelineStageFlagBits2::eFragmentShader,
+    vk::AccessFlagBits2::eShaderSampledRead,
+    vk::ImageLayout::eShaderReadOnlyOptimal,
+    vk::ImageAspectFlagBits::eDepth);
+
+  {
+    ETNA_PROFILE_GPU(cmd_buf, renderForward);
+
+    render_utility::execute_secondary_pass(
+      cmd_buf,
+      forwardRect,
+      render_utility::SecondaryPassAttachment{
+        .image = target_image,
+        .view = target_image_view,
+      },
+      render_utility::SecondaryPassAttachment{
+        .image = mainViewDepth.get(),
+        .view = mainViewDepth.getView({}),
+        .clearValue = vk::ClearDepthStencilValue{1.0f, 0},
+      },
+      secondaries.subspan(shadowTaskCount));
+  }
+}
+
+void WorldRenderer::renderShadowMap(vk::CommandBuffer cmd_buf)
+{
+  ETNA_PROFILE_GPU(cmd_buf, renderShadowMap);
+
+  const auto viewMask = takeCascadesToRender();
+  if (viewMask == 0)
+    return;
+
+  if (useMultiviewShadows)
+  {
+    renderShadowMapMultiview(cmd_buf, viewMask);
+    return;
+  }
+
+  const auto& pipeline =
+    (useGpuCulling
+       ? (useDepthOnlyShadows ? gpuDrivenShadowPipeline : gpuDrivenFullVertexShadowPipeline)
+       : (useDepthOnlyShadows ? shadowPipeline : fullVertexShadowPipeline))
+      .get();
+  const char* program = useGpuCulling
+    ? (useDepthOnlyShadows ? "depth_only_indirect" : "simple_shadow_indirect")
+    : (useDepthOnlyShadows ? "depth_only" : "simple_shadow");
+  const auto vertexBuffer =
+    useDepthOnlyShadows ? sceneMgr->getPositionBuffer() : sceneMgr->getVertexBuffer();
+
+  std::vector<etna::Binding> bindings;
+  if (useGpuCulling)
+    bindings = {
+      etna::Binding{2, sceneMgr->getInstanceMatricesBuffer().genBinding()},
+      etna::Binding{3, sceneMgr->getDrawInstanceIndicesBuffer().genBinding()}};
+  else
+    bindings = {etna::Binding{2, frameData->genBinding(drawMatrices)}};
+
+  const auto set = getDescriptorSet(
+    cmd_buf, etna::get_shader_program(programName(program)).getDescriptorLayoutId(0), bindings);
+
+  for (std::size_t i = 0; i < cascades.size(); ++i)
+  {
+    if ((viewMask & (1u << i)) == 0)
+      continue;
+    const auto& cascade = cascades[i];
+
+    const auto scopeName = fmt::format("Cascade {}", i);
+    const auto timerScope = gpuTimer->beginScope(cmd_buf, scopeName);
+
+    if (useGpuCulling)
+      sceneCuller->cull(cmd_buf, cascade.projView);
+    else
+      cullShadowCascade(i);
+
+    // Statistics queries can not cross the render pass boundary, unlike timestamps
+    const auto statsScope = pipelineStats->beginScope(cmd_buf, scopeName);
+    {
+      etna::RenderTargetState renderTargets(
+        cmd_buf,
+        SHADOW_CASCADE_RECT,
+        {},
+        {.image = shadowMap.get(), .view = shadowMapLayerViews[i].get()});
+
+      bindPipeline(cmd_buf, vk::PipelineBindPoint::eGraphics, pipeline.getVkPipeline());
+      cmd_buf.bindDescriptorSets(
+        vk::PipelineBindPoint::eGraphics, pipeline.getVkPipelineLayout(), 0, {set}, {});
+
+      const auto draw = [&]() {
+        if (useGpuCulling)
+          renderSceneGpuDriven(
+            cmd_buf, cascade.projView, pipeline.getVkPipelineLayout(), vertexBuffer);
+        else
+          renderScene(
+            cmd_buf,
+            cascade.projView,
+            pipeline.getVkPipelineLayout(),
+            vertexBuffer,
+            cascade.visibleInstances);
+      };
+
+      // Separate zones so both variants can be told apart in the profiler
+      if (useDepthOnlyShadows)
+      {
+        ETNA_PROFILE_GPU(cmd_buf, shadowDepthOnly);
+        draw();
+      }
+      else
+      {
+        ETNA_PROFILE_GPU(cmd_buf, shadowFullVertex);
+        draw();
+      }
+    }
+    pipelineStats->endScope(cmd_buf, statsScope);
+
+    gpuTimer->endScope(cmd_buf, timerScope);
+  }
+}
+
+void WorldRenderer::renderShadowMapMultiview(vk::CommandBuffer cmd_buf, std::uint32_t view_mask)
+{
+  ETNA_PROFILE_GPU(cmd_buf, shadowMultiview);
+
+  const std::string scopeName = "Cascades (multiview)";
+  const auto timerScope = gpuTimer->beginScope(cmd_buf, scopeName);
+
+  auto& pipelines = useGpuCulling ? *gpuDrivenMultiviewShadowPipelines : *multiviewShadowPipelines;
+
+  std::vector<etna::Binding> bindings{etna::Binding{0, frameData->genBinding(frameConstants)}};
+  if (useGpuCulling)
+  {
+    // The shader rejects relems outside of a particular cascade on its own
+    sceneCuller->cull(cmd_buf, multiviewCullingMatrix(view_mask));
+    bindings.push_back(etna::Binding{2, sceneMgr->getInstanceMatricesBuffer().genBinding()});
+    bindings.push_back(etna::Binding{3, sceneMgr->getDrawInstanceIndicesBuffer().genBinding()});
+    bindings.push_back(etna::Binding{4, sceneMgr->getBoundsBuffer().genBinding()});
+  }
+  else
+  {
+    cullShadowCascadesMultiview(view_mask);
+    bindings.push_back(etna::Binding{2, frameData->genBinding(drawMatrices)});
+    bindings.push_back(etna::Binding{3, frameData->genBinding(drawViewMasks)});
+  }
+
+  const auto set = getDescriptorSet(
+    cmd_buf,
+    etna::get_shader_program(
+      programName(useGpuCulling ? "depth_multiview_indirect" : "depth_multiview"))
+      .getDescriptorLayoutId(0),
+    bindings);
+
+  // Opened after culling, so only the draws are counted like for separate cascades
+  const auto statsScope = pipelineStats->beginScope(cmd_buf, scopeName);
+
+  etna::set_state(
+    cmd_buf,
+    shadowMap.get(),
+    vk::PipelineStageFlagBits2::eEarlyFragmentTests |
+      vk::PipelineStageFlagBits2::eLateFragmentTests,
+    vk::AccessFlagBits2::eDepthStencilAttachmentRead |
+      vk::AccessFlagBits2::eDepthStencilAttachmentWrite,
+    vk::ImageLayout::eDepthAttachmentOptimal,
+    vk::ImageAspectFlagBits::eDepth);
+  etna::flush_barriers(cmd_buf);
+
+  // etna::RenderTargetState has no view mask. Only the views in the mask are cleared,
+  // so cached cascades keep their contents.
+  const vk::RenderingAttachmentInfo depthAttachment{
+    .imageView = shadowMapArrayView.get(),
+    .imageLayout = vk::ImageLayout::eDepthAttachmentOptimal,
+    .loadOp = vk::AttachmentLoadOp::eClear,
+    .storeOp = vk::AttachmentStoreOp::eStore,
+    .clearValue = vk::ClearDepthStencilValue{1.0f, 0},
+  };
+  cmd_buf.beginRendering(
+    vk::RenderingInfo{
+      .renderArea = SHADOW_CASCADE_RECT,
+      .layerCount = 1,
+      .viewMask = view_mask,
+      .colorAttachmentCount = 0,
+      .pDepthAttachment = &depthAttachment,
+    });
+
+  set_viewport_and_scissor(cmd_buf, SHADOW_CASCADE_RECT);
+  bindPipeline(cmd_buf, vk::PipelineBindPoint::eGraphics, pipelines.get(view_mask));
+  cmd_buf.bindDescriptorSets(
+    vk::PipelineBindPoint::eGraphics, pipelines.getLayout(), 0, {set}, {});
+
+  // Cascade matrices are taken from the frame constants by the view index
+  if (useGpuCulling)
+    renderSceneGpuDriven(
+      cmd_buf, glm::mat4x4{1.0f}, pipelines.getLayout(), sceneMgr->getPositionBuffer());
+  else
+    renderScene(
+      cmd_buf,
+      glm::mat4x4{1.0f},
+      pipelines.getLayout(),
+      sceneMgr->getPositionBuffer(),
+      multiviewInstances);
+
+  cmd_buf.endRendering();
+
+  pipelineStats->endScope(cmd_buf, statsScope);
+  gpuTimer->endScope(cmd_buf, timerScope);
+}
+
+void WorldRenderer::disablePendingFeatures()
+{
+  // Checked in this order, so that later checks pick the variants that will actually be used
+  if (useGpuCulling && !(gpuDrivenForwardPipeline.isReady() && gpuDrivenShadowPipeline.isReady()))
+    useGpuCulling = false;
+
+  auto& fullVertexShadows =
+    useGpuCulling ? gpuDrivenFullVertexShadowPipeline : fullVertexShadowPipeline;
+  if (!useDepthOnlyShadows && !fullVertexShadows.isReady())
+    useDepthOnlyShadows = true;
+
+  auto& prepass = useGpuCulling ? gpuDrivenDepthPrepassPipeline : depthPrepassPipeline;
+  auto& forwardAfterPrepass =
+    useGpuCulling ? gpuDrivenForwardAfterPrepassPipeline : forwardAfterPrepassPipeline;
+  if (useDepthPrepass && !(prepass.isReady() && forwardAfterPrepass.isReady()))
+    useDepthPrepass = false;
+
+  auto& gbuffer = useGpuCulling ? gpuDrivenGbufferPipeline : gbufferPipeline;
+  if (
+    shadingPath == ShadingPath::Deferred &&
+    !(gbuffer.isReady() && deferredLightingPipeline.isReady()))
+    shadingPath = ShadingPath::Forward;
+}
+
+bool WorldRenderer::arePipelinesReady() const
+{
+  return pipelineCompiler->getPendingJobs() == 0;
+}
+
+void WorldRenderer::renderWorld(
+  vk::CommandBuffer cmd_buf, vk::Image target_image, vk::ImageView target_image_view)
+{
+  ETNA_PROFILE_GPU(cmd_buf, renderWorld);
+
+  reloadChangedShaders();
+
+  // Everything else falls back to these, so only the first frames ever wait for compilation
+  basicForwardPipeline.get();
+  shadowPipeline.get();
+
+  // Settings are restored right after recording, the GUI and benchmarks never see the fallbacks
+  const auto requestedFeatures =
+    std::tuple{shadingPath, useGpuCulling, useDepthPrepass, useDepthOnlyShadows};
+  disablePendingFeatures();
+
+  retiredResources->beginFrame();
+  descriptorSets->beginFrame();
+  gpuTimer->beginFrame(cmd_buf);
+  pipelineStats->beginFrame(cmd_buf);
+  pushFrameTimes();
+  renderCounters.beginFrame();
+  renderCounters.plotPipelineStatistics(pipelineStats->getResults(), PIPELINE_STATISTIC_NAMES);
+  uploadFrameData();
+
+  if (resolution == targetResolution)
+    renderFrame(cmd_buf, target_image, target_image_view);
+  else
+  {
+    // Benchmarks render at their own resolution, the result is scaled to the window
+    renderFrame(cmd_buf, offscreenTarget.get(), offscreenTarget.getView({}));
+    blit_color_image(cmd_buf, offscreenTarget.get(), resolution, target_image, targetResolution);
+  }
+
+  if (drawDebugFSQuad)
+    quadRenderer->render(
+      cmd_buf,
+      target_image,
+      target_image_view,
+      shadowMap,
+      shadowMapLayerViews[0].get(),
+      defaultSampler);
+
+  std::tie(shadingPath, useGpuCulling, useDepthPrepass, useDepthOnlyShadows) = requestedFeatures;
+
+  updateBenchmarks();
+}
+
+void WorldRenderer::renderFrame(
+  vk::CommandBuffer cmd_buf, vk::Image target_image, vk::ImageView target_image_view)
+{
+  // Secondary buffers only cover the forward path and have no per-pass timer scopes
+  const bool parallel =
+    !useGpuCulling && useParallelRecording && !shadingBenchmark.isRunning();
+
+  // Clusters only depend on the camera, so they are built before any of the passes
+  cullLights(cmd_buf);
+
+  if (parallel && shadingPath == ShadingPath::Forward)
+  {
+    renderWorldParallel(cmd_buf, target_image, target_image_view);
+    return;
+  }
+
+  if (useGpuCulling)
+    sceneCuller->prepareFrame(cmd_buf);
+
+  // draw scene to shadowmap, every cascade is culled separately
+  renderShadowMap(cmd_buf);
+
+  // draw final scene to screen
+  buildFrameGraph(target_image, target_image_view);
+  renderGraph->execute(cmd_buf);
+}
+
+void WorldRenderer::buildFrameGraph(vk::Image target_image, vk::ImageView target_image_view)
+{
+  using Access = RenderGraph::Access;
+  using ImageId = RenderGraph::ImageId;
+  using Phase = SceneCuller::Phase;
+
+  auto& graph = *renderGraph;
+  const vk::Extent2D extent{resolution.x, resolution.y};
+  const auto fragmentTests = vk::PipelineStageFlagBits2::eEarlyFragmentTests |
+    vk::PipelineStageFlagBits2::eLateFragmentTests;
+
+  const auto target = graph.importImage(
+    "target", target_image, target_image_view, extent, vk::ImageAspectFlagBits::eColor);
+  const auto depth = graph.importImage(
+    "main_view_depth",
+    mainViewDepth.get(),
+    mainViewDepth.getView({}),
+    extent,
+    vk::ImageAspectFlagBits::eDepth);
+  const auto shadows = graph.importImage(
+    "shadow_map",
+    shadowMap.get(),
+    shadowMapArrayView.get(),
+    {SHADOW_CASCADE_RESOLUTION, SHADOW_CASCADE_RESOLUTION},
+    vk::ImageAspectFlagBits::eDepth);
+
+  const bool deferred = shadingPath == ShadingPath::Deferred;
+  const auto compute = vk::PipelineStageFlagBits2::eComputeShader;
+
+  std::array<ImageId, GBUFFER_TARGET_COUNT> gbuffer{};
+  if (deferred)
+  {
+    const auto createGbufferImage = [&](const char* name, vk::Format format) {
+      return graph.createImage(
+        name,
+        {
+          .extent = extent,
+          .format = format,
+          .usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eSampled,
+        });
+    };
+    static_assert(GBUFFER_TARGET_COUNT == 3);
+    gbuffer = {
+      createGbufferImage("gbuffer_normal", GBUFFER_NORMAL_FORMAT),
+      createGbufferImage("gbuffer_albedo", GBUFFER_ALBEDO_FORMAT),
+      createGbufferImage("gbuffer_material", GBUFFER_MATERIAL_FORMAT),
+    };
+  }
+
+  // Culling only writes buffers, which the graph does not track
+  const auto addCullPass = [&](const char* name, Phase phase, std::optional<ImageId> hi_z) {
+    graph.addPass(
+      name,
+      [&](RenderGraph::PassBuilder& pass) {
+        pass.markSideEffect();
+        if (hi_z)
+          pass.read(*hi_z, Access::Sampled, compute);
+      },
+      [this, phase, hi_z](vk::CommandBuffer cmd_buf, const RenderGraph::Resources& resources) {
+        // Stats are gathered by the phase that sees every instance
+        sceneCuller->cull(
+          cmd_buf,
+          worldViewProj,
+          phase,
+          phase != Phase::Early,
+          hi_z ? resources.getView(*hi_z) : vk::ImageView{});
+      });
+  };
+
+  const auto addMainViewPass = [&](const char* suffix, vk::AttachmentLoadOp load_op) {
+    graph.addPass(
+      fmt::format("{}{}", deferred ? "G-buffer" : "Main view", suffix),
+      [&](RenderGraph::PassBuilder& pass) {
+        pass.write(depth, Access::DepthAttachment, fragmentTests);
+        if (deferred)
+        {
+          for (const auto image : gbuffer)
+            pass.write(
+              image, Access::ColorAttachment, vk::PipelineStageFlagBits2::eColorAttachmentOutput);
+          return;
+        }
+        pass.read(shadows, Access::Sampled, vk::PipelineStageFlagBits2::eFragmentShader);
+        pass.write(
+          target, Access::ColorAttachment, vk::PipelineStageFlagBits2::eColorAttachmentOutput);
+      },
+      [this, deferred, gbuffer, load_op, target_image, target_image_view](
+        vk::CommandBuffer cmd_buf, const RenderGraph::Resources& resources) {
+        if (deferred)
+          for (std::size_t i = 0; i < GBUFFER_TARGET_COUNT; ++i)
+            gbufferViews[i] = resources.getView(gbuffer[i]);
+        renderMainView(cmd_buf, target_image, target_image_view, load_op);
+      });
+  };
+
+  // With occlusion culling, draw what was visible last frame, then everything that got
+  // disoccluded according to the Hi-Z pyramid of the first draw
+  const bool occlusion = useGpuCulling && useOcclusionCulling;
+  if (useGpuCulling)
+    addCullPass(
+      occlusion ? "Early cull" : "Frustum cull",
+      occlusion ? Phase::Early : Phase::FrustumOnly,
+      std::nullopt);
+  addMainViewPass("", vk::AttachmentLoadOp::eClear);
+
+  if (useGpuCulling)
+  {
+    // Declared whenever the culler runs, the graph drops it unless the late phase samples it
+    const auto hiZInfo = sceneCuller->getHiZInfo();
+    const auto hiZ = graph.createImage("hiz_pyramid", hiZInfo);
+    graph.addPass(
+      "Hi-Z",
+      [&](RenderGraph::PassBuilder& pass) {
+        pass.read(depth, Access::Sampled, compute);
+        pass.write(hiZ, Access::StorageWrite, compute);
+      },
+      [this, hiZ, mipLevels = hiZInfo.mipLevels](
+        vk::CommandBuffer cmd_buf, const RenderGraph::Resources& resources) {
+        std::vector<vk::ImageView> mips;
+        mips.reserve(mipLevels);
+        for (std::uint32_t mip = 0; mip < mipLevels; ++mip)
+          mips.push_back(resources.getMipView(hiZ, mip));
+        sceneCuller->buildHiZ(cmd_buf, mainViewDepth, mips);
+      });
+
+    if (occlusion)
+    {
+      addCullPass("Late cull", Phase::Late, hiZ);
+      addMainViewPass(" (late)", vk::AttachmentLoadOp::eLoad);
+    }
+  }
+
+  if (!deferred)
+    return;
+
+  // Written by the lighting dispatch and blitted to the target, swapchains can't be storage
+  const auto deferredColor = graph.createImage(
+    "deferred_color",
+    {
+      .extent = extent,
+      .format = DEFERRED_COLOR_FORMAT,
+      .usage = vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc,
+    });
+
+  graph.addPass(
+    "Deferred lighting",
+    [&](RenderGraph::PassBuilder& pass) {
+      for (const auto image : gbuffer)
+        pass.read(image, Access::Sampled, compute);
+      pass.read(depth, Access::Sampled, compute);
+      pass.read(shadows, Access::Sampled, compute);
+      pass.write(deferredColor, Access::StorageWrite, compute);
+    },
+    [this, gbuffer, deferredColor](
+      vk::CommandBuffer cmd_buf, const RenderGraph::Resources& resources) {
+      std::array<vk::ImageView, GBUFFER_TARGET_COUNT> views;
+      for (std::size_t i = 0; i < GBUFFER_TARGET_COUNT; ++i)
+        views[i] = resources.getView(gbuffer[i]);
+      renderDeferredLighting(cmd_buf, views, resources.getView(deferredColor));
+    });
+
+  graph.addPass(
+    "Deferred resolve",
+    [&](RenderGraph::PassBuilder& pass) {
+      pass.read(deferredColor, Access::TransferSrc, vk::PipelineStageFlagBits2::eBlit);
+      pass.write(target, Access::TransferDst, vk::PipelineStageFlagBits2::eBlit);
+    },
+    [this, deferredColor, target](
+      vk::CommandBuffer cmd_buf, const RenderGraph::Resources& resources) {
+      const auto timerScope = gpuTimer->beginScope(cmd_buf, std::string(DEFERRED_RESOLVE_SCOPE));
+      record_blit(
+        cmd_buf,
+        resources.getImage(deferredColor),
+        resolution,
+        resources.getImage(target),
+        resolution);
+      gpuTimer->endScope(cmd_buf, timerScope);
+    });
+}
+
+void WorldRenderer::pushFrameTimes()
+{
+  const auto now = std::chrono::steady_clock::now();
+  if (lastFrameStart)
+    frameTimes.push(
+      std::chrono::duration<float, std::milli>(now - *lastFrameStart).count(), *gpuTimer);
+  lastFrameStart = now;
+}
+
+void WorldRenderer::drawFrameTimings() const
+{
+  if (frameTimes.getFrameCount() == 0)
+    return;
+
+  for (const auto& [name, milliseconds] : frameTimes.getPassAverages())
+    ImGui::Text(
+      "%.*s: %.3f ms",
+      static_cast<int>(name.size()),
+      name.data(),
+      static_cast<double>(milliseconds));
+
+  const auto cpu = frameTimes.getPercentiles(FrameTimeHistory::Series::Cpu);
+  const auto gpu = frameTimes.getPercentiles(FrameTimeHistory::Series::Gpu);
+  // Both graphs share a scale so they can be compared at a glance
+  const float scaleMax = std::max(cpu.p99, gpu.p99) * 1.25f;
+  const ImVec2 graphSize{0, 60};
+
+  const auto plot = [&](const char* label, FrameTimeHistory::Series series) {
+    const auto values = frameTimes.getValues(series);
+    ImGui::PlotLines(
+      label,
+      values.data(),
+      static_cast<int>(frameTimes.getFrameCount()),
+      static_cast<int>(frameTimes.getOffset() % frameTimes.getFrameCount()),
+      nullptr,
+      0.0f,
+      scaleMax,
+      graphSize);
+  };
+  plot("CPU ms", FrameTimeHistory::Series::Cpu);
+  plot("GPU ms", FrameTimeHistory::Series::Gpu);
+
+  const auto histogram = frameTimes.getHistogram(FrameTimeHistory::Series::Cpu, scaleMax);
+  const auto overlay = fmt::format("0 - {:.1f} ms", scaleMax);
+  ImGui::PlotHistogram(
+    "CPU frames",
+    histogram.data(),
+    static_cast<int>(histogram.size()),
+    0,
+    overlay.c_str(),
+    0.0f,
+    std::numeric_limits<float>::max(),
+    graphSize);
+
+  for (const auto& [label, percentiles] : {std::pair{"CPU", cpu}, std::pair{"GPU", gpu}})
+    ImGui::Text(
+      "%s p50 %.2f, p90 %.2f, p95 %.2f, p99 %.2f, max %.2f ms",
+      label,
+      static_cast<double>(percentiles.p50),
+      static_cast<double>(percentiles.p90),
+      static_cast<double>(percentiles.p95),
+      static_cast<double>(percentiles.p99),
+      static_cast<double>(percentiles.max));
+}
+
+void WorldRenderer::drawWorkCounters() const
+{
+  for (std::size_t i = 0; i < RenderCounters::COUNTER_COUNT; ++i)
+  {
+    const auto counter = static_cast<RenderCounters::Counter>(i);
+    ImGui::Text(
+      "%s: %llu",
+      RenderCounters::getName(counter),
+      static_cast<unsigned long long>(renderCounters.getLastFrame(counter)));
+  }
+
+  if (!ImGui::BeginTable("Pipeline statistics", 4, ImGuiTableFlags_Borders))
+    return;
+  ImGui::TableSetupColumn("Pass");
+  ImGui::TableSetupColumn("Vertices");
+  ImGui::TableSetupColumn("Primitives");
+  ImGui::TableSetupColumn("Fragments");
+  ImGui::TableHeadersRow();
+  for (const auto& result : pipelineStats->getResults())
+  {
+    ImGui::TableNextRow();
+    ImGui::TableNextColumn();
+    ImGui::TextUnformatted(result.name.c_str());
+    for (const auto stat :
+         {VERTEX_INVOCATIONS_STAT, CLIPPING_PRIMITIVES_STAT, FRAGMENT_INVOCATIONS_STAT})
+    {
+      ImGui::TableNextColumn();
+      ImGui::Text("%llu", static_cast<unsigned long long>(result.values[stat]));
+    }
+  }
+  ImGui::EndTable();
+}
+
+void WorldRenderer::updateMemoryReport()
+{
+  using Category = GpuMemoryReport::Category;
+
+  memoryReport.clear();
+  sceneMgr->reportMemory(memoryReport);
+  sceneCuller->reportMemory(memoryReport);
+  lightClusters->reportMemory(memoryReport);
+  if (offscreenFrames != nullptr)
+    offscreenFrames->reportMemory(memoryReport);
+
+  memoryReport.addImage(Category::RenderTargets, "main view depth", mainViewDepth.get());
+  memoryReport.addImage(Category::RenderTargets, "offscreen target", offscreenTarget.get());
+  memoryReport.addImage(Category::RenderTargets, "shadow map", shadowMap.get());
+  // Transient images share one aliased allocation, which exists once a frame was rendered
+  if (const auto& graphStats = renderGraph->getStats(); graphStats.transientBytesAllocated > 0)
+    memoryReport.addBytes(
+      Category::RenderTargets, "render graph", graphStats.transientBytesAllocated, 1);
+
+  memoryReport.addBuffer(Category::InstanceData, "frame data", frameData->getBuffer());
+
+  memoryReport.queryHeaps();
+}
+
+void WorldRenderer::drawMemoryReport() const
+{
+  constexpr double MIB = 1024.0 * 1024.0;
+
+  const auto total = memoryReport.getTotal();
+  ImGui::Text(
+    "Total: %.1f MiB in %u allocations",
+    static_cast<double>(total.bytes) / MIB,
+    total.allocations);
+
+  for (std::size_t i = 0; i < GpuMemoryReport::CATEGORY_COUNT; ++i)
+  {
+    const auto category = static_cast<GpuMemoryReport::Category>(i);
+    const auto usage = memoryReport.getTotal(category);
+    if (usage.allocations == 0)
+      continue;
+    const auto label = fmt::format(
+      "{}: {:.1f} MiB",
+      GpuMemoryReport::getName(category),
+      static_cast<double>(usage.bytes) / MIB);
+    if (!ImGui::TreeNode(GpuMemoryReport::getName(category), "%s", label.c_str()))
+      continue;
+    for (const auto& [key, groupUsage] : memoryReport.getGroups())
+      if (key.first == category)
+        ImGui::Text(
+          "%s: %.2f MiB (%u)",
+          key.second.c_str(),
+          static_cast<double>(groupUsage.bytes) / MIB,
+          groupUsage.allocations);
+    ImGui::TreePop();
+  }
+
+  if (!memoryReport.hasBudget())
+    ImGui::TextUnformatted("VK_EXT_memory_budget is not supported");
+  const auto& heaps = memoryReport.getHeaps();
+  for (std::size_t i = 0; i < heaps.size(); ++i)
+  {
+    const auto& heap = heaps[i];
+    ImGui::Text(
+      "Heap %zu (%s): %.0f / %.0f MiB, %.0f MiB total",
+      i,
+      heap.deviceLocal ? "device local" : "host",
+      static_cast<double>(heap.usage) / MIB,
+      static_cast<double>(heap.budget) / MIB,
+      static_cast<double>(heap.size) / MIB);
+    if (heap.budget > 0)
+      ImGui::ProgressBar(
+        static_cast<float>(static_cast<double>(heap.usage) / static_cast<double>(heap.budget)));
+  }
+}
+
+double WorldRenderer::getMainViewGpuTime() const
+{
+  double time = 0;
+  for (const auto& result : gpuTimer->getResults())
+    if (is_main_view_scope(result.name))
+      time += result.milliseconds;
+  return time;
+}
+
+double WorldRenderer::getLightCullingGpuTime() const
+{
+  double time = 0;
+  for (const auto& result : gpuTimer->getResults())
+    if (result.name == LIGHT_CLUSTERS_SCOPE)
+      time += result.milliseconds;
+  return time;
+}
+
+double WorldRenderer::getMainViewAttachmentTraffic() const
+{
+  double traffic = 0;
+  for (const auto& result : pipelineStats->getResults())
+    traffic += static_cast<double>(result.values[FRAGMENT_INVOCATIONS_STAT]) *
+      attachment_bytes_per_fragment(result.name);
+  if (shadingPath == ShadingPath::Deferred)
+    traffic +=
+      static_cast<double>(resolution.x) * resolution.y * DEFERRED_LIGHTING_BYTES_PER_PIXEL;
+  return traffic;
+}
+
+void WorldRenderer::reportFrameMetrics(BenchmarkRecorder& recorder) const
+{
+  for (const auto& result : gpuTimer->getResults())
+    recorder.record(fmt::format("GPU {} ms", result.name), result.milliseconds);
+
+  for (std::size_t i = 0; i < RenderCounters::COUNTER_COUNT; ++i)
+  {
+    const auto counter = static_cast<RenderCounters::Counter>(i);
+    recorder.record(
+      RenderCounters::getName(counter),
+      static_cast<double>(renderCounters.getLastFrame(counter)));
+  }
+
+  for (const auto& result : pipelineStats->getResults())
+  {
+    recorder.record(
+      fmt::format("{} vertices", result.name),
+      static_cast<double>(result.values[VERTEX_INVOCATIONS_STAT]));
+    recorder.record(
+      fmt::format("{} triangles", result.name),
+      static_cast<double>(result.values[CLIPPING_PRIMITIVES_STAT]));
+    recorder.record(
+      fmt::format("{} fragments", result.name),
+      static_cast<double>(result.values[FRAGMENT_INVOCATIONS_STAT]));
+  }
+
+  if (useGpuCulling)
+  {
+    const auto& stats = sceneCuller->getStats();
+    recorder.record("Visible instances", stats.visibleInstances);
+    recorder.record("Frustum culled instances", stats.frustumCulledInstances);
+    recorder.record("Occluded instances", stats.occludedInstances);
+  }
+  else if (useParallelRecording)
+    recorder.record("Command recording ms", lastRecordTimeMs);
+}
+
+void WorldRenderer::drawGui()
+{
+  ImGui::Begin("Simple render settings");
 
   float color[3]{uniformParams.baseColor.r, uniformParams.baseColor.g, uniformParams.baseColor.b};
   ImGui::ColorEdit3(
@@ -265,6 +2382,198 @@ void WorldRenderer::drawGui()
   ImGui::SliderFloat3("Light source position", pos, -10.f, 10.f);
   uniformParams.lightPos = {pos[0], pos[1], pos[2]};
 
+  if (const auto pendingPipelines = pipelineCompiler->getPendingJobs(); pendingPipelines > 0)
+    ImGui::Text("Compiling %u pipelines, some features are off until then", pendingPipelines);
+
+  ImGui::Checkbox("Position-only shadow pass", &useDepthOnlyShadows);
+  ImGui::Checkbox("Single-pass cascades (multiview)", &useMultiviewShadows);
+
+  if (ImGui::TreeNode("Shading path"))
+  {
+    ImGui::BeginDisabled(shadingBenchmark.isRunning());
+    int path = static_cast<int>(shadingPath);
+    ImGui::RadioButton("Forward", &path, static_cast<int>(ShadingPath::Forward));
+    ImGui::SameLine();
+    ImGui::RadioButton("Deferred", &path, static_cast<int>(ShadingPath::Deferred));
+    shadingPath = static_cast<ShadingPath>(path);
+    ImGui::EndDisabled();
+
+    ImGui::SliderFloat("Roughness", &uniformParams.roughness, 0.0f, 1.0f);
+    ImGui::SliderFloat("Metallic", &uniformParams.metallic, 0.0f, 1.0f);
+
+    ImGui::BeginDisabled(shadingBenchmark.isRunning());
+    if (ImGui::Button("Compare forward and deferred"))
+      startShadingBenchmark();
+    ImGui::EndDisabled();
+    for (const auto& result : shadingBenchmark.getResults())
+      ImGui::TextUnformatted(result.c_str());
+
+    // Not updated while the forward path records on worker threads
+    const auto& graphStats = renderGraph->getStats();
+    const auto toMiB = [](vk::DeviceSize bytes) { return static_cast<double>(bytes) / 1048576.0; };
+    ImGui::Text(
+      "Render graph: %u passes, %u culled",
+      graphStats.passes - graphStats.culledPasses,
+      graphStats.culledPasses);
+    ImGui::Text(
+      "%u image barriers in %u batches, %u merged reads",
+      graphStats.imageBarriers,
+      graphStats.barrierBatches,
+      graphStats.mergedReads);
+    ImGui::Text(
+      "%u transient images: %.2f MiB allocated, %.2f MiB saved",
+      graphStats.transientImages,
+      toMiB(graphStats.transientBytesAllocated),
+      toMiB(graphStats.transientBytesRequested - graphStats.transientBytesAllocated));
+
+    ImGui::TreePop();
+  }
+
+  if (ImGui::TreeNode("Point lights"))
+  {
+    ImGui::BeginDisabled(lightBenchmark.isRunning());
+    ImGui::SliderInt("Light count", &pointLightCount, 0, static_cast<int>(MAX_POINT_LIGHTS));
+    if (ImGui::Button("Measure light count scaling"))
+      startLightBenchmark();
+    ImGui::EndDisabled();
+
+    for (const auto& result : lightBenchmark.getResults())
+      ImGui::TextUnformatted(result.c_str());
+
+    ImGui::TreePop();
+  }
+
+  if (ImGui::TreeNode("Shader variants"))
+  {
+    ImGui::BeginDisabled(variantBenchmark.isRunning());
+    int filter = static_cast<int>(uniformParams.shadowFilter);
+    ImGui::RadioButton("Hard shadows", &filter, static_cast<int>(SHADOW_FILTER_HARD));
+    ImGui::SameLine();
+    ImGui::RadioButton("PCF 3x3", &filter, static_cast<int>(SHADOW_FILTER_PCF));
+    uniformParams.shadowFilter = static_cast<std::uint32_t>(filter);
+    ImGui::Checkbox("Specialized pipelines", &useSpecializedShaders);
+    if (ImGui::Button("Compare uniform branching and specialization"))
+      startVariantBenchmark();
+    ImGui::EndDisabled();
+
+    ImGui::Text("Specialized programs: %zu", shaderVariants->size());
+    for (const auto& result : variantBenchmark.getResults())
+      ImGui::TextUnformatted(result.c_str());
+
+    ImGui::TreePop();
+  }
+
+  if (ImGui::TreeNode("Depth prepass"))
+  {
+    ImGui::BeginDisabled(
+      (!useGpuCulling && useParallelRecording) || shadingPath == ShadingPath::Deferred);
+    ImGui::Checkbox("Enable depth prepass", &useDepthPrepass);
+    ImGui::EndDisabled();
+
+    // Both occlusion culling phases open their own scopes, they are summed up here
+    std::vector<std::pair<std::string, std::array<std::uint64_t, 2>>> passStats;
+    for (const auto& result : pipelineStats->getResults())
+    {
+      if (!is_main_view_scope(result.name))
+        continue;
+      auto it = std::ranges::find(passStats, result.name, &decltype(passStats)::value_type::first);
+      if (it == passStats.end())
+        it = passStats.insert(passStats.end(), {result.name, {}});
+      it->second[0] += result.values[CLIPPING_PRIMITIVES_STAT];
+      it->second[1] += result.values[FRAGMENT_INVOCATIONS_STAT];
+    }
+
+    const double pixelCount = static_cast<double>(resolution.x) * resolution.y;
+    for (const auto& [name, values] : passStats)
+      ImGui::Text(
+        "%s: %llu triangles, %llu fragments (%.2f per pixel)",
+        name.c_str(),
+        static_cast<unsigned long long>(values[0]),
+        static_cast<unsigned long long>(values[1]),
+        static_cast<double>(values[1]) / pixelCount);
+
+    ImGui::TreePop();
+  }
+
+  if (ImGui::TreeNode("Shadow cascades"))
+  {
+    ImGui::SliderFloat("Shadow distance", &shadowSettings.shadowDistance, 5.0f, 500.0f);
+    ImGui::SliderFloat("Split lambda", &shadowSettings.splitLambda, 0.0f, 1.0f);
+    ImGui::SliderFloat("Caster distance", &shadowSettings.casterDistance, 0.0f, 200.0f);
+    ImGui::Checkbox("Cache far cascades", &shadowSettings.cacheFarCascades);
+    ImGui::SliderInt(
+      "First cached cascade", &shadowSettings.firstCachedCascade, 0, SHADOW_CASCADE_COUNT - 1);
+    ImGui::SliderFloat("Cache threshold", &shadowSettings.cacheThreshold, 0.0f, 0.5f);
+
+    bool visualizeCascades = uniformParams.visualizeCascades != 0;
+    ImGui::Checkbox("Visualize cascades", &visualizeCascades);
+    uniformParams.visualizeCascades = visualizeCascades;
+
+    for (std::size_t i = 0; i < cascades.size(); ++i)
+      ImGui::Text(
+        "Cascade %zu: radius %.2f, %s",
+        i,
+        cascades[i].radius,
+        cascades[i].renderedLastFrame ? "rendered" : "cached");
+    for (const auto& result : gpuTimer->getResults())
+      ImGui::Text("%s: %.3f ms", result.name.c_str(), result.milliseconds);
+
+    ImGui::TreePop();
+  }
+
+  ImGui::BeginDisabled(scalingBenchmark.isRunning());
+  ImGui::Checkbox("GPU frustum culling", &useGpuCulling);
+  ImGui::EndDisabled();
+  if (!useGpuCulling)
+  {
+    ImGui::BeginDisabled(scalingBenchmark.isRunning());
+    ImGui::Checkbox("Multi-threaded recording", &useParallelRecording);
+    if (ImGui::SliderInt("Recording threads", &recordingThreadCount, 1, 16))
+      commandRecorder->setThreadCount(static_cast<std::uint32_t>(recordingThreadCount));
+    if (ImGui::Button("Measure recording scaling"))
+      startScalingBenchmark();
+    ImGui::EndDisabled();
+
+    if (useParallelRecording)
+      ImGui::Text("Command recording %.3f ms", lastRecordTimeMs);
+    for (const auto& result : scalingBenchmark.getResults())
+      ImGui::TextUnformatted(result.c_str());
+  }
+  else
+  {
+    ImGui::Checkbox("Occlusion culling (two-phase Hi-Z)", &useOcclusionCulling);
+
+    const auto& stats = sceneCuller->getStats();
+    ImGui::Text("Visible instances: %u", stats.visibleInstances);
+    ImGui::Text("Frustum culled instances: %u", stats.frustumCulledInstances);
+    ImGui::Text("Occluded instances: %u", stats.occludedInstances);
+  }
+
+  ImGui::Text(
+    "Frame data: %.1f / %.1f KiB",
+    static_cast<double>(frameData->getFrameUsage()) / 1024.0,
+    static_cast<double>(frameData->getFrameCapacity()) / 1024.0);
+  ImGui::Text("Cached descriptor sets: %zu", descriptorSets->size());
+
+  if (ImGui::TreeNode("Work counters"))
+  {
+    drawWorkCounters();
+    ImGui::TreePop();
+  }
+
+  if (ImGui::TreeNode("Frame timings"))
+  {
+    drawFrameTimings();
+    ImGui::TreePop();
+  }
+
+  if (ImGui::TreeNode("GPU memory"))
+  {
+    updateMemoryReport();
+    drawMemoryReport();
+    ImGui::TreePop();
+  }
+
   ImGui::Text(
     "Application average %.3f ms/frame (%.1f FPS)",
     1000.0f / ImGui::GetIO().Framerate,
@@ -273,5 +2582,7 @@ void WorldRenderer::drawGui()
   ImGui::NewLine();
 
   ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Press 'B' to recompile and reload shaders");
+  ImGui::TextColored(
+    ImVec4(1.0f, 1.0f, 0.0f, 1.0f), "Press 'C' to record the camera path, 'P' to play it back");
   ImGui::End();
 }
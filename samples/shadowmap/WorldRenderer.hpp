@@ -1,17 +1,43 @@
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <map>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
 #include <etna/Image.hpp>
 #include <etna/Sampler.hpp>
 #include <etna/Buffer.hpp>
-#include <etna/GraphicsPipeline.hpp>
 #include <glm/glm.hpp>
 
 #include "shaders/UniformParams.h"
 #include "scene/SceneManager.hpp"
+#include "scene/SceneCuller.hpp"
+#include "scene/LightClusters.hpp"
 #include "render_utils/QuadRenderer.hpp"
+#include "render_utils/ParallelCommandRecorder.hpp"
+#include "render_utils/FrameRingBuffer.hpp"
+#include "render_utils/DescriptorSetCache.hpp"
+#include "render_utils/BenchmarkRecorder.hpp"
+#include "render_utils/BenchmarkSweep.hpp"
+#include "render_utils/GpuTimer.hpp"
+#include "render_utils/FrameTimeHistory.hpp"
+#include "render_utils/RenderCounters.hpp"
+#include "render_utils/GpuMemoryReport.hpp"
+#include "render_utils/OffscreenFrames.hpp"
+#include "render_utils/PipelineStatistics.hpp"
+#include "render_utils/PipelineCompiler.hpp"
+#include "render_utils/ShaderHotReloader.hpp"
+#include "render_utils/DeferredDeletionQueue.hpp"
+#include "render_utils/ShaderVariants.hpp"
+#include "render_utils/RenderGraph.hpp"
 #include "wsi/Keyboard.hpp"
 
 #include "FramePacket.hpp"
+#include "MultiviewDepthPipelines.hpp"
 
 
 /**
@@ -21,62 +47,328 @@
 class WorldRenderer
 {
 public:
-  WorldRenderer();
+  // Pipelines are created with the cache. Headless renderers pass the images they render to,
+  // so that memory reports include them.
+  explicit WorldRenderer(
+    PipelineCache& pipeline_cache, const OffscreenFrames* offscreen_frames = nullptr);
 
   void loadScene(std::filesystem::path path);
 
   void loadShaders();
   void allocateResources(glm::uvec2 swapchain_resolution);
   void setupPipelines(vk::Format swapchain_format);
+  // Pipelines are compiled in the background after setupPipelines
+  bool arePipelinesReady() const;
 
   void debugInput(const Keyboard& kb);
   void update(const FramePacket& packet);
   void drawGui();
   void renderWorld(
     vk::CommandBuffer cmd_buf, vk::Image target_image, vk::ImageView target_image_view);
+  // GPU times and counters of the latest frame that was read back
+  void reportFrameMetrics(BenchmarkRecorder& recorder) const;
+  // Passes recorded after renderWorld, like the GUI, may add their own scopes
+  GpuTimer& getGpuTimer() { return *gpuTimer; }
 
 private:
+  enum class ShadingPath
+  {
+    Forward,
+    // Packed G-buffer followed by a single full-screen lighting dispatch
+    Deferred,
+  };
+
+  static constexpr std::size_t GBUFFER_TARGET_COUNT = 3;
+
+  // Values of the specialization constants of shading.glsl, indexed by constant_id
+  using ShadingConstants = std::array<std::uint32_t, SHADING_CONSTANT_COUNT>;
+
+  // Everything needed to create a pipeline again once the shaders of its program change
+  struct GraphicsPipelineDesc
+  {
+    AsyncPipeline<CompiledPipeline>* pipeline;
+    std::string_view program;
+    CompiledPipeline::GraphicsCreateInfo info;
+  };
+
+  void allocateRenderTargets(glm::uvec2 render_resolution);
+  void submitPipelines(fu2::function_view<bool(std::string_view)> affected);
+  void reloadChangedShaders();
+  // Current name of a program, it changes every time the program is reloaded
+  const char* programName(std::string_view program) const;
+  ShadingConstants shadingConstants() const;
+  // The variant for the current constants, or the generic pipeline while it compiles
+  CompiledPipeline& specialized(AsyncPipeline<CompiledPipeline>& generic);
+  CompiledPipeline& specializedDeferredLighting();
+  void uploadFrameData();
+  etna::ImageBinding shadowMapBinding() const;
+  vk::DescriptorSet getDescriptorSet(
+    vk::CommandBuffer cmd_buf,
+    etna::DescriptorLayoutId layout_id,
+    const std::vector<etna::Binding>& bindings,
+    std::span<const DescriptorSetCache::RawImageBinding> raw_images = {});
+  // Counted binds, safe to call from recording workers
+  void bindPipeline(
+    vk::CommandBuffer cmd_buf, vk::PipelineBindPoint bind_point, vk::Pipeline pipeline);
   void renderScene(
-    vk::CommandBuffer cmd_buf, const glm::mat4x4& glob_tm, vk::PipelineLayout pipeline_layout);
+    vk::CommandBuffer cmd_buf,
+    const glm::mat4x4& glob_tm,
+    vk::PipelineLayout pipeline_layout,
+    vk::Buffer vertex_buffer,
+    std::span<const std::uint32_t> instances);
+  void renderSceneGpuDriven(
+    vk::CommandBuffer cmd_buf,
+    const glm::mat4x4& glob_tm,
+    vk::PipelineLayout pipeline_layout,
+    vk::Buffer vertex_buffer);
+  void updateShadowCascades(const Camera& main_cam, const Camera& light_cam);
+  void cullShadowCascade(std::size_t cascade_idx);
+  void cullShadowCascadesMultiview(std::uint32_t view_mask);
+  glm::mat4x4 multiviewCullingMatrix(std::uint32_t view_mask) const;
+  std::uint32_t takeCascadesToRender();
+  void renderShadowMap(vk::CommandBuffer cmd_buf);
+  void renderShadowMapMultiview(vk::CommandBuffer cmd_buf, std::uint32_t view_mask);
+  void renderDepthPrepass(vk::CommandBuffer cmd_buf, vk::AttachmentLoadOp load_op);
+  void renderForward(
+    vk::CommandBuffer cmd_buf,
+    vk::Image target_image,
+    vk::ImageView target_image_view,
+    vk::AttachmentLoadOp load_op);
+  void addLightClusterBindings(std::vector<etna::Binding>& bindings);
+  void cullLights(vk::CommandBuffer cmd_buf);
+  void renderMainView(
+    vk::CommandBuffer cmd_buf,
+    vk::Image target_image,
+    vk::ImageView target_image_view,
+    vk::AttachmentLoadOp load_op);
+  void renderGBuffer(vk::CommandBuffer cmd_buf, vk::AttachmentLoadOp load_op);
+  void renderDeferredLighting(
+    vk::CommandBuffer cmd_buf,
+    const std::array<vk::ImageView, GBUFFER_TARGET_COUNT>& gbuffer_views,
+    vk::ImageView output_view);
+  void buildFrameGraph(vk::Image target_image, vk::ImageView target_image_view);
+  void disablePendingFeatures();
+  void renderFrame(
+    vk::CommandBuffer cmd_buf, vk::Image target_image, vk::ImageView target_image_view);
+  void renderWorldParallel(
+    vk::CommandBuffer cmd_buf, vk::Image target_image, vk::ImageView target_image_view);
+  void addSceneRecordingTasks(
+    std::vector<ParallelCommandRecorder::Task>& tasks,
+    vk::Pipeline pipeline,
+    vk::PipelineLayout pipeline_layout,
+    std::vector<vk::DescriptorSet> sets,
+    vk::Buffer vertex_buffer,
+    std::span<const std::uint32_t> instances,
+    vk::Rect2D rect,
+    const glm::mat4x4& glob_tm,
+    std::optional<vk::Format> color_format,
+    vk::Format depth_format,
+    std::uint32_t view_mask = 0);
+  // Sweeps live in WorldRendererBenchmarks.cpp
+  void startScalingBenchmark();
+  void startShadingBenchmark();
+  void startLightBenchmark();
+  void startVariantBenchmark();
+  void updateBenchmarks();
+  // From the latest GPU results, which lag behind by the frames in flight
+  double getMainViewGpuTime() const;
+  double getLightCullingGpuTime() const;
+  // Estimated from fragment invocations and attachment sizes, in bytes
+  double getMainViewAttachmentTraffic() const;
+  void pushFrameTimes();
+  void drawFrameTimings() const;
+  void drawWorkCounters() const;
+  void updateMemoryReport();
+  void drawMemoryReport() const;
 
 
 private:
   std::unique_ptr<SceneManager> sceneMgr;
+  // Sets are written once and reused until the resources they reference change
+  std::unique_ptr<DescriptorSetCache> descriptorSets;
+  std::unique_ptr<SceneCuller> sceneCuller;
+  std::unique_ptr<LightClusters> lightClusters;
 
   etna::Image mainViewDepth;
+  // The G-buffer, the lighting output and the Hi-Z pyramid are transient images of the
+  // render graph. The G-buffer passes leave the views of this frame here for renderGBuffer.
+  std::unique_ptr<RenderGraph> renderGraph;
+  std::array<vk::ImageView, GBUFFER_TARGET_COUNT> gbufferViews{};
+  // Only exists while the main view is rendered at a resolution other than the target's
+  etna::Image offscreenTarget;
+  // Every cascade is a layer, the array view is sampled and the layer views are rendered to
   etna::Image shadowMap;
+  vk::UniqueImageView shadowMapArrayView;
+  std::array<vk::UniqueImageView, SHADOW_CASCADE_COUNT> shadowMapLayerViews;
   etna::Sampler defaultSampler;
-  etna::Buffer constants;
 
-  struct PushConstants
-  {
-    glm::mat4x4 projView;
-    glm::mat4x4 model;
-  } pushConst2M;
+  // Frame constants and per-draw model matrices, rewritten every frame
+  std::unique_ptr<FrameRingBuffer> frameData;
+  FrameRingBuffer::Allocation frameConstants;
+  FrameRingBuffer::Allocation drawMatrices;
+  // Cascades each instance is visible in, only written for multiview CPU culling
+  FrameRingBuffer::Allocation drawViewMasks;
+
+  std::unique_ptr<GpuTimer> gpuTimer;
+  std::unique_ptr<PipelineStatistics> pipelineStats;
+  // CPU time between renderWorld calls next to the GPU times read back at that point
+  FrameTimeHistory frameTimes;
+  std::optional<std::chrono::steady_clock::time_point> lastFrameStart;
+  // Recording workers add to these too
+  RenderCounters renderCounters;
+  // Rebuilt on scene load and every frame the GUI shows it
+  GpuMemoryReport memoryReport;
+  const OffscreenFrames* offscreenFrames = nullptr;
+  PipelineCache* pipelineCache = nullptr;
+
+  // The scene is static, so world space bounding spheres are computed once per scene load
+  std::vector<glm::vec4> instanceSpheres;
+  std::vector<std::uint32_t> allInstances;
+  // Instances visible in at least one of the cascades of a multiview pass
+  std::vector<std::uint32_t> multiviewInstances;
+  std::vector<std::uint32_t> instanceViewMasks;
 
   glm::mat4x4 worldViewProj;
-  glm::mat4x4 lightMatrix;
   glm::vec3 lightPos;
 
-  struct ShadowMapCam
+  // Main camera, light clusters are built in its view space
+  glm::mat4x4 mainViewTm{1.0f};
+  glm::mat4x4 mainProjTm{1.0f};
+  float mainZNear = 0;
+  float mainZFar = 0;
+
+  // Scattered over the scene bounds on load, the first pointLightCount ones are used.
+  // Origins keep the animation phase in w.
+  std::vector<glm::vec4> pointLightOrigins;
+  std::vector<PointLight> pointLights;
+  int pointLightCount = 1024;
+
+  struct ShadowCascade
   {
-    float radius = 10;
-    float lightTargetDist = 24;
-    bool usePerspectiveM = false;
-  } lightProps;
+    glm::mat4x4 projView{1.0f};
+    // Texel-snapped center in light view space and the radius of the covered sphere
+    glm::vec3 center{};
+    float radius = 0;
+    float zNear = 0;
+    float zFar = 0;
+    glm::quat lightRotation{};
+    bool needsRender = true;
+    bool renderedLastFrame = false;
+    // Filled by CPU culling right before the cascade is recorded
+    std::vector<std::uint32_t> visibleInstances;
+  };
+  std::array<ShadowCascade, SHADOW_CASCADE_COUNT> cascades;
+
+  struct ShadowSettings
+  {
+    float shadowDistance = 60.0f;
+    // Blend between uniform (0) and logarithmic (1) split distances
+    float splitLambda = 0.75f;
+    // Casters this far behind a cascade along the light direction still shadow it
+    float casterDistance = 40.0f;
+    // Cascades starting from firstCachedCascade only contain static geometry, so they are
+    // re-rendered only when the light turns or the camera moves by cacheThreshold of a radius
+    bool cacheFarCascades = true;
+    int firstCachedCascade = 2;
+    float cacheThreshold = 0.1f;
+  } shadowSettings;
 
   UniformParams uniformParams{
-    .lightMatrix = {},
+    .cascadeMatrices = {},
     .lightPos = {},
     .time = {},
     .baseColor = {0.9f, 0.92f, 1.0f},
+    .visualizeCascades = false,
+    .invProjView = {},
+    .cameraPos = {},
+    .roughness = 1.0f,
+    .metallic = 0.0f,
+    .shadowFilter = SHADOW_FILTER_HARD,
+    ._padding1 = {},
+    ._padding2 = {},
   };
 
-  etna::GraphicsPipeline basicForwardPipeline{};
-  etna::GraphicsPipeline shadowPipeline{};
+  // Programs are recreated under a new name when their shaders change
+  std::unique_ptr<ShaderHotReloader> shaderReloader;
+  std::map<std::string, std::string, std::less<>> programNames;
+  std::uint32_t programVersion = 0;
+
+  // Replaced pipelines and render targets stay alive until the frames that used them are done
+  std::unique_ptr<DeferredDeletionQueue> retiredResources;
+  std::vector<GraphicsPipelineDesc> graphicsPipelines;
+  AsyncPipeline<CompiledPipeline> basicForwardPipeline;
+  AsyncPipeline<CompiledPipeline> shadowPipeline;
+  AsyncPipeline<CompiledPipeline> gpuDrivenForwardPipeline;
+  AsyncPipeline<CompiledPipeline> gpuDrivenShadowPipeline;
+  // Shadow pipelines fetching the full vertex, kept to compare against the depth-only ones
+  AsyncPipeline<CompiledPipeline> fullVertexShadowPipeline;
+  AsyncPipeline<CompiledPipeline> gpuDrivenFullVertexShadowPipeline;
+  // Position-only main view depth and the forward pass that only shades what it left visible
+  AsyncPipeline<CompiledPipeline> depthPrepassPipeline;
+  AsyncPipeline<CompiledPipeline> gpuDrivenDepthPrepassPipeline;
+  AsyncPipeline<CompiledPipeline> forwardAfterPrepassPipeline;
+  AsyncPipeline<CompiledPipeline> gpuDrivenForwardAfterPrepassPipeline;
+  AsyncPipeline<CompiledPipeline> gbufferPipeline;
+  AsyncPipeline<CompiledPipeline> gpuDrivenGbufferPipeline;
+  AsyncPipeline<CompiledPipeline> deferredLightingPipeline;
+  // Forward and deferred lighting pipelines with the shading.glsl constants baked in, so that
+  // the branches on them are compiled out. One exists for every permutation rendered with.
+  bool useSpecializedShaders = true;
+  std::unique_ptr<ShaderVariants> shaderVariants;
+  std::map<
+    std::pair<AsyncPipeline<CompiledPipeline>*, ShadingConstants>,
+    AsyncPipeline<CompiledPipeline>>
+    graphicsVariants;
+  std::map<ShadingConstants, AsyncPipeline<CompiledPipeline>> deferredLightingVariants;
+  // Declared after the pipelines, so that it finishes its jobs before they are destroyed
+  std::unique_ptr<PipelineCompiler> pipelineCompiler;
+
+  ShadingPath shadingPath = ShadingPath::Forward;
+
+  // Lays down main view depth first, so every pixel is shaded at most once.
+  // Not used by the multi-threaded recording path.
+  bool useDepthPrepass = false;
+
+  // Shadow passes read the position-only stream and skip all attribute decoding
+  bool useDepthOnlyShadows = true;
+
+  // Renders all cascades in one pass with VK_KHR_multiview, so the number of draws
+  // does not depend on the cascade count. Always uses the position-only stream.
+  bool useMultiviewShadows = true;
+  std::unique_ptr<MultiviewDepthPipelines> multiviewShadowPipelines;
+  std::unique_ptr<MultiviewDepthPipelines> gpuDrivenMultiviewShadowPipelines;
+
+  // Culls instances on the GPU and draws the whole scene with one indirect draw
+  bool useGpuCulling = true;
+  // Additionally tests instances against a Hi-Z pyramid of the main view depth
+  bool useOcclusionCulling = true;
+
+  // Records the CPU-driven shadow and forward passes concurrently on worker threads
+  bool useParallelRecording = false;
+  int recordingThreadCount = 4;
+  std::unique_ptr<ParallelCommandRecorder> commandRecorder;
+  double lastRecordTimeMs = 0;
+
+  // Recording time for every thread count of the parallel path
+  BenchmarkSweep scalingBenchmark;
+
+  // Renders the main view at fixed resolutions with both shading paths
+  BenchmarkSweep shadingBenchmark;
+  // Main view resolution of the running sweep step, kept when the window is resized
+  std::optional<glm::uvec2> benchmarkResolution;
+
+  // Measures light culling and main view shading with an increasing number of point lights
+  BenchmarkSweep lightBenchmark;
+
+  // Main view GPU time with uniform branching and with specialized pipelines
+  BenchmarkSweep variantBenchmark;
+
+  vk::Format targetFormat = vk::Format::eUndefined;
 
   std::unique_ptr<QuadRenderer> quadRenderer;
   bool drawDebugFSQuad = false;
 
+  // Main view resolution, differs from the target one only during benchmarks
   glm::uvec2 resolution;
+  glm::uvec2 targetResolution;
 };
@@ -0,0 +1,161 @@
+#include "WorldRenderer.hpp"
+
+#include <array>
+
+#include <fmt/format.h>
+
+
+static constexpr std::array SCALING_BENCHMARK_THREAD_COUNTS{1u, 2u, 4u, 8u, 16u};
+static constexpr std::string_view RECORD_TIME_METRIC = "recording ms";
+
+// Every resolution is measured with the forward path first, then with the deferred one
+static constexpr std::array SHADING_BENCHMARK_RESOLUTIONS{
+  glm::uvec2{1920, 1080}, glm::uvec2{3840, 2160}};
+static constexpr std::string_view MAIN_VIEW_TIME_METRIC = "main view ms";
+static constexpr std::string_view TRAFFIC_METRIC = "attachment traffic MiB";
+
+static constexpr std::array LIGHT_BENCHMARK_COUNTS{256u, 512u, 1024u, 2048u, 4096u, 8192u};
+static constexpr std::string_view LIGHT_CULLING_TIME_METRIC = "light culling ms";
+
+// Every shadow filter is measured with uniform branching first, then with specialized pipelines
+static constexpr std::array VARIANT_BENCHMARK_FILTERS{SHADOW_FILTER_HARD, SHADOW_FILTER_PCF};
+
+void WorldRenderer::startScalingBenchmark()
+{
+  scalingBenchmark.start(BenchmarkSweep::Steps{
+    .name = "Recording scaling",
+    .count = SCALING_BENCHMARK_THREAD_COUNTS.size(),
+    .apply =
+      [this](std::size_t step) {
+        useParallelRecording = true;
+        commandRecorder->setThreadCount(SCALING_BENCHMARK_THREAD_COUNTS[step]);
+      },
+    // Recording is only timed on the parallel path
+    .isReady = [this]() { return !useGpuCulling && useParallelRecording; },
+    .measure =
+      [this](BenchmarkRecorder& recorder) {
+        recorder.record(RECORD_TIME_METRIC, lastRecordTimeMs);
+      },
+    .describe =
+      [singleThreadMs = 0.0](std::size_t step, const BenchmarkSweep::StepResult& result) mutable {
+        const double recordTime = result.mean(RECORD_TIME_METRIC);
+        if (step == 0)
+          singleThreadMs = recordTime;
+        return fmt::format(
+          "{:>2} threads, {:.3f} ms, x{:.2f}",
+          SCALING_BENCHMARK_THREAD_COUNTS[step],
+          recordTime,
+          singleThreadMs / recordTime);
+      },
+    .restore =
+      [this, prevUseParallelRecording = useParallelRecording]() {
+        useParallelRecording = prevUseParallelRecording;
+        commandRecorder->setThreadCount(static_cast<std::uint32_t>(recordingThreadCount));
+      },
+  });
+}
+
+void WorldRenderer::startShadingBenchmark()
+{
+  // Render targets are replaced right after a frame was recorded, the old ones are retired
+  shadingBenchmark.start(BenchmarkSweep::Steps{
+    .name = "Shading benchmark",
+    .count = SHADING_BENCHMARK_RESOLUTIONS.size() * 2,
+    .apply =
+      [this](std::size_t step) {
+        shadingPath = step % 2 == 0 ? ShadingPath::Forward : ShadingPath::Deferred;
+        benchmarkResolution = SHADING_BENCHMARK_RESOLUTIONS[step / 2];
+        allocateRenderTargets(*benchmarkResolution);
+      },
+    .measure =
+      [this](BenchmarkRecorder& recorder) {
+        recorder.record(MAIN_VIEW_TIME_METRIC, getMainViewGpuTime());
+        recorder.record(TRAFFIC_METRIC, getMainViewAttachmentTraffic() / (1024.0 * 1024.0));
+      },
+    .describe =
+      [this](std::size_t, const BenchmarkSweep::StepResult& result) {
+        return fmt::format(
+          "{:<8} {}x{}, {:.3f} ms, ~{:.1f} MiB of attachment traffic",
+          shadingPath == ShadingPath::Forward ? "forward" : "deferred",
+          resolution.x,
+          resolution.y,
+          result.mean(MAIN_VIEW_TIME_METRIC),
+          result.mean(TRAFFIC_METRIC));
+      },
+    .restore =
+      [this, prevShadingPath = shadingPath]() {
+        shadingPath = prevShadingPath;
+        benchmarkResolution.reset();
+        allocateRenderTargets(targetResolution);
+      },
+  });
+}
+
+void WorldRenderer::startLightBenchmark()
+{
+  lightBenchmark.start(BenchmarkSweep::Steps{
+    .name = "Light benchmark",
+    .count = LIGHT_BENCHMARK_COUNTS.size(),
+    .apply =
+      [this](std::size_t step) {
+        pointLightCount = static_cast<int>(LIGHT_BENCHMARK_COUNTS[step]);
+      },
+    .measure =
+      [this](BenchmarkRecorder& recorder) {
+        recorder.record(LIGHT_CULLING_TIME_METRIC, getLightCullingGpuTime());
+        recorder.record(MAIN_VIEW_TIME_METRIC, getMainViewGpuTime());
+      },
+    .describe =
+      [](std::size_t step, const BenchmarkSweep::StepResult& result) {
+        return fmt::format(
+          "{:>4} lights, culling {:.3f} ms, shading {:.3f} ms",
+          LIGHT_BENCHMARK_COUNTS[step],
+          result.mean(LIGHT_CULLING_TIME_METRIC),
+          result.mean(MAIN_VIEW_TIME_METRIC));
+      },
+    .restore =
+      [this, prevPointLightCount = pointLightCount]() { pointLightCount = prevPointLightCount; },
+  });
+}
+
+void WorldRenderer::startVariantBenchmark()
+{
+  variantBenchmark.start(BenchmarkSweep::Steps{
+    .name = "Variant benchmark",
+    .count = VARIANT_BENCHMARK_FILTERS.size() * 2,
+    .apply =
+      [this](std::size_t step) {
+        uniformParams.shadowFilter = VARIANT_BENCHMARK_FILTERS[step / 2];
+        useSpecializedShaders = step % 2 == 1;
+      },
+    // The specialized pipelines of a step have to be compiled, or the generic ones get measured
+    .isReady = [this]() { return pipelineCompiler->getPendingJobs() == 0; },
+    .measure =
+      [this](BenchmarkRecorder& recorder) {
+        recorder.record(MAIN_VIEW_TIME_METRIC, getMainViewGpuTime());
+      },
+    .describe =
+      [](std::size_t step, const BenchmarkSweep::StepResult& result) {
+        return fmt::format(
+          "{:<4} {:<17} {:.3f} ms",
+          VARIANT_BENCHMARK_FILTERS[step / 2] == SHADOW_FILTER_PCF ? "PCF" : "hard",
+          step % 2 == 1 ? "specialized" : "uniform branching",
+          result.mean(MAIN_VIEW_TIME_METRIC));
+      },
+    .restore =
+      [this,
+       prevShadowFilter = uniformParams.shadowFilter,
+       prevUseSpecializedShaders = useSpecializedShaders]() {
+        uniformParams.shadowFilter = prevShadowFilter;
+        useSpecializedShaders = prevUseSpecializedShaders;
+      },
+  });
+}
+
+void WorldRenderer::updateBenchmarks()
+{
+  scalingBenchmark.update();
+  shadingBenchmark.update();
+  lightBenchmark.update();
+  variantBenchmark.update();
+}
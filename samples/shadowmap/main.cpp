@@ -1,11 +1,24 @@
+#include <span>
+
+#include "render_utils/RunOptions.hpp"
+
 #include "App.hpp"
 
 
-int main()
+int main(int argc, char** argv)
 {
+  const auto options = parse_run_options(
+    std::span(argv, static_cast<std::size_t>(argc)).subspan(argc > 0 ? 1 : 0),
+    "Usage: shadowmap [--headless] [--frames N] [--resolution WIDTHxHEIGHT]\n"
+    "  [--benchmark] [--camera-path FILE] [--benchmark-output PREFIX]\n"
+    "  [--baseline SUMMARY_CSV] [--threshold FRACTION]");
+  if (!options)
+    return 1;
+
+  bool succeeded = false;
   {
-    App app;
-    app.run();
+    App app{*options};
+    succeeded = app.run();
   }
 
   // Etna needs to be de-initialized after all resources allocated by app
@@ -13,5 +26,5 @@ int main()
   if (etna::is_initilized())
     etna::shutdown();
 
-  return 0;
+  return succeeded ? 0 : 1;
 }
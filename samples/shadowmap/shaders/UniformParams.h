@@ -4,12 +4,38 @@
 #include "cpp_glsl_compat.h"
 
 
+// Every cascade is a layer of a single depth array, which is also the multiview view index
+#define SHADOW_CASCADE_COUNT 4
+#define SHADOW_CASCADE_RESOLUTION 2048
+
+#define SHADOW_FILTER_HARD 0u
+// 3x3 depth comparisons averaged together
+#define SHADOW_FILTER_PCF 1u
+
+// Specialization constants of shading.glsl, indices into a ShaderVariants permutation
+#define SHADOW_FILTER_CONSTANT_ID 0
+#define VISUALIZE_CASCADES_CONSTANT_ID 1
+#define SHADING_CONSTANT_COUNT 2
+// Default of every constant, the shader falls back to the uniform of the same setting
+#define VARIANT_DYNAMIC 0xFFFFFFFFu
+
 struct UniformParams
 {
-  shader_mat4 lightMatrix;
+  shader_mat4 cascadeMatrices[SHADOW_CASCADE_COUNT];
   shader_vec3 lightPos;
   shader_float time;
+  // Tints the base color of every material
   shader_vec3 baseColor;
+  shader_bool visualizeCascades;
+  // Deferred lighting reconstructs world positions from depth
+  shader_mat4 invProjView;
+  shader_vec3 cameraPos;
+  // Uniform for the whole scene, materials only provide the base color
+  shader_float roughness;
+  shader_float metallic;
+  shader_uint shadowFilter;
+  shader_float _padding1;
+  shader_float _padding2;
 };
 
 
@@ -0,0 +1,42 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_multiview : require
+
+#include "UniformParams.h"
+
+
+layout(location = 0) in vec3 vPos;
+
+layout(binding = 0, set = 0) uniform AppData
+{
+  UniformParams params;
+};
+
+// Written every frame, every draw passes its index as firstInstance
+layout(std430, binding = 2) readonly buffer DrawMatrices_t
+{
+  mat4 drawMatrices[];
+};
+
+// Bit N is set when the instance survived culling against cascade N
+layout(std430, binding = 3) readonly buffer DrawViewMasks_t
+{
+  uint drawViewMasks[];
+};
+
+
+out gl_PerVertex { vec4 gl_Position; };
+void main(void)
+{
+  // Every vertex of a culled instance lands on the same point behind the near plane,
+  // so its triangles are dropped before rasterization
+  if ((drawViewMasks[gl_InstanceIndex] & (1u << gl_ViewIndex)) == 0u)
+  {
+    gl_Position = vec4(0.0, 0.0, -1.0, 1.0);
+    return;
+  }
+
+  gl_Position =
+    params.cascadeMatrices[gl_ViewIndex] * (drawMatrices[gl_InstanceIndex] * vec4(vPos, 1.0));
+}
@@ -0,0 +1,65 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_ARB_shader_draw_parameters : require
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_multiview : require
+
+#include "UniformParams.h"
+
+
+struct Bounds
+{
+  vec4 minPos;
+  vec4 maxPos;
+};
+
+layout(location = 0) in vec3 vPos;
+
+layout(binding = 0, set = 0) uniform AppData
+{
+  UniformParams params;
+};
+
+// Filled by the GPU culling pass, see SceneCuller
+layout(std430, binding = 2, set = 0) readonly buffer InstanceMatrices_t
+{
+  mat4 instanceMatrices[];
+};
+
+layout(std430, binding = 3, set = 0) readonly buffer DrawInstanceIndices_t
+{
+  uint drawInstanceIndices[];
+};
+
+// One indirect command is issued per relem, so gl_DrawID indexes relem bounds
+layout(std430, binding = 4, set = 0) readonly buffer Bounds_t
+{
+  Bounds relemBounds[];
+};
+
+
+out gl_PerVertex { vec4 gl_Position; };
+void main(void)
+{
+  const mat4 mModel = instanceMatrices[drawInstanceIndices[gl_InstanceIndex]];
+  const mat4 mvp = params.cascadeMatrices[gl_ViewIndex] * mModel;
+
+  // Instances were culled against all cascades at once, this is the per-view part.
+  // Cascades are orthographic, so the clip space box of the bounds is exact.
+  const Bounds bounds = relemBounds[gl_DrawIDARB];
+  const vec3 center = (bounds.minPos.xyz + bounds.maxPos.xyz) * 0.5;
+  const vec3 extent = (bounds.maxPos.xyz - bounds.minPos.xyz) * 0.5;
+  const vec3 clipCenter = (mvp * vec4(center, 1.0)).xyz;
+  const vec3 clipExtent =
+    abs(mvp[0].xyz) * extent.x + abs(mvp[1].xyz) * extent.y + abs(mvp[2].xyz) * extent.z;
+
+  const bool outside = any(greaterThan(abs(clipCenter.xy) - clipExtent.xy, vec2(1.0)))
+    || clipCenter.z - clipExtent.z > 1.0 || clipCenter.z + clipExtent.z < 0.0;
+  if (outside)
+  {
+    gl_Position = vec4(0.0, 0.0, -1.0, 1.0);
+    return;
+  }
+
+  gl_Position = mvp * vec4(vPos, 1.0);
+}
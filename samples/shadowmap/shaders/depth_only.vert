@@ -0,0 +1,26 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+
+layout(location = 0) in vec3 vPos;
+
+layout(push_constant) uniform params_t
+{
+  mat4 mProjView;
+} params;
+
+// Written every frame, every draw passes its index as firstInstance
+layout(std430, binding = 2) readonly buffer DrawMatrices_t
+{
+  mat4 drawMatrices[];
+};
+
+
+// Invariant, so the depth prepass and the forward pass produce bit-identical depth
+out gl_PerVertex { invariant vec4 gl_Position; };
+void main(void)
+{
+  // Same operations as in simple.vert, the result has to match it exactly
+  const vec3 wPos = (drawMatrices[gl_InstanceIndex] * vec4(vPos, 1.0)).xyz;
+  gl_Position = params.mProjView * vec4(wPos, 1.0);
+}
@@ -0,0 +1,32 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+
+layout(location = 0) in vec3 vPos;
+
+layout(push_constant) uniform params_t
+{
+  mat4 mProjView;
+} params;
+
+// Filled by the GPU culling pass, see SceneCuller
+layout(std430, binding = 2, set = 0) readonly buffer InstanceMatrices_t
+{
+  mat4 instanceMatrices[];
+};
+
+layout(std430, binding = 3, set = 0) readonly buffer DrawInstanceIndices_t
+{
+  uint drawInstanceIndices[];
+};
+
+
+out gl_PerVertex { invariant vec4 gl_Position; };
+void main(void)
+{
+  const mat4 mModel = instanceMatrices[drawInstanceIndices[gl_InstanceIndex]];
+
+  // Same operations as in simple_indirect.vert, the result has to match it exactly
+  const vec3 wPos = (mModel * vec4(vPos, 1.0)).xyz;
+  gl_Position = params.mProjView * vec4(wPos, 1.0);
+}
@@ -0,0 +1,36 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
+
+#include "UniformParams.h"
+#include "bindless.glsl"
+#include "octahedral.glsl"
+
+
+// Layout of the G-buffer, depth comes from the main view depth buffer
+layout(location = 0) out vec2 out_normal;   // R16G16 snorm, octahedral
+layout(location = 1) out vec4 out_albedo;   // R8G8B8A8 unorm
+layout(location = 2) out vec2 out_material; // R8G8 unorm, roughness and metallic
+
+layout(location = 0) in VS_OUT
+{
+  vec3 wPos;
+  vec3 wNorm;
+  vec3 wTangent;
+  vec2 texCoord;
+  flat uint material;
+} surf;
+
+layout(binding = 0, set = 0) uniform AppData
+{
+  UniformParams params;
+};
+
+void main()
+{
+  out_normal = oct_encode(normalize(surf.wNorm));
+  const vec3 albedo = params.baseColor * material_base_color(surf.material, surf.texCoord).rgb;
+  out_albedo = vec4(albedo, 1.0f);
+  out_material = vec2(params.roughness, params.metallic);
+}
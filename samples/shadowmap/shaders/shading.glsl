@@ -0,0 +1,121 @@
+#ifndef SHADING_GLSL_INCLUDED
+#define SHADING_GLSL_INCLUDED
+
+// Lighting shared by the forward and the deferred paths, so both produce the same image.
+// Expects `params` (UniformParams) and `shadowMap` to be declared by the including shader.
+
+// Point lights binned by LightClusters take up bindings 8 to 10
+#define CLUSTERED_LIGHTS_BINDING 8
+#include "clustered_lights.glsl"
+
+// Pipelines specialized by ShaderVariants have these folded into constants, generic ones
+// keep the VARIANT_DYNAMIC defaults and branch on the uniforms
+layout(constant_id = SHADOW_FILTER_CONSTANT_ID) const uint SHADOW_FILTER = VARIANT_DYNAMIC;
+layout(constant_id = VISUALIZE_CASCADES_CONSTANT_ID) const uint VISUALIZE_CASCADES =
+  VARIANT_DYNAMIC;
+
+uint shadow_filter()
+{
+  return SHADOW_FILTER == VARIANT_DYNAMIC ? params.shadowFilter : SHADOW_FILTER;
+}
+
+bool visualize_cascades()
+{
+  return VISUALIZE_CASCADES == VARIANT_DYNAMIC ? params.visualizeCascades
+                                               : VISUALIZE_CASCADES != 0u;
+}
+
+// Picks the finest cascade that contains the point, cascades are ordered by distance
+float sample_shadow(vec3 wPos, out uint cascade)
+{
+  for (cascade = 0; cascade < SHADOW_CASCADE_COUNT; ++cascade)
+  {
+    const vec4 posLightClipSpace = params.cascadeMatrices[cascade] * vec4(wPos, 1.0f);
+    const vec3 posLightSpaceNDC = posLightClipSpace.xyz / posLightClipSpace.w;
+
+    // just shift coords from [-1,1] to [0,1]
+    const vec2 shadowTexCoord = posLightSpaceNDC.xy * 0.5f + vec2(0.5f, 0.5f);
+
+    const bool outOfView = any(lessThan(shadowTexCoord, vec2(0.0001f)))
+      || any(greaterThan(shadowTexCoord, vec2(0.9999f))) || posLightSpaceNDC.z > 1.0f;
+    if (outOfView)
+      continue;
+
+    if (shadow_filter() == SHADOW_FILTER_PCF)
+    {
+      const vec2 texelSize = 1.0f / vec2(textureSize(shadowMap, 0).xy);
+      float lit = 0.0f;
+      for (int y = -1; y <= 1; ++y)
+        for (int x = -1; x <= 1; ++x)
+        {
+          const vec2 coord = shadowTexCoord + vec2(x, y) * texelSize;
+          const float depth = textureLod(shadowMap, vec3(coord, cascade), 0).x;
+          lit += posLightSpaceNDC.z < depth + 0.001f ? 1.0f : 0.0f;
+        }
+      return lit / 9.0f;
+    }
+
+    const float depth = textureLod(shadowMap, vec3(shadowTexCoord, cascade), 0).x;
+    return posLightSpaceNDC.z < depth + 0.001f ? 1.0f : 0.0f;
+  }
+
+  return 1.0f;
+}
+
+// Diffuse contribution of the point lights of the fragment's cluster
+vec3 point_lights(vec2 fragCoord, vec3 wPos, vec3 wNorm)
+{
+  const uvec2 range = light_cluster_range(fragCoord, wPos);
+
+  vec3 result = vec3(0.0f);
+  for (uint i = 0; i < range.y; ++i)
+  {
+    const PointLight light = clusteredLights[clusterLightIndices[range.x + i]];
+    const vec3 toLight = light.position - wPos;
+    const float dist = length(toLight);
+    const float falloff = clamp(1.0f - dist / light.radius, 0.0f, 1.0f);
+    const float nDotL = max(dot(wNorm, toLight / max(dist, 1e-4f)), 0.0f);
+    result += light.color * (light.intensity * falloff * falloff * nDotL);
+  }
+  return result;
+}
+
+vec4 shade_surface(
+  vec2 fragCoord, vec3 wPos, vec3 wNorm, vec3 albedo, float roughness, float metallic)
+{
+  uint cascade;
+  const float shadow = sample_shadow(wPos, cascade);
+
+  const vec4 dark_violet = vec4(0.59f, 0.0f, 0.82f, 1.0f);
+  const vec4 chartreuse  = vec4(0.5f, 1.0f, 0.0f, 1.0f);
+
+  const vec4 lightColor1 = mix(dark_violet, chartreuse, abs(sin(params.time)));
+
+  const vec3 lightDir   = normalize(params.lightPos - wPos);
+  const vec4 lightColor = max(dot(wNorm, lightDir), 0.0f) * lightColor1;
+  const float ambient = 0.05;
+  // Light formula is pretty arbitrary and most definitely wrong
+  vec4 color = (lightColor * shadow + ambient) * vec4(albedo * (1.0f - metallic), 1.0f);
+
+  // Blinn-Phong highlight, vanishes for fully rough surfaces
+  const vec3 viewDir = normalize(params.cameraPos - wPos);
+  const vec3 halfDir = normalize(lightDir + viewDir);
+  const float smoothness = 1.0f - roughness;
+  const float shininess = 1.0f + 255.0f * smoothness * smoothness;
+  const float specular = pow(max(dot(wNorm, halfDir), 0.0f), shininess) * smoothness * smoothness;
+  const vec3 specularColor = mix(vec3(0.04f), albedo, metallic);
+  color.rgb += specular * specularColor * lightColor1.rgb * shadow;
+
+  color.rgb += point_lights(fragCoord, wPos, wNorm) * albedo * (1.0f - metallic);
+
+  if (visualize_cascades())
+  {
+    const vec3 cascadeColors[4] = vec3[](
+      vec3(1.0f, 0.3f, 0.3f), vec3(0.3f, 1.0f, 0.3f), vec3(0.3f, 0.3f, 1.0f), vec3(1.0f, 1.0f, 0.3f));
+    color.rgb *= cascade < SHADOW_CASCADE_COUNT ? cascadeColors[cascade % 4] : vec3(1.0f);
+  }
+
+  return color;
+}
+
+#endif // SHADING_GLSL_INCLUDED
@@ -11,9 +11,14 @@ layout(location = 1) in vec4 vTexCoordAndTang;
 layout(push_constant) uniform params_t
 {
   mat4 mProjView;
-  mat4 mModel;
 } params;
 
+// Written every frame, every draw passes its index as firstInstance
+layout(std430, binding = 2) readonly buffer DrawMatrices_t
+{
+  mat4 drawMatrices[];
+};
+
 
 layout (location = 0 ) out VS_OUT
 {
@@ -21,18 +26,23 @@ layout (location = 0 ) out VS_OUT
   vec3 wNorm;
   vec3 wTangent;
   vec2 texCoord;
+  flat uint material;
 } vOut;
 
-out gl_PerVertex { vec4 gl_Position; };
+// The forward pass tests depth for equality after the prepass (depth_only.vert)
+out gl_PerVertex { invariant vec4 gl_Position; };
 void main(void)
 {
+  const mat4 mModel = drawMatrices[gl_InstanceIndex];
+
   const vec4 wNorm = vec4(decode_normal(floatBitsToInt(vPosNorm.w)),     0.0f);
   const vec4 wTang = vec4(decode_normal(floatBitsToInt(vTexCoordAndTang.z)), 0.0f);
 
-  vOut.wPos = (params.mModel * vec4(vPosNorm.xyz, 1.0f)).xyz;
-  vOut.wNorm = normalize(mat3(transpose(inverse(params.mModel))) * wNorm.xyz);
-  vOut.wTangent = normalize(mat3(transpose(inverse(params.mModel))) * wTang.xyz);
+  vOut.wPos = (mModel * vec4(vPosNorm.xyz, 1.0f)).xyz;
+  vOut.wNorm = normalize(mat3(transpose(inverse(mModel))) * wNorm.xyz);
+  vOut.wTangent = normalize(mat3(transpose(inverse(mModel))) * wTang.xyz);
   vOut.texCoord = vTexCoordAndTang.xy;
+  vOut.material = floatBitsToUint(vTexCoordAndTang.w);
 
   gl_Position   = params.mProjView * vec4(vOut.wPos, 1.0);
 }
@@ -0,0 +1,53 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "unpack_attributes.glsl"
+
+
+layout(location = 0) in vec4 vPosNorm;
+layout(location = 1) in vec4 vTexCoordAndTang;
+
+layout(push_constant) uniform params_t
+{
+  mat4 mProjView;
+} params;
+
+// Filled by the GPU culling pass, see SceneCuller
+layout(std430, binding = 2, set = 0) readonly buffer InstanceMatrices_t
+{
+  mat4 instanceMatrices[];
+};
+
+layout(std430, binding = 3, set = 0) readonly buffer DrawInstanceIndices_t
+{
+  uint drawInstanceIndices[];
+};
+
+
+layout (location = 0 ) out VS_OUT
+{
+  vec3 wPos;
+  vec3 wNorm;
+  vec3 wTangent;
+  vec2 texCoord;
+  flat uint material;
+} vOut;
+
+// Has to match depth_only_indirect.vert exactly, see simple.vert
+out gl_PerVertex { invariant vec4 gl_Position; };
+void main(void)
+{
+  const mat4 mModel = instanceMatrices[drawInstanceIndices[gl_InstanceIndex]];
+
+  const vec4 wNorm = vec4(decode_normal(floatBitsToInt(vPosNorm.w)),     0.0f);
+  const vec4 wTang = vec4(decode_normal(floatBitsToInt(vTexCoordAndTang.z)), 0.0f);
+
+  vOut.wPos = (mModel * vec4(vPosNorm.xyz, 1.0f)).xyz;
+  vOut.wNorm = normalize(mat3(transpose(inverse(mModel))) * wNorm.xyz);
+  vOut.wTangent = normalize(mat3(transpose(inverse(mModel))) * wTang.xyz);
+  vOut.texCoord = vTexCoordAndTang.xy;
+  vOut.material = floatBitsToUint(vTexCoordAndTang.w);
+
+  gl_Position   = params.mProjView * vec4(vOut.wPos, 1.0);
+}
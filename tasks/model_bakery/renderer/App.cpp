@@ -1,40 +1,85 @@
 #include "App.hpp"
 
+#include <spdlog/spdlog.h>
 #include <tracy/Tracy.hpp>
 
 
-App::App()
+static constexpr float BENCHMARK_ORBIT_RADIUS = 10.0f;
+static constexpr float BENCHMARK_ORBIT_HEIGHT = 10.0f;
+static constexpr float BENCHMARK_ORBIT_DURATION = 20.0f;
+
+static constexpr float CAMERA_RECORDING_INTERVAL = 0.1f;
+static constexpr const char* DEFAULT_CAMERA_PATH = "camera_path.txt";
+
+App::App(RunOptions app_options)
+  : options{app_options}
+  , fixedStep{
+      app_options,
+      FixedStepRunner::Hooks{
+        .poll =
+          [this]() {
+            if (!windowing)
+              return true;
+            windowing->poll();
+            return !mainWindow->isBeingClosed();
+          },
+        .draw = [this]() { drawFrame(); },
+        .reportMetrics =
+          [this](BenchmarkRecorder& recorder) { renderer->reportFrameMetrics(recorder); },
+      }}
 {
-  glm::uvec2 initialRes = {1280, 720};
-  mainWindow = windowing.createWindow(
-    OsWindow::CreateInfo{
-      .resolution = initialRes,
-    });
+  if (!options.headless)
+  {
+    windowing = std::make_unique<OsWindowingManager>();
+    mainWindow = windowing->createWindow(
+      OsWindow::CreateInfo{
+        .resolution = options.resolution,
+      });
+  }
 
-  renderer.reset(new Renderer(initialRes));
+  renderer.reset(new Renderer(options.resolution, options.headless));
 
-  auto instExts = windowing.getRequiredVulkanInstanceExtensions();
-  renderer->initVulkan(instExts);
+  if (options.headless)
+  {
+    renderer->initVulkan({});
+    renderer->initFrameDelivery({}, [res = options.resolution]() { return res; });
+  }
+  else
+  {
+    auto instExts = windowing->getRequiredVulkanInstanceExtensions();
+    renderer->initVulkan(instExts);
 
-  auto surface = mainWindow->createVkSurface(etna::get_context().getInstance());
+    auto surface = mainWindow->createVkSurface(etna::get_context().getInstance());
 
-  renderer->initFrameDelivery(std::move(surface), [this]() { return mainWindow->getResolution(); });
+    renderer->initFrameDelivery(
+      std::move(surface), [this]() { return mainWindow->getResolution(); });
+  }
 
   mainCam.lookAt({0, 10, 10}, {0, 0, 0}, {0, 1, 0});
 
-  renderer->loadScene(GRAPHICS_COURSE_RESOURCES_ROOT "/scenes/low_poly_dark_town/scene.gltf");
+  // The many_objects workload, thousands of instances of a single mesh
+  renderer->loadScene(GRAPHICS_COURSE_RESOURCES_ROOT "/scenes/Avocado/Avocado.gltf");
 }
 
-void App::run()
+bool App::run()
 {
-  double lastTime = windowing.getTime();
+  if (options.benchmark)
+    return runBenchmark();
+
+  if (options.headless)
+  {
+    fixedStep.runHeadless();
+    return true;
+  }
+
+  double lastTime = windowing->getTime();
   while (!mainWindow->isBeingClosed())
   {
-    const double currTime = windowing.getTime();
+    const double currTime = windowing->getTime();
     const float diffTime = static_cast<float>(currTime - lastTime);
     lastTime = currTime;
 
-    windowing.poll();
+    windowing->poll();
 
     processInput(diffTime);
 
@@ -42,6 +87,26 @@ void App::run()
 
     FrameMark;
   }
+
+  return true;
+}
+
+bool App::runBenchmark()
+{
+  const auto path = options.cameraPath.empty()
+    ? std::optional{CameraPath::orbit(
+        {0, 0, 0}, BENCHMARK_ORBIT_RADIUS, BENCHMARK_ORBIT_HEIGHT, BENCHMARK_ORBIT_DURATION)}
+    : CameraPath::load(options.cameraPath);
+  if (!path)
+    return false;
+
+  return fixedStep.runBenchmark(
+    path->getDuration(), [&](float time) { path->apply(time, mainCam); });
+}
+
+double App::getTime() const
+{
+  return windowing && !options.benchmark ? windowing->getTime() : fixedStep.getTime();
 }
 
 void App::processInput(float dt)
@@ -63,9 +128,72 @@ void App::processInput(float dt)
   if (mainWindow->captureMouse)
     rotateCam(mainCam, mainWindow->mouse, dt);
 
+  if (mainWindow->keyboard[KeyboardKey::kC] == ButtonState::Falling)
+    toggleCameraRecording();
+  if (mainWindow->keyboard[KeyboardKey::kP] == ButtonState::Falling)
+    toggleCameraPlayback();
+  updateCameraPath(dt);
+
   renderer->debugInput(mainWindow->keyboard);
 }
 
+void App::toggleCameraRecording()
+{
+  if (cameraPlayback)
+    return;
+
+  if (!cameraRecorder)
+  {
+    cameraRecorder.emplace(CAMERA_RECORDING_INTERVAL);
+    spdlog::info("Recording the camera path, press C again to stop");
+    return;
+  }
+
+  const auto path = cameraRecorder->finish();
+  cameraRecorder.reset();
+
+  const auto file = options.cameraPath.empty() ? DEFAULT_CAMERA_PATH : options.cameraPath;
+  if (path.save(file))
+    spdlog::info(
+      "Saved {} camera keyframes over {:.1f} s to {}",
+      path.getKeyframeCount(),
+      path.getDuration(),
+      file.string());
+}
+
+void App::toggleCameraPlayback()
+{
+  if (cameraRecorder)
+    return;
+
+  if (cameraPlayback)
+  {
+    cameraPlayback.reset();
+    return;
+  }
+
+  cameraPlayback =
+    CameraPath::load(options.cameraPath.empty() ? DEFAULT_CAMERA_PATH : options.cameraPath);
+  cameraPlaybackTime = 0;
+}
+
+void App::updateCameraPath(float dt)
+{
+  if (cameraRecorder)
+    cameraRecorder->update(dt, mainCam);
+
+  if (!cameraPlayback)
+    return;
+
+  cameraPlayback->apply(cameraPlaybackTime, mainCam);
+  cameraPlaybackTime += dt;
+  if (cameraPlaybackTime > cameraPlayback->getDuration())
+  {
+    spdlog::info("Camera path playback finished");
+    cameraPlayback.reset();
+  }
+}
+
 void App::drawFrame()
 {
   ZoneScoped;
@@ -73,7 +201,7 @@ void App::drawFrame()
   renderer->update(
     FramePacket{
       .mainCam = mainCam,
-      .currentTime = static_cast<float>(windowing.getTime()),
+      .currentTime = static_cast<float>(getTime()),
     });
   renderer->drawFrame();
 }
@@ -1,7 +1,12 @@
 #pragma once
 
+#include <filesystem>
+
 #include "wsi/OsWindowingManager.hpp"
 #include "scene/Camera.hpp"
+#include "scene/CameraPath.hpp"
+#include "render_utils/RunOptions.hpp"
+#include "render_utils/FixedStepRunner.hpp"
 
 #include "Renderer.hpp"
 
@@ -9,25 +14,41 @@
 class App
 {
 public:
-  App();
+  explicit App(RunOptions app_options);
 
-  void run();
+  // False if a benchmark failed or regressed
+  bool run();
 
 private:
+  bool runBenchmark();
+  double getTime() const;
   void processInput(float dt);
+  void toggleCameraRecording();
+  void toggleCameraPlayback();
+  void updateCameraPath(float dt);
   void drawFrame();
 
   void moveCam(Camera& cam, const Keyboard& kb, float dt);
   void rotateCam(Camera& cam, const Mouse& ms, float dt);
 
 private:
-  OsWindowingManager windowing;
+  RunOptions options;
+
+  // Neither exists in headless mode
+  std::unique_ptr<OsWindowingManager> windowing;
   std::unique_ptr<OsWindow> mainWindow;
+  // Headless runs and benchmarks, frames are a fixed step apart
+  FixedStepRunner fixedStep;
 
   float camMoveSpeed = 1;
   float camRotateSpeed = 0.1f;
   float zoomSensitivity = 2.0f;
   Camera mainCam;
 
+  // Recording and playback of the main camera, it ignores input while a path is played
+  std::optional<CameraPathRecorder> cameraRecorder;
+  std::optional<CameraPath> cameraPlayback;
+  float cameraPlaybackTime = 0;
+
   std::unique_ptr<Renderer> renderer;
 };
@@ -5,10 +5,12 @@
 #include <etna/RenderTargetStates.hpp>
 #include <etna/PipelineManager.hpp>
 #include <etna/Profiling.hpp>
+#include <render_utils/PipelineCache.hpp>
 
 
-Renderer::Renderer(glm::uvec2 res)
-  : resolution{res}
+Renderer::Renderer(glm::uvec2 res, bool headless_rendering)
+  : headless{headless_rendering}
+  , resolution{res}
 {
 }
 
@@ -21,7 +23,8 @@ void Renderer::initVulkan(std::span<const char*> instance_extensions)
 
   std::vector<const char*> deviceExtensions;
 
-  deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+  if (!headless)
+    deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 
   etna::initialize(
     etna::InitParams{
@@ -37,30 +40,49 @@ void Renderer::initVulkan(std::span<const char*> instance_extensions)
 
 void Renderer::initFrameDelivery(vk::UniqueSurfaceKHR a_surface, ResolutionProvider res_provider)
 {
+  ETNA_VERIFY(headless == !a_surface);
+
   resolutionProvider = std::move(res_provider);
 
   auto& ctx = etna::get_context();
 
   commandManager = ctx.createPerFrameCmdMgr();
 
-  window = ctx.createWindow(
-    etna::Window::CreateInfo{
-      .surface = std::move(a_surface),
-    });
+  if (headless)
+    offscreenFrames =
+      std::make_unique<OffscreenFrames>(OffscreenFrames::CreateInfo{.resolution = resolution});
+  else
+  {
+    window = ctx.createWindow(
+      etna::Window::CreateInfo{
+        .surface = std::move(a_surface),
+      });
 
-  auto [w, h] = window->recreateSwapchain(
-    etna::Window::DesiredProperties{
-      .resolution = {resolution.x, resolution.y},
-      .vsync = useVsync,
-    });
+    auto [w, h] = window->recreateSwapchain(
+      etna::Window::DesiredProperties{
+        .resolution = {resolution.x, resolution.y},
+        .vsync = useVsync,
+      });
 
-  resolution = {w, h};
+    resolution = {w, h};
+  }
+
+  pipelineCache = std::make_unique<PipelineCache>(MODEL_BAKERY_RENDERER_PIPELINE_CACHE_DIR);
 
-  worldRenderer = std::make_unique<WorldRenderer>();
+  {
+    // All pipelines of the renderer are created through etna
+    const auto etnaPipelines = pipelineCache->scopeEtnaPipelines();
 
-  worldRenderer->allocateResources(resolution);
-  worldRenderer->loadShaders();
-  worldRenderer->setupPipelines(window->getCurrentFormat());
+    worldRenderer = std::make_unique<WorldRenderer>(offscreenFrames.get());
+
+    worldRenderer->allocateResources(resolution);
+    worldRenderer->loadShaders();
+    worldRenderer->setupPipelines(
+      window ? window->getCurrentFormat() : offscreenFrames->getCurrentFormat());
+  }
+
+  pipelineCache->logCreationStats();
+  pipelineCache->save();
 }
 
 void Renderer::loadScene(std::filesystem::path path)
@@ -82,6 +104,7 @@ void Renderer::debugInput(const Keyboard& kb)
     else
     {
       ETNA_CHECK_VK_RESULT(etna::get_context().getDevice().waitIdle());
+      const auto etnaPipelines = pipelineCache->scopeEtnaPipelines();
       etna::reload_shaders();
       spdlog::info("Successfully reloaded shaders!");
     }
@@ -101,7 +124,7 @@ void Renderer::drawFrame()
 
   etna::begin_frame();
 
-  auto nextSwapchainImage = window->acquireNext();
+  auto nextSwapchainImage = acquireTargetImage();
 
   if (nextSwapchainImage)
   {
@@ -113,13 +136,14 @@ void Renderer::drawFrame()
 
       worldRenderer->renderWorld(currentCmdBuf, image, view);
 
-      etna::set_state(
-        currentCmdBuf,
-        image,
-        vk::PipelineStageFlagBits2::eColorAttachmentOutput,
-        {},
-        vk::ImageLayout::ePresentSrcKHR,
-        vk::ImageAspectFlagBits::eColor);
+      if (window)
+        etna::set_state(
+          currentCmdBuf,
+          image,
+          vk::PipelineStageFlagBits2::eColorAttachmentOutput,
+          {},
+          vk::ImageLayout::ePresentSrcKHR,
+          vk::ImageAspectFlagBits::eColor);
 
       etna::flush_barriers(currentCmdBuf);
 
@@ -130,7 +154,7 @@ void Renderer::drawFrame()
     auto renderingDone = commandManager->submit(
       std::move(currentCmdBuf), std::move(availableSem), std::move(readyForPresentSem));
 
-    const bool presented = window->present(std::move(renderingDone), view);
+    const bool presented = presentTargetImage(std::move(renderingDone), view);
 
     if (!presented)
       nextSwapchainImage = std::nullopt;
@@ -149,6 +173,36 @@ void Renderer::drawFrame()
   etna::end_frame();
 }
 
+void Renderer::reportFrameMetrics(BenchmarkRecorder& recorder) const
+{
+  worldRenderer->reportFrameMetrics(recorder);
+}
+
+std::optional<OffscreenFrames::Frame> Renderer::acquireTargetImage()
+{
+  if (offscreenFrames)
+    return offscreenFrames->acquireNext();
+
+  auto swapchainImage = window->acquireNext();
+  if (!swapchainImage)
+    return std::nullopt;
+
+  auto [image, view, availableSem, readyForPresentSem] = *swapchainImage;
+  return OffscreenFrames::Frame{
+    .image = image,
+    .view = view,
+    .available = availableSem,
+    .readyForPresent = readyForPresentSem,
+  };
+}
+
+bool Renderer::presentTargetImage(vk::Semaphore rendering_done, vk::ImageView view)
+{
+  if (offscreenFrames)
+    return offscreenFrames->present(rendering_done, view);
+  return window->present(rendering_done, view);
+}
+
 Renderer::~Renderer()
 {
   ETNA_CHECK_VK_RESULT(etna::get_context().getDevice().waitIdle());
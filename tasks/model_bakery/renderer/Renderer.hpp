@@ -5,21 +5,26 @@
 #include <glm/glm.hpp>
 #include <function2/function2.hpp>
 
+#include "render_utils/OffscreenFrames.hpp"
 #include "wsi/Keyboard.hpp"
 
 #include "FramePacket.hpp"
 #include "WorldRenderer.hpp"
 
 
+class PipelineCache;
+
 using ResolutionProvider = fu2::unique_function<glm::uvec2() const>;
 
 class Renderer
 {
 public:
-  explicit Renderer(glm::uvec2 resolution);
+  // Headless renderers draw into offscreen images instead of a window
+  explicit Renderer(glm::uvec2 resolution, bool headless = false);
   ~Renderer();
 
   void initVulkan(std::span<const char*> instance_extensions);
+  // The surface is null for headless renderers
   void initFrameDelivery(vk::UniqueSurfaceKHR surface, ResolutionProvider res_provider);
   void recreateSwapchain(glm::uvec2 res);
   void loadScene(std::filesystem::path path);
@@ -28,11 +33,22 @@ public:
   void update(const FramePacket& packet);
   void drawFrame();
 
+  void reportFrameMetrics(BenchmarkRecorder& recorder) const;
+
+private:
+  // Swapchain images are converted to the offscreen frame type, they have the same fields
+  std::optional<OffscreenFrames::Frame> acquireTargetImage();
+  bool presentTargetImage(vk::Semaphore rendering_done, vk::ImageView view);
+
 private:
+  bool headless;
   ResolutionProvider resolutionProvider;
 
+  // Exactly one of them delivers frames
   std::unique_ptr<etna::Window> window;
+  std::unique_ptr<OffscreenFrames> offscreenFrames;
   std::unique_ptr<etna::PerFrameCmdMgr> commandManager;
+  std::unique_ptr<PipelineCache> pipelineCache;
 
   glm::uvec2 resolution;
   bool useVsync = true;
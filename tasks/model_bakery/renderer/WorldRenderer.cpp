@@ -1,14 +1,28 @@
 #include "WorldRenderer.hpp"
 
+#include <algorithm>
+#include <array>
+
 #include <etna/GlobalContext.hpp>
 #include <etna/PipelineManager.hpp>
 #include <etna/RenderTargetStates.hpp>
 #include <etna/Profiling.hpp>
 #include <glm/ext.hpp>
+#include <spdlog/spdlog.h>
+#include <fmt/format.h>
+
 
+static constexpr std::uint32_t BENCHMARK_WARMUP_FRAMES = 32;
+static constexpr std::uint32_t BENCHMARK_MEASURED_FRAMES = 128;
+static constexpr std::string_view FRAME_TIME_METRIC = "frame ms";
+static constexpr std::string_view RECORD_TIME_METRIC = "recording ms";
+static constexpr std::uint32_t MAX_GPU_TIMER_SCOPES = 4;
 
-WorldRenderer::WorldRenderer()
+WorldRenderer::WorldRenderer(const OffscreenFrames* offscreen_frames)
   : sceneMgr{std::make_unique<SceneManager>()}
+  , offscreenFrames{offscreen_frames}
+  , gpuTimer{std::make_unique<GpuTimer>(MAX_GPU_TIMER_SCOPES)}
+  , descriptorSets{std::make_unique<DescriptorSetCache>()}
 {
 }
 
@@ -30,6 +44,70 @@ void WorldRenderer::allocateResources(glm::uvec2 swapchain_resolution)
 void WorldRenderer::loadScene(std::filesystem::path path)
 {
   sceneMgr->selectScene(path);
+
+  groupInstances();
+  descriptorSets->invalidate();
+
+  GpuMemoryReport memoryReport;
+  sceneMgr->reportMemory(memoryReport);
+  memoryReport.addImage(
+    GpuMemoryReport::Category::RenderTargets, "main view depth", mainViewDepth.get());
+  memoryReport.addBuffer(
+    GpuMemoryReport::Category::InstanceData, "instance matrices", instanceMatrices.get());
+  if (offscreenFrames != nullptr)
+    offscreenFrames->reportMemory(memoryReport);
+  memoryReport.queryHeaps();
+  memoryReport.log();
+}
+
+void WorldRenderer::groupInstances()
+{
+  auto instanceMeshes = sceneMgr->getInstanceMeshes();
+  auto instanceMatricesSrc = sceneMgr->getInstanceMatrices();
+  const auto meshCount = sceneMgr->getMeshes().size();
+
+  // Counting sort of the instances by mesh, offsets[m] is the first instance of mesh m
+  meshInstanceOffsets.assign(meshCount + 1, 0);
+  for (const auto meshIdx : instanceMeshes)
+    ++meshInstanceOffsets[meshIdx + 1];
+  for (std::size_t meshIdx = 0; meshIdx < meshCount; ++meshIdx)
+    meshInstanceOffsets[meshIdx + 1] += meshInstanceOffsets[meshIdx];
+
+  std::vector<std::uint32_t> cursors(meshInstanceOffsets.begin(), meshInstanceOffsets.end() - 1);
+  groupedInstances.resize(instanceMeshes.size());
+  for (std::size_t instIdx = 0; instIdx < instanceMeshes.size(); ++instIdx)
+    groupedInstances[cursors[instanceMeshes[instIdx]]++] = static_cast<std::uint32_t>(instIdx);
+
+  // The scene never moves, so the matrices are written once and read by every frame
+  instanceMatrices = etna::get_context().createBuffer(
+    etna::Buffer::CreateInfo{
+      .size = std::max<std::size_t>(groupedInstances.size(), 1) * sizeof(glm::mat4x4),
+      .bufferUsage = vk::BufferUsageFlagBits::eStorageBuffer,
+      .memoryUsage = VMA_MEMORY_USAGE_CPU_TO_GPU,
+      .name = "instance_matrices",
+    });
+  instanceMatrices.map();
+  auto* groupedMatrices = reinterpret_cast<glm::mat4x4*>(instanceMatrices.data());
+  for (std::size_t slot = 0; slot < groupedInstances.size(); ++slot)
+    groupedMatrices[slot] = instanceMatricesSrc[groupedInstances[slot]];
+  instanceMatrices.unmap();
+
+  setInstanceLimit(instanceLimit);
+}
+
+void WorldRenderer::setInstanceLimit(std::size_t limit)
+{
+  instanceLimit = limit;
+
+  // Groups keep the scene order, so the instances below the limit are a prefix of each
+  meshInstanceCounts.resize(meshInstanceOffsets.size() - 1);
+  for (std::size_t meshIdx = 0; meshIdx < meshInstanceCounts.size(); ++meshIdx)
+  {
+    const auto first = groupedInstances.begin() + meshInstanceOffsets[meshIdx];
+    const auto last = groupedInstances.begin() + meshInstanceOffsets[meshIdx + 1];
+    meshInstanceCounts[meshIdx] =
+      static_cast<std::uint32_t>(std::lower_bound(first, last, limit) - first);
+  }
 }
 
 void WorldRenderer::loadShaders()
@@ -39,6 +117,11 @@ void WorldRenderer::loadShaders()
     {MODEL_BAKERY_RENDERER_SHADERS_ROOT "static_mesh.frag.spv",
      MODEL_BAKERY_RENDERER_SHADERS_ROOT "static_mesh.vert.spv"});
   etna::create_program("static_mesh", {MODEL_BAKERY_RENDERER_SHADERS_ROOT "static_mesh.vert.spv"});
+
+  etna::create_program(
+    "static_mesh_instanced_material",
+    {MODEL_BAKERY_RENDERER_SHADERS_ROOT "static_mesh.frag.spv",
+     MODEL_BAKERY_RENDERER_SHADERS_ROOT "static_mesh_instanced.vert.spv"});
 }
 
 void WorldRenderer::setupPipelines(vk::Format swapchain_format)
@@ -69,9 +152,85 @@ void WorldRenderer::setupPipelines(vk::Format swapchain_format)
           .depthAttachmentFormat = vk::Format::eD32Sfloat,
         },
     });
+
+  instancedStaticMeshPipeline = {};
+  instancedStaticMeshPipeline = pipelineManager.createGraphicsPipeline(
+    "static_mesh_instanced_material",
+    etna::GraphicsPipeline::CreateInfo{
+      .vertexShaderInput = sceneVertexInputDesc,
+      .rasterizationConfig =
+        vk::PipelineRasterizationStateCreateInfo{
+          .polygonMode = vk::PolygonMode::eFill,
+          .cullMode = vk::CullModeFlagBits::eBack,
+          .frontFace = vk::FrontFace::eCounterClockwise,
+          .lineWidth = 1.f,
+        },
+      .fragmentShaderOutput =
+        {
+          .colorAttachmentFormats = {swapchain_format},
+          .depthAttachmentFormat = vk::Format::eD32Sfloat,
+        },
+    });
+}
+
+void WorldRenderer::debugInput(const Keyboard& kb)
+{
+  if (kb[KeyboardKey::kI] == ButtonState::Falling && !benchmark.isRunning())
+  {
+    useInstancing = !useInstancing;
+    spdlog::info("Instanced drawing {}", useInstancing ? "enabled" : "disabled");
+  }
+
+  if (kb[KeyboardKey::kN] == ButtonState::Falling && !benchmark.isRunning())
+    startInstancingBenchmark();
 }
 
-void WorldRenderer::debugInput(const Keyboard&) {}
+void WorldRenderer::startInstancingBenchmark()
+{
+  const std::size_t totalInstances = sceneMgr->getInstanceMatrices().size();
+  if (totalInstances == 0)
+  {
+    spdlog::warn("Instancing benchmark: the scene has no instances");
+    return;
+  }
+
+  std::vector<std::size_t> instanceCounts;
+  for (std::size_t count = 1; count < totalInstances; count *= 4)
+    instanceCounts.push_back(count);
+  instanceCounts.push_back(totalInstances);
+
+  // Every instance count is measured without and then with instancing
+  benchmark.start(BenchmarkSweep::Steps{
+    .name = "Instancing benchmark",
+    .count = instanceCounts.size() * 2,
+    .warmupFrames = BENCHMARK_WARMUP_FRAMES,
+    .measuredFrames = BENCHMARK_MEASURED_FRAMES,
+    .apply =
+      [this, instanceCounts](std::size_t step) {
+        setInstanceLimit(instanceCounts[step / 2]);
+        useInstancing = step % 2 == 1;
+      },
+    .measure =
+      [this](BenchmarkRecorder& recorder) {
+        recorder.record(FRAME_TIME_METRIC, lastFrameTime.count());
+        recorder.record(RECORD_TIME_METRIC, lastRecordTime.count());
+      },
+    .describe =
+      [this](std::size_t step, const BenchmarkSweep::StepResult& result) {
+        return fmt::format(
+          "{:>6} instances, {:>9}: frame {:.3f} ms, recording {:.3f} ms",
+          instanceLimit,
+          step % 2 == 1 ? "instanced" : "naive",
+          result.mean(FRAME_TIME_METRIC),
+          result.mean(RECORD_TIME_METRIC));
+      },
+    .restore =
+      [this, prevUseInstancing = useInstancing]() {
+        setInstanceLimit(std::numeric_limits<std::size_t>::max());
+        useInstancing = prevUseInstancing;
+      },
+  });
+}
 
 void WorldRenderer::update(const FramePacket& packet)
 {
@@ -82,6 +241,12 @@ void WorldRenderer::update(const FramePacket& packet)
     const float aspect = float(resolution.x) / float(resolution.y);
     worldViewProj = packet.mainCam.projTm(aspect) * packet.mainCam.viewTm();
   }
+
+  const auto now = std::chrono::steady_clock::now();
+  lastFrameTime = now - lastUpdate;
+  lastUpdate = now;
+
+  benchmark.update();
 }
 
 void WorldRenderer::renderScene(
@@ -101,7 +266,11 @@ void WorldRenderer::renderScene(
   auto meshes = sceneMgr->getMeshes();
   auto relems = sceneMgr->getRenderElements();
 
-  for (std::size_t instIdx = 0; instIdx < instanceMeshes.size(); ++instIdx)
+  const std::size_t instanceCount = std::min(instanceMeshes.size(), instanceLimit);
+
+  std::uint64_t drawCount = 0;
+  std::uint64_t indexCount = 0;
+  for (std::size_t instIdx = 0; instIdx < instanceCount; ++instIdx)
   {
     pushConst2M.model = instanceMatrices[instIdx];
 
@@ -115,8 +284,63 @@ void WorldRenderer::renderScene(
       const auto relemIdx = meshes[meshIdx].firstRelem + j;
       const auto& relem = relems[relemIdx];
       cmd_buf.drawIndexed(relem.indexCount, 1, relem.indexOffset, relem.vertexOffset, 0);
+      ++drawCount;
+      indexCount += relem.indexCount;
+    }
+  }
+
+  renderCounters.add(RenderCounters::Counter::PushConstants, instanceCount);
+  renderCounters.add(RenderCounters::Counter::Draws, drawCount);
+  renderCounters.add(RenderCounters::Counter::Triangles, indexCount / 3);
+  renderCounters.add(RenderCounters::Counter::InstancesVisited, instanceCount);
+  renderCounters.add(RenderCounters::Counter::RelemsVisited, drawCount);
+}
+
+void WorldRenderer::renderSceneInstanced(
+  vk::CommandBuffer cmd_buf, const glm::mat4x4& glob_tm, vk::PipelineLayout pipeline_layout)
+{
+  if (!sceneMgr->getVertexBuffer())
+    return;
+
+  cmd_buf.bindVertexBuffers(0, {sceneMgr->getVertexBuffer()}, {0});
+  cmd_buf.bindIndexBuffer(sceneMgr->getIndexBuffer(), 0, vk::IndexType::eUint32);
+
+  // Model matrices are fetched by gl_InstanceIndex, so only projView is pushed
+  cmd_buf.pushConstants<glm::mat4x4>(
+    pipeline_layout, vk::ShaderStageFlagBits::eVertex, 0, {glob_tm});
+
+  auto meshes = sceneMgr->getMeshes();
+  auto relems = sceneMgr->getRenderElements();
+
+  const std::size_t instanceCount = std::min(groupedInstances.size(), instanceLimit);
+
+  std::uint64_t drawCount = 0;
+  std::uint64_t triangleCount = 0;
+  std::uint64_t relemCount = 0;
+  for (std::size_t meshIdx = 0; meshIdx < meshes.size(); ++meshIdx)
+  {
+    const auto firstInstance = meshInstanceOffsets[meshIdx];
+    const auto meshInstanceCount = meshInstanceCounts[meshIdx];
+    if (meshInstanceCount == 0)
+      continue;
+
+    for (std::size_t j = 0; j < meshes[meshIdx].relemCount; ++j)
+    {
+      const auto relemIdx = meshes[meshIdx].firstRelem + j;
+      const auto& relem = relems[relemIdx];
+      cmd_buf.drawIndexed(
+        relem.indexCount, meshInstanceCount, relem.indexOffset, relem.vertexOffset, firstInstance);
+      ++drawCount;
+      triangleCount += std::uint64_t{relem.indexCount} / 3 * meshInstanceCount;
+      relemCount += meshInstanceCount;
     }
   }
+
+  renderCounters.add(RenderCounters::Counter::PushConstants);
+  renderCounters.add(RenderCounters::Counter::Draws, drawCount);
+  renderCounters.add(RenderCounters::Counter::Triangles, triangleCount);
+  renderCounters.add(RenderCounters::Counter::InstancesVisited, instanceCount);
+  renderCounters.add(RenderCounters::Counter::RelemsVisited, relemCount);
 }
 
 void WorldRenderer::renderWorld(
@@ -124,6 +348,11 @@ void WorldRenderer::renderWorld(
 {
   ETNA_PROFILE_GPU(cmd_buf, renderWorld);
 
+  gpuTimer->beginFrame(cmd_buf);
+  renderCounters.beginFrame();
+  descriptorSets->beginFrame();
+  const auto timerScope = gpuTimer->beginScope(cmd_buf, "Forward");
+
   // draw final scene to screen
   {
     ETNA_PROFILE_GPU(cmd_buf, renderForward);
@@ -134,7 +363,53 @@ void WorldRenderer::renderWorld(
       {{.image = target_image, .view = target_image_view}},
       {.image = mainViewDepth.get(), .view = mainViewDepth.getView({})});
 
-    cmd_buf.bindPipeline(vk::PipelineBindPoint::eGraphics, staticMeshPipeline.getVkPipeline());
-    renderScene(cmd_buf, worldViewProj, staticMeshPipeline.getVkPipelineLayout());
+    const auto recordStart = std::chrono::steady_clock::now();
+
+    if (useInstancing && instanceMatrices.get())
+    {
+      auto instancedMaterialInfo = etna::get_shader_program("static_mesh_instanced_material");
+
+      // The matrices buffer only changes with the scene, so the same set is reused every frame
+      const std::array bindings{etna::Binding{0, instanceMatrices.genBinding()}};
+      const auto set =
+        descriptorSets->get(instancedMaterialInfo.getDescriptorLayoutId(0), bindings);
+
+      cmd_buf.bindPipeline(
+        vk::PipelineBindPoint::eGraphics, instancedStaticMeshPipeline.getVkPipeline());
+      renderCounters.add(RenderCounters::Counter::PipelineBinds);
+      cmd_buf.bindDescriptorSets(
+        vk::PipelineBindPoint::eGraphics,
+        instancedStaticMeshPipeline.getVkPipelineLayout(),
+        0,
+        {set},
+        {});
+      renderSceneInstanced(
+        cmd_buf, worldViewProj, instancedStaticMeshPipeline.getVkPipelineLayout());
+    }
+    else
+    {
+      cmd_buf.bindPipeline(vk::PipelineBindPoint::eGraphics, staticMeshPipeline.getVkPipeline());
+      renderCounters.add(RenderCounters::Counter::PipelineBinds);
+      renderScene(cmd_buf, worldViewProj, staticMeshPipeline.getVkPipelineLayout());
+    }
+
+    lastRecordTime = std::chrono::steady_clock::now() - recordStart;
+  }
+
+  gpuTimer->endScope(cmd_buf, timerScope);
+}
+
+void WorldRenderer::reportFrameMetrics(BenchmarkRecorder& recorder) const
+{
+  for (const auto& result : gpuTimer->getResults())
+    recorder.record(fmt::format("GPU {} ms", result.name), result.milliseconds);
+
+  recorder.record("Recording ms", lastRecordTime.count());
+  for (std::size_t i = 0; i < RenderCounters::COUNTER_COUNT; ++i)
+  {
+    const auto counter = static_cast<RenderCounters::Counter>(i);
+    recorder.record(
+      RenderCounters::getName(counter),
+      static_cast<double>(renderCounters.getLastFrame(counter)));
   }
 }
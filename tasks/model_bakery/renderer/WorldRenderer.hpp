@@ -1,5 +1,8 @@
 #pragma once
 
+#include <chrono>
+#include <limits>
+
 #include <etna/Image.hpp>
 #include <etna/Sampler.hpp>
 #include <etna/Buffer.hpp>
@@ -7,6 +10,12 @@
 #include <glm/glm.hpp>
 
 #include "scene/SceneManager.hpp"
+#include "render_utils/BenchmarkRecorder.hpp"
+#include "render_utils/BenchmarkSweep.hpp"
+#include "render_utils/DescriptorSetCache.hpp"
+#include "render_utils/GpuTimer.hpp"
+#include "render_utils/OffscreenFrames.hpp"
+#include "render_utils/RenderCounters.hpp"
 #include "wsi/Keyboard.hpp"
 
 #include "FramePacket.hpp"
@@ -15,7 +24,8 @@
 class WorldRenderer
 {
 public:
-  WorldRenderer();
+  // Headless renderers pass the images they render to, so that memory reports include them
+  explicit WorldRenderer(const OffscreenFrames* offscreen_frames = nullptr);
 
   void loadScene(std::filesystem::path path);
 
@@ -28,14 +38,24 @@ public:
   void drawGui();
   void renderWorld(
     vk::CommandBuffer cmd_buf, vk::Image target_image, vk::ImageView target_image_view);
+  // GPU time of the latest frame that was read back, CPU recording time and drawn instances
+  void reportFrameMetrics(BenchmarkRecorder& recorder) const;
 
 private:
   void renderScene(
     vk::CommandBuffer cmd_buf, const glm::mat4x4& glob_tm, vk::PipelineLayout pipeline_layout);
+  void renderSceneInstanced(
+    vk::CommandBuffer cmd_buf, const glm::mat4x4& glob_tm, vk::PipelineLayout pipeline_layout);
+
+  // Instances are grouped once per scene, a limit only shortens the groups
+  void groupInstances();
+  void setInstanceLimit(std::size_t limit);
 
+  void startInstancingBenchmark();
 
 private:
   std::unique_ptr<SceneManager> sceneMgr;
+  const OffscreenFrames* offscreenFrames = nullptr;
 
   etna::Image mainViewDepth;
   etna::Buffer constants;
@@ -50,6 +70,29 @@ private:
   glm::mat4x4 lightMatrix;
 
   etna::GraphicsPipeline staticMeshPipeline{};
+  etna::GraphicsPipeline instancedStaticMeshPipeline{};
+
+  // Groups instances by mesh and draws every relem once with instanceCount = N
+  bool useInstancing = true;
+  // Transforms of all instances grouped by mesh, in scene order within a group
+  etna::Buffer instanceMatrices;
+  std::vector<std::uint32_t> meshInstanceOffsets;
+  // Scene indices of the grouped instances
+  std::vector<std::uint32_t> groupedInstances;
+  // Leading instances of every group that are below the limit
+  std::vector<std::uint32_t> meshInstanceCounts;
+  // Only the first instanceLimit instances of the scene are drawn
+  std::size_t instanceLimit = std::numeric_limits<std::size_t>::max();
+  std::chrono::duration<double, std::milli> lastRecordTime{};
+  std::unique_ptr<GpuTimer> gpuTimer;
+  std::unique_ptr<DescriptorSetCache> descriptorSets;
+  RenderCounters renderCounters;
+
+  // Sweeps instance counts in both drawing modes, press 'N' to start
+  BenchmarkSweep benchmark;
+  // Between consecutive updates, so vsync has to be off for it to mean anything
+  std::chrono::duration<double, std::milli> lastFrameTime{};
+  std::chrono::steady_clock::time_point lastUpdate;
 
   glm::uvec2 resolution;
 };